@@ -34,6 +34,9 @@
 /* Defined if your system has setenv of its own */
 #define HAVE_SETENV
 
+/* Defined if your system has sem_timedwait of its own */
+#define HAVE_SEM_TIMEDWAIT
+
 /* Defined if your system has strupr of its own */
 #undef HAVE_STRUPR
 
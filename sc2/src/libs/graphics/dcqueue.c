@@ -25,110 +25,208 @@
 #include "libs/timelib.h"
 #include "libs/log.h"
 #include "libs/misc.h"
+#include "libs/proflib.h"
 		// for TFB_DEBUG_HALT
 
 
+// The DCQ is filled by a single thread (the game logic thread) and
+// emptied by another (the main() thread, in TFB_FlushGraphics()). Pushing
+// and popping commands is lock-free; DCQ_Mutex is only taken by Lock_DCQ()
+// callers, by the producer while a Lock_DCQ() is in effect, and for
+// commands queued from any other thread (see TFB_DrawCommandQueue_Push()).
+// A batch in progress is written into the queue as it goes, but only
+// becomes visible to the consumer, all at once, in Synchronize_DCQ().
+
 static RecursiveMutex DCQ_Mutex;
 
 CondVar RenderingCond;
 
-TFB_DrawCommand DCQ[DCQ_MAX];
-
 TFB_DrawCommandQueue DrawCommandQueue;
 
+// A command queued from outside the producer thread. It is popped once
+// the consumer has reached the producer's insertion point as it was
+// at the time the command was queued.
+typedef struct tfb_dcqforeign
+{
+	TFB_DrawCommand Command;
+	DWORD After;
+	struct tfb_dcqforeign *next;
+} TFB_DCQForeign;
+
 #define FPS_PERIOD  (ONE_SECOND / 100)
 int RenderedFrames = 0;
 
 
+static TFB_DCQSegment *
+AllocSegment (DWORD capacity, DWORD start)
+{
+	TFB_DCQSegment *seg;
+
+	seg = HMalloc (sizeof (TFB_DCQSegment));
+	seg->Commands = HMalloc (capacity * sizeof (TFB_DrawCommand));
+	seg->Mask = capacity - 1;
+	seg->Start = start;
+	seg->End = start;
+	seg->Next = NULL;
+	seg->Closed = 0;
+	return seg;
+}
+
+static void
+FreeSegment (TFB_DCQSegment *seg)
+{
+	HFree (seg->Commands);
+	HFree (seg);
+}
+
+// Producer only. Continue queueing in a new segment of 'capacity'
+// commands. The consumer frees the old one once it is done with it.
+static void
+SwitchSegment (DWORD capacity)
+{
+	TFB_DCQSegment *seg = DrawCommandQueue.ProducerSeg;
+	DWORD index = DrawCommandQueue.InsertionPoint;
+
+	seg->End = index;
+	seg->Next = AllocSegment (capacity, index);
+	AtomicStoreRelease (&seg->Closed, 1);
+	DrawCommandQueue.ProducerSeg = seg->Next;
+}
+
+// Producer only. The number of commands that can still be queued in the
+// current segment.
+static DWORD
+FreeSlots (void)
+{
+	TFB_DCQSegment *seg = DrawCommandQueue.ProducerSeg;
+	DWORD front = AtomicLoadAcquire (&DrawCommandQueue.Front);
+	DWORD first;
+
+	// While the consumer is still in an older segment, everything in
+	// this one is still to be popped.
+	first = ((SDWORD) (front - seg->Start) > 0) ? front : seg->Start;
+	return seg->Mask + 1 - (DrawCommandQueue.InsertionPoint - first);
+}
+
 // Wait for the queue to be emptied.
 static void
-TFB_WaitForSpace (int requested_slots)
+TFB_WaitForSpace (int requested_slots, BOOLEAN holdingLock)
 {
-	int old_depth, i;
+	int old_depth = 0;
+	int i;
 	log_add (log_Debug, "DCQ overload (Size = %d, FullSize = %d, "
 			"Requested = %d).  Sleeping until renderer is done.",
-			DrawCommandQueue.Size, DrawCommandQueue.FullSize,
-			requested_slots);
-	// Restore the DCQ locking level.  I *think* this is
-	// always 1, but...
+			(int) TFB_DrawCommandQueue_Size (),
+			(int) TFB_DrawCommandQueue_FullSize (), requested_slots);
 	TFB_BatchReset ();
-	old_depth = GetRecursiveMutexDepth (DCQ_Mutex);
+	// Let the renderer take the DCQ lock while we wait, if we hold it.
+	if (holdingLock)
+		old_depth = GetRecursiveMutexDepth (DCQ_Mutex);
 	for (i = 0; i < old_depth; i++)
 		UnlockRecursiveMutex (DCQ_Mutex);
 	WaitCondVar (RenderingCond);
 	for (i = 0; i < old_depth; i++)
 		LockRecursiveMutex (DCQ_Mutex);
 	log_add (log_Debug, "DCQ clear (Size = %d, FullSize = %d).  Continuing.",
-			DrawCommandQueue.Size, DrawCommandQueue.FullSize);
+			(int) TFB_DrawCommandQueue_Size (),
+			(int) TFB_DrawCommandQueue_FullSize ());
+}
+
+// Producer only. Make sure the next 'slots' commands fit. A batch in
+// progress grows the queue rather than being broken up; otherwise we wait
+// for the renderer to make room.
+static void
+MakeRoom (int slots, BOOLEAN holdingLock)
+{
+	for (;;)
+	{
+		DWORD capacity = DrawCommandQueue.ProducerSeg->Mask + 1;
+
+		if (FreeSlots () >= (DWORD) slots)
+		{
+			if (capacity > DCQ_MAX && TFB_DrawCommandQueue_FullSize () == 0)
+			{
+				// The renderer caught up; give back the memory.
+				SwitchSegment (DCQ_MAX);
+			}
+			return;
+		}
+
+		if (DrawCommandQueue.Batching && capacity < DCQ_MAX_GROWN)
+		{
+			log_add (log_Debug, "DCQ growing to %d commands for a batch "
+					"of %d.", (int) capacity * 2,
+					(int) (DrawCommandQueue.InsertionPoint
+					- DrawCommandQueue.Back));
+			SwitchSegment (capacity * 2);
+			continue;
+		}
+
+		TFB_WaitForSpace (slots, holdingLock);
+	}
 }
 
 void
 Lock_DCQ (int slots)
 {
 	LockRecursiveMutex (DCQ_Mutex);
-	while (DrawCommandQueue.FullSize >= DCQ_MAX - slots)
-	{
-		TFB_WaitForSpace (slots);
+	DrawCommandQueue.Locked++;
+	if (slots > 0)
+	{	// Only the producer asks for slots
+		MakeRoom (slots, TRUE);
 	}
 }
 
 void
 Unlock_DCQ (void)
 {
+	DrawCommandQueue.Locked--;
 	UnlockRecursiveMutex (DCQ_Mutex);
 }
 
-// Always have the DCQ locked when calling this.
+// Producer only. Publishes all queued commands to the consumer, unless a
+// batch is in progress.
 static void
 Synchronize_DCQ (void)
 {
 	if (!DrawCommandQueue.Batching)
 	{
-		int front = DrawCommandQueue.Front;
-		int back  = DrawCommandQueue.InsertionPoint;
-		DrawCommandQueue.Back = DrawCommandQueue.InsertionPoint;
-		if (front <= back)
-		{
-			DrawCommandQueue.Size = (back - front);
-		}
-		else
-		{
-			DrawCommandQueue.Size = (back + DCQ_MAX - front);
-		}
-		DrawCommandQueue.FullSize = DrawCommandQueue.Size;
+		AtomicStoreRelease (&DrawCommandQueue.Back,
+				DrawCommandQueue.InsertionPoint);
 	}
 }
 
 void
 TFB_BatchGraphics (void)
 {
-	LockRecursiveMutex (DCQ_Mutex);
 	DrawCommandQueue.Batching++;
-	UnlockRecursiveMutex (DCQ_Mutex);
 }
 
 void
 TFB_UnbatchGraphics (void)
 {	
-	LockRecursiveMutex (DCQ_Mutex);
 	if (DrawCommandQueue.Batching)
 	{
 		DrawCommandQueue.Batching--;
 	}
+	if (DrawCommandQueue.BreakBatch)
+	{
+		TFB_BatchReset ();
+		return;
+	}
 	Synchronize_DCQ ();
-	UnlockRecursiveMutex (DCQ_Mutex);
 }
 
 // Cancel all pending batch operations, making them unbatched.  This will
 // cause a small amount of flicker when invoked, but prevents 
 // batching problems from freezing the game.
+// Producer only; the consumer sets DrawCommandQueue.BreakBatch instead.
 void
 TFB_BatchReset (void)
 {
-	LockRecursiveMutex (DCQ_Mutex);
 	DrawCommandQueue.Batching = 0;
+	DrawCommandQueue.BreakBatch = 0;
 	Synchronize_DCQ ();
-	UnlockRecursiveMutex (DCQ_Mutex);
 }
 
 
@@ -141,8 +239,12 @@ Init_DrawCommandQueue (void)
 	DrawCommandQueue.Front = 0;
 	DrawCommandQueue.InsertionPoint = 0;
 	DrawCommandQueue.Batching = 0;
-	DrawCommandQueue.FullSize = 0;
-	DrawCommandQueue.Size = 0;
+	DrawCommandQueue.BreakBatch = 0;
+	DrawCommandQueue.Locked = 0;
+	DrawCommandQueue.ProducerSeg = AllocSegment (DCQ_MAX, 0);
+	DrawCommandQueue.ConsumerSeg = DrawCommandQueue.ProducerSeg;
+	DrawCommandQueue.Foreign = NULL;
+	DrawCommandQueue.ForeignCount = 0;
 
 	TFB_BBox_Init (ScreenWidth, ScreenHeight);
 
@@ -156,6 +258,8 @@ Init_DrawCommandQueue (void)
 void
 Uninit_DrawCommandQueue (void)
 {
+	TFB_DCQSegment *seg;
+
 	if (RenderingCond)
 	{
 		DestroyCondVar (RenderingCond);
@@ -167,61 +271,149 @@ Uninit_DrawCommandQueue (void)
 		DestroyRecursiveMutex (DCQ_Mutex);
 		DCQ_Mutex = 0;
 	}
+
+	seg = DrawCommandQueue.ConsumerSeg;
+	while (seg)
+	{
+		TFB_DCQSegment *next = seg->Closed ? seg->Next : NULL;
+		FreeSegment (seg);
+		seg = next;
+	}
+	DrawCommandQueue.ProducerSeg = NULL;
+	DrawCommandQueue.ConsumerSeg = NULL;
+
+	while (DrawCommandQueue.Foreign)
+	{
+		TFB_DCQForeign *next = DrawCommandQueue.Foreign->next;
+		HFree (DrawCommandQueue.Foreign);
+		DrawCommandQueue.Foreign = next;
+	}
+	DrawCommandQueue.ForeignCount = 0;
 }
 
-void
-TFB_DrawCommandQueue_Push (TFB_DrawCommand* Command)
+static void
+PushForeign (const TFB_DrawCommand *Command)
 {
-	Lock_DCQ (1);
-	DCQ[DrawCommandQueue.InsertionPoint] = *Command;
-	DrawCommandQueue.InsertionPoint = (DrawCommandQueue.InsertionPoint + 1)
-			% DCQ_MAX;
-	DrawCommandQueue.FullSize++;
-	Synchronize_DCQ ();
-	Unlock_DCQ ();
+	TFB_DCQForeign *cmd;
+	TFB_DCQForeign **link;
+
+	cmd = HMalloc (sizeof (TFB_DCQForeign));
+	cmd->Command = *Command;
+	cmd->After = DrawCommandQueue.InsertionPoint;
+	cmd->next = NULL;
+
+	LockRecursiveMutex (DCQ_Mutex);
+	for (link = &DrawCommandQueue.Foreign; *link; link = &(*link)->next)
+		;
+	*link = cmd;
+	DrawCommandQueue.ForeignCount++;
+	UnlockRecursiveMutex (DCQ_Mutex);
 }
 
-int
-TFB_DrawCommandQueue_Pop (TFB_DrawCommand *target)
+static int
+PopForeign (DWORD front, TFB_DrawCommand *target)
 {
-	LockRecursiveMutex (DCQ_Mutex);
+	TFB_DCQForeign *cmd;
 
-	if (DrawCommandQueue.Size == 0)
+	LockRecursiveMutex (DCQ_Mutex);
+	cmd = DrawCommandQueue.Foreign;
+	if (!cmd || (SDWORD) (front - cmd->After) < 0)
 	{
-		Unlock_DCQ ();
-		return (0);
+		UnlockRecursiveMutex (DCQ_Mutex);
+		return 0;
 	}
+	DrawCommandQueue.Foreign = cmd->next;
+	DrawCommandQueue.ForeignCount--;
+	UnlockRecursiveMutex (DCQ_Mutex);
+
+	*target = cmd->Command;
+	HFree (cmd);
+	return 1;
+}
+
+static void
+PushCommand (TFB_DrawCommand *Command, BOOLEAN holdingLock)
+{
+	TFB_DCQSegment *seg;
+	DWORD index;
 
-	if (DrawCommandQueue.Front == DrawCommandQueue.Back &&
-			DrawCommandQueue.Size != DCQ_MAX)
+	if (DrawCommandQueue.BreakBatch)
+		TFB_BatchReset ();
+	MakeRoom (1, holdingLock);
+
+	seg = DrawCommandQueue.ProducerSeg;
+	index = DrawCommandQueue.InsertionPoint;
+	seg->Commands[(index - seg->Start) & seg->Mask] = *Command;
+	AtomicStoreRelease (&DrawCommandQueue.InsertionPoint, index + 1);
+	Synchronize_DCQ ();
+}
+
+// TFB_DRAWCOMMANDTYPE_REINITVIDEO may also be queued from the main()
+// thread (see checkExclusiveThread()), so it does not go through the
+// ring; it is handed over under DCQ_Mutex instead.
+void
+TFB_DrawCommandQueue_Push (TFB_DrawCommand* Command)
+{
+	if (Command->Type == TFB_DRAWCOMMANDTYPE_REINITVIDEO)
 	{
-		log_add (log_Debug, "Augh!  Assertion failure in DCQ!  "
-				"Front == Back, Size != DCQ_MAX");
-		DrawCommandQueue.Size = 0;
+		PushForeign (Command);
+		return;
+	}
+
+	if (DrawCommandQueue.Locked)
+	{	// Someone holds the DCQ (most likely the renderer deterring
+		// livelock); wait for them to let go.
+		Lock_DCQ (1);
+		PushCommand (Command, TRUE);
 		Unlock_DCQ ();
-		return (0);
 	}
+	else
+	{
+		PushCommand (Command, FALSE);
+	}
+}
 
-	*target = DCQ[DrawCommandQueue.Front];
-	DrawCommandQueue.Front = (DrawCommandQueue.Front + 1) % DCQ_MAX;
+int
+TFB_DrawCommandQueue_Pop (TFB_DrawCommand *target)
+{
+	DWORD front = DrawCommandQueue.Front;
+	DWORD back;
+	TFB_DCQSegment *seg;
 
-	DrawCommandQueue.Size--;
-	DrawCommandQueue.FullSize--;
-	UnlockRecursiveMutex (DCQ_Mutex);
+	if (DrawCommandQueue.ForeignCount && PopForeign (front, target))
+		return 1;
+
+	back = AtomicLoadAcquire (&DrawCommandQueue.Back);
+	if (front == back)
+		return 0;
+
+	seg = DrawCommandQueue.ConsumerSeg;
+	while (AtomicLoadAcquire (&seg->Closed) && front == seg->End)
+	{
+		// The producer has moved on, and we have everything from
+		// this segment.
+		TFB_DCQSegment *next = seg->Next;
+		FreeSegment (seg);
+		seg = next;
+	}
+	DrawCommandQueue.ConsumerSeg = seg;
+
+	*target = seg->Commands[(front - seg->Start) & seg->Mask];
+	AtomicStoreRelease (&DrawCommandQueue.Front, front + 1);
 
 	return 1;
 }
 
+// Consumer only. Drops everything visible to the consumer; a batch still
+// in progress will show up once it is committed.
 void
 TFB_DrawCommandQueue_Clear ()
 {
+	TFB_DrawCommand DC;
+
 	LockRecursiveMutex (DCQ_Mutex);
-	DrawCommandQueue.Size = 0;
-	DrawCommandQueue.Front = 0;
-	DrawCommandQueue.Back = 0;
-	DrawCommandQueue.Batching = 0;
-	DrawCommandQueue.FullSize = 0;
-	DrawCommandQueue.InsertionPoint = 0;
+	while (TFB_DrawCommandQueue_Pop (&DC))
+		;
 	UnlockRecursiveMutex (DCQ_Mutex);
 }
 
@@ -325,9 +517,9 @@ TFB_FlushGraphics (void)
 	int commands_handled;
 	BOOLEAN livelock_deterrence;
 
-	// This is technically a locking violation on DrawCommandQueue.Size,
-	// but it is likely to not be very destructive.
-	if (DrawCommandQueue.Size == 0)
+	// The producer may be adding commands as we look, but we will get
+	// to those on the next call.
+	if (TFB_DrawCommandQueue_Size () == 0 && !DrawCommandQueue.ForeignCount)
 	{
 		static int last_fade = 255;
 		static int last_transition = 255;
@@ -354,18 +546,21 @@ TFB_FlushGraphics (void)
 		return;
 	}
 
+	PROF_BEGIN ("FlushGraphics");
 	if (GfxFlags & TFB_GFXFLAGS_SHOWFPS)
 		computeFPS ();
 
 	commands_handled = 0;
 	livelock_deterrence = FALSE;
 
-	if (DrawCommandQueue.FullSize > DCQ_FORCE_BREAK_SIZE)
+	if (TFB_DrawCommandQueue_FullSize () > DCQ_FORCE_BREAK_SIZE)
 	{
-		TFB_BatchReset ();
+		// Only the producer may touch the batch; it will reset it
+		// when it queues its next command.
+		DrawCommandQueue.BreakBatch = 1;
 	}
 
-	if (DrawCommandQueue.Size > DCQ_FORCE_SLOWDOWN_SIZE)
+	if (TFB_DrawCommandQueue_Size () > DCQ_FORCE_SLOWDOWN_SIZE)
 	{
 		Lock_DCQ (-1);
 		livelock_deterrence = TRUE;
@@ -384,8 +579,8 @@ TFB_FlushGraphics (void)
 		}
 
 		++commands_handled;
-		if (!livelock_deterrence && commands_handled + DrawCommandQueue.Size
-				> DCQ_LIVELOCK_MAX)
+		if (!livelock_deterrence && commands_handled
+				+ TFB_DrawCommandQueue_Size () > DCQ_LIVELOCK_MAX)
 		{
 			// log_add (log_Debug, "Initiating livelock deterrence!");
 			livelock_deterrence = TRUE;
@@ -621,6 +816,7 @@ TFB_FlushGraphics (void)
 	TFB_SwapBuffers (TFB_REDRAW_NO);
 	RenderedFrames++;
 	BroadcastCondVar (RenderingCond);
+	PROF_END ();
 }
 
 void
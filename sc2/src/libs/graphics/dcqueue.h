@@ -36,15 +36,23 @@
 // on slower machines.  Even there, it's seems nonexistent outside of
 // communications screens.  --Michael
 
+// The DCQ starts out DCQ_MAX commands large. When a batch does not fit,
+// the queue grows (doubling each time) up to DCQ_MAX_GROWN commands,
+// instead of breaking up the batch. Unbatched commands never grow the
+// queue; the producer waits for the renderer instead. Once the queue is
+// empty again, it shrinks back to DCQ_MAX.  Both must be powers of 2.
+
 #ifdef DCQ_OF_DOOM
 #define DCQ_MAX 512
+#define DCQ_MAX_GROWN 2048
 #define DCQ_FORCE_SLOWDOWN_SIZE 128
-#define DCQ_FORCE_BREAK_SIZE 512
+#define DCQ_FORCE_BREAK_SIZE 2048
 #define DCQ_LIVELOCK_MAX 256
 #else
 #define DCQ_MAX 16384
+#define DCQ_MAX_GROWN 131072
 #define DCQ_FORCE_SLOWDOWN_SIZE 4096
-#define DCQ_FORCE_BREAK_SIZE 16384
+#define DCQ_FORCE_BREAK_SIZE 131072
 #define DCQ_LIVELOCK_MAX 4096
 #endif
 
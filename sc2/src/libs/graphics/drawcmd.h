@@ -165,16 +165,63 @@ typedef struct tfb_drawcommand
 
 // Queue Stuff
 
+// The queue is a single-producer/single-consumer ring, made of a chain of
+// segments so that it can grow without moving commands the consumer may
+// be reading. Command indices only ever increase (modulo 2^32); each
+// segment maps its own range of indices onto its ring.
+typedef struct tfb_dcqsegment TFB_DCQSegment;
+
+struct tfb_dcqsegment
+{
+	TFB_DrawCommand *Commands;
+	DWORD Mask;
+			// Capacity - 1; the capacity is a power of 2
+	DWORD Start;
+			// Index of the first command stored in this segment
+	DWORD End;
+			// Index past the last command stored in this segment;
+			// only valid once Closed is set
+	TFB_DCQSegment *Next;
+			// Only valid once Closed is set
+	volatile DWORD Closed;
+			// Set (with release semantics) by the producer when it moves
+			// on to the next segment
+};
+
 typedef struct tfb_drawcommandqueue
 {
-	int Front;
-	int Back;
-	int InsertionPoint;
+	volatile DWORD Front;
+			// Index of the next command to pop. Only written by the
+			// consumer.
+	volatile DWORD Back;
+			// Index past the last command visible to the consumer. Only
+			// written by the producer.
+	volatile DWORD InsertionPoint;
+			// Index past the last command queued, including those of a
+			// batch in progress. Only written by the producer.
 	int Batching;
-	volatile int FullSize;
-	volatile int Size;
+			// Only accessed by the producer
+	volatile DWORD BreakBatch;
+			// Set by the consumer to have the producer perform a
+			// TFB_BatchReset() at its next opportunity
+	volatile DWORD Locked;
+			// Depth of Lock_DCQ(). While non-zero, the producer goes
+			// through DCQ_Mutex, so Lock_DCQ() still holds it off.
+	TFB_DCQSegment *ProducerSeg;
+	TFB_DCQSegment *ConsumerSeg;
+	struct tfb_dcqforeign *Foreign;
+	volatile DWORD ForeignCount;
+			// Commands queued from outside the producer thread; see
+			// TFB_DrawCommandQueue_Push()
 } TFB_DrawCommandQueue;
 
+// Commands visible to the consumer
+#define TFB_DrawCommandQueue_Size() \
+		((DWORD) (DrawCommandQueue.Back - DrawCommandQueue.Front))
+// Commands queued, including a batch in progress
+#define TFB_DrawCommandQueue_FullSize() \
+		((DWORD) (DrawCommandQueue.InsertionPoint - DrawCommandQueue.Front))
+
 void Init_DrawCommandQueue (void);
 
 void Uninit_DrawCommandQueue (void);
@@ -26,10 +26,12 @@ LoadGraphicFile (const char *pStr)
 {
 	uio_Stream *fp;
 
-	// FIXME: this theoretically needs a mechanism to prevent races
+	res_LockLoads ();
 	if (_cur_resfile_name)
-		// something else is loading resources atm
+	{	// something else is loading resources atm, on this thread
+		res_UnlockLoads ();
 		return 0;
+	}
 
 	fp = res_OpenResFile (contentDir, pStr, "rb");
 	if (fp != NULL)
@@ -40,9 +42,11 @@ LoadGraphicFile (const char *pStr)
 		hData = (DRAWABLE)_GetCelData (fp, LengthResFile (fp));
 		_cur_resfile_name = 0;
 		res_CloseResFile (fp);
+		res_UnlockLoads ();
 		return hData;
 	}
 
+	res_UnlockLoads ();
 	return (NULL);
 }
 
@@ -51,10 +55,12 @@ LoadFontFile (const char *pStr)
 {
 	uio_Stream *fp;
 
-	// FIXME: this theoretically needs a mechanism to prevent races
+	res_LockLoads ();
 	if (_cur_resfile_name)
-		// something else is loading resources atm
+	{	// something else is loading resources atm, on this thread
+		res_UnlockLoads ();
 		return 0;
+	}
 
 	fp = res_OpenResFile (contentDir, pStr, "rb");
 	if (fp != NULL)
@@ -65,8 +71,10 @@ LoadFontFile (const char *pStr)
 		hData = (FONT)_GetFontData (fp, LengthResFile (fp));
 		_cur_resfile_name = 0;
 		res_CloseResFile (fp);
+		res_UnlockLoads ();
 		return hData;
 	}
 
+	res_UnlockLoads ();
 	return (0);
 }
@@ -71,6 +71,10 @@ void TFB_ProcessEvents (void);
 bool TFB_SetGamma (float gamma);
 void TFB_UploadTransitionScreen (void);
 int TFB_SupportsHardwareScaling (void);
+// Number of threads the software screen scalers may use
+void TFB_SetScalerThreads (int threads);
+// Headless benchmark of the software graphics paths; returns exit status
+int TFB_RunGfxBenchmark (const char *imageFile);
 // This function should not be called directly
 void TFB_SwapBuffers (int force_full_redraw);
 
@@ -0,0 +1,288 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "port.h"
+#include "libs/graphics/scalecache.h"
+#include "libs/threadlib.h"
+#include "libs/memlib.h"
+#include "libs/log.h"
+
+struct tfb_scaledimage
+{
+	TFB_ScaleKey key;
+	TFB_Canvas canvas;
+	HOT_SPOT hs;
+	EXTENT extent;
+			// Of the image as scaled, as opposed to that of 'canvas'
+	DWORD size;
+			// Bytes of pixel data in 'canvas'
+	DWORD last_used;
+	TFB_Image *owner;
+	TFB_ScaledImage *next;
+			// Next variant of the same image
+	TFB_ScaledImage *lru_prev;
+	TFB_ScaledImage *lru_next;
+			// All variants, most recently used first
+};
+
+static Mutex cache_mutex;
+static TFB_ScaledImage *lru_head;
+static TFB_ScaledImage *lru_tail;
+static DWORD use_counter;
+static TFB_ScaleCacheStats cache_stats;
+
+static inline void
+LockCache (void)
+{
+	// Images may outlive the graphics system
+	if (cache_mutex)
+		LockMutex (cache_mutex);
+}
+
+static inline void
+UnlockCache (void)
+{
+	if (cache_mutex)
+		UnlockMutex (cache_mutex);
+}
+
+static BOOLEAN
+KeysEqual (const TFB_ScaleKey *k1, const TFB_ScaleKey *k2)
+{
+	return k1->scale == k2->scale && k1->type == k2->type &&
+			k1->colormap_version == k2->colormap_version &&
+			k1->filled == k2->filled &&
+			(!k1->filled || sameColor (k1->fill, k2->fill));
+}
+
+static void
+UnlinkLRU (TFB_ScaledImage *entry)
+{
+	if (entry->lru_prev)
+		entry->lru_prev->lru_next = entry->lru_next;
+	else
+		lru_head = entry->lru_next;
+	if (entry->lru_next)
+		entry->lru_next->lru_prev = entry->lru_prev;
+	else
+		lru_tail = entry->lru_prev;
+	entry->lru_prev = NULL;
+	entry->lru_next = NULL;
+}
+
+static void
+MarkUsed (TFB_ScaledImage *entry)
+{
+	if (entry != lru_head)
+	{
+		if (entry->lru_prev || entry->lru_next)
+			UnlinkLRU (entry);
+		entry->lru_next = lru_head;
+		if (lru_head)
+			lru_head->lru_prev = entry;
+		lru_head = entry;
+		if (!lru_tail)
+			lru_tail = entry;
+	}
+	entry->last_used = ++use_counter;
+
+	// The variant an image is drawn with must stay put
+	if (entry->key.filled)
+		entry->owner->CurFilled = entry;
+	else
+		entry->owner->CurScaled = entry;
+}
+
+static inline BOOLEAN
+IsPinned (const TFB_ScaledImage *entry)
+{
+	return entry == entry->owner->CurScaled ||
+			entry == entry->owner->CurFilled;
+}
+
+static void
+RemoveEntry (TFB_ScaledImage *entry)
+{
+	TFB_Image *img = entry->owner;
+	TFB_ScaledImage **link;
+
+	UnlinkLRU (entry);
+	for (link = &img->ScaleCache; *link != entry; link = &(*link)->next)
+		;
+	*link = entry->next;
+	img->ScaleCacheCount--;
+
+	if (img->CurScaled == entry)
+		img->CurScaled = NULL;
+	if (img->CurFilled == entry)
+		img->CurFilled = NULL;
+
+	cache_stats.entries--;
+	cache_stats.bytes -= entry->size;
+
+	TFB_DrawCanvas_Delete (entry->canvas);
+	HFree (entry);
+}
+
+static TFB_ScaledImage *
+OldestUnpinned (TFB_Image *img)
+{
+	TFB_ScaledImage *entry;
+	TFB_ScaledImage *oldest = NULL;
+
+	for (entry = img->ScaleCache; entry; entry = entry->next)
+	{
+		if (IsPinned (entry))
+			continue;
+		if (!oldest || (SDWORD) (entry->last_used - oldest->last_used) < 0)
+			oldest = entry;
+	}
+	return oldest;
+}
+
+static DWORD
+CanvasSize (TFB_Canvas canvas)
+{
+	EXTENT size;
+
+	TFB_DrawCanvas_GetExtent (canvas, &size);
+	return (DWORD) TFB_DrawCanvas_GetStride (canvas) * size.height;
+}
+
+void
+TFB_ScaleCache_Init (void)
+{
+	if (!cache_mutex)
+		cache_mutex = CreateMutex ("scale cache", SYNC_CLASS_VIDEO);
+}
+
+void
+TFB_ScaleCache_Uninit (void)
+{
+	if (!cache_mutex)
+		return;
+
+	log_add (log_Info, "Scaled image cache: %lu hits, %lu misses, "
+			"%lu evictions, peak %lu KB.",
+			(unsigned long) cache_stats.hits,
+			(unsigned long) cache_stats.misses,
+			(unsigned long) cache_stats.evictions,
+			(unsigned long) (cache_stats.peak_bytes >> 10));
+
+	DestroyMutex (cache_mutex);
+	cache_mutex = 0;
+}
+
+TFB_Canvas
+TFB_ScaleCache_Find (TFB_Image *img, const TFB_ScaleKey *key, HOT_SPOT *hs,
+		EXTENT *extent)
+{
+	TFB_ScaledImage *entry;
+
+	if (img->dirty)
+	{
+		img->dirty = FALSE;
+		TFB_ScaleCache_Flush (img);
+	}
+
+	LockCache ();
+	for (entry = img->ScaleCache; entry && !KeysEqual (&entry->key, key);
+			entry = entry->next)
+		;
+	if (!entry)
+	{
+		cache_stats.misses++;
+		UnlockCache ();
+		return NULL;
+	}
+
+	cache_stats.hits++;
+	MarkUsed (entry);
+	*hs = entry->hs;
+	*extent = entry->extent;
+	UnlockCache ();
+
+	return entry->canvas;
+}
+
+void
+TFB_ScaleCache_Add (TFB_Image *img, const TFB_ScaleKey *key,
+		TFB_Canvas canvas, HOT_SPOT hs, EXTENT extent)
+{
+	TFB_ScaledImage *entry;
+	TFB_ScaledImage *victim;
+
+	entry = HMalloc (sizeof (TFB_ScaledImage));
+	entry->key = *key;
+	entry->canvas = canvas;
+	entry->hs = hs;
+	entry->extent = extent;
+	entry->size = CanvasSize (canvas);
+	entry->owner = img;
+	entry->lru_prev = NULL;
+	entry->lru_next = NULL;
+
+	LockCache ();
+	entry->next = img->ScaleCache;
+	img->ScaleCache = entry;
+	img->ScaleCacheCount++;
+	MarkUsed (entry);
+
+	cache_stats.entries++;
+	cache_stats.bytes += entry->size;
+	if (cache_stats.bytes > cache_stats.peak_bytes)
+		cache_stats.peak_bytes = cache_stats.bytes;
+
+	// Make room among this image's variants first ...
+	while (img->ScaleCacheCount > TFB_SCALE_CACHE_PER_IMAGE
+			&& (victim = OldestUnpinned (img)))
+	{
+		RemoveEntry (victim);
+		cache_stats.evictions++;
+	}
+
+	// ... then among everyone's, least recently used first.
+	victim = lru_tail;
+	while (cache_stats.bytes > TFB_SCALE_CACHE_BUDGET && victim)
+	{
+		TFB_ScaledImage *prev = victim->lru_prev;
+		if (!IsPinned (victim))
+		{
+			RemoveEntry (victim);
+			cache_stats.evictions++;
+		}
+		victim = prev;
+	}
+	UnlockCache ();
+}
+
+void
+TFB_ScaleCache_Flush (TFB_Image *img)
+{
+	LockCache ();
+	while (img->ScaleCache)
+		RemoveEntry (img->ScaleCache);
+	img->ScaledImg = NULL;
+	UnlockCache ();
+}
+
+void
+TFB_ScaleCache_GetStats (TFB_ScaleCacheStats *stats)
+{
+	LockCache ();
+	*stats = cache_stats;
+	UnlockCache ();
+}
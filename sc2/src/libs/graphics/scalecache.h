@@ -0,0 +1,76 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef LIBS_GRAPHICS_SCALECACHE_H_
+#define LIBS_GRAPHICS_SCALECACHE_H_
+
+#include "libs/gfxlib.h"
+#include "libs/graphics/tfb_draw.h"
+
+/* Cache of the scaled and fill-stamped variants of TFB_Images.
+ *
+ * Every image keeps a short list of variants, keyed by scale, scaling
+ * type, the colormap version of a paletted source and, for fill-stamped
+ * variants, the fill color. All variants of all images share one LRU list
+ * and one memory budget. The variant an image is currently drawn with
+ * (TFB_Image.ScaledImg, and the current filled one) is pinned, so it
+ * stays valid for the caller while the image is locked, even when the
+ * cache is trimmed from another thread.
+ *
+ * All functions must be called with the image's mutex held. Writing to
+ * an image sets its 'dirty' flag, which drops all its variants at the
+ * next lookup.
+ */
+
+// Memory the cached variants of all images may use together
+#define TFB_SCALE_CACHE_BUDGET (16 * 1024 * 1024)
+// Variants kept for any one image
+#define TFB_SCALE_CACHE_PER_IMAGE 6
+
+typedef struct
+{
+	int scale;
+			// 0 for an unscaled (fill-stamped) variant
+	int type;
+			// TFB_SCALE_*
+	int colormap_version;
+			// Only relevant for paletted sources
+	BOOLEAN filled;
+	Color fill;
+} TFB_ScaleKey;
+
+typedef struct
+{
+	DWORD hits;
+	DWORD misses;
+	DWORD evictions;
+	DWORD entries;
+	DWORD bytes;
+	DWORD peak_bytes;
+} TFB_ScaleCacheStats;
+
+void TFB_ScaleCache_Init (void);
+void TFB_ScaleCache_Uninit (void);
+
+TFB_Canvas TFB_ScaleCache_Find (TFB_Image *img, const TFB_ScaleKey *key,
+		HOT_SPOT *hs, EXTENT *extent);
+void TFB_ScaleCache_Add (TFB_Image *img, const TFB_ScaleKey *key,
+		TFB_Canvas canvas, HOT_SPOT hs, EXTENT extent);
+void TFB_ScaleCache_Flush (TFB_Image *img);
+
+void TFB_ScaleCache_GetStats (TFB_ScaleCacheStats *stats);
+
+#endif /* LIBS_GRAPHICS_SCALECACHE_H_ */
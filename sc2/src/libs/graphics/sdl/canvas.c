@@ -23,6 +23,7 @@
 #include "libs/graphics/gfx_common.h"
 #include "libs/graphics/tfb_draw.h"
 #include "libs/graphics/cmap.h"
+#include "libs/graphics/scalecache.h"
 #include "libs/log.h"
 #include "libs/memlib.h"
 #include "primitives.h"
@@ -231,6 +232,9 @@ TFB_DrawCanvas_Image (TFB_Image *img, int x, int y, int scale,
 			scaleMode = TFB_SCALE_BILINEAR;
 		}
 
+		// Scaled variants are cached per colormap version
+		if (cmap)
+			img->colormap_version = cmap->version;
 		TFB_DrawImage_FixScaling (img, scale, scaleMode);
 		surf = img->ScaledImg;
 		if (TFB_DrawCanvas_IsPaletted (surf))
@@ -379,7 +383,6 @@ TFB_DrawCanvas_FilledImage (TFB_Image *img, int x, int y, int scale,
 	SDL_Surface *surf;
 	SDL_Palette *palette;
 	int i;
-	bool force_fill = false;
 
 	if (img == 0)
 	{
@@ -398,9 +401,6 @@ TFB_DrawCanvas_FilledImage (TFB_Image *img, int x, int y, int scale,
 			scaleMode = TFB_SCALE_BILINEAR;
 					// no point in trilinear for filled images
 
-		if (scale != img->last_scale || scaleMode != img->last_scale_type)
-			force_fill = true;
-
 		TFB_DrawImage_FixScaling (img, scale, scaleMode);
 		surf = img->ScaledImg;
 		srcRect.x = 0;
@@ -414,13 +414,8 @@ TFB_DrawCanvas_FilledImage (TFB_Image *img, int x, int y, int scale,
 	}
 	else
 	{
-		if (img->last_scale != 0)
-		{
-			// Make sure we remember that the last fill was from
-			// an unscaled image
-			force_fill = true;
-			img->last_scale = 0;
-		}
+		scale = 0;
+		scaleMode = 0;
 
 		surf = img->NormalImg;
 		pSrcRect = NULL;
@@ -450,18 +445,36 @@ TFB_DrawCanvas_FilledImage (TFB_Image *img, int x, int y, int scale,
 	}
 	else
 	{	// fill the non-transparent parts of the image with fillcolor
-		SDL_Surface *newfill = img->FilledImg;
-		SDL_PixelFormat *fillfmt;
+		TFB_ScaleKey key;
+		SDL_Surface *newfill;
+		HOT_SPOT fillHs;
+		EXTENT fillExtent;
 
-		if (newfill && (newfill->w < surf->w || newfill->h < surf->h))
-		{
-			TFB_DrawCanvas_Delete (newfill);
-			newfill = NULL;
+		if (mode.kind == DRAW_ALPHA && surf->format->Amask)
+		{	// Per-pixel alpha and surface alpha will not work together
+			// We have to handle DRAW_ALPHA differently by modulating
+			// the surface alpha channel ourselves.
+			color.a = mode.factor;
+			mode.kind = DRAW_REPLACE;
+		}
+		else
+		{	// Make sure we do not modulate the alpha channel
+			color.a = 0xff;
 		}
 
-		// prepare the filled image
+		// Filled variants are cached alongside the scaled ones
+		key.scale = scale;
+		key.type = scaleMode;
+		key.colormap_version = TFB_DrawCanvas_IsPaletted (img->NormalImg) ?
+				img->colormap_version : 0;
+		key.filled = TRUE;
+		key.fill = color;
+
+		newfill = TFB_ScaleCache_Find (img, &key, &fillHs, &fillExtent);
 		if (!newfill)
-		{
+		{	// image or fillcolor changed - regenerate
+			Uint32 fillColor;
+
 			newfill = SDL_CreateRGBSurface (SDL_SWSURFACE,
 						surf->w, surf->h,
 						surf->format->BitsPerPixel,
@@ -469,33 +482,15 @@ TFB_DrawCanvas_FilledImage (TFB_Image *img, int x, int y, int scale,
 						surf->format->Gmask,
 						surf->format->Bmask,
 						surf->format->Amask);
-			force_fill = true;
-		}
-		fillfmt = newfill->format;
-
-		if (force_fill || !sameColor (img->last_fill, color))
-		{	// image or fillcolor changed - regenerate
-			Uint32 fillColor;
-
-			if (mode.kind == DRAW_ALPHA && fillfmt->Amask)
-			{	// Per-pixel alpha and surface alpha will not work together
-				// We have to handle DRAW_ALPHA differently by modulating
-				// the surface alpha channel ourselves.
-				color.a = mode.factor;
-				mode.kind = DRAW_REPLACE;
-			}
-			else
-			{	// Make sure we do not modulate the alpha channel
-				color.a = 0xff;
-			}
 			fillColor = SDL_MapRGBA (newfill->format, color.r, color.g,
 					color.b, color.a);
 			TFB_DrawCanvas_Fill (surf, fillColor, newfill);
-			// cache filled image if possible
-			img->last_fill = color;
+			// The hotspot and extent are those of 'surf'; not needed
+			fillHs.x = 0;
+			fillHs.y = 0;
+			TFB_ScaleCache_Add (img, &key, newfill, fillHs, img->extent);
 		}
 
-		img->FilledImg = newfill;
 		surf = newfill;
 	}
 
@@ -0,0 +1,729 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+// Headless benchmark of the software graphics paths
+//
+// Runs every screen scaler on every platform the CPU supports, the
+// canvas rescalers, the rotator and the custom blitter over synthetic
+// surfaces (and optionally a PNG given on the command line), and logs
+// the time per output pixel together with a checksum of the output.
+// No window or video mode is needed; everything works on plain
+// software surfaces in a fixed 32bpp format, so the checksums are
+// comparable between runs and machines. On the synthetic content they
+// are checked against the known ones in benchExpected, and the
+// benchmark fails if any of them differs.
+//
+// Started with --benchgfx[=FILE.png]
+
+#include "port.h"
+#include <stdio.h>
+#include <string.h>
+#include SDL_INCLUDE(SDL.h)
+#include "sdl_common.h"
+#include "libs/graphics/gfx_common.h"
+#include "libs/graphics/tfb_draw.h"
+#include "libs/platform.h"
+#include "libs/threadlib.h"
+#include "libs/timelib.h"
+#include "libs/log.h"
+#include "primitives.h"
+#include "png2sdl.h"
+#include "scalers.h"
+#include "types.h"
+
+// Every case runs at least this many times and for at least this long
+#define BENCH_MIN_RUNS 3
+#define BENCH_MIN_TIME (ONE_SECOND / 4)
+
+#define BENCH_SCREEN_WIDTH  320
+#define BENCH_SCREEN_HEIGHT 240
+#define BENCH_SPRITE_SIZE   64
+
+typedef struct
+{
+	SDL_Surface *src;
+	SDL_Surface *mipmap;
+	SDL_Surface *dst;
+	HOT_SPOT src_hs;
+	HOT_SPOT mm_hs;
+	EXTENT size;
+	TFB_ScaleFunc scaler;
+	int scale;
+	int angle;
+	RenderPixelFn plot;
+	int factor;
+	const char *content;
+			// Of the synthetic content, to look up the expected
+			// checksums by; NULL for an image from a file
+} BenchContext;
+
+typedef void (*BenchFunc) (BenchContext *);
+
+static const struct
+{
+	const char *name;
+	int flag;
+} benchScalers[] =
+{
+	{"nearest",  0},
+	{"bilinear", TFB_GFXFLAGS_SCALE_BILINEAR},
+	{"biadapt",  TFB_GFXFLAGS_SCALE_BIADAPT},
+	{"biadv",    TFB_GFXFLAGS_SCALE_BIADAPTADV},
+	{"triscan",  TFB_GFXFLAGS_SCALE_TRISCAN},
+	{"hq",       TFB_GFXFLAGS_SCALE_HQXX},
+};
+
+static const struct
+{
+	const char *name;
+	PLATFORM_TYPE platform;
+	const char *expect;
+			// The platform whose expected checksums apply; SSE and
+			// 3DNow! only add instructions to the MMX code that do not
+			// change the result, but MMX rounds differently from C.
+} benchPlatforms[] =
+{
+	{"c",     PLATFORM_C,     "c"},
+#ifdef MMX_ASM
+	{"mmx",   PLATFORM_MMX,   "mmx"},
+	{"sse",   PLATFORM_SSE,   "mmx"},
+	{"3dnow", PLATFORM_3DNOW, "mmx"},
+#endif
+};
+
+#define ARRAY_SIZE(arr) (sizeof (arr) / sizeof ((arr)[0]))
+
+// What the synthetic content has to come out as
+static const struct
+{
+	const char *content;
+	const char *name;
+	const char *variant;
+	DWORD checksum;
+} benchExpected[] =
+{
+	{"screen", "nearest",   "c",         0x361d9e45},
+	{"screen", "bilinear",  "c",         0x75633041},
+	{"screen", "biadapt",   "c",         0x7bba3611},
+	{"screen", "biadv",     "c",         0x74eb2217},
+	{"screen", "triscan",   "c",         0x510fca23},
+	{"screen", "hq",        "c",         0x8d31dc05},
+#ifdef MMX_ASM
+	{"screen", "nearest",   "mmx",       0x361d9e45},
+	{"screen", "bilinear",  "mmx",       0xf78eee3c},
+	{"screen", "biadapt",   "mmx",       0x7bba3611},
+	{"screen", "biadv",     "mmx",       0x4ff5072a},
+	{"screen", "triscan",   "mmx",       0xe8a5ae17},
+	{"screen", "hq",        "mmx",       0x8d31dc05},
+#endif
+	{"screen", "nearest",   "scale 128", 0xe82cc240},
+	{"screen", "bilinear",  "scale 128", 0x3ec84c14},
+	{"screen", "nearest",   "scale 192", 0x465dfef6},
+	{"screen", "bilinear",  "scale 192", 0x375d9d1e},
+	{"screen", "trilinear", "scale 192", 0xea5c361a},
+	{"sprite", "nearest",   "scale 128", 0xaeb56672},
+	{"sprite", "bilinear",  "scale 128", 0xf4dc0012},
+	{"sprite", "nearest",   "scale 192", 0x1b6ab31b},
+	{"sprite", "bilinear",  "scale 192", 0x79dd7a00},
+	{"sprite", "trilinear", "scale 192", 0x9d8d1a0c},
+	{"sprite", "rotate",    "30 deg",    0x1f408ce0},
+	{"sprite", "rotate",    "45 deg",    0x291210b4},
+	{"sprite", "rotate",    "90 deg",    0xda2b0a32},
+	{"sprite", "blit",      "replace",   0x74a85f07},
+	{"sprite", "blit",      "additive",  0x74335538},
+	{"sprite", "blit",      "alpha",     0x5c9c6d6f},
+};
+
+static DWORD benchMismatches;
+
+
+static BOOLEAN
+Bench_HavePlatform (PLATFORM_TYPE platform)
+{
+	switch (platform)
+	{
+		case PLATFORM_C:
+			return TRUE;
+#ifdef MMX_ASM
+		case PLATFORM_MMX:
+			return SDL_HasMMX ();
+		case PLATFORM_SSE:
+			return SDL_HasSSE ();
+		case PLATFORM_3DNOW:
+			return SDL_Has3DNow ();
+#endif
+		default:
+			return FALSE;
+	}
+}
+
+// 'alpha' is FALSE for surfaces that are drawn on like the screen,
+// which has no alpha channel.
+static SDL_Surface *
+Bench_NewSurface (int w, int h, BOOLEAN alpha)
+{
+	SDL_Surface *surf = SDL_CreateRGBSurface (SDL_SWSURFACE, w, h, 32,
+			0x00ff0000, 0x0000ff00, 0x000000ff, alpha ? 0xff000000 : 0);
+	if (!surf)
+	{
+		log_add (log_Fatal, "Bench_NewSurface(): %s", SDL_GetError ());
+		exit (EXIT_FAILURE);
+	}
+	return surf;
+}
+
+// Small LCG so that the synthetic content is the same everywhere
+static DWORD
+Bench_Random (DWORD *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return (*seed >> 8) & 0xffffff;
+}
+
+// Screen-like content: flat runs, gradients and some noise, which is
+// what makes the adaptive scalers take all of their code paths.
+static SDL_Surface *
+Bench_MakeScreen (void)
+{
+	SDL_Surface *surf = Bench_NewSurface (BENCH_SCREEN_WIDTH,
+			BENCH_SCREEN_HEIGHT, TRUE);
+	DWORD seed = 1;
+	int x, y;
+
+	SDL_LockSurface (surf);
+	for (y = 0; y < surf->h; ++y)
+	{
+		Uint32 *p = (Uint32 *) ((Uint8 *) surf->pixels + y * surf->pitch);
+		Uint32 run = 0xff000000;
+
+		for (x = 0; x < surf->w; ++x)
+		{
+			DWORD r = Bench_Random (&seed);
+
+			if (y < surf->h / 3)
+			{	// horizontal gradient
+				p[x] = 0xff000000 | ((x * 255 / surf->w) << 16)
+						| ((y * 255 / surf->h) << 8);
+			}
+			else if (y < surf->h * 2 / 3)
+			{	// runs of flat colour, like sprites and text
+				if ((r & 0xf) == 0)
+					run = 0xff000000 | Bench_Random (&seed);
+				p[x] = run;
+			}
+			else
+			{	// noise
+				p[x] = 0xff000000 | r;
+			}
+		}
+	}
+	SDL_UnlockSurface (surf);
+
+	return surf;
+}
+
+// Sprite-like content: an opaque disc on a transparent background
+static SDL_Surface *
+Bench_MakeSprite (void)
+{
+	SDL_Surface *surf = Bench_NewSurface (BENCH_SPRITE_SIZE,
+			BENCH_SPRITE_SIZE, TRUE);
+	const int c = BENCH_SPRITE_SIZE / 2;
+	DWORD seed = 2;
+	int x, y;
+
+	SDL_LockSurface (surf);
+	for (y = 0; y < surf->h; ++y)
+	{
+		Uint32 *p = (Uint32 *) ((Uint8 *) surf->pixels + y * surf->pitch);
+
+		for (x = 0; x < surf->w; ++x)
+		{
+			DWORD r = Bench_Random (&seed);
+
+			if ((x - c) * (x - c) + (y - c) * (y - c) < c * c)
+				p[x] = 0xff000000 | r;
+			else
+				p[x] = 0;
+		}
+	}
+	SDL_UnlockSurface (surf);
+
+	return surf;
+}
+
+static SDL_Surface *
+Bench_LoadImage (const char *fileName)
+{
+	SDL_RWops *rwops;
+	SDL_Surface *img;
+	SDL_Surface *surf;
+	SDL_Surface *conv;
+
+	rwops = SDL_RWFromFile (fileName, "rb");
+	if (!rwops)
+	{
+		log_add (log_Error, "Could not open '%s': %s", fileName,
+				SDL_GetError ());
+		return NULL;
+	}
+	img = TFB_png_to_sdl (rwops);
+	SDL_RWclose (rwops);
+	if (!img)
+	{
+		log_add (log_Error, "Could not load '%s': %s", fileName,
+				SDL_GetError ());
+		return NULL;
+	}
+
+	// Bring it into the benchmark format
+	surf = Bench_NewSurface (1, 1, TRUE);
+	conv = SDL_ConvertSurface (img, surf->format, 0);
+	SDL_FreeSurface (surf);
+	SDL_FreeSurface (img);
+	if (!conv)
+		log_add (log_Error, "Could not convert '%s': %s", fileName,
+				SDL_GetError ());
+
+	return conv;
+}
+
+// FNV-1a over the visible pixels of a surface, a byte at a time from
+// the lowest, so that it does not depend on the byte order
+static DWORD
+Bench_Checksum (SDL_Surface *surf)
+{
+	DWORD hash = 0x811c9dc5;
+	int x, y, b;
+
+	SDL_LockSurface (surf);
+	for (y = 0; y < surf->h; ++y)
+	{
+		const Uint32 *p = (const Uint32 *) ((const Uint8 *) surf->pixels
+				+ y * surf->pitch);
+
+		for (x = 0; x < surf->w; ++x)
+		{
+			for (b = 0; b < 32; b += 8)
+			{
+				hash ^= (p[x] >> b) & 0xff;
+				hash *= 0x01000193;
+			}
+		}
+	}
+	SDL_UnlockSurface (surf);
+
+	return hash;
+}
+
+// Returns NULL if nothing is known about what the output should be.
+static const DWORD *
+Bench_Expected (const BenchContext *ctx, const char *name,
+		const char *variant)
+{
+	size_t i;
+
+	if (!ctx->content)
+		return NULL;
+
+	for (i = 0; i < ARRAY_SIZE (benchExpected); ++i)
+	{
+		if (!strcmp (benchExpected[i].content, ctx->content)
+				&& !strcmp (benchExpected[i].name, name)
+				&& !strcmp (benchExpected[i].variant, variant))
+			return &benchExpected[i].checksum;
+	}
+
+	log_add (log_Error, "  No expected checksum for %s %s on the %s.",
+			name, variant, ctx->content);
+	++benchMismatches;
+	return NULL;
+}
+
+// Checks the output against 'expected', unless that is NULL
+static void
+Bench_Run (const char *name, const char *variant, BenchFunc func,
+		BenchContext *ctx, DWORD pixels, const DWORD *expected)
+{
+	TimeCount start, elapsed;
+	DWORD runs = 0;
+	DWORD checksum;
+	double ns;
+
+	// once outside the timing, to warm the caches
+	func (ctx);
+
+	start = GetTimeCounter ();
+	do
+	{
+		func (ctx);
+		++runs;
+		elapsed = GetTimeCounter () - start;
+	} while (runs < BENCH_MIN_RUNS || elapsed < BENCH_MIN_TIME);
+
+	ns = (double) elapsed * 1000000000.0 / ONE_SECOND
+			/ ((double) runs * pixels);
+
+	checksum = Bench_Checksum (ctx->dst);
+	if (expected && checksum != *expected)
+	{
+		log_add (log_Error, "  %-10s %-12s %8.2f ns/px  %6u runs  %08x"
+				"  MISMATCH, expected %08x", name, variant, ns,
+				(unsigned) runs, (unsigned) checksum,
+				(unsigned) *expected);
+		++benchMismatches;
+	}
+	else
+	{
+		log_add (log_User, "  %-10s %-12s %8.2f ns/px  %6u runs  %08x",
+				name, variant, ns, (unsigned) runs, (unsigned) checksum);
+	}
+}
+
+static void
+Bench_Scaler (BenchContext *ctx)
+{
+	SDL_Rect r;
+
+	r.x = 0;
+	r.y = 0;
+	r.w = ctx->src->w;
+	r.h = ctx->src->h;
+
+	SDL_LockSurface (ctx->src);
+	SDL_LockSurface (ctx->dst);
+	ctx->scaler (ctx->src, ctx->dst, &r);
+	SDL_UnlockSurface (ctx->dst);
+	SDL_UnlockSurface (ctx->src);
+}
+
+static void
+Bench_RescaleNearest (BenchContext *ctx)
+{
+	HOT_SPOT dst_hs;
+
+	TFB_DrawCanvas_Rescale_Nearest (ctx->src, ctx->dst, ctx->scale,
+			&ctx->src_hs, &ctx->size, &dst_hs);
+}
+
+static void
+Bench_RescaleBilinear (BenchContext *ctx)
+{
+	HOT_SPOT dst_hs;
+
+	TFB_DrawCanvas_Rescale_Bilinear (ctx->src, ctx->dst, ctx->scale,
+			&ctx->src_hs, &ctx->size, &dst_hs);
+}
+
+static void
+Bench_RescaleTrilinear (BenchContext *ctx)
+{
+	HOT_SPOT dst_hs;
+
+	TFB_DrawCanvas_Rescale_Trilinear (ctx->src, ctx->mipmap, ctx->dst,
+			ctx->scale, &ctx->src_hs, &ctx->mm_hs, &ctx->size, &dst_hs);
+}
+
+static void
+Bench_Rotate (BenchContext *ctx)
+{
+	TFB_DrawCanvas_Rotate (ctx->src, ctx->dst, ctx->angle, ctx->size);
+}
+
+static void
+Bench_Blit (BenchContext *ctx)
+{
+	SDL_Rect src_r;
+	SDL_Rect dst_r;
+	int x, y;
+
+	src_r.x = 0;
+	src_r.y = 0;
+	src_r.w = ctx->src->w;
+	src_r.h = ctx->src->h;
+
+	// Every run starts from the same destination, or the blending modes
+	// would give a result that depends on the number of runs. It is not
+	// black, so that they do blend.
+	SDL_FillRect (ctx->dst, NULL, SDL_MapRGBA (ctx->dst->format,
+			0x40, 0x60, 0x80, 0xff));
+
+	// tile the sprite over the whole destination
+	SDL_LockSurface (ctx->dst);
+	for (y = 0; y < ctx->dst->h; y += ctx->src->h)
+	{
+		for (x = 0; x < ctx->dst->w; x += ctx->src->w)
+		{
+			dst_r.x = x;
+			dst_r.y = y;
+			dst_r.w = src_r.w;
+			dst_r.h = src_r.h;
+			blt_prim (ctx->src, src_r, ctx->plot, ctx->factor,
+					ctx->dst, dst_r);
+		}
+	}
+	SDL_UnlockSurface (ctx->dst);
+}
+
+static void
+Bench_WaitForScalerWorkers (BenchContext *ctx)
+{
+	const int threads = Scale_GetThreads ();
+	TimeCount timeout;
+
+	if (threads <= 1)
+		return;
+
+	// The first scale starts the workers; they are born in
+	// ProcessThreadLifecycles(), and this is the main thread.
+	Bench_Scaler (ctx);
+	timeout = GetTimeCounter () + ONE_SECOND;
+	while (Scale_GetWorkers () < threads - 1
+			&& GetTimeCounter () < timeout)
+	{
+		ProcessThreadLifecycles ();
+		SleepThread (ONE_SECOND / 100);
+	}
+}
+
+static void
+Bench_Scalers (SDL_Surface *src, const char *content)
+{
+	BenchContext ctx;
+	const PLATFORM_TYPE saved_platform = force_platform;
+	const DWORD pixels = src->w * src->h * 4;
+	size_t p, s;
+
+	memset (&ctx, 0, sizeof ctx);
+	ctx.src = src;
+	ctx.dst = Bench_NewSurface (src->w * 2, src->h * 2, FALSE);
+	ctx.content = content;
+
+	log_add (log_User, "Screen scalers, %dx%d -> %dx%d, %d thread(s):",
+			src->w, src->h, ctx.dst->w, ctx.dst->h, Scale_GetThreads ());
+
+	for (p = 0; p < ARRAY_SIZE (benchPlatforms); ++p)
+	{
+		if (!Bench_HavePlatform (benchPlatforms[p].platform))
+		{
+			log_add (log_User, "  (%s not supported by this CPU)",
+					benchPlatforms[p].name);
+			continue;
+		}
+
+		force_platform = benchPlatforms[p].platform;
+		for (s = 0; s < ARRAY_SIZE (benchScalers); ++s)
+		{
+			ctx.scaler = Scale_PrepPlatform (benchScalers[s].flag,
+					src->format);
+			if (p == 0 && s == 0)
+				Bench_WaitForScalerWorkers (&ctx);
+			Bench_Run (benchScalers[s].name, benchPlatforms[p].name,
+					Bench_Scaler, &ctx, pixels, Bench_Expected (&ctx,
+					benchScalers[s].name, benchPlatforms[p].expect));
+		}
+	}
+	force_platform = saved_platform;
+
+	SDL_FreeSurface (ctx.dst);
+}
+
+static void
+Bench_Rescalers (SDL_Surface *src, const char *content)
+{
+	static const int scales[] = { GSCALE_IDENTITY / 2,
+			GSCALE_IDENTITY * 3 / 4 };
+	BenchContext ctx;
+	EXTENT mm_size;
+	HOT_SPOT mm_hs;
+	char variant[32];
+	size_t i;
+
+	memset (&ctx, 0, sizeof ctx);
+	ctx.src = src;
+	ctx.src_hs.x = src->w / 2;
+	ctx.src_hs.y = src->h / 2;
+	// The scaled image may be larger by 1 pixel than the source
+	ctx.dst = Bench_NewSurface (src->w + 1, src->h + 1, TRUE);
+	ctx.content = content;
+
+	// Trilinear needs a half-size mipmap, as the game's content has
+	ctx.mipmap = Bench_NewSurface (src->w / 2 + 1, src->h / 2 + 1, TRUE);
+	TFB_DrawCanvas_Rescale_Bilinear (src, ctx.mipmap, GSCALE_IDENTITY / 2,
+			&ctx.src_hs, &mm_size, &mm_hs);
+	ctx.mm_hs = mm_hs;
+
+	log_add (log_User, "Canvas rescalers, %dx%d:", src->w, src->h);
+
+	for (i = 0; i < ARRAY_SIZE (scales); ++i)
+	{
+		HOT_SPOT hs;
+		DWORD pixels;
+
+		ctx.scale = scales[i];
+		snprintf (variant, sizeof variant, "scale %d", ctx.scale);
+		TFB_DrawCanvas_GetScaledExtent (src, &ctx.src_hs, NULL, NULL,
+				ctx.scale, TFB_SCALE_BILINEAR, &ctx.size, &hs);
+		pixels = ctx.size.width * ctx.size.height;
+		if (!pixels)
+			continue;
+
+		Bench_Run ("nearest", variant, Bench_RescaleNearest, &ctx, pixels,
+				Bench_Expected (&ctx, "nearest", variant));
+		Bench_Run ("bilinear", variant, Bench_RescaleBilinear, &ctx,
+				pixels, Bench_Expected (&ctx, "bilinear", variant));
+		if (ctx.scale > GSCALE_IDENTITY / 2)
+			Bench_Run ("trilinear", variant, Bench_RescaleTrilinear, &ctx,
+					pixels, Bench_Expected (&ctx, "trilinear", variant));
+	}
+
+	SDL_FreeSurface (ctx.mipmap);
+	SDL_FreeSurface (ctx.dst);
+}
+
+static void
+Bench_Rotation (SDL_Surface *src, const char *content)
+{
+	static const int angles[] = { 30, 45, 90 };
+	BenchContext ctx;
+	char variant[32];
+	size_t i;
+
+	memset (&ctx, 0, sizeof ctx);
+	ctx.src = src;
+	ctx.content = content;
+
+	log_add (log_User, "Canvas rotation, %dx%d:", src->w, src->h);
+
+	for (i = 0; i < ARRAY_SIZE (angles); ++i)
+	{
+		ctx.angle = angles[i];
+		TFB_DrawCanvas_GetRotatedExtent (src, ctx.angle, &ctx.size);
+		ctx.dst = TFB_DrawCanvas_New_RotationTarget (src, ctx.angle);
+
+		snprintf (variant, sizeof variant, "%d deg", ctx.angle);
+		Bench_Run ("rotate", variant, Bench_Rotate, &ctx,
+				ctx.size.width * ctx.size.height,
+				Bench_Expected (&ctx, "rotate", variant));
+
+		SDL_FreeSurface (ctx.dst);
+	}
+}
+
+static void
+Bench_Blitter (SDL_Surface *sprite, const char *content)
+{
+	static const struct
+	{
+		const char *name;
+		RenderKind kind;
+		int factor;
+	} modes[] =
+	{
+		{"replace",  renderReplace,  0},
+		{"additive", renderAdditive, ADDITIVE_FACTOR_1},
+		{"alpha",    renderAlpha,    FULLY_OPAQUE_ALPHA / 2},
+	};
+	BenchContext ctx;
+	size_t i;
+
+	memset (&ctx, 0, sizeof ctx);
+	ctx.src = sprite;
+	// The blitter only draws other than opaquely without alpha
+	ctx.dst = Bench_NewSurface (BENCH_SCREEN_WIDTH, BENCH_SCREEN_HEIGHT,
+			FALSE);
+	ctx.content = content;
+
+	log_add (log_User, "Custom blitter, %dx%d tiled over %dx%d:",
+			sprite->w, sprite->h, ctx.dst->w, ctx.dst->h);
+
+	for (i = 0; i < ARRAY_SIZE (modes); ++i)
+	{
+		ctx.plot = renderpixel_for (ctx.dst, modes[i].kind);
+		ctx.factor = modes[i].factor;
+		Bench_Run ("blit", modes[i].name, Bench_Blit, &ctx,
+				ctx.dst->w * ctx.dst->h,
+				Bench_Expected (&ctx, "blit", modes[i].name));
+	}
+
+	SDL_FreeSurface (ctx.dst);
+}
+
+int
+TFB_RunGfxBenchmark (const char *imageFile)
+{
+	SDL_Surface *screen;
+	SDL_Surface *sprite;
+	SDL_Surface *content = NULL;
+
+	// Only for the timer; there is no window
+	if (SDL_Init (SDL_INIT_NOPARACHUTE) == -1)
+	{
+		log_add (log_Fatal, "Could not initialize SDL: %s.",
+				SDL_GetError ());
+		return EXIT_FAILURE;
+	}
+
+	Scale_Init ();
+	TFB_DrawCanvas_Initialize ();
+
+	if (imageFile)
+	{
+		content = Bench_LoadImage (imageFile);
+		if (!content)
+		{
+			SDL_Quit ();
+			return EXIT_FAILURE;
+		}
+	}
+
+	screen = Bench_MakeScreen ();
+	sprite = Bench_MakeSprite ();
+
+	benchMismatches = 0;
+
+	log_add (log_User, "Synthetic content:");
+	Bench_Scalers (screen, "screen");
+	Bench_Rescalers (screen, "screen");
+	Bench_Rescalers (sprite, "sprite");
+	Bench_Rotation (sprite, "sprite");
+	Bench_Blitter (sprite, "sprite");
+
+	if (content)
+	{
+		log_add (log_User, "Content from '%s':", imageFile);
+		Bench_Scalers (content, NULL);
+		Bench_Rescalers (content, NULL);
+		Bench_Rotation (content, NULL);
+		Bench_Blitter (content, NULL);
+		SDL_FreeSurface (content);
+	}
+
+	SDL_FreeSurface (sprite);
+	SDL_FreeSurface (screen);
+
+	Scale_Uninit ();
+	ProcessThreadLifecycles ();
+	SDL_Quit ();
+
+	if (benchMismatches)
+	{
+		log_add (log_Error, "Graphics benchmark: %u results are not what "
+				"they should be.", (unsigned) benchMismatches);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
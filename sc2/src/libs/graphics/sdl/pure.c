@@ -419,34 +419,24 @@ TFB_Pure_ColorLayer (Uint8 r, Uint8 g, Uint8 b, Uint8 a, SDL_Rect *rect)
 	SDL_BlitSurface (fade_color_surface, rect, backbuffer, rect);
 }
 
-void
-Scale_PerfTest (void)
+static void
+Scale_PerfTestRun (void)
 {
 	TimeCount TimeStart, TimeIn;
 	TimeCount Now = 0;
-	SDL_Rect updated = {0, 0, ScreenWidth, ScreenHeight};
+	SDL_Rect updated;
 	int i;
 
-	if (!scaler)
-	{
-		log_add (log_Error, "No scaler configured! "
-				"Run with larger resolution, please");
-		return;
-	}
-	if (!scaled_display)
-	{
-		log_add (log_Error, "Run scaler performance tests "
-				"in Pure mode, please");
-		return;
-	}
-
-	SDL_LockSurface (SDL_Screen);
-	SDL_LockSurface (scaled_display);
+	log_add (log_Debug, "Scaling with %d thread(s), %d worker(s) running",
+			Scale_GetThreads (), Scale_GetWorkers ());
 
 	TimeStart = TimeIn = SDL_GetTicks ();
 
 	for (i = 1; i < 1001; ++i) // run for 1000 frames
 	{
+		updated.x = updated.y = 0;
+		updated.w = ScreenWidth;
+		updated.h = ScreenHeight;
 		scaler (SDL_Screen, scaled_display, &updated);
 		
 		if (GfxFlags & TFB_GFXFLAGS_SCANLINES)
@@ -463,6 +453,35 @@ Scale_PerfTest (void)
 
 	log_add (log_Debug, "Full frames scaled: %d; over %u ms; %d fps\n",
 			(i - 1), Now - TimeStart, i * 1000 / (Now - TimeStart));
+}
+
+void
+Scale_PerfTest (void)
+{
+	const int threads = Scale_GetThreads ();
+
+	if (!scaler)
+	{
+		log_add (log_Error, "No scaler configured! "
+				"Run with larger resolution, please");
+		return;
+	}
+	if (!scaled_display)
+	{
+		log_add (log_Error, "Run scaler performance tests "
+				"in Pure mode, please");
+		return;
+	}
+
+	SDL_LockSurface (SDL_Screen);
+	SDL_LockSurface (scaled_display);
+
+	// Single-threaded first, then tiled if more threads are configured
+	Scale_SetThreads (1);
+	Scale_PerfTestRun ();
+	Scale_SetThreads (threads);
+	if (threads > 1)
+		Scale_PerfTestRun ();
 
 	SDL_UnlockSurface (scaled_display);
 	SDL_UnlockSurface (SDL_Screen);
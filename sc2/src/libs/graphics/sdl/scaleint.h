@@ -93,6 +93,15 @@ typedef struct
 extern void Scale_ExpandRect (SDL_Rect* rect, int expansion,
 				const SDL_Rect* limits);
 
+// most threads the tiled scaler will use, including the calling one
+#define SCALE_MAX_THREADS 16
+
+// scales 'r' with 'func' in horizontal bands on the scaler worker
+// threads; 'expansion' must be what 'func' passes to Scale_ExpandRect()
+extern void Scale_Tiled (TFB_ScaleFunc func, int expansion,
+				SDL_Surface *src, SDL_Surface *dst, SDL_Rect *r);
+extern void Scale_StopWorkers (void);
+
 
 // Standard plain C versions of support functions
 
@@ -18,6 +18,7 @@
 #include "libs/graphics/sdl/sdl_common.h"
 #include "libs/platform.h"
 #include "libs/log.h"
+#include "libs/proflib.h"
 #include "scalers.h"
 #include "scaleint.h"
 #include "2xscalers.h"
@@ -199,12 +200,45 @@ Scale_PlatDefs[] =
 	{SCALEPLAT_NULL,    Scale_C_Functions}
 };
 
+// How far each scaler expands the updated region, which is the same
+// for every platform's version of it
+typedef struct
+{
+	int flag;
+	int expansion;
+} Scale_ExpansionDef_t;
+
+static const Scale_ExpansionDef_t
+Scale_ExpansionDefs[] =
+{
+	{TFB_GFXFLAGS_SCALE_BILINEAR,   1},
+	{TFB_GFXFLAGS_SCALE_BIADAPT,    2},
+	{TFB_GFXFLAGS_SCALE_BIADAPTADV, 2},
+	{TFB_GFXFLAGS_SCALE_TRISCAN,    1},
+	{TFB_GFXFLAGS_SCALE_HQXX,       1},
+	// Default (nearest)
+	{0,                             0}
+};
+
+// The scaler picked by Scale_PrepPlatform(), run through Scale_Tiled()
+static TFB_ScaleFunc Scale_Func = NULL;
+static int Scale_Expansion = 0;
+
+static void
+Scale_TiledDispatch (SDL_Surface *src, SDL_Surface *dst, SDL_Rect *r)
+{
+	PROF_BEGIN ("Scale");
+	Scale_Tiled (Scale_Func, Scale_Expansion, src, dst, r);
+	PROF_END ();
+}
+
 
 TFB_ScaleFunc
 Scale_PrepPlatform (int flags, const SDL_PixelFormat* fmt)
 {
 	const Scale_PlatDef_t* pdef;
 	const Scale_FuncDef_t* fdef;
+	const Scale_ExpansionDef_t* edef;
 
 	(void)flags;
 
@@ -284,6 +318,20 @@ Scale_PrepPlatform (int flags, const SDL_PixelFormat* fmt)
 			++fdef)
 		;
 
-	return fdef->func;
+	Scale_Func = fdef->func;
+
+	for (edef = Scale_ExpansionDefs;
+			(flags & edef->flag) != edef->flag;
+			++edef)
+		;
+	Scale_Expansion = edef->expansion;
+
+	return Scale_TiledDispatch;
+}
+
+void
+Scale_Uninit (void)
+{
+	Scale_StopWorkers ();
 }
 
@@ -24,4 +24,13 @@ typedef void (* TFB_ScaleFunc) (SDL_Surface *src, SDL_Surface *dst,
 
 TFB_ScaleFunc Scale_PrepPlatform (int flags, const SDL_PixelFormat* fmt);
 
+void Scale_Uninit (void);
+
+// Number of threads the screen scalers use, 1 for no worker threads.
+// May be changed at any time.
+void Scale_SetThreads (int threads);
+int Scale_GetThreads (void);
+// Number of worker threads currently available to the scalers
+int Scale_GetWorkers (void);
+
 #endif /* SCALERS_H_ */
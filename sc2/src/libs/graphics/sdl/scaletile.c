@@ -0,0 +1,278 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+// Tiled screen scaling
+//
+// Splits the updated region into horizontal bands and scales them on a
+// small pool of worker threads, the calling thread taking a share of the
+// bands itself.
+//
+// A scaler expands the rectangle it is given by a fixed number of pixels
+// (see Scale_ExpandRect()), because the output for a pixel depends on its
+// neighbours. The bands are cut from the already expanded rectangle and
+// shrunk by that same amount before they are handed to the scaler, so the
+// scaler expands each band back to exactly its slice of the rectangle.
+// The bands read overlapping rows of the source but write disjoint rows
+// of the destination, and the result is identical to a single pass.
+
+#include "types.h"
+#include "libs/graphics/sdl/sdl_common.h"
+#include "libs/threadlib.h"
+#include "libs/log.h"
+#include "scalers.h"
+#include "scaleint.h"
+
+// Bands thinner than this are not worth handing to another thread
+#define SCALE_TILE_MIN_ROWS 16
+
+typedef struct
+{
+	TFB_ScaleFunc func;
+	SDL_Surface *src;
+	SDL_Surface *dst;
+	SDL_Rect bands[SCALE_MAX_THREADS];
+	int numBands;
+	int nextBand;
+			// protected by jobLock
+} Scale_TileJob;
+
+static Scale_TileJob job;
+
+// Number of threads to scale with, including the calling thread
+static volatile int scaleThreads = 1;
+
+static Mutex jobLock;
+static Semaphore workSem;
+		// one count per worker that is to pick up bands
+static Semaphore doneSem;
+		// one count per worker that has run out of bands
+static Semaphore exitSem;
+		// one count per worker that has exited
+
+static int workersStarted;
+		// only touched by the scaling thread
+static int workersRunning;
+		// protected by jobLock
+static volatile BOOLEAN workersQuit;
+
+
+static void
+Scale_RunBands (void)
+{
+	for (;;)
+	{
+		SDL_Rect band;
+		int i;
+
+		LockMutex (jobLock);
+		i = job.nextBand;
+		if (i < job.numBands)
+			job.nextBand++;
+		UnlockMutex (jobLock);
+
+		if (i >= job.numBands)
+			break;
+
+		band = job.bands[i];
+		job.func (job.src, job.dst, &band);
+	}
+}
+
+static int
+Scale_WorkerFunc (void *data)
+{
+	LockMutex (jobLock);
+	workersRunning++;
+	UnlockMutex (jobLock);
+
+	for (;;)
+	{
+		SetSemaphore (workSem);
+		if (workersQuit)
+			break;
+
+		Scale_RunBands ();
+		ClearSemaphore (doneSem);
+	}
+
+	ClearSemaphore (exitSem);
+	(void) data;
+	return 0;
+}
+
+// Workers are started lazily, from whichever thread does the scaling.
+// They are born asynchronously (see StartThread()), and until they are
+// running the calling thread simply takes more of the bands.
+static void
+Scale_StartWorkers (int count)
+{
+	if (workersQuit)
+		return;
+
+	if (!jobLock)
+	{
+		jobLock = CreateMutex ("Scaler job lock", SYNC_CLASS_VIDEO);
+		workSem = CreateSemaphore (0, "Scaler work", SYNC_CLASS_VIDEO);
+		doneSem = CreateSemaphore (0, "Scaler done", SYNC_CLASS_VIDEO);
+		exitSem = CreateSemaphore (0, "Scaler exit", SYNC_CLASS_VIDEO);
+	}
+
+	for (; workersStarted < count; ++workersStarted)
+		StartThread (Scale_WorkerFunc, NULL, 1024, "scaler worker");
+}
+
+void
+Scale_StopWorkers (void)
+{
+	int running;
+	int i;
+
+	if (!jobLock)
+		return;
+
+	LockMutex (jobLock);
+	workersQuit = TRUE;
+	running = workersRunning;
+	UnlockMutex (jobLock);
+
+	for (i = 0; i < workersStarted; ++i)
+		ClearSemaphore (workSem);
+	for (i = 0; i < running; ++i)
+		SetSemaphore (exitSem);
+
+	if (running != workersStarted)
+	{	// A worker that was never born would still wake up to find
+		// the lock gone. Leave the synchronization objects alone.
+		log_add (log_Warning, "Scale_StopWorkers(): %d of %d scaler "
+				"workers never started", workersStarted - running,
+				workersStarted);
+		return;
+	}
+
+	DestroySemaphore (exitSem);
+	DestroySemaphore (doneSem);
+	DestroySemaphore (workSem);
+	DestroyMutex (jobLock);
+	exitSem = doneSem = workSem = NULL;
+	jobLock = NULL;
+	workersStarted = 0;
+	workersRunning = 0;
+}
+
+void
+Scale_SetThreads (int threads)
+{
+	if (threads < 1)
+		threads = 1;
+	else if (threads > SCALE_MAX_THREADS)
+		threads = SCALE_MAX_THREADS;
+
+	scaleThreads = threads;
+}
+
+int
+Scale_GetThreads (void)
+{
+	return scaleThreads;
+}
+
+int
+Scale_GetWorkers (void)
+{
+	int running;
+
+	if (!jobLock)
+		return 0;
+
+	LockMutex (jobLock);
+	running = workersRunning;
+	UnlockMutex (jobLock);
+
+	return running;
+}
+
+void
+Scale_Tiled (TFB_ScaleFunc func, int expansion, SDL_Surface *src,
+		SDL_Surface *dst, SDL_Rect *r)
+{
+	const int threads = scaleThreads;
+	SDL_Rect region = *r;
+	SDL_Rect limits;
+	int helpers;
+	int bands;
+	int i;
+
+	if (threads <= 1 || workersQuit)
+	{
+		func (src, dst, r);
+		return;
+	}
+
+	Scale_StartWorkers (threads - 1);
+
+	limits.x = 0;
+	limits.y = 0;
+	limits.w = src->w;
+	limits.h = src->h;
+	Scale_ExpandRect (&region, expansion, &limits);
+
+	bands = region.h / SCALE_TILE_MIN_ROWS;
+	if (bands > threads)
+		bands = threads;
+
+	LockMutex (jobLock);
+	helpers = workersRunning;
+	UnlockMutex (jobLock);
+	if (helpers > threads - 1)
+		helpers = threads - 1;
+	if (helpers > bands - 1)
+		helpers = bands - 1;
+
+	if (helpers < 1)
+	{
+		func (src, dst, r);
+		return;
+	}
+
+	job.func = func;
+	job.src = src;
+	job.dst = dst;
+	job.numBands = bands;
+	job.nextBand = 0;
+	for (i = 0; i < bands; ++i)
+	{
+		SDL_Rect *band = &job.bands[i];
+		int y0 = region.y + region.h * i / bands;
+		int y1 = region.y + region.h * (i + 1) / bands;
+
+		// The scaler will grow this back by 'expansion' on each side.
+		// Horizontally the original rect expands to the same columns.
+		band->x = r->x;
+		band->w = r->w;
+		band->y = y0 + expansion;
+		band->h = y1 - y0 - 2 * expansion;
+	}
+
+	for (i = 0; i < helpers; ++i)
+		ClearSemaphore (workSem);
+
+	Scale_RunBands ();
+
+	for (i = 0; i < helpers; ++i)
+		SetSemaphore (doneSem);
+
+	*r = region;
+}
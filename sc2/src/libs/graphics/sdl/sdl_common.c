@@ -20,6 +20,7 @@
 #include "opengl.h"
 #include "pure.h"
 #include "primitives.h"
+#include "scalers.h"
 #include "options.h"
 #include "uqmversion.h"
 #include "libs/graphics/drawcmd.h"
@@ -28,6 +29,7 @@
 #include "libs/input/sdl/input.h"
 		// for ProcessInputEvent()
 #include "libs/graphics/bbox.h"
+#include "libs/graphics/scalecache.h"
 #include "port.h"
 #include "libs/uio.h"
 #include "libs/log.h"
@@ -92,6 +94,7 @@ TFB_InitGraphics (int driver, int flags, const char *renderer, int width, int he
 		SDL_ShowCursor (SDL_DISABLE);
 
 	Init_DrawCommandQueue ();
+	TFB_ScaleCache_Init ();
 
 	TFB_DrawCanvas_Initialize ();
 
@@ -104,6 +107,7 @@ TFB_UninitGraphics (void)
 	int i;
 
 	Uninit_DrawCommandQueue ();
+	TFB_ScaleCache_Uninit ();
 
 	for (i = 0; i < TFB_GFX_NUMSCREENS; i++)
 		UnInit_Screen (&SDL_Screens[i]);
@@ -112,10 +116,17 @@ TFB_UninitGraphics (void)
 #ifdef HAVE_OPENGL
 	TFB_GL_UninitGraphics ();
 #endif
+	Scale_Uninit ();
 
 	UnInit_Screen (&format_conv_surf);
 }
 
+void
+TFB_SetScalerThreads (int threads)
+{
+	Scale_SetThreads (threads);
+}
+
 void
 TFB_ProcessEvents ()
 {
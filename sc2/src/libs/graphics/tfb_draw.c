@@ -17,6 +17,7 @@
 #include "gfx_common.h"
 #include "tfb_draw.h"
 #include "drawcmd.h"
+#include "scalecache.h"
 #include "libs/log.h"
 #include "libs/memlib.h"
 
@@ -293,7 +294,6 @@ TFB_DrawImage_New (TFB_Canvas canvas)
 	img->mutex = CreateMutex ("image lock", SYNC_CLASS_VIDEO);
 	img->ScaledImg = NULL;
 	img->MipmapImg = NULL;
-	img->FilledImg = NULL;
 	img->colormap_index = -1;
 	img->colormap_version = 0;
 	img->NormalHs = NullHs;
@@ -302,6 +302,10 @@ TFB_DrawImage_New (TFB_Canvas canvas)
 	img->last_scale_type = -1;
 	img->last_scale = 0;
 	img->dirty = FALSE;
+	img->ScaleCache = NULL;
+	img->CurScaled = NULL;
+	img->CurFilled = NULL;
+	img->ScaleCacheCount = 0;
 	TFB_DrawCanvas_GetExtent (canvas, &img->extent);
 
 	if (TFB_DrawCanvas_IsPaletted (canvas))
@@ -323,7 +327,6 @@ TFB_DrawImage_CreateForScreen (int w, int h, BOOLEAN withalpha)
 	img->mutex = CreateMutex ("image lock", SYNC_CLASS_VIDEO);
 	img->ScaledImg = NULL;
 	img->MipmapImg = NULL;
-	img->FilledImg = NULL;
 	img->colormap_index = -1;
 	img->colormap_version = 0;
 	img->NormalHs = NullHs;
@@ -331,6 +334,11 @@ TFB_DrawImage_CreateForScreen (int w, int h, BOOLEAN withalpha)
 	img->last_scale_hs = NullHs;
 	img->last_scale_type = -1;
 	img->last_scale = 0;
+	img->dirty = FALSE;
+	img->ScaleCache = NULL;
+	img->CurScaled = NULL;
+	img->CurFilled = NULL;
+	img->ScaleCacheCount = 0;
 	img->extent.width = w;
 	img->extent.height = h;
 
@@ -397,6 +405,8 @@ TFB_DrawImage_SetMipmap (TFB_Image *img, TFB_Image *mmimg, int hotx, int hoty)
 	{
 		img->MipmapImg = NULL;
 	}
+	// Trilinear variants were made with the old mipmap
+	img->dirty = TRUE;
 
 	UnlockMutex (mmimg->mutex);
 	UnlockMutex (img->mutex);
@@ -414,18 +424,7 @@ TFB_DrawImage_Delete (TFB_Image *image)
 	LockMutex (image->mutex);
 
 	TFB_DrawCanvas_Delete (image->NormalImg);
-			
-	if (image->ScaledImg)
-	{
-		TFB_DrawCanvas_Delete (image->ScaledImg);
-		image->ScaledImg = 0;
-	}
-
-	if (image->FilledImg)
-	{
-		TFB_DrawCanvas_Delete (image->FilledImg);
-		image->FilledImg = 0;
-	}
+	TFB_ScaleCache_Flush (image);
 
 	UnlockMutex (image->mutex);
 	DestroyMutex (image->mutex);
@@ -433,34 +432,51 @@ TFB_DrawImage_Delete (TFB_Image *image)
 	HFree (image);
 }
 
+// Sets up image->ScaledImg, from the scale cache if possible.
+// The image must be locked.
 void
 TFB_DrawImage_FixScaling (TFB_Image *image, int target, int type)
 {
-	if (image->dirty || !image->ScaledImg ||
-			target != image->last_scale ||
-			type != image->last_scale_type)
+	TFB_ScaleKey key;
+	TFB_Canvas scaled;
+	HOT_SPOT hs;
+	EXTENT extent;
+
+	key.scale = target;
+	key.type = type;
+	key.colormap_version = TFB_DrawCanvas_IsPaletted (image->NormalImg) ?
+			image->colormap_version : 0;
+	key.filled = FALSE;
+	key.fill = BUILD_COLOR_RGBA (0, 0, 0, 0);
+
+	scaled = TFB_ScaleCache_Find (image, &key, &hs, &extent);
+	if (!scaled)
 	{
-		image->dirty = FALSE;
-		image->ScaledImg = TFB_DrawCanvas_New_ScaleTarget (image->NormalImg,
-			image->ScaledImg, type, image->last_scale_type);
-		
+		scaled = TFB_DrawCanvas_New_ScaleTarget (image->NormalImg,
+				NULL, type, -1);
+
 		if (type == TFB_SCALE_NEAREST)
 			TFB_DrawCanvas_Rescale_Nearest (image->NormalImg,
-					image->ScaledImg, target, &image->NormalHs,
-					&image->extent, &image->last_scale_hs);
+					scaled, target, &image->NormalHs,
+					&extent, &hs);
 		else if (type == TFB_SCALE_BILINEAR)
 			TFB_DrawCanvas_Rescale_Bilinear (image->NormalImg,
-					image->ScaledImg, target, &image->NormalHs,
-					&image->extent, &image->last_scale_hs);
+					scaled, target, &image->NormalHs,
+					&extent, &hs);
 		else
 			TFB_DrawCanvas_Rescale_Trilinear (image->NormalImg,
-					image->MipmapImg, image->ScaledImg, target,
+					image->MipmapImg, scaled, target,
 					&image->NormalHs, &image->MipmapHs,
-					&image->extent, &image->last_scale_hs);
+					&extent, &hs);
 
-		image->last_scale_type = type;
-		image->last_scale = target;
+		TFB_ScaleCache_Add (image, &key, scaled, hs, extent);
 	}
+
+	image->ScaledImg = scaled;
+	image->extent = extent;
+	image->last_scale_hs = hs;
+	image->last_scale_type = type;
+	image->last_scale = target;
 }
 
 BOOLEAN
@@ -35,12 +35,15 @@ typedef enum {
 #include "libs/graphics/gfx_common.h"
 #include "libs/graphics/cmap.h"
 
+typedef struct tfb_scaledimage TFB_ScaledImage;
+
 typedef struct tfb_image
 {
 	TFB_Canvas NormalImg;
 	TFB_Canvas ScaledImg;
+			// The variant set up by the last TFB_DrawImage_FixScaling();
+			// owned by the scale cache
 	TFB_Canvas MipmapImg;
-	TFB_Canvas FilledImg;
 	int colormap_index;
 	int colormap_version;
 	HOT_SPOT NormalHs;
@@ -48,10 +51,14 @@ typedef struct tfb_image
 	HOT_SPOT last_scale_hs;
 	int last_scale;
 	int last_scale_type;
-	Color last_fill;
 	EXTENT extent;
 	Mutex mutex;
 	BOOLEAN dirty;
+	TFB_ScaledImage *ScaleCache;
+	TFB_ScaledImage *CurScaled;
+	TFB_ScaledImage *CurFilled;
+	int ScaleCacheCount;
+			// Cached scaled and filled variants; see scalecache.h
 } TFB_Image;
 
 typedef struct tfb_char
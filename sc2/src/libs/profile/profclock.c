@@ -0,0 +1,50 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "profint.h"
+
+#ifdef WIN32
+#	include <windows.h>
+#else
+#	include <time.h>
+#	include <sys/time.h>
+#endif
+
+uint64
+prof_now (void)
+{
+#if defined(WIN32)
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER count;
+
+	if (freq.QuadPart == 0)
+		QueryPerformanceFrequency (&freq);
+	QueryPerformanceCounter (&count);
+	return (uint64) (count.QuadPart / freq.QuadPart) * 1000000000
+			+ (uint64) (count.QuadPart % freq.QuadPart) * 1000000000
+			/ freq.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (uint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return (uint64) tv.tv_sec * 1000000000 + (uint64) tv.tv_usec * 1000;
+#endif
+}
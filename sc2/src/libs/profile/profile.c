@@ -0,0 +1,367 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "port.h"
+#include "libs/proflib.h"
+#include "profint.h"
+#include "libs/threadlib.h"
+#include "libs/memlib.h"
+#include "libs/log.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__GNUC__)
+#	define PROF_THREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+#	define PROF_THREAD_LOCAL __declspec(thread)
+#endif
+
+#define PROF_OPEN 0xffffffff
+		/* Duration of a zone that has not ended yet */
+#define PROF_DUMP_MARGIN 1024
+		/* The oldest zones of a ring are not dumped, as the thread may
+		 * be overwriting them while the dump is being written */
+
+typedef struct
+{
+	const char *name;
+	uint64 start;
+			/* In ns since prof_start() */
+	DWORD duration;
+			/* In ns; written last, with AtomicStoreRelease() */
+	char detail[PROF_DETAIL_SIZE];
+} ProfEvent;
+
+typedef struct
+{
+	DWORD id;
+	const char *name;
+	DWORD generation;
+			/* The recording that the ring is of */
+	DWORD head;
+			/* Zones begun in this recording; written with
+			 * AtomicStoreRelease() */
+	DWORD depth;
+	DWORD stack[PROF_MAX_DEPTH];
+			/* Positions in the ring of the zones that are open */
+	ProfEvent events[PROF_RING_SIZE];
+} ProfThread;
+
+volatile BOOLEAN prof_active = FALSE;
+
+static Mutex profMutex;
+		/* Guards the list of threads and the dumps */
+static ProfThread *profThreads[PROF_MAX_THREADS];
+static DWORD profNumThreads;
+static DWORD profGeneration;
+static uint64 profStartTime;
+static char *profFileName;
+static DWORD profNumDumps;
+
+#ifdef PROF_THREAD_LOCAL
+static PROF_THREAD_LOCAL ProfThread *profThread;
+static PROF_THREAD_LOCAL const char *profThreadName;
+static PROF_THREAD_LOCAL BOOLEAN profNoRing;
+		/* Set when there was no room for the thread */
+#endif
+
+
+BOOLEAN
+prof_start (const char *fileName)
+{
+#ifndef PROF_THREAD_LOCAL
+	log_add (log_Warning, "The profiler is not available on this "
+			"platform.");
+	(void) fileName;
+	return FALSE;
+#else
+	if (prof_active)
+		return TRUE;
+
+	if (!profMutex)
+		profMutex = CreateMutex ("profiler", SYNC_CLASS_RESOURCE);
+
+	LockMutex (profMutex);
+	HFree (profFileName);
+	profFileName = HMalloc (strlen (fileName) + 1);
+	strcpy (profFileName, fileName);
+	profNumDumps = 0;
+	++profGeneration;
+	profStartTime = prof_now ();
+	UnlockMutex (profMutex);
+
+	prof_active = TRUE;
+	log_add (log_Info, "Profiling; the trace goes to '%s'.", fileName);
+	return TRUE;
+#endif
+}
+
+static void
+writeJsonString (FILE *out, const char *str)
+{
+	putc ('"', out);
+	for (; *str; ++str)
+	{
+		unsigned char c = (unsigned char) *str;
+
+		if (c == '"' || c == '\\')
+			fprintf (out, "\\%c", c);
+		else if (c < 0x20)
+			fprintf (out, "\\u%04x", c);
+		else
+			putc (c, out);
+	}
+	putc ('"', out);
+}
+
+static void
+writeThread (FILE *out, const ProfThread *t, BOOLEAN *first)
+{
+	DWORD head = AtomicLoadAcquire (&t->head);
+	DWORD slot;
+
+	fprintf (out, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+			"\"tid\":%lu,\"args\":{\"name\":", *first ? "" : ",",
+			(unsigned long) t->id);
+	if (t->name)
+		writeJsonString (out, t->name);
+	else
+		fprintf (out, "\"thread %lu\"", (unsigned long) t->id);
+	fprintf (out, "}}");
+	*first = FALSE;
+
+	slot = head > PROF_RING_SIZE - PROF_DUMP_MARGIN ?
+			head - (PROF_RING_SIZE - PROF_DUMP_MARGIN) : 0;
+	for (; slot < head; ++slot)
+	{
+		const ProfEvent *e = &t->events[slot % PROF_RING_SIZE];
+		DWORD duration = AtomicLoadAcquire (&e->duration);
+
+		if (duration == PROF_OPEN)
+			continue;
+
+		fprintf (out, ",\n{\"name\":");
+		writeJsonString (out, e->name);
+		fprintf (out, ",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,"
+				"\"ts\":%.3f,\"dur\":%.3f", (unsigned long) t->id,
+				(double) e->start / 1000.0, (double) duration / 1000.0);
+		if (e->detail[0])
+		{
+			fprintf (out, ",\"args\":{\"detail\":");
+			writeJsonString (out, e->detail);
+			putc ('}', out);
+		}
+		putc ('}', out);
+	}
+}
+
+static BOOLEAN
+writeTrace (const char *fileName)
+{
+	FILE *out;
+	BOOLEAN first = TRUE;
+	DWORD i;
+
+	out = fopen (fileName, "w");
+	if (!out)
+	{
+		log_add (log_Error, "Could not open '%s' to write the profile "
+				"trace.", fileName);
+		return FALSE;
+	}
+
+	fprintf (out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	for (i = 0; i < profNumThreads; ++i)
+	{
+		const ProfThread *t = profThreads[i];
+
+		if (t->generation == profGeneration)
+			writeThread (out, t, &first);
+	}
+	fprintf (out, "\n]}\n");
+
+	if (fclose (out) != 0)
+	{
+		log_add (log_Error, "Could not write the profile trace to '%s'.",
+				fileName);
+		return FALSE;
+	}
+
+	log_add (log_Info, "Profile trace written to '%s'.", fileName);
+	return TRUE;
+}
+
+// Each dump goes to a file of its own: "trace.json" becomes
+// "trace-1.json", "trace-2.json" and so on.
+BOOLEAN
+prof_dump (void)
+{
+	char fileName[PATH_MAX];
+	const char *ext;
+	BOOLEAN result;
+
+	if (!prof_active)
+		return FALSE;
+
+	LockMutex (profMutex);
+	ext = strrchr (profFileName, '.');
+	if (!ext || strpbrk (ext, "/\\"))
+		ext = profFileName + strlen (profFileName);
+	snprintf (fileName, sizeof fileName, "%.*s-%lu%s",
+			(int) (ext - profFileName), profFileName,
+			(unsigned long) ++profNumDumps, ext);
+	result = writeTrace (fileName);
+	UnlockMutex (profMutex);
+
+	return result;
+}
+
+void
+prof_stop (void)
+{
+	if (!prof_active)
+		return;
+
+	// The rings are left alone; threads may still be writing to them.
+	prof_active = FALSE;
+	LockMutex (profMutex);
+	writeTrace (profFileName);
+	UnlockMutex (profMutex);
+}
+
+void
+prof_nameThread (const char *name)
+{
+#ifdef PROF_THREAD_LOCAL
+	profThreadName = name;
+	if (profThread)
+		profThread->name = name;
+#else
+	(void) name;
+#endif
+}
+
+#ifdef PROF_THREAD_LOCAL
+static ProfThread *
+getThread (void)
+{
+	ProfThread *t = profThread;
+
+	if (!t)
+	{
+		if (profNoRing)
+			return NULL;
+
+		LockMutex (profMutex);
+		if (profNumThreads < PROF_MAX_THREADS)
+		{
+			t = HCalloc (sizeof (*t));
+			if (t)
+			{
+				t->id = profNumThreads + 1;
+				t->name = profThreadName;
+				t->generation = profGeneration;
+				profThreads[profNumThreads++] = t;
+			}
+		}
+		UnlockMutex (profMutex);
+
+		if (!t)
+		{
+			profNoRing = TRUE;
+			return NULL;
+		}
+		profThread = t;
+	}
+
+	if (t->generation != profGeneration)
+	{	// Left over from an earlier recording
+		t->head = 0;
+		t->depth = 0;
+		AtomicStoreRelease (&t->generation, profGeneration);
+	}
+
+	return t;
+}
+#endif
+
+void
+prof_beginZone (const char *name, const char *detail)
+{
+#ifdef PROF_THREAD_LOCAL
+	ProfThread *t = getThread ();
+	ProfEvent *e;
+	DWORD slot;
+
+	if (!t)
+		return;
+
+	if (t->depth >= PROF_MAX_DEPTH)
+	{	// Not recorded, but prof_endZone() needs to count it
+		++t->depth;
+		return;
+	}
+
+	slot = t->head;
+	e = &t->events[slot % PROF_RING_SIZE];
+	e->name = name;
+	e->duration = PROF_OPEN;
+	if (detail)
+	{
+		strncpy (e->detail, detail, PROF_DETAIL_SIZE - 1);
+		e->detail[PROF_DETAIL_SIZE - 1] = '\0';
+	}
+	else
+		e->detail[0] = '\0';
+	t->stack[t->depth++] = slot;
+	e->start = prof_now () - profStartTime;
+	AtomicStoreRelease (&t->head, slot + 1);
+#else
+	(void) name;
+	(void) detail;
+#endif
+}
+
+void
+prof_endZone (void)
+{
+#ifdef PROF_THREAD_LOCAL
+	ProfThread *t = profThread;
+	ProfEvent *e;
+	uint64 duration;
+	DWORD slot;
+
+	// A zone that was begun before this recording started has nothing
+	// to end.
+	if (!t || t->generation != profGeneration || t->depth == 0)
+		return;
+
+	--t->depth;
+	if (t->depth >= PROF_MAX_DEPTH)
+		return;
+
+	slot = t->stack[t->depth];
+	if (t->head - slot >= PROF_RING_SIZE)
+		return;  // Overwritten by the zones within it
+
+	e = &t->events[slot % PROF_RING_SIZE];
+	duration = prof_now () - profStartTime - e->start;
+	if (duration >= PROF_OPEN)
+		duration = PROF_OPEN - 1;
+	AtomicStoreRelease (&e->duration, (DWORD) duration);
+#endif
+}
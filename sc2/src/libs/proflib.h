@@ -0,0 +1,84 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef LIBS_PROFLIB_H_
+#define LIBS_PROFLIB_H_
+
+#include "libs/compiler.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* Profiler of timed zones, for any thread.
+ *
+ * A zone is the time between PROF_BEGIN() and the matching PROF_END() on
+ * the same thread; zones may nest. While the profiler is not recording,
+ * these cost a test of a global flag. While it is, every thread writes
+ * its zones to a ring buffer of its own, without locking, which keeps
+ * the last PROF_RING_SIZE of them.
+ *
+ * prof_dump() writes what is in the rings as a JSON trace in the Chrome
+ * trace event format, which chrome://tracing and Perfetto can show.
+ * prof_stop() does so one last time.
+ *
+ * The names of zones and threads must be string constants, or at least
+ * outlive the profiler; the detail strings are copied. */
+
+#define PROF_RING_SIZE 8192
+		/* Zones kept per thread */
+#define PROF_MAX_DEPTH 32
+		/* Deeper zones are not recorded */
+#define PROF_MAX_THREADS 64
+		/* Threads that have recorded zones; the zones of any more
+		 * threads are not recorded */
+#define PROF_DETAIL_SIZE 32
+
+extern volatile BOOLEAN prof_active;
+
+BOOLEAN prof_start (const char *fileName);
+void prof_stop (void);
+BOOLEAN prof_dump (void);
+
+uint64 prof_now (void);
+		/* Monotonic time in nanoseconds, from some arbitrary point; this
+		 * works whether or not the profiler is recording */
+
+void prof_nameThread (const char *name);
+void prof_beginZone (const char *name, const char *detail);
+void prof_endZone (void);
+
+#define PROF_BEGIN(name) \
+		do { \
+			if (prof_active) \
+				prof_beginZone ((name), NULL); \
+		} while (0)
+#define PROF_BEGIN_DETAIL(name, detail) \
+		do { \
+			if (prof_active) \
+				prof_beginZone ((name), (detail)); \
+		} while (0)
+#define PROF_END() \
+		do { \
+			if (prof_active) \
+				prof_endZone (); \
+		} while (0)
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif  /* LIBS_PROFLIB_H_ */
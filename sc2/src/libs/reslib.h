@@ -75,6 +75,52 @@ DWORD res_GetIntResource (RESOURCE res);
 BOOLEAN res_GetBooleanResource (RESOURCE res);
 const char *res_GetResourceType (RESOURCE res);
 
+/* Loading in the background.
+ *
+ * Requested resources are loaded on a loader thread, in the order of
+ * the requests, into the same place res_GetResource() would load them.
+ * res_GetResource() of a resource that is being loaded waits for that
+ * load to finish.
+ *
+ * Only one resource is loaded at a time, on any thread, which is also
+ * why there is one loader thread and not several. The loaders share
+ * state that has no locking of its own:
+ *  - _cur_resfile_name, which a loader sets to the file it reads, and
+ *    which the loaders of sound and graphics look up file names
+ *    relative to;
+ *  - the uio repository: the mount tree and the open zip packages that
+ *    all files are read through;
+ *  - the descriptors in the resource index, with their reference
+ *    counts.
+ * The load lock of res_LockLoads() is held around every load for that.
+ *
+ * A prefetch only loads the resource, for a res_GetResource() that is
+ * to follow. What is prefetched and then not asked for stays loaded
+ * until res_DropPrefetched(). A load request can be polled and is finished with
+ * res_FinishResourceLoad(), which waits for the load if need be and
+ * returns what res_GetResource() would. The callback of a request is
+ * called on the loader thread once the resource is loaded, with the
+ * data or NULL if the load failed; it may be called on the calling
+ * thread if there was nothing to load. */
+typedef struct resource_load *RESOURCE_LOAD;
+typedef void (ResourceLoadCallback) (RESOURCE res, void *data, void *arg);
+
+RESOURCE_LOAD res_LoadResourceAsync (RESOURCE res,
+		ResourceLoadCallback *callback, void *arg);
+BOOLEAN res_IsResourceLoaded (RESOURCE_LOAD load);
+void *res_FinishResourceLoad (RESOURCE_LOAD load);
+void res_PrefetchResource (RESOURCE res);
+/* Frees the prefetched resources that have not been asked for, and
+ * drops the prefetches still queued. */
+void res_DropPrefetched (void);
+
+/* To be held by anything that loads from a file outside
+ * res_GetResource(), and so sets _cur_resfile_name. */
+void res_LockLoads (void);
+void res_UnlockLoads (void);
+
+void res_LogLoadStats (void);
+
 void LoadResourceIndex (uio_DirHandle *dir, const char *filename, const char *prefix);
 void SaveResourceIndex (uio_DirHandle *dir, const char *rmpfile, const char *root, BOOLEAN strip_root);
 
@@ -0,0 +1,576 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+// Loading resources on a thread of their own; see reslib.h.
+
+#include "resintrn.h"
+#include "libs/threadlib.h"
+#include "libs/timelib.h"
+#include "libs/memlib.h"
+#include "libs/log.h"
+
+#include <stdlib.h>
+
+#define RES_STATS_LISTED 20
+		// The number of resources that res_LogLoadStats() lists, the
+		// slowest first
+
+struct resource_load
+{
+	RESOURCE res;
+	ResourceDesc *desc;
+			// Set to NULL when the descriptor goes away; see
+			// dropResourceLoads()
+	ResourceLoadCallback *callback;
+	void *arg;
+	Semaphore done;
+			// Cleared once the request is finished; NULL for prefetches,
+			// which the loader thread frees itself
+	BOOLEAN finished;
+	struct resource_load *next;
+};
+
+ResourceLoadStats resLoadStats;
+
+static RecursiveMutex loadLock;
+		// Held for every load, on whatever thread
+static Mutex queueLock;
+		// Guards the queue, loaderCurrent, loaderRunning and the
+		// 'finished' flag of the requests
+static Semaphore loaderWork;
+		// One count per queued request, and one to quit
+static Semaphore loaderExit;
+
+static RESOURCE_LOAD queueHead;
+static RESOURCE_LOAD queueTail;
+static RESOURCE_LOAD loaderCurrent;
+		// Taken off the queue, and being loaded
+
+static BOOLEAN loaderStarted;
+		// Only touched by the thread that makes the requests
+static BOOLEAN loaderRunning;
+static volatile BOOLEAN loaderQuit;
+
+static ResourceDesc **prefetchedDescs;
+static COUNT numPrefetched;
+static COUNT prefetchedSize;
+		// The descriptors loaded in the background, some of which may
+		// have been asked for since; guarded by the load lock. See
+		// res_DropPrefetched().
+
+
+void
+InitResourceLoader (void)
+{
+	if (loadLock)
+		return;
+
+	loadLock = CreateRecursiveMutex ("resource load lock",
+			SYNC_CLASS_RESOURCE);
+	queueLock = CreateMutex ("resource queue lock", SYNC_CLASS_RESOURCE);
+	loaderWork = CreateSemaphore (0, "resource loader work",
+			SYNC_CLASS_RESOURCE);
+	loaderExit = CreateSemaphore (0, "resource loader exit",
+			SYNC_CLASS_RESOURCE);
+}
+
+void
+res_LockLoads (void)
+{
+	if (loadLock)
+		LockRecursiveMutex (loadLock);
+}
+
+void
+res_UnlockLoads (void)
+{
+	if (loadLock)
+		UnlockRecursiveMutex (loadLock);
+}
+
+static void
+finishLoad (RESOURCE_LOAD load)
+{
+	Semaphore done;
+
+	LockMutex (queueLock);
+	load->finished = TRUE;
+	done = load->done;
+	UnlockMutex (queueLock);
+
+	if (done)
+		ClearSemaphore (done);
+	else
+		HFree (load);
+}
+
+// Called with the load lock held.
+static void
+addPrefetched (ResourceDesc *desc)
+{
+	COUNT i;
+
+	for (i = 0; i < numPrefetched; ++i)
+	{
+		if (prefetchedDescs[i] == desc)
+			return;
+	}
+
+	if (numPrefetched == prefetchedSize)
+	{
+		COUNT newSize = prefetchedSize ? prefetchedSize * 2 : 32;
+		ResourceDesc **newDescs = HRealloc (prefetchedDescs,
+				newSize * sizeof (*newDescs));
+		if (!newDescs)
+			return;  // Then it will not be dropped
+		prefetchedDescs = newDescs;
+		prefetchedSize = newSize;
+	}
+	prefetchedDescs[numPrefetched++] = desc;
+}
+
+static void
+runLoad (RESOURCE_LOAD load)
+{
+	ResourceDesc *desc;
+	void *data = NULL;
+
+	res_LockLoads ();
+	desc = load->desc;
+	if (desc)
+	{
+		if (desc->resdata.ptr == NULL)
+		{
+			loadResourceDesc (desc, TRUE);
+			desc->prefetched = (desc->resdata.ptr != NULL);
+			if (desc->prefetched)
+				addPrefetched (desc);
+		}
+		data = desc->resdata.ptr;
+	}
+
+	// With the lock still held, so that the data stays put for the
+	// duration of the call.
+	if (load->callback)
+		load->callback (load->res, data, load->arg);
+	res_UnlockLoads ();
+
+	LockMutex (queueLock);
+	loaderCurrent = NULL;
+	UnlockMutex (queueLock);
+
+	finishLoad (load);
+}
+
+static int
+LoaderThreadFunc (void *data)
+{
+	LockMutex (queueLock);
+	loaderRunning = TRUE;
+	UnlockMutex (queueLock);
+
+	for (;;)
+	{
+		RESOURCE_LOAD load;
+
+		SetSemaphore (loaderWork);
+		if (loaderQuit)
+			break;
+
+		LockMutex (queueLock);
+		load = queueHead;
+		queueHead = load->next;
+		if (!queueHead)
+			queueTail = NULL;
+		loaderCurrent = load;
+		UnlockMutex (queueLock);
+
+		runLoad (load);
+	}
+
+	ClearSemaphore (loaderExit);
+	(void) data;
+	return 0;
+}
+
+static RESOURCE_LOAD
+queueLoad (RESOURCE res, ResourceLoadCallback *callback, void *arg,
+		BOOLEAN wait)
+{
+	ResourceDesc *desc;
+	RESOURCE_LOAD load;
+
+	desc = lookupResourceDesc (_get_current_index_header (), res);
+	if (desc == NULL || desc->vtable == NULL)
+	{
+		log_add (log_Warning, "Trying to load undefined resource '%s'",
+				res);
+		return NULL;
+	}
+
+	load = HCalloc (sizeof (*load));
+	load->res = res;
+	load->desc = desc;
+	load->callback = callback;
+	load->arg = arg;
+	if (wait)
+		load->done = CreateSemaphore (0, "resource load",
+				SYNC_CLASS_RESOURCE);
+
+	if (desc->vtable->freeFun == NULL || loaderQuit)
+	{	// Either a raw value, which was worked out with the index, or the
+		// loader is gone; res_FinishResourceLoad() will have to do.
+		if (callback)
+			callback (res, desc->vtable->freeFun ? NULL :
+					desc->resdata.ptr, arg);
+		finishLoad (load);
+		return wait ? load : NULL;
+	}
+
+	if (!loaderStarted)
+	{	// Born asynchronously (see StartThread()); the requests queue
+		// up until it runs.
+		loaderStarted = TRUE;
+		StartThread (LoaderThreadFunc, NULL, 1024, "resource loader");
+	}
+
+	LockMutex (queueLock);
+	if (queueTail)
+		queueTail->next = load;
+	else
+		queueHead = load;
+	queueTail = load;
+	UnlockMutex (queueLock);
+	ClearSemaphore (loaderWork);
+
+	return wait ? load : NULL;
+}
+
+RESOURCE_LOAD
+res_LoadResourceAsync (RESOURCE res, ResourceLoadCallback *callback,
+		void *arg)
+{
+	if (res == NULL_RESOURCE)
+	{
+		log_add (log_Warning, "Trying to load null resource");
+		return NULL;
+	}
+
+	return queueLoad (res, callback, arg, TRUE);
+}
+
+void
+res_PrefetchResource (RESOURCE res)
+{
+	if (res == NULL_RESOURCE)
+		return;
+
+	queueLoad (res, NULL, NULL, FALSE);
+}
+
+BOOLEAN
+res_IsResourceLoaded (RESOURCE_LOAD load)
+{
+	BOOLEAN finished;
+
+	if (!load)
+		return TRUE;
+	if (!queueLock)
+		return load->finished;  // The loader is gone
+
+	LockMutex (queueLock);
+	finished = load->finished;
+	UnlockMutex (queueLock);
+
+	return finished;
+}
+
+void *
+res_FinishResourceLoad (RESOURCE_LOAD load)
+{
+	RESOURCE res;
+
+	if (!load)
+		return NULL;
+
+	SetSemaphore (load->done);
+	DestroySemaphore (load->done);
+	res = load->res;
+	HFree (load);
+
+	// This also takes care of a load that failed, or never happened,
+	// by trying again.
+	return res_GetResource (res);
+}
+
+void
+res_DropPrefetched (void)
+{
+	RESOURCE_LOAD load;
+	COUNT i;
+
+	if (!loadLock)
+		return;
+
+	// Also waits for the load that may be under way.
+	res_LockLoads ();
+
+	// The prefetches that are still to come are finished without
+	// loading anything, as for a descriptor that is freed.
+	LockMutex (queueLock);
+	for (load = queueHead; load; load = load->next)
+	{
+		if (!load->done)
+			load->desc = NULL;
+	}
+	if (loaderCurrent && !loaderCurrent->done)
+		loaderCurrent->desc = NULL;
+	UnlockMutex (queueLock);
+
+	for (i = 0; i < numPrefetched; ++i)
+	{
+		ResourceDesc *desc = prefetchedDescs[i];
+
+		if (desc->prefetched && desc->refcount == 0
+				&& desc->resdata.ptr != NULL)
+		{
+			desc->vtable->freeFun (desc->resdata.ptr);
+			desc->resdata.ptr = NULL;
+		}
+		desc->prefetched = FALSE;
+	}
+	numPrefetched = 0;
+
+	res_UnlockLoads ();
+}
+
+// Called with the load lock held, when a descriptor is about to be freed.
+void
+dropResourceLoads (ResourceDesc *desc)
+{
+	RESOURCE_LOAD load;
+	COUNT i;
+
+	for (i = 0; i < numPrefetched; ++i)
+	{
+		if (prefetchedDescs[i] == desc)
+		{
+			prefetchedDescs[i] = prefetchedDescs[--numPrefetched];
+			break;
+		}
+	}
+
+	if (!queueLock)
+		return;
+
+	LockMutex (queueLock);
+	for (load = queueHead; load; load = load->next)
+	{
+		if (load->desc == desc)
+			load->desc = NULL;
+	}
+	if (loaderCurrent && loaderCurrent->desc == desc)
+		loaderCurrent->desc = NULL;
+	UnlockMutex (queueLock);
+}
+
+// What is left in the queue is finished without being loaded.
+static void
+finishQueuedLoads (void)
+{
+	RESOURCE_LOAD load;
+	RESOURCE_LOAD next;
+
+	LockMutex (queueLock);
+	load = queueHead;
+	queueHead = queueTail = NULL;
+	UnlockMutex (queueLock);
+
+	for (; load; load = next)
+	{
+		next = load->next;
+		finishLoad (load);
+	}
+}
+
+void
+UninitResourceLoader (void)
+{
+	if (!loadLock)
+		return;
+
+	if (loaderStarted)
+	{
+		BOOLEAN running;
+
+		LockMutex (queueLock);
+		loaderQuit = TRUE;
+		running = loaderRunning;
+		UnlockMutex (queueLock);
+
+		if (!running)
+		{	// It would still wake up to find the synchronization
+			// objects gone. Leave them alone; from now on, requests are
+			// finished on the spot.
+			log_add (log_Warning, "UninitResourceLoader(): the resource "
+					"loader thread never started");
+			finishQueuedLoads ();
+			return;
+		}
+
+		ClearSemaphore (loaderWork);
+		SetSemaphore (loaderExit);
+	}
+
+	finishQueuedLoads ();
+
+	HFree (prefetchedDescs);
+	prefetchedDescs = NULL;
+	numPrefetched = 0;
+	prefetchedSize = 0;
+
+	DestroySemaphore (loaderExit);
+	DestroySemaphore (loaderWork);
+	DestroyMutex (queueLock);
+	DestroyRecursiveMutex (loadLock);
+	loaderExit = loaderWork = NULL;
+	queueLock = NULL;
+	loadLock = NULL;
+	loaderStarted = FALSE;
+	loaderRunning = FALSE;
+	loaderQuit = FALSE;
+}
+
+typedef struct
+{
+	const char *key;
+	const ResourceDesc *desc;
+} LoadStatsEntry;
+
+typedef struct
+{
+	LoadStatsEntry *entries;
+	COUNT count;
+			// Of the entries filled in, or only counted if 'entries' is
+			// NULL
+	COUNT size;
+} LoadStatsList;
+
+static void
+addLoadStatsEntry (const char *key, ResourceDesc *desc, void *arg)
+{
+	LoadStatsList *list = (LoadStatsList *) arg;
+
+	if (!desc->vtable || desc->loadCount == 0)
+		return;
+
+	if (list->entries)
+	{
+		if (list->count >= list->size)
+			return;
+		list->entries[list->count].key = key;
+		list->entries[list->count].desc = desc;
+	}
+	++list->count;
+}
+
+static void
+forEachResourceDesc (ResourceDescFun *fun, void *arg)
+{
+	RESOURCE_INDEX idx = _get_current_index_header ();
+	CharHashTable_Iterator *it;
+
+	for (it = CharHashTable_getIterator (idx->map);
+			!CharHashTable_iteratorDone (it);
+			it = CharHashTable_iteratorNext (it))
+	{
+		fun (CharHashTable_iteratorKey (it),
+				CharHashTable_iteratorValue (it), arg);
+	}
+	CharHashTable_freeIterator (it);
+
+	forEachCompiledResourceDesc (idx, fun, arg);
+}
+
+static int
+compareLoadTimes (const void *a, const void *b)
+{
+	const LoadStatsEntry *ea = (const LoadStatsEntry *) a;
+	const LoadStatsEntry *eb = (const LoadStatsEntry *) b;
+
+	if (ea->desc->loadTime != eb->desc->loadTime)
+		return ea->desc->loadTime < eb->desc->loadTime ? 1 : -1;
+	return strcmp (ea->key, eb->key);
+}
+
+static unsigned long
+ticksToMs (DWORD ticks)
+{
+	return (unsigned long) ((uint64) ticks * 1000 / ONE_SECOND);
+}
+
+// The time counter is coarser than many loads, but the rounding errors
+// even out over a number of them.
+void
+res_LogLoadStats (void)
+{
+	LoadStatsList list;
+	COUNT i;
+
+	res_LockLoads ();
+
+	list.entries = NULL;
+	list.count = 0;
+	forEachResourceDesc (addLoadStatsEntry, &list);
+
+	log_add (log_Info, "Resource loads: %lu on request, taking %lu ms, "
+			"of which %lu ms waiting for the loader thread; %lu in the "
+			"background, taking %lu ms, %lu of which were asked for "
+			"later.", (unsigned long) resLoadStats.loads,
+			ticksToMs (resLoadStats.loadTime),
+			ticksToMs (resLoadStats.waitTime),
+			(unsigned long) resLoadStats.bgLoads,
+			ticksToMs (resLoadStats.bgLoadTime),
+			(unsigned long) resLoadStats.bgHits);
+
+	list.size = list.count;
+	list.entries = list.size ? HMalloc (list.size * sizeof (*list.entries))
+			: NULL;
+	if (!list.entries)
+	{
+		res_UnlockLoads ();
+		return;
+	}
+
+	list.count = 0;
+	forEachResourceDesc (addLoadStatsEntry, &list);
+
+	qsort (list.entries, list.count, sizeof (*list.entries),
+			compareLoadTimes);
+	log_add (log_Info, "Slowest resources (total ms, loads, name):");
+	for (i = 0; i < list.count && i < RES_STATS_LISTED; ++i)
+	{
+		const ResourceDesc *desc = list.entries[i].desc;
+
+		log_add (log_Info, "%8lu %4lu  %s (%s)",
+				ticksToMs (desc->loadTime),
+				(unsigned long) desc->loadCount,
+				list.entries[i].key, desc->fname);
+	}
+
+	HFree (list.entries);
+	res_UnlockLoads ();
+}
@@ -0,0 +1,436 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+// Compiled resource indices; see cindex.h.
+
+#include "port.h"
+#include "resintrn.h"
+#include "cindex.h"
+#include "libs/uio/fileblock.h"
+#include "libs/threadlib.h"
+#include "libs/memlib.h"
+#include "libs/log.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+enum
+{
+	CINDEX_UNMADE = 0,
+			// The descriptor has not been asked for yet
+	CINDEX_MADE,
+	CINDEX_REMOVED,
+			// Removed, overridden by a later index, or out of memory
+	CINDEX_SKIPPED
+			// Of a type that cannot be loaded; like the text index, this
+			// index then leaves the earlier definition in place
+};
+
+struct compiled_index
+{
+	uio_Handle *handle;
+	uio_FileBlock *block;
+	char *copy;
+			// The contents, if the file block's buffer was not aligned well
+			// enough to use; the file is closed then
+	const CIndexHeader *header;
+	const uint32 *seeds;
+	const CIndexEntry *entries;
+	const char *strings;
+	ResourceDesc **descs;
+	DWORD *states;
+			// Per entry; written with AtomicStoreRelease()
+	CompiledIndex *next;
+			// An earlier index
+};
+
+static Mutex makeLock;
+		// Guards making and removing descriptors, as resources may be
+		// looked up on any thread
+
+
+static char *
+compiledIndexName (const char *rmpfile)
+{
+	size_t len = strlen (rmpfile);
+	char *name;
+
+	if (len < 4 || strcasecmp (rmpfile + len - 4, ".rmp") != 0)
+		return NULL;
+
+	// "uqm.rmp" becomes "uqm.rmc", and "UQM.RMP" becomes "UQM.RMC".
+	name = HMalloc (len + 1);
+	strcpy (name, rmpfile);
+	name[len - 1] = (rmpfile[len - 1] == 'P') ? 'C' : 'c';
+	return name;
+}
+
+static BOOLEAN
+openWholeFile (uio_DirHandle *dir, const char *name, uio_Handle **handle,
+		uio_FileBlock **block, const char **data, size_t *size)
+{
+	struct stat sb;
+	char *buf;
+
+	*handle = uio_open (dir, name, O_RDONLY
+#ifdef WIN32
+			| O_BINARY
+#endif
+			, 0);
+	if (*handle == NULL)
+		return FALSE;
+
+	if (uio_fstat (*handle, &sb) == -1)
+		goto err;
+	*size = (size_t) sb.st_size;
+
+	// The block is mapped into memory where the file system allows it.
+	*block = uio_openFileBlock (*handle);
+	if (*block == NULL)
+		goto err;
+	if (uio_accessFileBlock (*block, 0, *size, &buf) != (ssize_t) *size)
+	{
+		uio_closeFileBlock (*block);
+		goto err;
+	}
+
+	*data = buf;
+	return TRUE;
+
+err:
+	uio_close (*handle);
+	return FALSE;
+}
+
+static void
+closeWholeFile (uio_Handle *handle, uio_FileBlock *block)
+{
+	uio_closeFileBlock (block);
+	uio_close (handle);
+}
+
+static BOOLEAN
+checkCompiledIndex (const char *data, size_t size)
+{
+	const CIndexHeader *header = (const CIndexHeader *) data;
+	const CIndexEntry *entries;
+	const char *strings;
+	size_t rest;
+	uint32 i;
+
+	if (size < sizeof (CIndexHeader) || header->magic != CINDEX_MAGIC ||
+			header->version != CINDEX_VERSION)
+		return FALSE;
+	if ((header->numEntries == 0) != (header->numBuckets == 0))
+		return FALSE;
+
+	rest = size - sizeof (CIndexHeader);
+	if (header->numBuckets > rest / sizeof (uint32))
+		return FALSE;
+	rest -= header->numBuckets * sizeof (uint32);
+	if (header->numEntries > rest / sizeof (CIndexEntry))
+		return FALSE;
+	rest -= header->numEntries * sizeof (CIndexEntry);
+	if (header->stringsSize != rest || rest == 0)
+		return FALSE;
+
+	entries = (const CIndexEntry *) (data + sizeof (CIndexHeader) +
+			header->numBuckets * sizeof (uint32));
+	strings = (const char *) (entries + header->numEntries);
+	if (strings[header->stringsSize - 1] != '\0')
+		return FALSE;
+
+	for (i = 0; i < header->numEntries; ++i)
+	{
+		if (entries[i].key >= header->stringsSize ||
+				entries[i].value >= header->stringsSize ||
+				entries[i].path >= header->stringsSize - entries[i].value)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static BOOLEAN
+sourceMatches (uio_DirHandle *dir, const char *rmpfile,
+		const CIndexHeader *header)
+{
+	uio_Handle *handle;
+	uio_FileBlock *block;
+	const char *data;
+	size_t size;
+	BOOLEAN match;
+
+	if (!openWholeFile (dir, rmpfile, &handle, &block, &data, &size))
+		return FALSE;
+	match = size == header->sourceSize &&
+			cindex_hash (data, size, 0) == header->sourceHash;
+	closeWholeFile (handle, block);
+
+	return match;
+}
+
+BOOLEAN
+LoadCompiledResourceIndex (uio_DirHandle *dir, const char *rmpfile)
+{
+	RESOURCE_INDEX idx = _get_current_index_header ();
+	CompiledIndex *ci;
+	char *name;
+	uio_Handle *handle;
+	uio_FileBlock *block;
+	const char *data;
+	char *copy = NULL;
+	size_t size;
+	const CIndexHeader *header;
+	uint32 i;
+
+	name = compiledIndexName (rmpfile);
+	if (!name)
+		return FALSE;
+
+	if (!openWholeFile (dir, name, &handle, &block, &data, &size))
+	{	// There is none, which is fine.
+		HFree (name);
+		return FALSE;
+	}
+
+	if ((size_t) data % sizeof (uint32) != 0)
+	{	// Mapped from a package at an odd offset
+		copy = HMalloc (size);
+		memcpy (copy, data, size);
+		data = copy;
+		closeWholeFile (handle, block);
+		handle = NULL;
+		block = NULL;
+	}
+
+	if (!checkCompiledIndex (data, size))
+	{
+		log_add (log_Warning, "Compiled resource index '%s' is corrupt, "
+				"or for another version; using '%s' instead.", name,
+				rmpfile);
+		goto fail;
+	}
+	header = (const CIndexHeader *) data;
+	if (!sourceMatches (dir, rmpfile, header))
+	{
+		log_add (log_Info, "Compiled resource index '%s' is out of date; "
+				"using '%s' instead.", name, rmpfile);
+		goto fail;
+	}
+
+	if (!makeLock)
+		makeLock = CreateMutex ("compiled resource index",
+				SYNC_CLASS_RESOURCE);
+
+	ci = HCalloc (sizeof (*ci));
+	ci->handle = handle;
+	ci->block = block;
+	ci->copy = copy;
+	ci->header = header;
+	ci->seeds = (const uint32 *) (header + 1);
+	ci->entries = (const CIndexEntry *) (ci->seeds + header->numBuckets);
+	ci->strings = (const char *) (ci->entries + header->numEntries);
+	ci->descs = HCalloc ((header->numEntries + 1) * sizeof (*ci->descs));
+	ci->states = HCalloc ((header->numEntries + 1) * sizeof (*ci->states));
+
+	// What this index has overrides what came before, as far as it can
+	// be made into descriptors.
+	for (i = 0; i < header->numEntries; ++i)
+	{
+		const CIndexEntry *entry = &ci->entries[i];
+		const char *value = ci->strings + entry->value;
+
+		if (!canMakeResourceDesc (value,
+				entry->path ? value + entry->path : NULL))
+		{
+			log_add (log_Warning, "Unable to load '%s'; no handler for "
+					"its type defined.", ci->strings + entry->key);
+			ci->states[i] = CINDEX_SKIPPED;
+			continue;
+		}
+		res_Remove (ci->strings + entry->key);
+	}
+
+	ci->next = idx->compiled;
+	idx->compiled = ci;
+
+	log_add (log_Debug, "Using compiled resource index '%s' (%lu "
+			"resources).", name, (unsigned long) header->numEntries);
+	HFree (name);
+	return TRUE;
+
+fail:
+	if (copy)
+		HFree (copy);
+	else
+		closeWholeFile (handle, block);
+	HFree (name);
+	return FALSE;
+}
+
+static BOOLEAN
+findEntry (const CompiledIndex *ci, RESOURCE res, uint32 *index)
+{
+	const CIndexHeader *header = ci->header;
+	size_t len;
+	uint32 bucket;
+	uint32 i;
+
+	if (header->numEntries == 0)
+		return FALSE;
+
+	len = strlen (res);
+	bucket = cindex_hash (res, len, 0) % header->numBuckets;
+	i = cindex_hash (res, len, ci->seeds[bucket]) % header->numEntries;
+	if (strcmp (ci->strings + ci->entries[i].key, res) != 0)
+		return FALSE;
+
+	*index = i;
+	return TRUE;
+}
+
+static ResourceDesc *
+makeResourceDesc (CompiledIndex *ci, uint32 i)
+{
+	const CIndexEntry *entry = &ci->entries[i];
+	ResourceDesc *desc;
+
+	LockMutex (makeLock);
+	if (ci->states[i] == CINDEX_UNMADE)
+	{	// Much as if it had been in the text index all along
+		const char *value = ci->strings + entry->value;
+
+		desc = newSplitResourceDesc (ci->strings + entry->key, value,
+				entry->path ? value + entry->path : NULL);
+		ci->descs[i] = desc;
+		AtomicStoreRelease (&ci->states[i],
+				desc ? CINDEX_MADE : CINDEX_REMOVED);
+	}
+	else
+	{	// Another thread got here first.
+		desc = ci->descs[i];
+	}
+	UnlockMutex (makeLock);
+
+	return desc;
+}
+
+ResourceDesc *
+lookupCompiledResourceDesc (RESOURCE_INDEX idx, RESOURCE res)
+{
+	CompiledIndex *ci;
+	uint32 i;
+	DWORD state;
+
+	for (ci = idx->compiled; ci; ci = ci->next)
+	{
+		if (!findEntry (ci, res, &i))
+			continue;
+
+		state = AtomicLoadAcquire (&ci->states[i]);
+		if (state == CINDEX_MADE)
+			return ci->descs[i];
+		if (state == CINDEX_UNMADE)
+			return makeResourceDesc (ci, i);
+		if (state == CINDEX_SKIPPED)
+			continue;
+		// Removed; then it is in no earlier index either.
+		return NULL;
+	}
+
+	return NULL;
+}
+
+BOOLEAN
+removeCompiledResourceDesc (RESOURCE_INDEX idx, RESOURCE res)
+{
+	CompiledIndex *ci;
+	uint32 i;
+	DWORD state;
+	ResourceDesc *desc;
+
+	for (ci = idx->compiled; ci; ci = ci->next)
+	{
+		if (!findEntry (ci, res, &i) || ci->states[i] == CINDEX_SKIPPED)
+			continue;
+
+		LockMutex (makeLock);
+		state = ci->states[i];
+		desc = ci->descs[i];
+		ci->descs[i] = NULL;
+		AtomicStoreRelease (&ci->states[i], CINDEX_REMOVED);
+		UnlockMutex (makeLock);
+
+		if (desc)
+			freeResourceDesc (res, desc);
+		return state != CINDEX_REMOVED;
+	}
+
+	return FALSE;
+}
+
+void
+forEachCompiledResourceDesc (RESOURCE_INDEX idx, ResourceDescFun *fun,
+		void *arg)
+{
+	CompiledIndex *ci;
+	uint32 i;
+
+	for (ci = idx->compiled; ci; ci = ci->next)
+	{
+		for (i = 0; i < ci->header->numEntries; ++i)
+		{
+			if (AtomicLoadAcquire (&ci->states[i]) == CINDEX_MADE)
+				fun (ci->strings + ci->entries[i].key, ci->descs[i], arg);
+		}
+	}
+}
+
+// Like the map, this leaves the loaded resources alone.
+void
+freeCompiledResourceIndices (RESOURCE_INDEX idx)
+{
+	CompiledIndex *ci;
+	uint32 i;
+
+	while (idx->compiled)
+	{
+		ci = idx->compiled;
+		idx->compiled = ci->next;
+
+		for (i = 0; i < ci->header->numEntries; ++i)
+		{
+			if (ci->descs[i])
+			{
+				HFree (ci->descs[i]->fname);
+				HFree (ci->descs[i]);
+			}
+		}
+		HFree (ci->descs);
+		HFree (ci->states);
+		if (ci->copy)
+			HFree (ci->copy);
+		else
+			closeWholeFile (ci->handle, ci->block);
+		HFree (ci);
+	}
+
+	if (makeLock)
+	{
+		DestroyMutex (makeLock);
+		makeLock = NULL;
+	}
+}
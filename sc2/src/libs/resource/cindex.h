@@ -0,0 +1,93 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef LIBS_RESOURCE_CINDEX_H_
+#define LIBS_RESOURCE_CINDEX_H_
+
+#include "types.h"
+
+/* Compiled resource indices.
+ *
+ * tools/rmpc compiles a resource index such as "uqm.rmp" into "uqm.rmc",
+ * which LoadResourceIndex() uses in its place as long as it was compiled
+ * from the same text. The file is used where it lies, and is laid out as
+ *     CIndexHeader header;
+ *     uint32 seeds[numBuckets];
+ *     CIndexEntry entries[numEntries];
+ *     char strings[stringsSize];
+ * in the byte order of the machine that reads it; the magic number does
+ * not match in the other byte order.
+ *
+ * The entries are placed by a minimal perfect hash of their keys: a key
+ * belongs to bucket cindex_hash (key, 0) % numBuckets, and to entry
+ * cindex_hash (key, seeds[bucket]) % numEntries. Keys that are not in
+ * the index land on some entry too, so the key there has to be compared.
+ *
+ * The descriptors of the resources are only made when they are first
+ * looked up. The tool has a copy of these definitions; keep them the
+ * same. */
+
+#define CINDEX_MAGIC 0x434d5255
+		/* "URMC" */
+#define CINDEX_VERSION 1
+
+typedef struct
+{
+	uint32 magic;
+	uint32 version;
+	uint32 sourceSize;
+	uint32 sourceHash;
+			/* cindex_hash() with seed 0 of the text index that this was
+			 * compiled from */
+	uint32 numEntries;
+	uint32 numBuckets;
+	uint32 stringsSize;
+	uint32 reserved;
+} CIndexHeader;
+
+typedef struct
+{
+	uint32 key;
+	uint32 value;
+			/* Offsets of NUL-terminated strings; the value is what
+			 * followed the '=' in the text index */
+	uint32 path;
+			/* Offset of the path in the value, just past "TYPE:", or 0
+			 * if the value has no type */
+} CIndexEntry;
+
+static inline uint32
+cindex_hash (const char *data, size_t len, uint32 seed)
+{
+	uint32 hash = 0x811c9dc5 ^ (seed * 0x9e3779b9);
+	size_t i;
+
+	for (i = 0; i < len; ++i)
+	{
+		hash ^= (uint8) data[i];
+		hash *= 0x01000193;
+	}
+
+	// FNV-1a alone spreads similar keys poorly over the low bits.
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+#endif /* LIBS_RESOURCE_CINDEX_H_ */
@@ -21,6 +21,8 @@
 #include "resintrn.h"
 #include "libs/memlib.h"
 #include "libs/log.h"
+#include "libs/proflib.h"
+#include "libs/timelib.h"
 #include "libs/uio/charhashtable.h"
 
 const char *_cur_resfile_name;
@@ -30,13 +32,37 @@ const char *_cur_resfile_name;
 ResourceDesc *
 lookupResourceDesc (RESOURCE_INDEX idx, RESOURCE res)
 {
-	return (ResourceDesc *) CharHashTable_find (idx->map, res);
+	ResourceDesc *desc = (ResourceDesc *) CharHashTable_find (idx->map, res);
+	if (desc == NULL && idx->compiled)
+		desc = lookupCompiledResourceDesc (idx, res);
+	return desc;
 }
 
+// To be called with the load lock held.
 void
-loadResourceDesc (ResourceDesc *desc)
+loadResourceDesc (ResourceDesc *desc, BOOLEAN background)
 {
+	TimeCount start;
+	DWORD time;
+
+	start = GetTimeCounter ();
+	PROF_BEGIN_DETAIL ("LoadResource", desc->fname);
 	desc->vtable->loadFun (desc->fname, &desc->resdata);
+	PROF_END ();
+	time = GetTimeCounter () - start;
+
+	desc->loadTime += time;
+	desc->loadCount++;
+	if (background)
+	{
+		resLoadStats.bgLoads++;
+		resLoadStats.bgLoadTime += time;
+	}
+	else
+	{
+		resLoadStats.loads++;
+		resLoadStats.loadTime += time;
+	}
 }
 
 void *
@@ -53,6 +79,8 @@ LoadResourceFromPath (const char *path, ResourceLoadFileFun *loadFun)
 		return NULL;
 	}
 
+	res_LockLoads ();
+
 	dataLen = LengthResFile (stream);
 	log_add (log_Info, "\t'%s' -- %lu bytes", path, dataLen);
 	
@@ -65,11 +93,13 @@ LoadResourceFromPath (const char *path, ResourceLoadFileFun *loadFun)
 	_cur_resfile_name = path;
 	resdata = (*loadFun) (stream, dataLen);
 	_cur_resfile_name = NULL;
+	res_UnlockLoads ();
 	res_CloseResFile (stream);
 
 	return resdata;
 
 err:
+	res_UnlockLoads ();
 	res_CloseResFile (stream);
 	return NULL;
 }
@@ -105,6 +135,8 @@ res_GetResource (RESOURCE res)
 {
 	RESOURCE_INDEX resourceIndex;
 	ResourceDesc *desc;
+	TimeCount start;
+	void *result;
 	
 	if (res == NULL_RESOURCE)
 	{
@@ -122,13 +154,23 @@ res_GetResource (RESOURCE res)
 		return NULL;
 	}
 
+	// Waits for the loader thread, if it is loading something.
+	start = GetTimeCounter ();
+	res_LockLoads ();
+	resLoadStats.waitTime += GetTimeCounter () - start;
+
 	if (desc->resdata.ptr == NULL)
-		loadResourceDesc (desc);
+		loadResourceDesc (desc, FALSE);
+	else if (desc->prefetched)
+		resLoadStats.bgHits++;
+	desc->prefetched = FALSE;
 	if (desc->resdata.ptr != NULL)
 		++desc->refcount;
-
-	return desc->resdata.ptr;
+	result = desc->resdata.ptr;
 			// May still be NULL, if the load failed.
+
+	res_UnlockLoads ();
+	return result;
 }
 
 DWORD
@@ -162,9 +204,8 @@ res_GetBooleanResource (RESOURCE res)
 	return (res_GetIntResource (res) != 0);
 }
 
-// NB: this function appears to be never called!
-void
-res_FreeResource (RESOURCE res)
+static void
+freeResource (RESOURCE res)
 {
 	ResourceDesc *desc;
 	ResourceFreeFun *freeFun;
@@ -202,12 +243,8 @@ res_FreeResource (RESOURCE res)
 	desc->resdata.ptr = NULL;
 }
 
-// By calling this function the caller will be responsible of unloading
-// the resource. If res_GetResource() get called again for this
-// resource, a NEW copy will be loaded, regardless of whether a detached
-// copy still exists.
-void *
-res_DetachResource (RESOURCE res)
+static void *
+detachResource (RESOURCE res)
 {
 	ResourceDesc *desc;
 	ResourceFreeFun *freeFun;
@@ -249,6 +286,31 @@ res_DetachResource (RESOURCE res)
 	return result;
 }
 
+// By calling this function the caller will be responsible of unloading
+// the resource. If res_GetResource() get called again for this
+// resource, a NEW copy will be loaded, regardless of whether a detached
+// copy still exists.
+void *
+res_DetachResource (RESOURCE res)
+{
+	void *result;
+
+	res_LockLoads ();
+	result = detachResource (res);
+	res_UnlockLoads ();
+
+	return result;
+}
+
+// NB: this function appears to be never called!
+void
+res_FreeResource (RESOURCE res)
+{
+	res_LockLoads ();
+	freeResource (res);
+	res_UnlockLoads ();
+}
+
 BOOLEAN
 FreeResourceData (void *data)
 {
@@ -21,6 +21,7 @@
 
 typedef struct resource_handlers ResourceHandlers;
 typedef struct resource_desc ResourceDesc;
+typedef struct compiled_index CompiledIndex;
 
 #include <stdio.h>
 #include "libs/reslib.h"
@@ -42,12 +43,22 @@ struct resource_desc
 	RESOURCE_DATA resdata;
 	// refcount is rudimentary as nothing really frees the descriptors
 	unsigned refcount;
+	// Load statistics; like resdata, these are only touched with the
+	// load lock held
+	DWORD loadTime;
+			// Total time spent loading the resource, in TimeCount ticks
+	DWORD loadCount;
+	BOOLEAN prefetched;
+			// Loaded in the background, and not asked for since
 };
 
 struct resource_index_desc
 {
 	CharHashTable_HashTable *map;
 	size_t numRes;
+	CompiledIndex *compiled;
+			// Loaded compiled indices, the latest first; see cindex.h.
+			// A key is in the map or in one of these, never in two places
 };
 
 #endif /* LIBS_RESOURCE_INDEX_H_ */
@@ -36,6 +36,7 @@ allocResourceIndex (void) {
 	RESOURCE_INDEX ndx = HMalloc (sizeof (RESOURCE_INDEX_DESC));
 	ndx->map = CharHashTable_newHashTable (NULL, NULL, NULL, NULL, NULL,
 			0, 0.85, 0.9);
+	ndx->compiled = NULL;
 	return ndx;
 }
 
@@ -45,32 +46,28 @@ freeResourceIndex (RESOURCE_INDEX h) {
 	{
 		/* TODO: This leaks the contents of h->map */
 		CharHashTable_deleteHashTable (h->map);
+		freeCompiledResourceIndices (h);
 		HFree (h);
 	}
 }
 
 #define TYPESIZ 32
 
-static ResourceDesc *
-newResourceDesc (const char *res_id, const char *resval)
+// Puts the name of the type descriptor of a resource in 'typestr', and
+// returns where its path starts. 'resval' and 'path' are as for
+// newSplitResourceDesc().
+static const char *
+getResourceTypeName (const char *resval, const char *path,
+		char typestr[TYPESIZ])
 {
-	const char *path;
-	int pathlen;
-	ResourceHandlers *vtable;
-	ResourceDesc *result, *handlerdesc;
-	RESOURCE_INDEX idx = _get_current_index_header ();
-	char typestr[TYPESIZ];
-
-	path = strchr (resval, ':');
 	if (path == NULL)
 	{
-		log_add (log_Warning, "Could not find type information for resource '%s'", res_id);
 		strncpy(typestr, "sys.UNKNOWNRES", TYPESIZ);
-		path = resval;
+		return resval;
 	}
 	else
 	{
-		int n = path - resval;
+		int n = path - 1 - resval;
 
 		if (n >= TYPESIZ - 4)
 		{
@@ -79,8 +76,42 @@ newResourceDesc (const char *res_id, const char *resval)
 		strncpy (typestr, "sys.", TYPESIZ);
 		strncat (typestr+1, resval, n);
 		typestr[n+4] = '\0';
-		path++;
+		return path;
 	}
+}
+
+// Whether newSplitResourceDesc() would make a descriptor for a resource
+// with this value, memory permitting. Logs nothing.
+BOOLEAN
+canMakeResourceDesc (const char *resval, const char *path)
+{
+	RESOURCE_INDEX idx = _get_current_index_header ();
+	ResourceDesc *handlerdesc;
+	char typestr[TYPESIZ];
+
+	getResourceTypeName (resval, path, typestr);
+	handlerdesc = lookupResourceDesc (idx, typestr);
+	if (handlerdesc == NULL)
+		handlerdesc = lookupResourceDesc (idx, "sys.UNKNOWNRES");
+
+	return ((ResourceHandlers *) handlerdesc->resdata.ptr)->loadFun != NULL;
+}
+
+// 'resval' is "TYPE:path", and 'path' points to the path in it, or is
+// NULL when there is no type.
+ResourceDesc *
+newSplitResourceDesc (const char *res_id, const char *resval,
+		const char *path)
+{
+	int pathlen;
+	ResourceHandlers *vtable;
+	ResourceDesc *result, *handlerdesc;
+	RESOURCE_INDEX idx = _get_current_index_header ();
+	char typestr[TYPESIZ];
+
+	if (path == NULL)
+		log_add (log_Warning, "Could not find type information for resource '%s'", res_id);
+	path = getResourceTypeName (resval, path, typestr);
 	pathlen = strlen (path);
 
 	handlerdesc = lookupResourceDesc(idx, typestr);
@@ -108,6 +139,9 @@ newResourceDesc (const char *res_id, const char *resval)
 	result->fname[pathlen] = '\0';
 	result->vtable = vtable;
 	result->refcount = 0;
+	result->loadTime = 0;
+	result->loadCount = 0;
+	result->prefetched = FALSE;
 	
 	if (vtable->freeFun == NULL)
 	{
@@ -121,17 +155,30 @@ newResourceDesc (const char *res_id, const char *resval)
 	return result;
 }
 
+static ResourceDesc *
+newResourceDesc (const char *res_id, const char *resval)
+{
+	const char *path = strchr (resval, ':');
+	return newSplitResourceDesc (res_id, resval, path ? path + 1 : NULL);
+}
+
 static void
 process_resource_desc (const char *key, const char *value)
 {
-	CharHashTable_HashTable *map = _get_current_index_header ()->map;
+	RESOURCE_INDEX idx = _get_current_index_header ();
 	ResourceDesc *newDesc = newResourceDesc (key, value);
 	if (newDesc != NULL)
 	{
-		if (!CharHashTable_add (map, key, newDesc))
+		if (!CharHashTable_add (idx->map, key, newDesc))
 		{
 			res_Remove (key);
-			CharHashTable_add (map, key, newDesc);
+			CharHashTable_add (idx->map, key, newDesc);
+		}
+		else if (idx->compiled)
+		{	// It may be in a compiled index, which this overrides.
+			res_LockLoads ();
+			removeCompiledResourceDesc (idx, key);
+			res_UnlockLoads ();
 		}
 	}
 }
@@ -339,6 +386,7 @@ InitResourceSystem (void)
 	ndx = allocResourceIndex ();
 	
 	_set_current_index_header (ndx);
+	InitResourceLoader ();
 
 	InstallResTypeVectors ("UNKNOWNRES", UseDescriptorAsRes, NULL, NULL);
 	InstallResTypeVectors ("STRING", UseDescriptorAsRes, NULL, RawDescriptor);
@@ -367,6 +415,8 @@ _get_current_index_header (void)
 void
 LoadResourceIndex (uio_DirHandle *dir, const char *rmpfile, const char *prefix)
 {
+	if (prefix == NULL && LoadCompiledResourceIndex (dir, rmpfile))
+		return;
 	PropFile_from_filename (dir, rmpfile, process_resource_desc, prefix);
 }
 
@@ -419,6 +469,7 @@ SaveResourceIndex (uio_DirHandle *dir, const char *rmpfile, const char *root, BO
 void
 UninitResourceSystem (void)
 {
+	UninitResourceLoader ();
 	freeResourceIndex (_get_current_index_header ());
 	_set_current_index_header (NULL);
 }
@@ -456,6 +507,10 @@ InstallResTypeVectors (const char *resType, ResourceLoadFun *loadFun,
 	result->fname[typelen] = '\0';
 	result->vtable = NULL;
 	result->resdata.ptr = handlers;
+	result->refcount = 0;
+	result->loadTime = 0;
+	result->loadCount = 0;
+	result->prefetched = FALSE;
 
 	map = _get_current_index_header ()->map;
 	return CharHashTable_add (map, key, result) != 0;
@@ -628,24 +683,42 @@ res_HasKey (const char *key)
 	return (lookupResourceDesc(idx, key) != NULL);
 }
 
+// To be called with the load lock held.
+void
+freeResourceDesc (const char *key, ResourceDesc *desc)
+{
+	dropResourceLoads (desc);
+	if (desc->resdata.ptr != NULL)
+	{
+		if (desc->refcount > 0)
+			log_add (log_Warning, "WARNING: Replacing '%s' while it is live", key);
+		if (desc->vtable && desc->vtable->freeFun)
+		{
+			desc->vtable->freeFun(desc->resdata.ptr);
+		}
+	}
+	HFree (desc->fname);
+	HFree (desc);
+}
+
 BOOLEAN
 res_Remove (const char *key)
 {
-	CharHashTable_HashTable *map = _get_current_index_header ()->map;
-	ResourceDesc *oldDesc = (ResourceDesc *)CharHashTable_find (map, key);
+	RESOURCE_INDEX idx = _get_current_index_header ();
+	ResourceDesc *oldDesc = (ResourceDesc *)CharHashTable_find (idx->map, key);
+	BOOLEAN result;
+
+	res_LockLoads ();
 	if (oldDesc != NULL)
 	{
-		if (oldDesc->resdata.ptr != NULL)
-		{
-			if (oldDesc->refcount > 0)
-				log_add (log_Warning, "WARNING: Replacing '%s' while it is live", key);
-			if (oldDesc->vtable && oldDesc->vtable->freeFun)
-			{
-				oldDesc->vtable->freeFun(oldDesc->resdata.ptr);
-			}
-		}
-		HFree (oldDesc->fname);
-		HFree (oldDesc);
+		freeResourceDesc (key, oldDesc);
+		result = CharHashTable_remove (idx->map, key);
 	}
-	return CharHashTable_remove (map, key);
+	else
+	{
+		result = removeCompiledResourceDesc (idx, key);
+	}
+	res_UnlockLoads ();
+
+	return result;
 }
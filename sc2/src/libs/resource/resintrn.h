@@ -24,7 +24,45 @@
 #include "index.h"
 
 ResourceDesc *lookupResourceDesc (RESOURCE_INDEX idx, RESOURCE res);
-void loadResourceDesc (ResourceDesc *desc);
+void loadResourceDesc (ResourceDesc *desc, BOOLEAN background);
+ResourceDesc *newSplitResourceDesc (const char *res_id, const char *resval,
+		const char *path);
+BOOLEAN canMakeResourceDesc (const char *resval, const char *path);
+void freeResourceDesc (const char *key, ResourceDesc *desc);
+
+typedef void (ResourceDescFun) (const char *key, ResourceDesc *desc,
+		void *arg);
+
+BOOLEAN LoadCompiledResourceIndex (uio_DirHandle *dir, const char *rmpfile);
+ResourceDesc *lookupCompiledResourceDesc (RESOURCE_INDEX idx, RESOURCE res);
+BOOLEAN removeCompiledResourceDesc (RESOURCE_INDEX idx, RESOURCE res);
+		// To be called with the load lock held
+void forEachCompiledResourceDesc (RESOURCE_INDEX idx, ResourceDescFun *fun,
+		void *arg);
+void freeCompiledResourceIndices (RESOURCE_INDEX idx);
+
+typedef struct
+{
+	DWORD loads;
+			// Loads on the threads that asked for the resource
+	DWORD loadTime;
+	DWORD waitTime;
+			// Time those threads spent waiting for the loader thread
+			// to finish loading something else
+	DWORD bgLoads;
+			// Loads on the loader thread
+	DWORD bgLoadTime;
+	DWORD bgHits;
+			// res_GetResource() calls that found the resource loaded
+			// in the background
+} ResourceLoadStats;
+
+extern ResourceLoadStats resLoadStats;
+		// Only touched with the load lock held
+
+void InitResourceLoader (void);
+void UninitResourceLoader (void);
+void dropResourceLoads (ResourceDesc *desc);
 
 void _set_current_index_header (RESOURCE_INDEX newResourceIndex);
 RESOURCE_INDEX _get_current_index_header (void);
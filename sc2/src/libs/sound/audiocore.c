@@ -270,3 +270,14 @@ audio_GetFormatInfo (uint32 format, int *channels, int *sample_size)
 	}
 	return false;
 }
+
+
+/*
+ * Notifications
+ */
+
+bool
+audio_SetProcessedCallback (audio_ProcessedCallback callback)
+{
+	return audiodrv.SetProcessedCallback (callback);
+}
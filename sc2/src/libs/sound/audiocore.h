@@ -84,6 +84,14 @@ enum
 
 extern int snddriver, soundflags;
 
+/* Called when a source has finished playing some of its queued buffers,
+ * with the number of buffers processed and queued (counting the
+ * processed ones). It is called on the thread of the driver, which may
+ * be in the middle of mixing, so it must be quick and must not call any
+ * of the audio functions. */
+typedef void (* audio_ProcessedCallback) (audio_Object srcobj,
+		uint32 processed, uint32 queued);
+
 typedef struct {
 	/* General */
 	void (* Uninitialize) (void);
@@ -122,6 +130,9 @@ typedef struct {
 			audio_IntVal *value);
 	void (* BufferData) (audio_Object bufobj, uint32 format, void* data,
 			uint32 size, uint32 freq);
+
+	/* Notifications */
+	bool (* SetProcessedCallback) (audio_ProcessedCallback callback);
 } audio_Driver;
 
 
@@ -166,4 +177,9 @@ void audio_BufferData (audio_Object bufobj, uint32 format, void* data,
 
 bool audio_GetFormatInfo (uint32 format, int *channels, int *sample_size);
 
+/* Notifications */
+/* Returns false if the driver cannot tell when buffers are processed;
+ * then their state has to be polled. */
+bool audio_SetProcessedCallback (audio_ProcessedCallback callback);
+
 #endif /* LIBS_SOUND_AUDIOCORE_H_ */
@@ -28,10 +28,12 @@ LoadSoundFile (const char *pStr)
 {
 	uio_Stream *fp;
 
-	// FIXME: this theoretically needs a mechanism to prevent races
+	res_LockLoads ();
 	if (_cur_resfile_name)
-		// something else is loading resources atm
+	{	// something else is loading resources atm, on this thread
+		res_UnlockLoads ();
 		return 0;
+	}
 
 	fp = res_OpenResFile (contentDir, pStr, "rb");
 	if (fp)
@@ -43,10 +45,12 @@ LoadSoundFile (const char *pStr)
 		_cur_resfile_name = 0;
 
 		res_CloseResFile (fp);
+		res_UnlockLoads ();
 
 		return hData;
 	}
 
+	res_UnlockLoads ();
 	return NULL;
 }
 
@@ -56,10 +60,12 @@ LoadMusicFile (const char *pStr)
 	uio_Stream *fp;
 	char filename[256];
 
-	// FIXME: this theoretically needs a mechanism to prevent races
+	res_LockLoads ();
 	if (_cur_resfile_name)
-		// something else is loading resources atm
+	{	// something else is loading resources atm, on this thread
+		res_UnlockLoads ();
 		return 0;
+	}
 
 	strncpy (filename, pStr, sizeof(filename) - 1);
 	filename[sizeof(filename) - 1] = '\0';
@@ -78,10 +84,12 @@ LoadMusicFile (const char *pStr)
 		_cur_resfile_name = 0;
 
 		res_CloseResFile (fp);
+		res_UnlockLoads ();
 
 		return hData;
 	}
 
+	res_UnlockLoads ();
 	return (0);
 }
 
@@ -0,0 +1,211 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/* Checks the block mixer against the per-sample one.
+ *
+ * Mixes the same synthetic sounds with mixer_MixChannels() and with
+ * mixer_MixChannelsReference(), for every output format and resampling
+ * quality, and fails if the output differs in a single byte. The sounds
+ * cover every buffer format, upsampling, downsampling, looping, a queue
+ * of buffers ending in the middle of a block, and gains that clip.
+ *
+ * Started with --checkmixer.
+ */
+
+#include <string.h>
+#include "mixer.h"
+#include "libs/log.h"
+#include "libs/memlib.h"
+
+#define CHECK_FREQ 44100
+
+typedef struct
+{
+	uint32 format;
+	uint32 freq;
+	float gain;
+	bool looping;
+	uint32 numBuffers;
+	uint32 samples;
+			// Per buffer; every buffer is a bit longer than the last
+} CheckSource;
+
+static const CheckSource checkSources[] =
+{
+	{MIX_FORMAT_MONO16,   22050, 0.8f, false, 3, 1001},
+	{MIX_FORMAT_STEREO16, 44100, 1.0f, true,  1,  777},
+	{MIX_FORMAT_STEREO8,  11025, 0.5f, false, 2,  333},
+	{MIX_FORMAT_MONO8,    48000, 1.5f, false, 4,  913},
+	{MIX_FORMAT_STEREO16, 32000, 2.5f, true,  2,  257},
+};
+#define NUM_CHECK_SOURCES (sizeof checkSources / sizeof checkSources[0])
+#define MAX_CHECK_BUFFERS 4
+
+static const uint32 checkFormats[] =
+{
+	MIX_FORMAT_STEREO16,
+	MIX_FORMAT_MONO16,
+	MIX_FORMAT_STEREO8,
+	MIX_FORMAT_MONO8,
+};
+#define NUM_CHECK_FORMATS (sizeof checkFormats / sizeof checkFormats[0])
+
+static const uint32 checkChunks[] =
+{
+	// In output samples; chosen to end blocks and buffers at odd places
+	1, 700, 511, 1500, 4000, 3,
+};
+#define NUM_CHECK_CHUNKS (sizeof checkChunks / sizeof checkChunks[0])
+
+typedef void MixFunc (void *userdata, uint8 *stream, sint32 len);
+
+// A sawtooth plus a bit of noise, different per source, buffer and
+// channel, covering the whole range of the sample size.
+static void
+fillCheckBuffer (uint8 *data, uint32 format, uint32 samples, uint32 seed)
+{
+	uint32 bpc = MIX_FORMAT_BPC (format);
+	uint32 count = samples * MIX_FORMAT_CHANS (format);
+	uint32 i;
+
+	for (i = 0; i < count; ++i)
+	{
+		uint32 v;
+
+		seed = seed * 1103515245 + 12345;
+		v = (i * 2731 + (seed >> 24)) & 0xffff;
+		if (bpc == 2)
+		{
+			sint16 s = (sint16) (v - 0x8000);
+			memcpy (data + i * 2, &s, 2);
+		}
+		else
+		{	// 8-bit buffers are unsigned
+			data[i] = (uint8) (v >> 8);
+		}
+	}
+}
+
+// Sets up the sources afresh, mixes all chunks with 'mix' into 'out',
+// and deletes the sources again.
+static void
+mixCheckSounds (MixFunc *mix, uint8 *out, uint32 sampsize)
+{
+	mixer_Object srcs[NUM_CHECK_SOURCES];
+	mixer_Object bufs[NUM_CHECK_SOURCES][MAX_CHECK_BUFFERS];
+	uint32 i, j;
+
+	mixer_GenSources (NUM_CHECK_SOURCES, srcs);
+	for (i = 0; i < NUM_CHECK_SOURCES; ++i)
+	{
+		const CheckSource *cs = &checkSources[i];
+
+		mixer_GenBuffers (cs->numBuffers, bufs[i]);
+		for (j = 0; j < cs->numBuffers; ++j)
+		{
+			uint32 samples = cs->samples + j * 97;
+			uint32 size = samples * MIX_FORMAT_SAMPSIZE (cs->format);
+			uint8 *data = HMalloc (size);
+
+			fillCheckBuffer (data, cs->format, samples, i * 16 + j);
+			mixer_BufferData (bufs[i][j], cs->format, data, size,
+					cs->freq);
+			HFree (data);
+		}
+		mixer_SourceQueueBuffers (srcs[i], cs->numBuffers, bufs[i]);
+		mixer_Sourcef (srcs[i], MIX_GAIN, cs->gain);
+		mixer_Sourcei (srcs[i], MIX_LOOPING, cs->looping);
+		mixer_SourcePlay (srcs[i]);
+	}
+
+	for (i = 0; i < NUM_CHECK_CHUNKS; ++i)
+	{
+		mix (NULL, out, checkChunks[i] * sampsize);
+		out += checkChunks[i] * sampsize;
+	}
+
+	for (i = 0; i < NUM_CHECK_SOURCES; ++i)
+	{
+		mixer_SourceStop (srcs[i]);
+		mixer_Sourcei (srcs[i], MIX_BUFFER, 0);
+		mixer_DeleteBuffers (checkSources[i].numBuffers, bufs[i]);
+	}
+	mixer_DeleteSources (NUM_CHECK_SOURCES, srcs);
+}
+
+/* Returns 0 if both mixers agree everywhere, and 1 if not. */
+int
+mixer_RunSelfCheck (void)
+{
+	uint32 total = 0;
+	uint8 *fast;
+	uint8 *ref;
+	int result = 0;
+	uint32 i;
+	mixer_Quality quality;
+
+	for (i = 0; i < NUM_CHECK_CHUNKS; ++i)
+		total += checkChunks[i];
+	// Room for the largest output format
+	fast = HMalloc (total * 4);
+	ref = HMalloc (total * 4);
+
+	for (i = 0; i < NUM_CHECK_FORMATS; ++i)
+	{
+		uint32 format = checkFormats[i];
+		uint32 sampsize = MIX_FORMAT_SAMPSIZE (format);
+		uint32 size = total * sampsize;
+
+		for (quality = MIX_QUALITY_LOW; quality <= MIX_QUALITY_HIGH;
+				++quality)
+		{
+			uint32 diff;
+
+			mixer_Init (CHECK_FREQ, format, quality, MIX_NOFLAGS);
+			memset (fast, 0x55, size);
+			memset (ref, 0xaa, size);
+			mixCheckSounds (mixer_MixChannels, fast, sampsize);
+			mixCheckSounds (mixer_MixChannelsReference, ref, sampsize);
+			mixer_Uninit ();
+
+			for (diff = 0; diff < size && fast[diff] == ref[diff]; ++diff)
+				;
+			if (diff < size)
+			{
+				log_add (log_Error, "Mixer check: %u-bit %s, quality %d: "
+						"the block mixer differs from the reference at "
+						"sample %u.", MIX_FORMAT_BPC (format) * 8,
+						MIX_FORMAT_CHANS (format) == 2 ? "stereo" : "mono",
+						(int) quality, diff / sampsize);
+				result = 1;
+			}
+			else
+			{
+				log_add (log_Info, "Mixer check: %u-bit %s, quality %d: "
+						"%u samples match.", MIX_FORMAT_BPC (format) * 8,
+						MIX_FORMAT_CHANS (format) == 2 ? "stereo" : "mono",
+						(int) quality, total);
+			}
+		}
+	}
+
+	HFree (fast);
+	HFree (ref);
+
+	log_add (result ? log_Error : log_Info, "Mixer check %s.",
+			result ? "FAILED" : "passed");
+	return result;
+}
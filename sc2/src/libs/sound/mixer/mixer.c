@@ -26,6 +26,7 @@
 #include "libs/threadlib.h"
 #include "libs/log.h"
 #include "libs/memlib.h"
+#include "libs/proflib.h"
 
 static uint32 mixer_initialized = 0;
 static uint32 mixer_format;
@@ -48,6 +49,12 @@ static RecursiveMutex act_mutex;
 #define MAX_SOURCES 8
 mixer_Source *active_sources[MAX_SOURCES];
 
+/* sources with buffers processed in the current mixing pass;
+ * only touched with the mixer mutexes held */
+static mixer_ProcessedCallback processed_callback;
+static mixer_Source *notify_sources[MAX_SOURCES];
+static uint32 notify_count;
+
 
 /*************************************************
  *  Internals
@@ -109,6 +116,15 @@ mixer_Init (uint32 frequency, uint32 format, mixer_Quality quality,
 	return true;
 }
 
+/* Set the function to tell about processed buffers; NULL for none */
+void
+mixer_SetProcessedCallback (mixer_ProcessedCallback callback)
+{
+	LockRecursiveMutex (src_mutex);
+	processed_callback = callback;
+	UnlockRecursiveMutex (src_mutex);
+}
+
 /* Uninitialize the mixer */
 void
 mixer_Uninit (void)
@@ -128,8 +144,76 @@ mixer_Uninit (void)
  *
  */
 
+/* Mixes MIX_BLOCK_SAMPLES output samples (of one channel each) at a
+ * time: every active source is rendered into mixer_blockSource, summed
+ * into mixer_blockAccum, and the sum is clipped once at the end.
+ * Sources do not affect each other, so doing them one at a time gives
+ * the same output as mixer_MixChannelsReference(), which goes sample by
+ * sample; mixer_RunSelfCheck() (--checkmixer) checks that.
+ * Must be even, so every block starts on a left sample.
+ * The scratch buffers are only touched with the mixer mutexes held.
+ */
+#define MIX_BLOCK_SAMPLES 512
+static float mixer_blockAccum[MIX_BLOCK_SAMPLES];
+static float mixer_blockSource[MIX_BLOCK_SAMPLES];
+
 void
 mixer_MixChannels (void *userdata, uint8 *stream, sint32 len)
+{
+	uint32 total = len / mixer_chansize;
+
+	/* Called on the thread of the audio driver, which we do not start */
+	prof_nameThread ("audio mixer");
+	PROF_BEGIN ("MixChannels");
+
+	/* keep this order or die */
+	LockRecursiveMutex (src_mutex);
+	LockRecursiveMutex (buf_mutex);
+	LockRecursiveMutex (act_mutex);
+
+	while (total > 0)
+	{
+		uint32 count = total;
+		uint32 i;
+
+		if (count > MIX_BLOCK_SAMPLES)
+			count = MIX_BLOCK_SAMPLES;
+
+		memset (mixer_blockAccum, 0, count * sizeof (float));
+
+		for (i = 0; i < MAX_SOURCES; i++)
+		{
+			mixer_Source *src = active_sources[i];
+			uint32 got;
+
+			if (!src || src->state != MIX_PLAYING)
+				continue;
+
+			got = mixer_SourceGetBlock (src, mixer_blockSource, count);
+			mixer_AccumulateBlock (mixer_blockAccum, mixer_blockSource, got);
+		}
+
+		mixer_PutBlock (stream, mixer_blockAccum, count);
+		stream += count * mixer_chansize;
+		total -= count;
+	}
+
+	mixer_NotifyProcessed ();
+
+	/* keep this order or die */
+	UnlockRecursiveMutex (act_mutex);
+	UnlockRecursiveMutex (buf_mutex);
+	UnlockRecursiveMutex (src_mutex);
+	PROF_END ();
+
+	(void) userdata; // satisfying compiler - unused arg
+}
+
+/* The original per-sample mixer; mixer_MixChannels() must produce the
+ * same output. Kept as the reference that mixer_RunSelfCheck() checks it
+ * against. */
+void
+mixer_MixChannelsReference (void *userdata, uint8 *stream, sint32 len)
 {
 	uint8 *end_stream = stream + len;
 	bool left = true;
@@ -187,6 +271,8 @@ mixer_MixChannels (void *userdata, uint8 *stream, sint32 len)
 			left = !left;
 	}
 
+	mixer_NotifyProcessed ();
+
 	/* keep this order or die */
 	UnlockRecursiveMutex (act_mutex);
 	UnlockRecursiveMutex (buf_mutex);
@@ -228,6 +314,8 @@ mixer_MixFake (void *userdata, uint8 *stream, sint32 len)
 			left = !left;
 	}
 
+	mixer_NotifyProcessed ();
+
 	/* keep this order or die */
 	UnlockRecursiveMutex (act_mutex);
 	UnlockRecursiveMutex (buf_mutex);
@@ -272,6 +360,7 @@ mixer_GenSources (uint32 n, mixer_Object *psrcobj)
 		src->lastqueued = 0;
 		src->pos = 0;
 		src->count = 0;
+		src->notify = false;
 
 		*psrcobj = (mixer_Object) src;
 	}
@@ -1005,6 +1094,39 @@ mixer_SourceRewind_internal (mixer_Source *src)
 	src->state = MIX_INITIAL;
 }
 
+/* count a buffer of the source as processed, and remember to report it
+ * at the end of the mixing pass */
+static inline void
+mixer_SourceBufferProcessed (mixer_Source *src)
+{
+	src->cprocessed++;
+	if (!src->notify && notify_count < MAX_SOURCES)
+	{
+		src->notify = true;
+		notify_sources[notify_count++] = src;
+	}
+}
+
+/* report the sources that had buffers processed in this mixing pass */
+static void
+mixer_NotifyProcessed (void)
+{
+	uint32 i;
+
+	for (i = 0; i < notify_count; i++)
+	{
+		mixer_Source *src = notify_sources[i];
+
+		src->notify = false;
+		if (processed_callback)
+		{
+			processed_callback ((mixer_Object) src, src->cprocessed,
+					src->cqueued);
+		}
+	}
+	notify_count = 0;
+}
+
 /* get the sample next in queue in internal format */
 static inline bool
 mixer_SourceGetNextSample (mixer_Source *src, float *psamp, bool left)
@@ -1023,7 +1145,7 @@ mixer_SourceGetNextSample (mixer_Source *src, float *psamp, bool left)
 			buf->state = MIX_BUF_PROCESSED;
 			src->pos = 0;
 			src->nextqueued = src->nextqueued->next;
-			src->cprocessed++;
+			mixer_SourceBufferProcessed (src);
 			continue;
 		}
 
@@ -1049,7 +1171,7 @@ mixer_SourceGetNextSample (mixer_Source *src, float *psamp, bool left)
 			src->pos = 0;
 			src->prevqueued = src->nextqueued;
 			src->nextqueued = src->nextqueued->next;
-			src->cprocessed++;
+			mixer_SourceBufferProcessed (src);
 		}
 		
 		return true;
@@ -1064,6 +1186,154 @@ mixer_SourceGetNextSample (mixer_Source *src, float *psamp, bool left)
 	return false;
 }
 
+/* copy a run of samples from a buffer that needs no resampling,
+ * starting on a left sample; returns the number of output samples
+ * produced, or 0 if the next sample has to go the per-sample way */
+static inline uint32
+mixer_SourceCopyRun (mixer_Source *src, float *dst, uint32 count)
+{
+	mixer_Buffer *buf = src->nextqueued;
+	/* mono buffer on a stereo mixer: each sample goes to both channels */
+	bool dup = buf->sampsize != mixer_sampsize;
+	float gain = src->gain;
+	uint32 avail;
+	uint32 n, i;
+
+	if (src->pos >= buf->size)
+		return 0;
+	avail = (buf->size - src->pos) / mixer_chansize;
+	if (dup)
+		count /= 2;
+	n = avail < count ? avail : count;
+	if (n == 0)
+		return 0;
+
+	if (mixer_chansize == 2)
+	{
+		const sint16 *s = (const sint16 *) (buf->data + src->pos);
+		if (dup)
+		{
+			for (i = 0; i < n; i++)
+				dst[i * 2] = dst[i * 2 + 1] = s[i] * gain;
+		}
+		else
+		{
+			for (i = 0; i < n; i++)
+				dst[i] = s[i] * gain;
+		}
+	}
+	else
+	{
+		const sint8 *s = (const sint8 *) (buf->data + src->pos);
+		if (dup)
+		{
+			for (i = 0; i < n; i++)
+				dst[i * 2] = dst[i * 2 + 1] = s[i] * gain;
+		}
+		else
+		{
+			for (i = 0; i < n; i++)
+				dst[i] = s[i] * gain;
+		}
+	}
+
+	src->pos += n * mixer_chansize;
+	if (dup)
+		n *= 2;
+	src->samplecache = dst[n - 1];
+
+	if (src->pos < buf->size)
+	{
+		buf->state = MIX_BUF_PLAYING;
+	}
+	else
+	{
+		/* buffer exhausted, go next */
+		buf->state = MIX_BUF_PROCESSED;
+		src->pos = 0;
+		src->prevqueued = src->nextqueued;
+		src->nextqueued = src->nextqueued->next;
+		mixer_SourceBufferProcessed (src);
+	}
+
+	return n;
+}
+
+/* get the next count samples of a source, as the per-sample mixer
+ * would; returns less than count only when the source runs out */
+static uint32
+mixer_SourceGetBlock (mixer_Source *src, float *dst, uint32 count)
+{
+	uint32 k = 0;
+
+	while (k < count)
+	{
+		mixer_Buffer *buf = src->nextqueued;
+		bool left = mixer_channels != 2 || !(k & 1);
+
+		if (left && buf && buf->data && buf->size >= mixer_sampsize
+				&& buf->Resample == mixer_ResampleNone
+				&& !(mixer_flags & MIX_FAKE_DATA))
+		{
+			uint32 run = mixer_SourceCopyRun (src, dst + k, count - k);
+			if (run > 0)
+			{
+				k += run;
+				continue;
+			}
+		}
+
+		if (!mixer_SourceGetNextSample (src, dst + k, left))
+			break;
+		k++;
+	}
+
+	return k;
+}
+
+/* add a source's samples to the mix */
+static inline void
+mixer_AccumulateBlock (float *accum, const float *samples, uint32 count)
+{
+	uint32 i;
+
+	for (i = 0; i < count; i++)
+		accum[i] += samples[i];
+}
+
+/* clip the mix and put it in the output stream */
+static void
+mixer_PutBlock (uint8 *stream, const float *accum, uint32 count)
+{
+	uint32 i;
+
+	if (mixer_chansize == 2)
+	{
+		sint16 *dst = (sint16 *) stream;
+		for (i = 0; i < count; i++)
+		{
+			float samp = accum[i];
+			if (samp > MIX_S16_MAX)
+				samp = MIX_S16_MAX;
+			else if (samp < MIX_S16_MIN)
+				samp = MIX_S16_MIN;
+			dst[i] = (sint16) samp;
+		}
+	}
+	else
+	{
+		for (i = 0; i < count; i++)
+		{
+			float samp = accum[i];
+			if (samp > MIX_S8_MAX)
+				samp = MIX_S8_MAX;
+			else if (samp < MIX_S8_MIN)
+				samp = MIX_S8_MIN;
+			stream[i] = (uint8) ((sint32) samp ^ 0x80);
+		}
+	}
+}
+
 /* fake the next sample, but process buffers and states */
 static inline bool
 mixer_SourceGetFakeSample (mixer_Source *src, float *psamp, bool left)
@@ -1093,7 +1363,7 @@ mixer_SourceGetFakeSample (mixer_Source *src, float *psamp, bool left)
 			src->pos = 0;
 			src->prevqueued = src->nextqueued;
 			src->nextqueued = src->nextqueued->next;
-			src->cprocessed++;
+			mixer_SourceBufferProcessed (src);
 		}
 		
 		return true;
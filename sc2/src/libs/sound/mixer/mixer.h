@@ -203,6 +203,7 @@ struct _mixer_Source
 
 	float samplecache;
 
+	bool notify; /* has processed buffers to report */
 };
 
 #define mixer_srcMagic 0x5358494DU /* MIXS in LSB */
@@ -216,7 +217,22 @@ bool mixer_Init (uint32 frequency, uint32 format, mixer_Quality quality,
 		mixer_Flags flags);
 void mixer_Uninit (void);
 void mixer_MixChannels (void *userdata, uint8 *stream, sint32 len);
+void mixer_MixChannelsReference (void *userdata, uint8 *stream,
+		sint32 len);
 void mixer_MixFake (void *userdata, uint8 *stream, sint32 len);
+/* Mixes the same sounds with mixer_MixChannels() and with
+ * mixer_MixChannelsReference(); returns 0 if they agree, 1 if not.
+ * Uses the mixer itself, so nothing else may be using it. */
+int mixer_RunSelfCheck (void);
+
+/* Called at the end of a mixing pass, for every source that finished
+ * playing some of its buffers in that pass, with the number of buffers
+ * processed and queued (counting the processed ones) at that point.
+ * Runs on the mixing thread with the mixer locked, so it must be quick
+ * and must not call back into the mixer. */
+typedef void (* mixer_ProcessedCallback) (mixer_Object srcobj,
+		uint32 processed, uint32 queued);
+void mixer_SetProcessedCallback (mixer_ProcessedCallback callback);
 
 /*************************************************
  *  Sources
@@ -106,5 +106,17 @@ static inline bool mixer_SourceGetNextSample (mixer_Source *src,
 static inline bool mixer_SourceGetFakeSample (mixer_Source *src,
 		float *psamp, bool left);
 static inline uint32 mixer_SourceAdvance (mixer_Source *src, bool left);
+static inline void mixer_SourceBufferProcessed (mixer_Source *src);
+static void mixer_NotifyProcessed (void);
+
+/* The block mixer */
+static inline uint32 mixer_SourceCopyRun (mixer_Source *src, float *dst,
+		uint32 count);
+static uint32 mixer_SourceGetBlock (mixer_Source *src, float *dst,
+		uint32 count);
+static inline void mixer_AccumulateBlock (float *accum,
+		const float *samples, uint32 count);
+static void mixer_PutBlock (uint8 *stream, const float *accum,
+		uint32 count);
 
 #endif /* LIBS_SOUND_MIXER_MIXERINT_H_ */
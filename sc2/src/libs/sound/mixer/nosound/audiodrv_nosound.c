@@ -90,7 +90,10 @@ static const audio_Driver noSound_Driver =
 	noSound_DeleteBuffers,
 	noSound_IsBuffer,
 	noSound_GetBufferi,
-	noSound_BufferData
+	noSound_BufferData,
+
+	/* Notifications */
+	noSound_SetProcessedCallback
 };
 
 
@@ -408,3 +411,28 @@ noSound_BufferData (audio_Object bufobj, uint32 format, void* data,
 {
 	mixer_BufferData ((mixer_Object) bufobj, format, data, size, freq);
 }
+
+
+/*
+ * Notifications
+ */
+
+static audio_ProcessedCallback processedCallback;
+
+static void
+processedCallbackMixer (mixer_Object srcobj, uint32 processed,
+		uint32 queued)
+{
+	processedCallback ((audio_Object) srcobj, processed, queued);
+}
+
+bool
+noSound_SetProcessedCallback (audio_ProcessedCallback callback)
+{
+	// The mixer serializes this with the mixing
+	mixer_SetProcessedCallback (NULL);
+	processedCallback = callback;
+	if (callback)
+		mixer_SetProcessedCallback (processedCallbackMixer);
+	return true;
+}
@@ -65,5 +65,8 @@ void noSound_GetBufferi (audio_Object bufobj, audio_BufferProp pname,
 void noSound_BufferData (audio_Object bufobj, uint32 format, void* data,
 		uint32 size, uint32 freq);
 
+/* Notifications */
+bool noSound_SetProcessedCallback (audio_ProcessedCallback callback);
+
 
 #endif /* LIBS_SOUND_MIXER_NOSOUND_AUDIODRV_NOSOUND_H_ */
@@ -94,7 +94,10 @@ static const audio_Driver mixSDL_Driver =
 	mixSDL_DeleteBuffers,
 	mixSDL_IsBuffer,
 	mixSDL_GetBufferi,
-	mixSDL_BufferData
+	mixSDL_BufferData,
+
+	/* Notifications */
+	mixSDL_SetProcessedCallback
 };
 
 
@@ -484,3 +487,28 @@ mixSDL_BufferData (audio_Object bufobj, uint32 format, void* data,
 {
 	mixer_BufferData ((mixer_Object) bufobj, format, data, size, freq);
 }
+
+
+/*
+ * Notifications
+ */
+
+static audio_ProcessedCallback processedCallback;
+
+static void
+processedCallbackMixer (mixer_Object srcobj, uint32 processed,
+		uint32 queued)
+{
+	processedCallback ((audio_Object) srcobj, processed, queued);
+}
+
+bool
+mixSDL_SetProcessedCallback (audio_ProcessedCallback callback)
+{
+	// The mixer serializes this with the mixing
+	mixer_SetProcessedCallback (NULL);
+	processedCallback = callback;
+	if (callback)
+		mixer_SetProcessedCallback (processedCallbackMixer);
+	return true;
+}
@@ -62,5 +62,8 @@ void mixSDL_GetBufferi (audio_Object bufobj, audio_BufferProp pname,
 void mixSDL_BufferData (audio_Object bufobj, uint32 format, void* data,
 		uint32 size, uint32 freq);
 
+/* Notifications */
+bool mixSDL_SetProcessedCallback (audio_ProcessedCallback callback);
+
 
 #endif /* LIBS_SOUND_MIXER_SDL_AUDIODRV_SDL_H_ */
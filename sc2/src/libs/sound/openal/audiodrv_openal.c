@@ -96,7 +96,10 @@ static const audio_Driver openAL_Driver =
 	openAL_DeleteBuffers,
 	openAL_IsBuffer,
 	openAL_GetBufferi,
-	openAL_BufferData
+	openAL_BufferData,
+
+	/* Notifications */
+	openAL_SetProcessedCallback
 };
 
 
@@ -417,4 +420,17 @@ openAL_BufferData (audio_Object bufobj, uint32 format, void* data,
 			(ALsizei) size, (ALsizei) freq);
 }
 
+
+/*
+ * Notifications
+ */
+
+bool
+openAL_SetProcessedCallback (audio_ProcessedCallback callback)
+{
+	// OpenAL does not tell when a buffer has been played
+	(void) callback;
+	return false;
+}
+
 #endif
@@ -82,5 +82,8 @@ void openAL_GetBufferi (audio_Object bufobj, audio_BufferProp pname,
 void openAL_BufferData (audio_Object bufobj, uint32 format, void* data,
 		uint32 size, uint32 freq);
 
+/* Notifications */
+bool openAL_SetProcessedCallback (audio_ProcessedCallback callback);
+
 
 #endif /* LIBS_SOUND_OPENAL_AUDIODRV_OPENAL_H_ */
@@ -62,6 +62,7 @@ typedef struct tfb_soundsource
 	void *positional_object;
 
 	audio_Object last_q_buf; // for callbacks processing
+	uint32 refill_batch;     // processed buffers to wake the decoder for
 
 	// Cyclic waveform buffer for oscilloscope
 	void *sbuffer; 
@@ -25,10 +25,35 @@
 #include "libs/threadlib.h"
 #include "libs/log.h"
 #include "libs/memlib.h"
+#include "libs/proflib.h"
 
 
 static Task decoderTask;
 
+// The decoder task sleeps on decoderWakeup until the audio driver tells
+// that a stream has played enough of its buffers (see
+// StreamBuffersProcessed()), so that it decodes a batch of buffers at a
+// time. Drivers that cannot tell (OpenAL) are polled instead.
+static Semaphore decoderWakeup;
+static Mutex wakeupMutex;
+static bool wakeupPending;
+		// decoderWakeup has been posted and not yet taken;
+		// guarded by wakeupMutex
+static bool buffersNotified;
+		// The driver tells when buffers are processed
+
+#define STREAM_FADE_PERIOD  (ONE_SECOND / 60)
+		// Between music fade steps
+#define STREAM_POLL_PERIOD  (ONE_SECOND / 50)
+		// Between checks of the streams, when the driver does not tell
+		// when buffers are processed
+#define STREAM_CHECK_PERIOD (ONE_SECOND / 4)
+		// Between checks of the streams otherwise, just in case
+#define STREAM_IDLE_PERIOD  (ONE_SECOND / 10)
+		// Between checks when no streams are playing, when polling
+
+static TFB_StreamDecoderStats decoderStats;
+
 static TimeCount musicFadeStartTime;
 static sint32 musicFadeInterval;
 static int musicFadeStartVolume;
@@ -37,6 +62,7 @@ static int musicFadeDelta;
 static Mutex fade_mutex;
 
 static void add_scope_data (TFB_SoundSource *source, uint32 bytes);
+static void WakeStreamDecoder (void);
 
 
 void
@@ -68,6 +94,13 @@ PlayStream (TFB_SoundSample *sample, uint32 source, bool looping, bool scope,
 	
 	soundSource[source].sample = sample;
 	decoder->looping = looping;
+	// The oscilloscope and the buffer tags (for subtitles) need every
+	// buffer handled as soon as it has played; otherwise, refill half
+	// of the buffers at a time.
+	if (scope || sample->callbacks.OnTaggedBuffer)
+		soundSource[source].refill_batch = 1;
+	else
+		soundSource[source].refill_batch = (sample->num_buffers + 1) / 2;
 	audio_Sourcei (soundSource[source].handle, audio_LOOPING, false);
 
 	if (scope)
@@ -350,41 +383,56 @@ add_scope_data (TFB_SoundSource *source, uint32 bytes)
 	}
 }
 
+// Handles a source that has stopped playing: the stream either has
+// ended, or it has run out of buffers before they could be replaced.
 static void
+check_stream_state (TFB_SoundSource *source)
+{
+	TFB_SoundSample *sample = source->sample;
+	TFB_SoundDecoder *decoder = sample->decoder;
+	audio_IntVal queued;
+	audio_IntVal state;
+
+	audio_GetSourcei (source->handle, audio_SOURCE_STATE, &state);
+	if (state == audio_PLAYING)
+		return;
+
+	audio_GetSourcei (source->handle, audio_BUFFERS_QUEUED, &queued);
+	if (queued == 0 && decoder->error == SOUNDDECODER_EOF)
+	{	// The stream has reached the end
+		log_add (log_Info, "StreamDecoderTaskFunc(): "
+				"finished playing %s", decoder->filename);
+		source->stream_should_be_playing = FALSE;
+		
+		if (sample->callbacks.OnEndStream)
+			sample->callbacks.OnEndStream (sample);
+	}
+	else
+	{
+		log_add (log_Warning, "StreamDecoderTaskFunc(): "
+				"buffer underrun playing %s", decoder->filename);
+		decoderStats.underruns++;
+		audio_SourcePlay (source->handle);
+	}
+}
+
+// Replaces the buffers of the source that have been played.
+// Returns the number of buffers queued.
+static uint32
 process_stream (TFB_SoundSource *source)
 {
 	TFB_SoundSample *sample = source->sample;
 	TFB_SoundDecoder *decoder = sample->decoder;
 	bool end_chunk_failed = false;
 	audio_IntVal processed;
-	audio_IntVal queued;
+	uint32 refilled = 0;
 
 	audio_GetSourcei (source->handle, audio_BUFFERS_PROCESSED, &processed);
-	audio_GetSourcei (source->handle, audio_BUFFERS_QUEUED, &queued);
 
 	if (processed == 0)
 	{	// Nothing was played
-		audio_IntVal state;
-
-		audio_GetSourcei (source->handle, audio_SOURCE_STATE, &state);
-		if (state != audio_PLAYING)
-		{
-			if (queued == 0 && decoder->error == SOUNDDECODER_EOF)
-			{	// The stream has reached the end
-				log_add (log_Info, "StreamDecoderTaskFunc(): "
-						"finished playing %s", decoder->filename);
-				source->stream_should_be_playing = FALSE;
-				
-				if (sample->callbacks.OnEndStream)
-					sample->callbacks.OnEndStream (sample);
- 			}
-			else
- 			{
-				log_add (log_Warning, "StreamDecoderTaskFunc(): "
-						"buffer underrun playing %s", decoder->filename);
-				audio_SourcePlay (source->handle);
-			}
-		}
+		check_stream_state (source);
+		return 0;
 	}
     
 	// Unqueue processed buffers and replace them with new ones
@@ -499,22 +547,31 @@ process_stream (TFB_SoundSource *source)
 		
 		if (source->sbuffer)
 			add_scope_data (source, decoded_bytes);
+		refilled++;
 	}
+
+	// The source may have run dry before its buffers were replaced
+	if (source->stream_should_be_playing)
+		check_stream_state (source);
+
+	return refilled;
 }
 
-static void
+// Returns true if the fade is still going on
+static bool
 processMusicFade (void)
 {
 	TimeCount Now;
 	sint32 elapsed;
 	int newVolume;
+	bool fading;
 
 	LockMutex (fade_mutex);
 
 	if (!musicFadeInterval)
 	{	// there is no fade set
 		UnlockMutex (fade_mutex);
-		return;
+		return false;
 	}
 
 	Now = GetTimeCounter ();
@@ -528,8 +585,56 @@ processMusicFade (void)
 
 	if (elapsed >= musicFadeInterval)
 		musicFadeInterval = 0; // fade is over
+	fading = musicFadeInterval != 0;
 
 	UnlockMutex (fade_mutex);
+
+	return fading;
+}
+
+// Wakes up the decoder task, if it is not already about to wake up.
+static void
+WakeStreamDecoder (void)
+{
+	LockMutex (wakeupMutex);
+	if (!wakeupPending)
+	{
+		wakeupPending = true;
+		ClearSemaphore (decoderWakeup);
+	}
+	UnlockMutex (wakeupMutex);
+}
+
+// Sleeps until woken up, or for at most 'timeout'.
+static void
+WaitStreamDecoder (TimePeriod timeout)
+{
+	SetSemaphoreTimeout (decoderWakeup, timeout);
+
+	// Any buffers processed from here on need another wakeup
+	LockMutex (wakeupMutex);
+	wakeupPending = false;
+	UnlockMutex (wakeupMutex);
+}
+
+// Called by the audio driver, possibly in the middle of mixing.
+static void
+StreamBuffersProcessed (audio_Object srcobj, uint32 processed,
+		uint32 queued)
+{
+	int i;
+
+	for (i = MUSIC_SOURCE; i < NUM_SOUNDSOURCES; ++i)
+	{
+		if (soundSource[i].handle != srcobj)
+			continue;
+
+		// Wait for a batch of buffers to replace, unless the stream
+		// has run dry
+		if (processed >= soundSource[i].refill_batch || processed >= queued)
+			WakeStreamDecoder ();
+		break;
+	}
 }
 
 static int
@@ -537,13 +642,16 @@ StreamDecoderTaskFunc (void *data)
 {
 	Task task = (Task)data;
 	int active_streams;
+	bool fading;
 	int i;
 	
+	prof_nameThread ("audio streams");
 	while (!Task_ReadState (task, TASK_EXIT))
 	{
 		active_streams = 0;
+		decoderStats.wakeups++;
 
-		processMusicFade ();
+		fading = processMusicFade ();
 
 		for (i = MUSIC_SOURCE; i < NUM_SOUNDSOURCES; ++i)
 		{
@@ -560,18 +668,23 @@ StreamDecoderTaskFunc (void *data)
 				continue;
 			}
 
-			process_stream (source);
+			PROF_BEGIN_DETAIL ("process_stream",
+					source->sample->decoder->filename);
+			decoderStats.buffers += process_stream (source);
+			PROF_END ();
 			active_streams++;
 
 			UnlockMutex (source->stream_mutex);
 		}
 
-		if (active_streams == 0) 
-		{	// Throttle down the thread when there are no active streams
-			HibernateThread (ONE_SECOND / 10);
-		}
+		if (fading)
+			WaitStreamDecoder (STREAM_FADE_PERIOD);
+		else if (buffersNotified)
+			WaitStreamDecoder (STREAM_CHECK_PERIOD);
+		else if (active_streams == 0)
+			WaitStreamDecoder (STREAM_IDLE_PERIOD);
 		else
-			TaskSwitch ();
+			WaitStreamDecoder (STREAM_POLL_PERIOD);
 	}
 
 	FinishTask (task);
@@ -779,9 +892,18 @@ SetMusicStreamFade (sint32 howLong, int endVolume)
 
 	UnlockMutex (fade_mutex);
 
+	if (ret)
+		WakeStreamDecoder ();
+
 	return ret;
 }
 
+void
+GetStreamDecoderStats (TFB_StreamDecoderStats *stats)
+{
+	*stats = decoderStats;
+}
+
 int
 InitStreamDecoder (void)
 {
@@ -789,6 +911,20 @@ InitStreamDecoder (void)
 	if (!fade_mutex)
 		return -1;
 
+	wakeupMutex = CreateMutex ("Stream wakeup mutex", SYNC_CLASS_AUDIO);
+	decoderWakeup = CreateSemaphore (0, "Stream decoder wakeup",
+			SYNC_CLASS_AUDIO);
+	wakeupPending = false;
+	memset (&decoderStats, 0, sizeof decoderStats);
+	decoderStats.start_time = GetTimeCounter ();
+
+	buffersNotified = audio_SetProcessedCallback (StreamBuffersProcessed);
+	if (!buffersNotified)
+	{
+		log_add (log_Info, "Stream decoder: the audio driver does not "
+				"report played buffers; polling");
+	}
+
 	decoderTask = AssignTask (StreamDecoderTaskFunc, 1024, 
 		"audio stream decoder");
 	if (!decoderTask)
@@ -800,10 +936,40 @@ InitStreamDecoder (void)
 void
 UninitStreamDecoder (void)
 {
+	if (buffersNotified)
+	{
+		audio_SetProcessedCallback (NULL);
+		buffersNotified = false;
+	}
+
 	if (decoderTask)
 	{
+		TimeCount elapsed = GetTimeCounter () - decoderStats.start_time;
+
+		Task_SetState (decoderTask, TASK_EXIT);
+		WakeStreamDecoder ();
 		ConcludeTask (decoderTask);
 		decoderTask = NULL;
+
+		log_add (log_Info, "Stream decoder: %lu wakeups in %lu s "
+				"(%.1f per second), %lu buffers decoded, %lu underruns",
+				(unsigned long) decoderStats.wakeups,
+				(unsigned long) (elapsed / ONE_SECOND),
+				elapsed ? (double) decoderStats.wakeups * ONE_SECOND
+				/ elapsed : 0.0,
+				(unsigned long) decoderStats.buffers,
+				(unsigned long) decoderStats.underruns);
+	}
+
+	if (decoderWakeup)
+	{
+		DestroySemaphore (decoderWakeup);
+		decoderWakeup = NULL;
+	}
+	if (wakeupMutex)
+	{
+		DestroyMutex (wakeupMutex);
+		wakeupMutex = NULL;
 	}
 
 	if (fade_mutex)
@@ -20,6 +20,19 @@
 int InitStreamDecoder (void);
 void UninitStreamDecoder (void);
 
+// Counters of the stream decoder task, since it was started.
+// They are only updated by that task, so another thread may see them
+// slightly out of date.
+typedef struct
+{
+	uint32 wakeups;        // times the task woke up to look at the streams
+	uint32 buffers;        // buffers decoded and queued
+	uint32 underruns;      // times a stream ran dry and was restarted
+	TimeCount start_time;  // when the task was started
+} TFB_StreamDecoderStats;
+
+void GetStreamDecoderStats (TFB_StreamDecoderStats *stats);
+
 void PlayStream (TFB_SoundSample *sample, uint32 source, bool looping, 
 				 bool scope, bool rewind);
 void StopStream (uint32 source);
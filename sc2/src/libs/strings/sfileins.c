@@ -27,10 +27,12 @@ LoadStringTableFile (uio_DirHandle *dir, const char *fileName)
 {
 	uio_Stream *fp;
 
-	// FIXME: this theoretically needs a mechanism to prevent races
+	res_LockLoads ();
 	if (_cur_resfile_name)
-		// something else is loading resources atm
+	{	// something else is loading resources atm, on this thread
+		res_UnlockLoads ();
 		return 0;
+	}
 
 	fp = res_OpenResFile (dir, fileName, "rb");
 	if (fp)
@@ -41,10 +43,12 @@ LoadStringTableFile (uio_DirHandle *dir, const char *fileName)
 		data = (STRING_TABLE) _GetStringData (fp, LengthResFile (fp));
 		_cur_resfile_name = 0;
 		res_CloseResFile (fp);
+		res_UnlockLoads ();
 
 		return data;
 	}
 
+	res_UnlockLoads ();
 	return (0);
 }
 
@@ -164,6 +164,9 @@ void PrintThreadsStats (void);
 void DestroySemaphore (Semaphore sem);
 void SetSemaphore (Semaphore sem);
 void ClearSemaphore (Semaphore sem);
+/* Like SetSemaphore(), but gives up after 'timeout'.
+   Returns true if the semaphore was acquired. */
+bool SetSemaphoreTimeout (Semaphore sem, TimePeriod timeout);
 
 void DestroyMutex (Mutex sem);
 void LockMutex (Mutex sem);
@@ -179,6 +182,40 @@ void WaitCondVar (CondVar);
 void SignalCondVar (CondVar);
 void BroadcastCondVar (CondVar);
 
+/* Ordered access to words shared between two threads without a lock, as
+   in a single-producer/single-consumer queue. Everything a thread wrote
+   before an AtomicStoreRelease() is visible to a thread that sees the
+   stored value through AtomicLoadAcquire(). These give no atomicity for
+   read-modify-write sequences; only one thread may write a given word. */
+#if defined(__GNUC__) && (__GNUC__ > 4 || \
+		(__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
+#	define AtomicLoadAcquire(ptr) \
+		__atomic_load_n ((ptr), __ATOMIC_ACQUIRE)
+#	define AtomicStoreRelease(ptr, val) \
+		__atomic_store_n ((ptr), (val), __ATOMIC_RELEASE)
+#elif defined(__GNUC__)
+	/* Older GCC only has the full barrier. */
+#	define AtomicLoadAcquire(ptr) \
+		AtomicLoadAcquire_Sync ((volatile DWORD *) (ptr))
+#	define AtomicStoreRelease(ptr, val) \
+		do { \
+			__sync_synchronize (); \
+			*(ptr) = (val); \
+		} while (0)
+static inline DWORD
+AtomicLoadAcquire_Sync (volatile DWORD *ptr)
+{
+	DWORD val = *ptr;
+	__sync_synchronize ();
+	return val;
+}
+#else
+	/* MSVC gives volatile accesses acquire/release semantics (/volatile:ms,
+	   the default on x86 and x64). */
+#	define AtomicLoadAcquire(ptr) (*(ptr))
+#	define AtomicStoreRelease(ptr, val) ((void) (*(ptr) = (val)))
+#endif
+
 #if defined(__cplusplus)
 }
 #endif
@@ -22,6 +22,8 @@
 #include <unistd.h>
 
 #include <semaphore.h>
+#include <errno.h>
+#include <time.h>
 
 #include "libs/log/uqmlog.h"
 
@@ -483,6 +485,71 @@ ClearSemaphore_PT (Semaphore s)
 	//log_add (log_Debug, "Attempt to clear semaphore %x success", sem);
 }
 
+// Returns the time left until 'deadline' on the monotonic clock, in
+// nanoseconds, or 0 if it has passed.
+static uint64
+nsecUntil (const struct timespec *deadline)
+{
+	struct timespec now;
+	sint64 left;
+
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	left = (sint64) (deadline->tv_sec - now.tv_sec) * 1000000000
+			+ (deadline->tv_nsec - now.tv_nsec);
+	return left > 0 ? (uint64) left : 0;
+}
+
+// The timeout is kept on the monotonic clock, so that setting the wall
+// clock does not make the wait shorter or longer than asked.
+bool
+SetSemaphoreTimeout_PT (Semaphore s, TimePeriod timeout)
+{
+	Sem *sem = (Sem *)s;
+	struct timespec deadline;
+	uint64 nsec;
+
+	clock_gettime (CLOCK_MONOTONIC, &deadline);
+	nsec = (uint64) timeout * 1000000000 / ONE_SECOND + deadline.tv_nsec;
+	deadline.tv_sec += (time_t) (nsec / 1000000000);
+	deadline.tv_nsec = (long) (nsec % 1000000000);
+
+#ifdef HAVE_SEM_TIMEDWAIT
+	// sem_timedwait() only takes an absolute time on the realtime clock.
+	// If that clock is set forward during the wait, the wait ends early
+	// and is started again for the time that is left. A clock set back
+	// still makes it last longer.
+	while ((nsec = nsecUntil (&deadline)) > 0)
+	{
+		struct timespec until;
+
+		clock_gettime (CLOCK_REALTIME, &until);
+		nsec += until.tv_nsec;
+		until.tv_sec += (time_t) (nsec / 1000000000);
+		until.tv_nsec = (long) (nsec % 1000000000);
+
+		if (sem_timedwait (&sem->sem, &until) == 0)
+			return true;
+		if (errno != EINTR && errno != ETIMEDOUT)
+			return false;
+	}
+#else
+	// No sem_timedwait() (MacOS X); poll the semaphore instead.
+	while (nsecUntil (&deadline) > 0)
+	{
+		static const struct timespec pollInterval = { 0, 1000000 };
+				// 1 ms
+
+		if (sem_trywait (&sem->sem) == 0)
+			return true;
+		if (errno != EAGAIN && errno != EINTR)
+			return false;
+		nanosleep (&pollInterval, NULL);
+	}
+#endif
+	// One last try, which also covers a zero timeout
+	return sem_trywait (&sem->sem) == 0;
+}
+
 /* Recursive mutexes. Adapted from mixSDL code, which was adapted from
    the original DCQ code. */
 
@@ -54,6 +54,7 @@ void UnlockMutex_PT (Mutex m);
 void DestroySemaphore_PT (Semaphore sem);
 void SetSemaphore_PT (Semaphore sem);
 void ClearSemaphore_PT (Semaphore sem);
+bool SetSemaphoreTimeout_PT (Semaphore sem, TimePeriod timeout);
 
 void DestroyCondVar_PT (CondVar c);
 void WaitCondVar_PT (CondVar c);
@@ -86,6 +87,7 @@ int  GetRecursiveMutexDepth_PT (RecursiveMutex m);
 #define NativeDestroySemaphore DestroySemaphore_PT
 #define NativeSetSemaphore SetSemaphore_PT
 #define NativeClearSemaphore ClearSemaphore_PT
+#define NativeSetSemaphoreTimeout SetSemaphoreTimeout_PT
 
 #define NativeCreateCondVar CreateCondVar_PT
 #define NativeDestroyCondVar DestroyCondVar_PT
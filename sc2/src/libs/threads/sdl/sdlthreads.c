@@ -517,6 +517,13 @@ ClearSemaphore_SDL (Semaphore s)
 	}
 }
 
+bool
+SetSemaphoreTimeout_SDL (Semaphore s, TimePeriod timeout)
+{
+	Sem *sem = (Sem *)s;
+	return SDL_SemWaitTimeout (sem->sem, timeout * 1000 / ONE_SECOND) == 0;
+}
+
 /* Recursive mutexes. Adapted from mixSDL code, which was adapted from
    the original DCQ code. */
 
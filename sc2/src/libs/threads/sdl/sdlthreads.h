@@ -57,6 +57,7 @@ void UnlockMutex_SDL (Mutex m);
 void DestroySemaphore_SDL (Semaphore sem);
 void SetSemaphore_SDL (Semaphore sem);
 void ClearSemaphore_SDL (Semaphore sem);
+bool SetSemaphoreTimeout_SDL (Semaphore sem, TimePeriod timeout);
 
 void DestroyCondVar_SDL (CondVar c);
 void WaitCondVar_SDL (CondVar c);
@@ -89,6 +90,7 @@ int  GetRecursiveMutexDepth_SDL (RecursiveMutex m);
 #define NativeDestroySemaphore DestroySemaphore_SDL
 #define NativeSetSemaphore SetSemaphore_SDL
 #define NativeClearSemaphore ClearSemaphore_SDL
+#define NativeSetSemaphoreTimeout SetSemaphoreTimeout_SDL
 
 #define NativeCreateCondVar CreateCondVar_SDL
 #define NativeDestroyCondVar DestroyCondVar_SDL
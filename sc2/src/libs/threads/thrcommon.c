@@ -402,6 +402,12 @@ ClearSemaphore (Semaphore sem)
 	NativeClearSemaphore (sem);
 }
 
+bool
+SetSemaphoreTimeout (Semaphore sem, TimePeriod timeout)
+{
+	return NativeSetSemaphoreTimeout (sem, timeout);
+}
+
 void
 DestroyCondVar (CondVar cv)
 {
@@ -22,15 +22,24 @@
 
 #include "iointrn.h"
 #include "fileblock.h"
+#include "fstypes.h"
 #include "uioport.h"
 
 #include <errno.h>
+#ifdef uio_HAVE_MMAP
+#	include <sys/mman.h>
+#endif
+
+#define uio_FB_MMAP_MIN_SIZE 0x10000
+		// Blocks smaller than this are read instead of mapped; for those,
+		// setting up and tearing down a mapping costs more than copying.
 
 static uio_FileBlock *uio_FileBlock_new(uio_Handle *handle, int flags,
 		off_t offset, size_t blockSize, char *buffer, size_t bufSize,
 		off_t bufOffset, size_t bufFill, size_t readAheadBufSize);
 static inline uio_FileBlock *uio_FileBlock_alloc(void);
 static void uio_FileBlock_free(uio_FileBlock *block);
+static void uio_FileBlock_mmap(uio_FileBlock *block, off_t fileSize);
 
 // caller should uio_Handle_ref(handle) (unless it doesn't need it's own
 // reference anymore).
@@ -50,6 +59,8 @@ uio_FileBlock_new(uio_Handle *handle, int flags, off_t offset,
 	result->bufOffset = bufOffset;
 	result->bufFill = bufFill;
 	result->readAheadBufSize = readAheadBufSize;
+	result->mapAddr = NULL;
+	result->mapSize = 0;
 	return result;
 }
 
@@ -63,54 +74,84 @@ uio_FileBlock_free(uio_FileBlock *block) {
 	uio_free(block);
 }
 
+// Map the part of the block that lies within the file into memory, if
+// the file system of the handle supports that. If it doesn't, or the
+// mapping fails, the block is read the ordinary way.
+static void
+uio_FileBlock_mmap(uio_FileBlock *block, off_t fileSize) {
+	uio_FileSystemHandler *handler;
+	size_t length;
+	char *data;
+
+	handler = block->handle->root->handler;
+	if (handler->mmap == NULL || handler->munmap == NULL)
+		return;
+
+	if (block->offset < 0 || block->offset >= fileSize)
+		return;
+	length = block->blockSize;
+	if (length > (size_t) (fileSize - block->offset))
+		length = fileSize - block->offset;
+	if (length < uio_FB_MMAP_MIN_SIZE)
+		return;
+
+	data = (handler->mmap)(block->handle, block->offset, length,
+			&block->mapAddr, &block->mapSize);
+	if (data == NULL)
+		return;
+
+	block->flags |= uio_FB_USE_MMAP;
+	block->buffer = data;
+	block->bufSize = length;
+	block->bufOffset = 0;
+	block->bufFill = length;
+}
+
 uio_FileBlock *
 uio_openFileBlock(uio_Handle *handle) {
-	// TODO: if mmap support is available, and it is available natively
-	//       for the filesystem (make some sort of sysctl for filesystems
-	//       to check this?), use mmap.
-	//       mmap the entire file if it's small enough.
-	//       N.B. Keep in mind streams of which the size is not known in
+	// TODO: Keep in mind streams of which the size is not known in
 	//       advance.
 	struct stat statBuf;
+	uio_FileBlock *result;
+
 	if (uio_fstat(handle, &statBuf) == -1) {
 		// errno is set
 		return NULL;
 	}
 	uio_Handle_ref(handle);
-	return uio_FileBlock_new(handle, 0, 0, statBuf.st_size, NULL, 0, 0, 0, 0);
+	result = uio_FileBlock_new(handle, 0, 0, statBuf.st_size, NULL, 0, 0,
+			0, 0);
+	uio_FileBlock_mmap(result, statBuf.st_size);
+	return result;
 }
 
 uio_FileBlock *
 uio_openFileBlock2(uio_Handle *handle, off_t offset, size_t size) {
-	// TODO: mmap (see uio_openFileBlock)
-
 	// TODO: check if offset and size are acceptable.
 	//       Need to handle streams of which the size is unknown.
-#if 0
-	if (uio_stat(handle, &statBuf) == -1) {
-		// errno is set
-		return NULL;
-	}
-	if (statBuf.st_size > offset || (statBuf.st_size - offset > size)) {
-		// NOT: 'if (statBuf.st_size > offset + size)', to protect
-		// against overflow.
+	struct stat statBuf;
+	uio_FileBlock *result;
 
-	}
-#endif
 	uio_Handle_ref(handle);
-	return uio_FileBlock_new(handle, 0, offset, size, NULL, 0, 0, 0, 0);
+	result = uio_FileBlock_new(handle, 0, offset, size, NULL, 0, 0, 0, 0);
+
+	// If the size of the file is not known, the block is not mapped.
+	if (uio_fstat(handle, &statBuf) == 0)
+		uio_FileBlock_mmap(result, statBuf.st_size);
+	return result;
 }
 
 static inline ssize_t
 uio_accessFileBlockMmap(uio_FileBlock *block, off_t offset, size_t length,
 		char **buffer) {
-	// TODO
-	errno = ENOSYS;
-	(void) block;
-	(void) offset;
-	(void) length;
-	(void) buffer;
-	return -1;
+	// Don't go beyond the end of the mapped data.
+	if (offset > (off_t) block->bufFill)
+		offset = block->bufFill;
+	if (length > block->bufFill - offset)
+		length = block->bufFill - offset;
+
+	*buffer = block->buffer + offset;
+	return length;
 }
 
 static inline ssize_t
@@ -243,9 +284,14 @@ int
 uio_copyFileBlock(uio_FileBlock *block, off_t offset, char *buffer,
 		size_t length) {
 	if (block->flags & uio_FB_USE_MMAP) {
-		// TODO
-		errno = ENOSYS;
-		return -1;
+		// Don't go beyond the end of the mapped data.
+		if (offset > (off_t) block->bufFill)
+			return 0;
+		if (length > block->bufFill - offset)
+			length = block->bufFill - offset;
+
+		memcpy(buffer, block->buffer + offset, length);
+		return length;
 	} else {
 		ssize_t numCopied = 0;
 		ssize_t readResult;
@@ -295,10 +341,8 @@ uio_copyFileBlock(uio_FileBlock *block, off_t offset, char *buffer,
 int
 uio_closeFileBlock(uio_FileBlock *block) {
 	if (block->flags & uio_FB_USE_MMAP) {
-#if 0
-		if (block->buffer != NULL)
-			uio_mmunmap(block->buffer);
-#endif
+		(block->handle->root->handler->munmap)(block->handle,
+				block->mapAddr, block->mapSize);
 	} else {
 		if (block->buffer != NULL)
 			uio_free(block->buffer);
@@ -316,6 +360,28 @@ uio_setFileBlockUsageHint(uio_FileBlock *block, int usage,
 	block->flags = (block->flags & ~uio_FB_USAGE_MASK) |
 			(usage & uio_FB_USAGE_MASK);
 	block->readAheadBufSize = readAheadBufSize;
+
+#ifdef uio_HAVE_MMAP
+	if (block->flags & uio_FB_USE_MMAP) {
+		// For a mapping, it's up to the kernel how much to read ahead.
+		int advice;
+		switch (usage & uio_FB_USAGE_MASK) {
+			case uio_FB_USAGE_FORWARD:
+				advice = POSIX_MADV_SEQUENTIAL;
+				break;
+			case uio_FB_USAGE_BACKWARD:
+				// Reading ahead would only fetch what has been used
+				// already.
+				advice = POSIX_MADV_RANDOM;
+				break;
+			default:
+				advice = POSIX_MADV_NORMAL;
+				break;
+		}
+		// It's only a hint; failure is harmless.
+		(void) posix_madvise(block->mapAddr, block->mapSize, advice);
+	}
+#endif
 }
 
 // Call if you want the memory used by the fileblock to be released, but
@@ -323,9 +389,20 @@ uio_setFileBlockUsageHint(uio_FileBlock *block, int usage,
 // call uio_closeFileBlock() instead.
 void
 uio_clearFileBlockBuffers(uio_FileBlock *block) {
+	if (block->flags & uio_FB_USE_MMAP) {
+		// The mapping stays; the pages in it can be dropped.
+#ifdef uio_HAVE_MMAP
+		(void) posix_madvise(block->mapAddr, block->mapSize,
+				POSIX_MADV_DONTNEED);
+#endif
+		return;
+	}
+
 	if (block->buffer != NULL) {
 		uio_free(block->buffer);
 		block->buffer = NULL;
+		block->bufSize = 0;
+		block->bufFill = 0;
 	}
 }
 
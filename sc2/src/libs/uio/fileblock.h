@@ -58,6 +58,10 @@ struct uio_FileBlock {
 	size_t readAheadBufSize;
 			// Try to read up to this many bytes at a time, even when less
 			// is immediately needed.
+	void *mapAddr;
+	size_t mapSize;
+			// The mapping as a whole, if uio_FB_USE_MMAP is set. It may
+			// start before 'buffer', as mappings start at page boundaries.
 };
 // INV: The FileBlock represents 'fileData[offset..(offset + blockSize - 1)]'
 // where 'fileData' is the contents of the file.
@@ -66,6 +70,9 @@ struct uio_FileBlock {
 //     bufFill <= blockSize
 //     buffer[0..bufFill - 1] == fileData[
 //             (offset + bufOffset)..(offset + bufOffset + bufFill - 1)]
+// INV: If flags & uio_FB_USE_MMAP then:
+//     bufOffset == 0
+//     bufFill == bufSize == the part of the block that lies within the file
 
 
 #endif  /* uio_INTERNAL_FILEBLOCK */
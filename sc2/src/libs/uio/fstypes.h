@@ -89,6 +89,18 @@ struct uio_FileSystemHandler {
 			uio_PDirHandleExtra pDirHandleExtra);
 	void              (*deletePFileHandleExtra) (
 			uio_PFileHandleExtra pFileHandleExtra);
+
+	void *            (*mmap)     (uio_Handle *, off_t, size_t, void **,
+			size_t *);
+			// Optional. Maps part of a file into memory, for reading.
+			// Returns a pointer to the first byte of that part, and the
+			// mapping as a whole through the last two arguments, to be
+			// passed to munmap(). Fails if the part extends beyond the
+			// end of the file.
+	int               (*munmap)   (uio_Handle *, void *, size_t);
+	int               (*fsync)    (uio_Handle *);
+			// Optional. Writes the data of a file that is still held
+			// by the OS out to the storage device.
 };
 
 struct uio_FileSystemInfo {
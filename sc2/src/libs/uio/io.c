@@ -438,9 +438,9 @@ uio_close(uio_Handle *handle) {
 	return 0;
 }
 
-int
-uio_rename(uio_DirHandle *oldDir, const char *oldPath,
-		uio_DirHandle *newDir, const char *newPath) {
+static int
+uio_renameGeneric(uio_DirHandle *oldDir, const char *oldPath,
+		uio_DirHandle *newDir, const char *newPath, uio_bool replace) {
 	uio_PDirHandle *oldPReadDir, *newPReadDir, *newPWriteDir;
 	uio_MountInfo *oldReadMountInfo, *newReadMountInfo, *newWriteMountInfo;
 	char *oldName, *newName;
@@ -453,8 +453,8 @@ uio_rename(uio_DirHandle *oldDir, const char *oldPath,
 		return -1;
 	}
 
-	if (uio_getPhysicalAccess(newDir, newPath, O_WRONLY | O_CREAT | O_EXCL,
-			uio_GPA_NOWRITE, &newReadMountInfo, &newPReadDir, NULL,
+	if (uio_getPhysicalAccess(newDir, newPath,
+			O_WRONLY | O_CREAT | (replace ? 0 : O_EXCL), uio_GPA_NOWRITE, &newReadMountInfo, &newPReadDir, NULL,
 			&newWriteMountInfo, &newPWriteDir, NULL, &newName) == -1) {
 		int savedErrno = errno;
 		uio_PDirHandle_unref(oldPReadDir);
@@ -515,6 +515,18 @@ uio_rename(uio_DirHandle *oldDir, const char *oldPath,
 	return 0;
 }
 
+int
+uio_rename(uio_DirHandle *oldDir, const char *oldPath,
+		uio_DirHandle *newDir, const char *newPath) {
+	return uio_renameGeneric(oldDir, oldPath, newDir, newPath, false);
+}
+
+int
+uio_renameReplace(uio_DirHandle *oldDir, const char *oldPath,
+		uio_DirHandle *newDir, const char *newPath) {
+	return uio_renameGeneric(oldDir, oldPath, newDir, newPath, true);
+}
+
 int
 uio_access(uio_DirHandle *dir, const char *path, int mode) {
 	(void) dir;
@@ -652,6 +664,15 @@ uio_fstat(uio_Handle *handle, struct stat *statBuf) {
 	return (handle->root->handler->fstat)(handle, statBuf);
 }
 
+int
+uio_fsync(uio_Handle *handle) {
+	if (handle->root->handler->fsync == NULL) {
+		errno = ENOSYS;
+		return -1;
+	}
+	return (handle->root->handler->fsync)(handle);
+}
+
 int
 uio_stat(uio_DirHandle *dir, const char *path, struct stat *statBuf) {
 	uio_PDirHandle *pReadDir;
@@ -108,12 +108,22 @@ int uio_close(uio_Handle *handle);
 int uio_rename(uio_DirHandle *oldDir, const char *oldPath,
 		uio_DirHandle *newDir, const char *newPath);
 
+// Rename or move a file, replacing 'newPath' if it exists. Where the
+// file system allows, 'newPath' always refers to either the old or the
+// new file while this happens.
+int uio_renameReplace(uio_DirHandle *oldDir, const char *oldPath,
+		uio_DirHandle *newDir, const char *newPath);
+
 // Test permissions on a file or directory.
 int uio_access(uio_DirHandle *dir, const char *path, int mode);
 
 // Fstat a file descriptor
 int uio_fstat(uio_Handle *handle, struct stat *statBuf);
 
+// Write the data of a file out to the storage device. For a stream,
+// uio_fflush() it first.
+int uio_fsync(uio_Handle *handle);
+
 int uio_stat(uio_DirHandle *dir, const char *path, struct stat *statBuf);
 
 int uio_mkdir(uio_DirHandle *dir, const char *name, mode_t mode);
@@ -150,6 +160,13 @@ void uio_DirList_free(uio_DirList *dirList);
 // For debugging purposes
 void uio_DirHandle_print(const uio_DirHandle *dirHandle, FILE *out);
 
+#ifdef HAVE_ZIP
+// Keep the directory indices of .zip archives, and the seek indices of
+// deflated files in them, in the specified directory between runs, or
+// not at all if 'dir' is NULL.
+void uio_setZipCacheDir(uio_DirHandle *dir);
+#endif
+
 
 #ifdef DEBUG
 #	define uio_DEBUG
@@ -29,11 +29,16 @@
 
 #ifdef WIN32
 #	include <io.h>
+#	include <windows.h>
+			// For MoveFileEx()
 #else
 #	include <sys/stat.h>
 #	include <unistd.h>
 #	include <dirent.h>
 #endif
+#ifdef uio_HAVE_MMAP
+#	include <sys/mman.h>
+#endif
 #include <stdio.h>
 #include <sys/types.h>
 #include <errno.h>
@@ -91,6 +96,15 @@ uio_FileSystemHandler stdio_fileSystemHandler = {
 	/* .deletePRootExtra       = */  uio_GPRoot_delete,
 	/* .deletePDirHandleExtra  = */  uio_GPDirHandle_delete,
 	/* .deletePFileHandleExtra = */  uio_GPFileHandle_delete,
+
+#ifdef uio_HAVE_MMAP
+	/* .mmap   = */  stdio_mmap,
+	/* .munmap = */  stdio_munmap,
+#else
+	/* .mmap   = */  NULL,
+	/* .munmap = */  NULL,
+#endif
+	/* .fsync  = */  stdio_fsync,
 };
 
 uio_GPRoot_Operations stdio_GPRootOperations = {
@@ -268,7 +282,18 @@ stdio_rename(uio_PDirHandle *oldPDirHandle, const char *oldName,
 		return -1;
 	}
 	
+#ifdef WIN32
+	// rename() will not replace an existing file on Windows. Whether
+	// the file may be replaced has been checked by the caller.
+	if (MoveFileEx(oldPath, newPath, MOVEFILE_REPLACE_EXISTING)) {
+		result = 0;
+	} else {
+		errno = EACCES;
+		result = -1;
+	}
+#else
 	result = rename(oldPath, newPath);
+#endif
 	if (result == -1) {
 		int savedErrno = errno;
 		uio_free(oldPath);
@@ -285,6 +310,10 @@ stdio_rename(uio_PDirHandle *oldPDirHandle, const char *oldName,
 		uio_GPDirEntry *entry;
 
 		// TODO: add locking
+		// A file that was replaced is gone.
+		if (oldPDirHandle->extra != newPDirHandle->extra ||
+				strcmp(oldName, newName) != 0)
+			uio_GPDir_removeFile(newPDirHandle->extra, newName);
 		entry = uio_GPDir_getGPDirEntry(oldPDirHandle->extra, oldName);
 		if (entry != NULL) {
 			uio_GPDirEntries_remove(oldPDirHandle->extra->entries, oldName);
@@ -332,6 +361,60 @@ stdio_write(uio_Handle *handle, const void *buf, size_t count) {
 	return write(handle->native->fd, buf, count);
 }
 
+int
+stdio_fsync(uio_Handle *handle) {
+#ifdef WIN32
+	return _commit(handle->native->fd);
+#else
+	return fsync(handle->native->fd);
+#endif
+}
+
+#ifdef uio_HAVE_MMAP
+void *
+stdio_mmap(uio_Handle *handle, off_t offset, size_t length, void **mapAddr,
+		size_t *mapSize) {
+	static long pageSize = 0;
+	struct stat statBuf;
+	off_t start;
+	void *addr;
+
+	if (pageSize == 0)
+		pageSize = sysconf(_SC_PAGESIZE);
+
+	// Touching the pages of a mapping beyond the end of the file
+	// would raise SIGBUS.
+	if (fstat(handle->native->fd, &statBuf) == -1) {
+		// errno is set
+		return NULL;
+	}
+	if (length == 0 || offset < 0 || offset >= statBuf.st_size ||
+			length > (size_t) (statBuf.st_size - offset)) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	// The offset of a mapping has to be a multiple of the page size.
+	start = offset - offset % pageSize;
+	addr = mmap(NULL, length + (offset - start), PROT_READ, MAP_SHARED,
+			handle->native->fd, start);
+	if (addr == MAP_FAILED) {
+		// errno is set
+		return NULL;
+	}
+
+	*mapAddr = addr;
+	*mapSize = length + (offset - start);
+	return (char *) addr + (offset - start);
+}
+
+int
+stdio_munmap(uio_Handle *handle, void *addr, size_t size) {
+	(void) handle;
+	return munmap(addr, size);
+}
+#endif  /* uio_HAVE_MMAP */
+
 int
 stdio_unlink(uio_PDirHandle *pDirHandle, const char *name) {
 	char *path;
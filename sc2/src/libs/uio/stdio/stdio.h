@@ -94,6 +94,12 @@ int stdio_rename(uio_PDirHandle *oldPDirHandle, const char *oldName,
 int stdio_rmdir(uio_PDirHandle *pDirHandle, const char *name);
 off_t stdio_seek(uio_Handle *handle, off_t offset, int whence);
 ssize_t stdio_write(uio_Handle *handle, const void *buf, size_t count);
+int stdio_fsync(uio_Handle *handle);
+#ifdef uio_HAVE_MMAP
+void *stdio_mmap(uio_Handle *handle, off_t offset, size_t length,
+		void **mapAddr, size_t *mapSize);
+int stdio_munmap(uio_Handle *handle, void *addr, size_t size);
+#endif
 int stdio_unlink(uio_PDirHandle *pDirHandle, const char *name);
 
 stdio_EntriesIterator *stdio_openEntries(uio_PDirHandle *pDirHandle);
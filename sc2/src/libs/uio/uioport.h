@@ -82,6 +82,13 @@
 #	define HAVE_UNC_PATHS
 #endif
 
+// Memory-mapped files
+#if !defined(WIN32) && !defined(_WIN32_WCE) && !defined(__SYMBIAN32__)
+	// uio_HAVE_MMAP is defined to signify that files can be read through
+	// mmap() on this platform.
+#	define uio_HAVE_MMAP
+#endif
+
 // User ids
 #ifdef WIN32
 typedef short uid_t;
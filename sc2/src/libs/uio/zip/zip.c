@@ -29,9 +29,15 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <assert.h>
 #include <sys/stat.h>
+#ifdef _MSC_VER
+#	include <windows.h>
+			// For InterlockedCompareExchangePointer()
+#endif
 
 #include "zip.h"
 #include "../physical.h"
@@ -57,7 +63,14 @@ static off_t zip_findEndOfCentralDirectoryRecord(uio_Handle *handle,
 		uio_FileBlock *fileBlock);
 static int zip_fillDirStructureCentral(uio_GPDir *top, uio_Handle *handle);
 static int zip_fillDirStructureCentralProcessEntry(uio_GPDir *topGPDir,
-		uio_FileBlock *fileBlock, off_t *pos);
+		uio_FileBlock *fileBlock, off_t *pos, zip_DirCache *dirCache);
+static int zip_DirCache_init(zip_DirCache *dirCache, uio_Handle *handle,
+		const char *eocdr);
+static void zip_DirCache_uninit(zip_DirCache *dirCache);
+static void zip_DirCache_add(zip_DirCache *dirCache, const char *path,
+		const zip_GPFileData *gPFileData, uio_bool isDir);
+static int zip_loadDirCache(uio_GPDir *top, const zip_DirCache *dirCache);
+static void zip_saveDirCache(const zip_DirCache *dirCache);
 static int zip_updatePFileDataFromLocalFileHeader(zip_GPFileData *gPFileData,
 		uio_FileBlock *fileBlock, int pos);
 int zip_updateFileDataFromLocalHeader(uio_Handle *handle,
@@ -87,6 +100,22 @@ static inline void zip_GPDirData_free(zip_GPDirData *gPDirData);
 
 static ssize_t zip_readStored(uio_Handle *handle, void *buf, size_t count);
 static ssize_t zip_readDeflated(uio_Handle *handle, void *buf, size_t count);
+static zip_SeekIndex *zip_getSeekIndex(zip_Handle *zipHandle);
+static uio_bool zip_wantSeekPoint(zip_Handle *zipHandle);
+static void zip_addSeekPoint(zip_Handle *zipHandle);
+static void zip_completeSeekIndex(zip_Handle *zipHandle);
+static const zip_SeekPoint *zip_findSeekPoint(zip_Handle *zipHandle,
+		off_t offset);
+static int zip_resumeFromSeekPoint(zip_Handle *zipHandle,
+		const zip_SeekPoint *point);
+static zip_SeekIndex *zip_SeekIndex_new(void);
+static zip_SeekIndex *zip_sharedSeekIndex(const zip_GPFileData *gPFileData);
+static void zip_SeekIndex_delete(zip_SeekIndex *index);
+static zip_SeekIndex *zip_publishSeekIndex(zip_GPFileData *gPFileData,
+		zip_SeekIndex *index);
+static zip_SeekIndex *zip_loadSeekIndex(const zip_GPFileData *gPFileData);
+static void zip_saveSeekIndex(const zip_GPFileData *gPFileData,
+		const zip_SeekIndex *index);
 static off_t zip_seekStored(uio_Handle *handle, off_t offset);
 static off_t zip_seekDeflated(uio_Handle *handle, off_t offset);
 
@@ -119,6 +148,10 @@ uio_FileSystemHandler zip_fileSystemHandler = {
 	/* .deletePRootExtra       = */  uio_GPRoot_delete,
 	/* .deletePDirHandleExtra  = */  uio_GPDirHandle_delete,
 	/* .deletePFileHandleExtra = */  uio_GPFileHandle_delete,
+
+	/* .mmap   = */  zip_mmap,
+	/* .munmap = */  zip_munmap,
+	/* .fsync  = */  NULL,
 };
 
 uio_GPRoot_Operations zip_GPRootOperations = {
@@ -191,6 +224,19 @@ static mode_t zip_makeFileMode(zip_OSType creatorOS, uio_uint32 modeBytes);
 #define zip_INPUT_BUFFER_SIZE 0x10000
 		// TODO: make this configurable a la sysctl?
 #define zip_SEEK_BUFFER_SIZE zip_INPUT_BUFFER_SIZE
+#define zip_SEEK_POINT_SPACING 0x100000
+		// Distance between the points from which inflating a file can be
+		// resumed. A seek inflates at most this much data (plus the size
+		// of one deflate block), and each point costs zip_WINDOW_SIZE
+		// bytes.
+#define zip_SEEK_INDEX_MAGIC 0x5a534931
+		// "ZSI1"
+#define zip_DIR_CACHE_MAGIC 0x5a444931
+		// "ZDI1"
+
+static uio_DirHandle *zip_cacheDir = NULL;
+		// Where directory and seek indices are kept between runs; see
+		// uio_setZipCacheDir().
 
 
 void
@@ -201,6 +247,8 @@ zip_close(uio_Handle *handle) {
 	fprintf(stderr, "zip_close - handle=%p\n", (void *) handle);
 #endif
 	zip_handle = handle->native;
+	if (zip_handle->seekIndex != NULL)
+		zip_SeekIndex_delete(zip_handle->seekIndex);
 	uio_GPFile_unref(zip_handle->file);
 	zip_unInitZipStream(&zip_handle->zipStream);
 	uio_closeFileBlock(zip_handle->fileBlock);
@@ -387,6 +435,7 @@ zip_open(uio_PDirHandle *pDirHandle, const char *name, int flags,
 	}
 	handle->compressedOffset = 0;
 	handle->uncompressedOffset = 0;
+	handle->seekIndex = NULL;
 	
 	(void) mode;
 	return uio_Handle_new(pDirHandle->pRoot, handle, flags);
@@ -408,6 +457,39 @@ zip_read(uio_Handle *handle, void *buf, size_t count) {
 	return result;
 }
 
+// Only files which are stored uncompressed can be mapped; they are mapped
+// straight from the archive, if the file system it is on allows that.
+void *
+zip_mmap(uio_Handle *handle, off_t offset, size_t length, void **mapAddr,
+		size_t *mapSize) {
+	zip_GPFileData *fileData;
+	uio_Handle *archiveHandle;
+
+	fileData = handle->native->file->extra;
+	archiveHandle = handle->root->handle;
+	if (fileData->compressionMethod != 0 ||
+			archiveHandle->root->handler->mmap == NULL) {
+		errno = ENOSYS;
+		return NULL;
+	}
+	if (offset < 0 || offset >= fileData->uncompressedSize ||
+			length > (size_t) (fileData->uncompressedSize - offset)) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	return (archiveHandle->root->handler->mmap)(archiveHandle,
+			fileData->fileOffset + offset, length, mapAddr, mapSize);
+}
+
+int
+zip_munmap(uio_Handle *handle, void *addr, size_t size) {
+	uio_Handle *archiveHandle;
+
+	archiveHandle = handle->root->handle;
+	return (archiveHandle->root->handler->munmap)(archiveHandle, addr, size);
+}
+
 static ssize_t
 zip_readStored(uio_Handle *handle, void *buf, size_t count) {
 	int numBytes;
@@ -440,6 +522,8 @@ zip_readDeflated(uio_Handle *handle, void *buf, size_t count) {
 	zipHandle->zipStream.next_out = (Bytef *) buf;
 	zipHandle->zipStream.avail_out = count;
 	while (zipHandle->zipStream.avail_out > 0) {
+		int flush;
+
 		if (zipHandle->zipStream.avail_in == 0) {
 			ssize_t numBytes;
 			numBytes = uio_accessFileBlock(zipHandle->fileBlock,
@@ -463,12 +547,18 @@ zip_readDeflated(uio_Handle *handle, void *buf, size_t count) {
 			zipHandle->zipStream.avail_in = numBytes;
 			zipHandle->compressedOffset += numBytes;
 		}
-		inflateResult = inflate(&zipHandle->zipStream, Z_SYNC_FLUSH);
+		// When a seek point is due, stop at the end of each deflate
+		// block, as that is where one can be placed.
+		flush = zip_wantSeekPoint(zipHandle) ? Z_BLOCK : Z_SYNC_FLUSH;
+		inflateResult = inflate(&zipHandle->zipStream, flush);
 		zipHandle->uncompressedOffset = zipHandle->zipStream.total_out;
 		if (inflateResult == Z_STREAM_END) {
 			// Everything is decompressed
+			zip_completeSeekIndex(zipHandle);
 			break;
 		}
+		if (flush == Z_BLOCK && inflateResult == Z_OK)
+			zip_addSeekPoint(zipHandle);
 		if (inflateResult != Z_OK) {
 			switch (inflateResult) {
 				case Z_VERSION_ERROR:
@@ -571,10 +661,24 @@ zip_seekStored(uio_Handle *handle, off_t offset) {
 static off_t
 zip_seekDeflated(uio_Handle *handle, off_t offset) {
 	zip_Handle *zipHandle;
+	const zip_SeekPoint *point;
+	uio_bool restart = false;
 
 	zipHandle = handle->native;
 
-	if (offset < zipHandle->uncompressedOffset) {
+	// Continue from the last seek point before the new offset, if that
+	// saves inflating anything.
+	point = zip_findSeekPoint(zipHandle, offset);
+	if (point != NULL && (offset < zipHandle->uncompressedOffset ||
+			point->uncompressedOffset > zipHandle->uncompressedOffset)) {
+		if (zip_resumeFromSeekPoint(zipHandle, point) == -1) {
+			fprintf(stderr, "Warning: Could not resume inflating from a "
+					"seek point: %s.\n", strerror(errno));
+			restart = true;
+		}
+	}
+
+	if (restart || offset < zipHandle->uncompressedOffset) {
 		// The new offset is earlier than the current offset. We need to
 		// seek from the beginning.
 		if (zip_reInitZipStream(&zipHandle->zipStream) == -1) {
@@ -616,6 +720,411 @@ zip_seekDeflated(uio_Handle *handle, off_t offset) {
 	return zipHandle->uncompressedOffset;
 }
 
+// Seek indices for deflated files.
+//
+// Inflating can only be started at the start of a deflated file, unless
+// the state of the inflater at some later point was saved. As files are
+// read (or skipped through by zip_seekDeflated()), a seek point is placed
+// at the first deflate block boundary after each zip_SEEK_POINT_SPACING
+// bytes. Reading from the start of the file, or from a seek point, always
+// passes all later points, so the points that are there are always
+// contiguous. Once the end of the file is reached, the index is complete;
+// if there's a directory to keep them in, it is then written to disk, to
+// be used again the next time.
+//
+// A handle builds an index of its own while it reads, and resumes only
+// from its own points. Only once that index is complete does it become the
+// shared one, after which it is never changed. So handles on different
+// threads never see an index that is being changed, without the need for
+// locking.
+
+static zip_SeekIndex *
+zip_SeekIndex_new(void) {
+	zip_SeekIndex *index;
+
+	index = uio_malloc(sizeof (zip_SeekIndex));
+	index->numPoints = 0;
+	index->maxPoints = 0;
+	index->points = NULL;
+	index->complete = false;
+	return index;
+}
+
+// Returns the shared index of the file, or NULL if there is none yet.
+// The load is ordered before any reads through the returned pointer, so
+// that the contents stored by the publishing thread are seen.
+static zip_SeekIndex *
+zip_sharedSeekIndex(const zip_GPFileData *gPFileData) {
+#if defined(__GNUC__)
+	return __atomic_load_n(&gPFileData->seekIndex, __ATOMIC_ACQUIRE);
+#else
+	// MSVC gives volatile reads acquire semantics.
+	return gPFileData->seekIndex;
+#endif
+}
+
+// Make 'index', which must be complete, the shared index of the file,
+// unless another handle got there first; then 'index' is deleted.
+// Returns the shared index.
+static zip_SeekIndex *
+zip_publishSeekIndex(zip_GPFileData *gPFileData, zip_SeekIndex *index) {
+	uio_bool published;
+
+	assert(index->complete);
+#ifdef _MSC_VER
+	published = InterlockedCompareExchangePointer(
+			(PVOID volatile *) &gPFileData->seekIndex, index, NULL) == NULL;
+#else
+	published = __sync_bool_compare_and_swap(&gPFileData->seekIndex,
+			NULL, index);
+#endif
+	if (!published)
+		zip_SeekIndex_delete(index);
+	return zip_sharedSeekIndex(gPFileData);
+}
+
+// Returns the shared index if there is one, and the handle's own index
+// otherwise. The first time, the shared index is loaded from disk if it
+// is there.
+static zip_SeekIndex *
+zip_getSeekIndex(zip_Handle *zipHandle) {
+	zip_GPFileData *gPFileData;
+	zip_SeekIndex *index;
+
+	gPFileData = zipHandle->file->extra;
+	index = zip_sharedSeekIndex(gPFileData);
+	if (index != NULL)
+		return index;
+
+	if (zipHandle->seekIndex == NULL) {
+		index = zip_loadSeekIndex(gPFileData);
+		if (index != NULL)
+			return zip_publishSeekIndex(gPFileData, index);
+		zipHandle->seekIndex = zip_SeekIndex_new();
+	}
+	return zipHandle->seekIndex;
+}
+
+static uio_bool
+zip_wantSeekPoint(zip_Handle *zipHandle) {
+	zip_GPFileData *gPFileData;
+	zip_SeekIndex *index;
+	off_t nextOffset;
+
+	gPFileData = zipHandle->file->extra;
+	if (zipHandle->uncompressedOffset < zip_SEEK_POINT_SPACING ||
+			gPFileData->uncompressedSize <= zip_SEEK_POINT_SPACING)
+		return false;
+
+	index = zip_getSeekIndex(zipHandle);
+	if (index->complete)
+		return false;
+
+	nextOffset = (index->numPoints == 0) ? zip_SEEK_POINT_SPACING :
+			index->points[index->numPoints - 1]->uncompressedOffset +
+			zip_SEEK_POINT_SPACING;
+	return zipHandle->uncompressedOffset >= nextOffset;
+}
+
+// To be called after inflate() with Z_BLOCK returned, if
+// zip_wantSeekPoint() was true.
+static void
+zip_addSeekPoint(zip_Handle *zipHandle) {
+	z_stream *zipStream;
+	zip_SeekIndex *index;
+	zip_SeekPoint *point;
+	uInt windowSize;
+
+	zipStream = &zipHandle->zipStream;
+	if ((zipStream->data_type & 128) == 0 ||
+			(zipStream->data_type & 64) != 0) {
+		// Not at the end of a block, or the block was the last one.
+		return;
+	}
+
+	index = zipHandle->seekIndex;
+	if (index == NULL)
+		return;
+
+	point = uio_malloc(sizeof (zip_SeekPoint));
+	windowSize = zip_WINDOW_SIZE;
+	if (inflateGetDictionary(zipStream, point->window, &windowSize) != Z_OK
+			|| windowSize != zip_WINDOW_SIZE) {
+		uio_free(point);
+		return;
+	}
+	point->uncompressedOffset = zipStream->total_out;
+	point->compressedOffset =
+			zipHandle->compressedOffset - zipStream->avail_in;
+	point->bits = zipStream->data_type & 7;
+
+	if (index->numPoints == index->maxPoints) {
+		int maxPoints = (index->maxPoints == 0) ? 8 : index->maxPoints * 2;
+		zip_SeekPoint **points = uio_realloc(index->points,
+				maxPoints * sizeof (zip_SeekPoint *));
+		if (points == NULL) {
+			uio_free(point);
+			return;
+		}
+		index->points = points;
+		index->maxPoints = maxPoints;
+	}
+	index->points[index->numPoints++] = point;
+}
+
+// To be called when the end of the file has been reached.
+static void
+zip_completeSeekIndex(zip_Handle *zipHandle) {
+	zip_GPFileData *gPFileData;
+	zip_SeekIndex *index;
+
+	index = zipHandle->seekIndex;
+	if (index == NULL)
+		return;
+
+	gPFileData = zipHandle->file->extra;
+	zipHandle->seekIndex = NULL;
+	index->complete = true;
+	if (zip_publishSeekIndex(gPFileData, index) == index &&
+			index->numPoints > 0)
+		zip_saveSeekIndex(gPFileData, index);
+}
+
+// Returns the last seek point at or before 'offset', or NULL if there is
+// none.
+static const zip_SeekPoint *
+zip_findSeekPoint(zip_Handle *zipHandle, off_t offset) {
+	zip_GPFileData *gPFileData;
+	zip_SeekIndex *index;
+	int low;
+	int high;
+
+	gPFileData = zipHandle->file->extra;
+	if (offset < zip_SEEK_POINT_SPACING ||
+			gPFileData->uncompressedSize <= zip_SEEK_POINT_SPACING)
+		return NULL;
+
+	index = zip_getSeekIndex(zipHandle);
+	low = 0;
+	high = index->numPoints;
+	while (low < high) {
+		int mid = low + (high - low) / 2;
+		if (index->points[mid]->uncompressedOffset <= offset) {
+			low = mid + 1;
+		} else
+			high = mid;
+	}
+	return (low == 0) ? NULL : index->points[low - 1];
+}
+
+// On failure, the zip stream needs to be reinitialised.
+static int
+zip_resumeFromSeekPoint(zip_Handle *zipHandle, const zip_SeekPoint *point) {
+	z_stream *zipStream;
+
+	zipStream = &zipHandle->zipStream;
+	if (zip_reInitZipStream(zipStream) == -1) {
+		// errno is set
+		return -1;
+	}
+
+	if (point->bits != 0) {
+		char *buf;
+
+		if (uio_accessFileBlock(zipHandle->fileBlock,
+				point->compressedOffset - 1, 1, &buf) != 1) {
+			errno = EIO;
+			return -1;
+		}
+		if (inflatePrime(zipStream, point->bits,
+				((unsigned char) buf[0]) >> (8 - point->bits)) != Z_OK) {
+			errno = EIO;
+			return -1;
+		}
+	}
+	if (inflateSetDictionary(zipStream, point->window, zip_WINDOW_SIZE)
+			!= Z_OK) {
+		errno = EIO;
+		return -1;
+	}
+
+	// zip_readDeflated() works with offsets from the start of the file.
+	zipStream->total_out = point->uncompressedOffset;
+	zipHandle->compressedOffset = point->compressedOffset;
+	zipHandle->uncompressedOffset = point->uncompressedOffset;
+	return 0;
+}
+
+static void
+zip_SeekIndex_delete(zip_SeekIndex *index) {
+	int i;
+
+	for (i = 0; i < index->numPoints; i++)
+		uio_free(index->points[i]);
+	if (index->points != NULL)
+		uio_free(index->points);
+	uio_free(index);
+}
+
+// Set 'dir' to NULL to not keep the indices.
+void
+uio_setZipCacheDir(uio_DirHandle *dir) {
+	if (dir != NULL)
+		uio_DirHandle_ref(dir);
+	if (zip_cacheDir != NULL)
+		uio_DirHandle_unref(zip_cacheDir);
+	zip_cacheDir = dir;
+}
+
+// The file is named after the CRC and sizes of the file the index is
+// for. The index is stored in the native byte order, as it is not meant
+// to be moved to another machine:
+//   header: magic, crc, compressedSize, uncompressedSize, spacing,
+//           numPoints (all uio_uint32)
+//   for each point: uncompressedOffset, compressedOffset, bits (all
+//           uio_uint32), window (zip_WINDOW_SIZE bytes)
+static void
+zip_seekIndexFileName(const zip_GPFileData *gPFileData, char *buf,
+		size_t size) {
+	snprintf(buf, size, "%08lx-%08lx-%08lx.zsi",
+			(unsigned long) gPFileData->crc,
+			(unsigned long) gPFileData->compressedSize,
+			(unsigned long) gPFileData->uncompressedSize);
+}
+
+// Returns a new, complete index, or NULL if there is none on disk.
+static zip_SeekIndex *
+zip_loadSeekIndex(const zip_GPFileData *gPFileData) {
+	zip_SeekIndex *index;
+	char fileName[32];
+	uio_Handle *handle;
+	uio_uint32 header[6];
+	zip_SeekPoint **points;
+	uio_uint32 i;
+
+	if (zip_cacheDir == NULL)
+		return NULL;
+
+	zip_seekIndexFileName(gPFileData, fileName, sizeof fileName);
+	handle = uio_open(zip_cacheDir, fileName, O_RDONLY
+#ifdef WIN32
+			| O_BINARY
+#endif
+			, 0);
+	if (handle == NULL)
+		return NULL;
+
+	if (uio_read(handle, header, sizeof header) != sizeof header ||
+			header[0] != zip_SEEK_INDEX_MAGIC ||
+			header[1] != gPFileData->crc ||
+			header[2] != (uio_uint32) gPFileData->compressedSize ||
+			header[3] != (uio_uint32) gPFileData->uncompressedSize ||
+			header[4] != zip_SEEK_POINT_SPACING || header[5] == 0 ||
+			header[5] > gPFileData->uncompressedSize /
+			zip_SEEK_POINT_SPACING) {
+		uio_close(handle);
+		return NULL;
+	}
+
+	points = uio_malloc(header[5] * sizeof (zip_SeekPoint *));
+	for (i = 0; i < header[5]; i++) {
+		uio_uint32 pointHeader[3];
+		zip_SeekPoint *point;
+
+		if (uio_read(handle, pointHeader, sizeof pointHeader) !=
+				sizeof pointHeader ||
+				pointHeader[0] >= gPFileData->uncompressedSize ||
+				pointHeader[1] >= gPFileData->compressedSize ||
+				(pointHeader[1] == 0 && pointHeader[2] != 0) ||
+				pointHeader[2] >= 8 || (i > 0 && pointHeader[0] <=
+				points[i - 1]->uncompressedOffset))
+			break;
+
+		point = uio_malloc(sizeof (zip_SeekPoint));
+		point->uncompressedOffset = pointHeader[0];
+		point->compressedOffset = pointHeader[1];
+		point->bits = pointHeader[2];
+		points[i] = point;
+		if (uio_read(handle, point->window, zip_WINDOW_SIZE) !=
+				zip_WINDOW_SIZE) {
+			i++;
+			break;
+		}
+		if (i + 1 == header[5]) {
+			// All there.
+			uio_close(handle);
+			index = zip_SeekIndex_new();
+			index->points = points;
+			index->numPoints = header[5];
+			index->maxPoints = header[5];
+			index->complete = true;
+			return index;
+		}
+	}
+
+	fprintf(stderr, "Warning: Seek index '%s' is corrupt; ignored.\n",
+			fileName);
+	while (i > 0)
+		uio_free(points[--i]);
+	uio_free(points);
+	uio_close(handle);
+	return NULL;
+}
+
+static void
+zip_saveSeekIndex(const zip_GPFileData *gPFileData,
+		const zip_SeekIndex *index) {
+	char fileName[32];
+	uio_Handle *handle;
+	uio_uint32 header[6];
+	int i;
+
+	if (zip_cacheDir == NULL)
+		return;
+
+	zip_seekIndexFileName(gPFileData, fileName, sizeof fileName);
+	handle = uio_open(zip_cacheDir, fileName,
+			O_WRONLY | O_CREAT | O_TRUNC
+#ifdef WIN32
+			| O_BINARY
+#endif
+			, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (handle == NULL)
+		return;
+
+	header[0] = zip_SEEK_INDEX_MAGIC;
+	header[1] = gPFileData->crc;
+	header[2] = (uio_uint32) gPFileData->compressedSize;
+	header[3] = (uio_uint32) gPFileData->uncompressedSize;
+	header[4] = zip_SEEK_POINT_SPACING;
+	header[5] = (uio_uint32) index->numPoints;
+	if (uio_write(handle, header, sizeof header) != sizeof header)
+		goto err;
+
+	for (i = 0; i < index->numPoints; i++) {
+		const zip_SeekPoint *point = index->points[i];
+		uio_uint32 pointHeader[3];
+
+		pointHeader[0] = (uio_uint32) point->uncompressedOffset;
+		pointHeader[1] = (uio_uint32) point->compressedOffset;
+		pointHeader[2] = (uio_uint32) point->bits;
+		if (uio_write(handle, pointHeader, sizeof pointHeader) !=
+				sizeof pointHeader ||
+				uio_write(handle, point->window, zip_WINDOW_SIZE) !=
+				zip_WINDOW_SIZE)
+			goto err;
+	}
+
+	uio_close(handle);
+	return;
+
+err:
+	fprintf(stderr, "Warning: Could not write seek index '%s': %s.\n",
+			fileName, strerror(errno));
+	uio_close(handle);
+	uio_unlink(zip_cacheDir, fileName);
+}
+
 uio_PRoot *
 zip_mount(uio_Handle *handle, int flags) {
 	uio_PRoot *result;
@@ -669,6 +1178,8 @@ zip_fillDirStructureCentral(uio_GPDir *top, uio_Handle *handle) {
 			//       to a smart size
 	off_t eocdr;
 	off_t startCentralDir;
+	zip_DirCache dirCacheBuf;
+	zip_DirCache *dirCache = NULL;
 
 	fileBlock = uio_openFileBlock(handle);
 	if (fileBlock == NULL) {
@@ -702,19 +1213,39 @@ zip_fillDirStructureCentral(uio_GPDir *top, uio_Handle *handle) {
 
 	startCentralDir = makeUInt32(buf[16], buf[17], buf[18], buf[19]);
 
+	if (zip_cacheDir != NULL &&
+			zip_DirCache_init(&dirCacheBuf, handle, buf) == 0) {
+		dirCache = &dirCacheBuf;
+		switch (zip_loadDirCache(top, dirCache)) {
+			case 1:
+				zip_DirCache_uninit(dirCache);
+				uio_closeFileBlock(fileBlock);
+				return 0;
+			case 0:
+				break;
+			case -1:
+				// errno is set
+				goto err;
+		}
+	}
+
 	// Enable read-ahead buffering, for speed.
 	uio_setFileBlockUsageHint(fileBlock, uio_FB_USAGE_FORWARD,
 			DIR_STRUCTURE_READ_BUFSIZE);
 
 	pos = startCentralDir;
 	while (numEntries--) {
-		if (zip_fillDirStructureCentralProcessEntry(top, fileBlock, &pos)
-				== -1) {
+		if (zip_fillDirStructureCentralProcessEntry(top, fileBlock, &pos,
+				dirCache) == -1) {
 			// errno is set
 			goto err;
 		}
 	}
 
+	if (dirCache != NULL) {
+		zip_saveDirCache(dirCache);
+		zip_DirCache_uninit(dirCache);
+	}
 	uio_closeFileBlock(fileBlock);
 	return 0;
 
@@ -722,6 +1253,8 @@ err:
 	{
 		int savedErrno = errno;
 
+		if (dirCache != NULL)
+			zip_DirCache_uninit(dirCache);
 		if (fileBlock != NULL)
 			uio_closeFileBlock(fileBlock);
 		errno = savedErrno;
@@ -729,9 +1262,10 @@ err:
 	}
 }
 
+// If 'dirCache' is not NULL, the entry is added to it.
 static int
 zip_fillDirStructureCentralProcessEntry(uio_GPDir *topGPDir,
-		uio_FileBlock *fileBlock, off_t *pos) {
+		uio_FileBlock *fileBlock, off_t *pos, zip_DirCache *dirCache) {
 	char *buf;
 	zip_GPFileData *gPFileData;
 	ssize_t numBytes;
@@ -769,6 +1303,7 @@ zip_fillDirStructureCentralProcessEntry(uio_GPDir *topGPDir,
 	gPFileData->mtime = dosToUnixTime(lastModDate, lastModTime);
 	gPFileData->ctime = (time_t) 0;
 	crc = makeUInt32(buf[16], buf[17], buf[18], buf[19]);
+	gPFileData->crc = crc;
 	gPFileData->compressedSize =
 			makeUInt32(buf[20], buf[21], buf[22], buf[23]);
 	gPFileData->uncompressedSize =
@@ -850,6 +1385,8 @@ zip_fillDirStructureCentralProcessEntry(uio_GPDir *topGPDir,
 			}
 			return zip_badFile(gPFileData, fileName);
 		}
+		if (dirCache != NULL)
+			zip_DirCache_add(dirCache, fileName, gPFileData, false);
 
 #if defined(DEBUG) && DEBUG > 1
 		fprintf(stderr, "Debug: Found file '%s'.\n", fileName);
@@ -867,6 +1404,8 @@ zip_fillDirStructureCentralProcessEntry(uio_GPDir *topGPDir,
 			}
 			return zip_badFile(gPFileData, fileName);
 		}
+		if (dirCache != NULL)
+			zip_DirCache_add(dirCache, fileName, gPFileData, true);
 #if defined(DEBUG) && DEBUG > 1
 		fprintf(stderr, "Debug: Found dir '%s'.\n", fileName);
 #endif
@@ -882,6 +1421,392 @@ zip_fillDirStructureCentralProcessEntry(uio_GPDir *topGPDir,
 	return 0;
 }
 
+// Directory indices.
+//
+// Reading the central directory of an archive means parsing every entry
+// in it. The result is kept on disk, in the directory set with
+// uio_setZipCacheDir(), to be restored in one read the next time the
+// archive is mounted. An index is used only if the size and
+// modification time of the archive and its 'End of Central Directory
+// Record' are still the same; otherwise the central directory is parsed
+// again.
+
+static uio_uint32
+zip_hashBytes(uio_uint32 hash, const void *data, size_t size) {
+	const unsigned char *bytes = (const unsigned char *) data;
+
+	// FNV-1a
+	while (size--) {
+		hash ^= *bytes++;
+		hash *= 0x01000193;
+	}
+	return hash;
+}
+
+static void
+zip_dirCacheFileName(const zip_DirCacheHeader *header, char *buf,
+		size_t size) {
+	uio_uint32 hash;
+
+	hash = zip_hashBytes(0x811c9dc5, &header->archiveMTime,
+			sizeof header->archiveMTime);
+	hash = zip_hashBytes(hash, header->eocdr, sizeof header->eocdr);
+	snprintf(buf, size, "%08lx-%08lx.zdi",
+			(unsigned long) header->archiveSize, (unsigned long) hash);
+}
+
+// Returns -1 if the archive can't be identified; the index can't be
+// used then.
+static int
+zip_DirCache_init(zip_DirCache *dirCache, uio_Handle *handle,
+		const char *eocdr) {
+	struct stat statBuf;
+
+	if (uio_fstat(handle, &statBuf) == -1)
+		return -1;
+
+	memset(&dirCache->header, '\0', sizeof dirCache->header);
+	dirCache->header.magic = zip_DIR_CACHE_MAGIC;
+	dirCache->header.recordSize = sizeof (zip_DirCacheRecord);
+	dirCache->header.archiveSize = (uio_uint32) statBuf.st_size;
+	dirCache->header.archiveMTime = (uio_sint32) statBuf.st_mtime;
+	memcpy(dirCache->header.eocdr, eocdr, 22);
+	dirCache->data = NULL;
+	dirCache->dataSize = 0;
+	dirCache->bufSize = 0;
+	dirCache->failed = false;
+	return 0;
+}
+
+static void
+zip_DirCache_uninit(zip_DirCache *dirCache) {
+	if (dirCache->data != NULL)
+		uio_free(dirCache->data);
+}
+
+static void
+zip_DirCache_add(zip_DirCache *dirCache, const char *path,
+		const zip_GPFileData *gPFileData, uio_bool isDir) {
+	zip_DirCacheRecord *record;
+	size_t pathLen;
+	size_t pathSize;
+
+	if (dirCache->failed)
+		return;
+
+	pathLen = strlen(path) + 1;
+	pathSize = (pathLen + 3) & ~(size_t) 3;
+	if (pathSize > 0xffff) {
+		dirCache->failed = true;
+		return;
+	}
+
+	if (dirCache->dataSize + sizeof (zip_DirCacheRecord) + pathSize >
+			dirCache->bufSize) {
+		size_t bufSize;
+		char *data;
+
+		bufSize = (dirCache->bufSize == 0) ? 0x4000 : dirCache->bufSize * 2;
+		while (bufSize < dirCache->dataSize + sizeof (zip_DirCacheRecord)
+				+ pathSize)
+			bufSize *= 2;
+		data = uio_realloc(dirCache->data, bufSize);
+		if (data == NULL) {
+			dirCache->failed = true;
+			return;
+		}
+		dirCache->data = data;
+		dirCache->bufSize = bufSize;
+	}
+
+	record = (zip_DirCacheRecord *) (dirCache->data + dirCache->dataSize);
+	record->compressedSize = (uio_uint32) gPFileData->compressedSize;
+	record->uncompressedSize = (uio_uint32) gPFileData->uncompressedSize;
+	record->headerOffset = (uio_uint32) gPFileData->headerOffset;
+	record->crc = gPFileData->crc;
+	record->mode = (uio_uint32) gPFileData->mode;
+	record->uid = (uio_uint32) gPFileData->uid;
+	record->gid = (uio_uint32) gPFileData->gid;
+	record->atime = (uio_sint32) gPFileData->atime;
+	record->mtime = (uio_sint32) gPFileData->mtime;
+	record->ctime = (uio_sint32) gPFileData->ctime;
+	record->compressionFlags = gPFileData->compressionFlags;
+	record->compressionMethod = gPFileData->compressionMethod;
+	record->pathSize = (uio_uint16) pathSize;
+	record->isDir = isDir;
+	memcpy(record + 1, path, pathLen);
+	memset((char *) (record + 1) + pathLen, '\0', pathSize - pathLen);
+
+	dirCache->dataSize += sizeof (zip_DirCacheRecord) + pathSize;
+	dirCache->header.numRecords++;
+}
+
+// The files in an archive mostly come dir by dir. Remembering the dir
+// of the last file added saves looking it up again for the next one.
+typedef struct {
+	uio_GPDir *gPDir;
+	const char *path;
+			// Not NUL-terminated; points into the index data, which stays
+			// around while the entries are added
+	size_t pathLen;
+} zip_LastDir;
+
+static void
+zip_setLastDir(zip_LastDir *lastDir, uio_GPDir *top, const char *path) {
+	const char *name;
+	const char *rest;
+
+	if (path[0] == '/')
+		path++;
+	name = strrchr(path, '/');
+	lastDir->path = path;
+	lastDir->pathLen = (name == NULL) ? 0 : (size_t) (name - path);
+	if (uio_walkGPPath(top, path, lastDir->pathLen, &lastDir->gPDir,
+			&rest) != 0)
+		lastDir->gPDir = NULL;
+}
+
+// Adds the file at 'path' directly if it is in the dir of the last file,
+// and its name is not taken yet. Returns whether it did; if not,
+// zip_foundFile() does the work, and the complaining.
+static uio_bool
+zip_addToLastDir(const zip_LastDir *lastDir, const char *path,
+		zip_GPFileData *gPFileData) {
+	const char *name;
+	uio_GPFile *file;
+
+	if (lastDir->gPDir == NULL)
+		return false;
+	if (path[0] == '/')
+		path++;
+	if (lastDir->pathLen == 0) {
+		name = path;
+	} else {
+		if (strncmp(path, lastDir->path, lastDir->pathLen) != 0 ||
+				path[lastDir->pathLen] != '/')
+			return false;
+		name = path + lastDir->pathLen + 1;
+	}
+	if (name[0] == '\0' || strchr(name, '/') != NULL ||
+			strcmp(name, ".") == 0 || strcmp(name, "..") == 0 ||
+			uio_GPDir_getGPDirEntry(lastDir->gPDir, name) != NULL)
+		return false;
+
+	file = uio_GPFile_new(lastDir->gPDir->pRoot,
+			(uio_GPFileExtra) gPFileData,
+			uio_gPFileFlagsFromPRootFlags(lastDir->gPDir->pRoot->flags));
+	uio_GPDir_addFile(lastDir->gPDir, name, file);
+	return true;
+}
+
+// Returns 1 if the tree was restored from the index, 0 if there is no
+// usable index (and nothing was added to the tree), and -1 if restoring
+// failed halfway.
+static int
+zip_loadDirCache(uio_GPDir *top, const zip_DirCache *dirCache) {
+	char fileName[32];
+	uio_Handle *handle;
+	struct stat statBuf;
+	zip_DirCacheHeader header;
+	char *data;
+	size_t pos;
+	uio_uint32 i;
+	zip_LastDir lastDir;
+
+	zip_dirCacheFileName(&dirCache->header, fileName, sizeof fileName);
+	handle = uio_open(zip_cacheDir, fileName, O_RDONLY
+#ifdef WIN32
+			| O_BINARY
+#endif
+			, 0);
+	if (handle == NULL)
+		return 0;
+
+	if (uio_fstat(handle, &statBuf) == -1 ||
+			uio_read(handle, &header, sizeof header) != sizeof header ||
+			header.magic != dirCache->header.magic ||
+			header.recordSize != dirCache->header.recordSize ||
+			header.archiveSize != dirCache->header.archiveSize ||
+			header.archiveMTime != dirCache->header.archiveMTime ||
+			memcmp(header.eocdr, dirCache->header.eocdr,
+			sizeof header.eocdr) != 0 ||
+			(off_t) (sizeof header + header.dataSize) != statBuf.st_size) {
+		// Not for this archive, or out of date.
+		uio_close(handle);
+		return 0;
+	}
+
+	data = uio_malloc(header.dataSize + 1);
+	if (uio_read(handle, data, header.dataSize) != (ssize_t) header.dataSize)
+		goto corrupt;
+	uio_close(handle);
+	handle = NULL;
+
+	// Check all of it before adding anything.
+	pos = 0;
+	for (i = 0; i < header.numRecords; i++) {
+		const zip_DirCacheRecord *record;
+
+		if (header.dataSize - pos < sizeof (zip_DirCacheRecord))
+			goto corrupt;
+		record = (const zip_DirCacheRecord *) (data + pos);
+		if (record->pathSize == 0 || record->pathSize % 4 != 0 ||
+				record->pathSize > header.dataSize - pos -
+				sizeof (zip_DirCacheRecord) ||
+				(record->compressionMethod >= NUM_COMPRESSION_METHODS ||
+				!zip_compressionMethodSupported[
+				record->compressionMethod]))
+			goto corrupt;
+		pos += sizeof (zip_DirCacheRecord) + record->pathSize;
+		if (data[pos - 1] != '\0' || data[pos - record->pathSize] == '\0')
+			goto corrupt;
+	}
+	if (pos != header.dataSize)
+		goto corrupt;
+
+	pos = 0;
+	lastDir.gPDir = NULL;
+	for (i = 0; i < header.numRecords; i++) {
+		const zip_DirCacheRecord *record;
+		const char *path;
+		zip_GPFileData *gPFileData;
+		int result;
+
+		record = (const zip_DirCacheRecord *) (data + pos);
+		path = (const char *) (record + 1);
+		pos += sizeof (zip_DirCacheRecord) + record->pathSize;
+
+		gPFileData = zip_GPFileData_new();
+		gPFileData->compressedSize = record->compressedSize;
+		gPFileData->uncompressedSize = record->uncompressedSize;
+		gPFileData->compressionFlags = record->compressionFlags;
+		gPFileData->compressionMethod = record->compressionMethod;
+		gPFileData->headerOffset = record->headerOffset;
+		gPFileData->fileOffset = (off_t) -1;
+		gPFileData->crc = record->crc;
+		gPFileData->uid = (uid_t) record->uid;
+		gPFileData->gid = (gid_t) record->gid;
+		gPFileData->mode = (mode_t) record->mode;
+		gPFileData->atime = (time_t) record->atime;
+		gPFileData->mtime = (time_t) record->mtime;
+		gPFileData->ctime = (time_t) record->ctime;
+
+		if (record->isDir) {
+			result = zip_foundDir(top, path, gPFileData);
+		} else if (zip_addToLastDir(&lastDir, path, gPFileData)) {
+			result = 0;
+		} else {
+			result = zip_foundFile(top, path, gPFileData);
+			if (result == 0)
+				zip_setLastDir(&lastDir, top, path);
+		}
+		if (result == -1) {
+			// The same happened when the index was made, so the same
+			// goes now.
+			int savedErrno = errno;
+			zip_GPFileData_delete(gPFileData);
+			if (savedErrno != EISDIR) {
+				uio_free(data);
+				errno = savedErrno;
+				return -1;
+			}
+		}
+	}
+
+	uio_free(data);
+	return 1;
+
+corrupt:
+	fprintf(stderr, "Warning: Directory index '%s' is corrupt; ignored.\n",
+			fileName);
+	uio_free(data);
+	if (handle != NULL)
+		uio_close(handle);
+	return 0;
+}
+
+// Orders records by the dir they are in, and otherwise keeps them in
+// the order of the archive.
+static int
+zip_compareDirCacheRecords(const void *a, const void *b) {
+	const zip_DirCacheRecord *recordA = *(const zip_DirCacheRecord **) a;
+	const zip_DirCacheRecord *recordB = *(const zip_DirCacheRecord **) b;
+	const char *pathA = (const char *) (recordA + 1);
+	const char *pathB = (const char *) (recordB + 1);
+	const char *endA = strrchr(pathA, '/');
+	const char *endB = strrchr(pathB, '/');
+	size_t lenA = (endA == NULL) ? 0 : (size_t) (endA - pathA);
+	size_t lenB = (endB == NULL) ? 0 : (size_t) (endB - pathB);
+	int cmp;
+
+	cmp = memcmp(pathA, pathB, lenA < lenB ? lenA : lenB);
+	if (cmp == 0 && lenA != lenB)
+		cmp = lenA < lenB ? -1 : 1;
+	if (cmp == 0 && recordA != recordB)
+		cmp = recordA < recordB ? -1 : 1;
+	return cmp;
+}
+
+// The records are written grouped by dir, whatever the order in the
+// archive, so that zip_loadDirCache() can add most files to the dir of
+// the one before.
+static void
+zip_saveDirCache(const zip_DirCache *dirCache) {
+	char fileName[32];
+	uio_Handle *handle;
+	zip_DirCacheHeader header;
+	const zip_DirCacheRecord **records;
+	char *data;
+	size_t pos;
+	uio_uint32 i;
+
+	if (dirCache->failed)
+		return;
+
+	header = dirCache->header;
+	header.dataSize = (uio_uint32) dirCache->dataSize;
+
+	records = uio_malloc((header.numRecords + 1) * sizeof *records);
+	pos = 0;
+	for (i = 0; i < header.numRecords; i++) {
+		records[i] = (const zip_DirCacheRecord *) (dirCache->data + pos);
+		pos += sizeof (zip_DirCacheRecord) + records[i]->pathSize;
+	}
+	qsort(records, header.numRecords, sizeof *records,
+			zip_compareDirCacheRecords);
+	data = uio_malloc(dirCache->dataSize + 1);
+	pos = 0;
+	for (i = 0; i < header.numRecords; i++) {
+		size_t size = sizeof (zip_DirCacheRecord) + records[i]->pathSize;
+		memcpy(data + pos, records[i], size);
+		pos += size;
+	}
+	uio_free(records);
+
+	zip_dirCacheFileName(&header, fileName, sizeof fileName);
+	handle = uio_open(zip_cacheDir, fileName, O_WRONLY | O_CREAT | O_TRUNC
+#ifdef WIN32
+			| O_BINARY
+#endif
+			, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (handle == NULL) {
+		uio_free(data);
+		return;
+	}
+
+	if (uio_write(handle, &header, sizeof header) != sizeof header ||
+			uio_write(handle, data, dirCache->dataSize) !=
+			(ssize_t) dirCache->dataSize) {
+		fprintf(stderr, "Warning: Could not write directory index '%s': "
+				"%s.\n", fileName, strerror(errno));
+		uio_close(handle);
+		uio_unlink(zip_cacheDir, fileName);
+	} else {
+		uio_close(handle);
+	}
+	uio_free(data);
+}
+
 static off_t
 zip_findEndOfCentralDirectoryRecord(uio_Handle *handle,
 		uio_FileBlock *fileBlock) {
@@ -1116,6 +2041,7 @@ zip_fillDirStructureLocalProcessEntry(uio_GPDir *topGPDir,
 		// If bit 3 is not set, this info will be in the data descriptor
 		// behind the file data.
 		crc = makeUInt32(buf[10], buf[11], buf[12], buf[13]);
+		gPFileData->crc = crc;
 		gPFileData->compressedSize =
 				makeUInt32(buf[14], buf[15], buf[16], buf[17]);
 		gPFileData->uncompressedSize =
@@ -1200,6 +2126,7 @@ zip_fillDirStructureLocalProcessEntry(uio_GPDir *topGPDir,
 		if (signature != 0x08074b50)
 			return zip_badFile(gPFileData, fileName);
 		crc = makeUInt32(buf[4], buf[5], buf[6], buf[7]);
+		gPFileData->crc = crc;
 		gPFileData->compressedSize =
 				makeUInt32(buf[8], buf[9], buf[10], buf[11]);
 		gPFileData->uncompressedSize =
@@ -1638,11 +2565,15 @@ zip_free(voidpf opaque, voidpf address) {
 
 static inline zip_GPFileData *
 zip_GPFileData_new(void) {
-	return zip_GPFileData_alloc();
+	zip_GPFileData *result = zip_GPFileData_alloc();
+	result->seekIndex = NULL;
+	return result;
 }
 
 static inline void
 zip_GPFileData_delete(zip_GPFileData *gPFileData) {
+	if (gPFileData->seekIndex != NULL)
+		zip_SeekIndex_delete(gPFileData->seekIndex);
 	zip_GPFileData_free(gPFileData);
 }
 
@@ -55,6 +55,32 @@ typedef struct uio_GPDirEntries_Iterator *uio_NativeEntriesContext;
 		// inaccurate. The advantage is that a possibly costly seek and
 		// read can be avoided.
 
+#define zip_WINDOW_SIZE 0x8000
+		// The amount of earlier uncompressed data that deflate may refer
+		// back to.
+
+// A point in a deflated file from which inflating can be resumed, as in
+// zlib's examples/zran.c.
+typedef struct zip_SeekPoint {
+	off_t uncompressedOffset;
+	off_t compressedOffset;
+			// Of the first whole byte of the deflate block starting here.
+	int bits;
+			// Number of bits of the byte before compressedOffset which
+			// are part of that block.
+	Bytef window[zip_WINDOW_SIZE];
+			// The uncompressed data up to this point.
+} zip_SeekPoint;
+
+typedef struct zip_SeekIndex {
+	int numPoints;
+	int maxPoints;
+	zip_SeekPoint **points;
+			// In order of uncompressedOffset.
+	uio_bool complete;
+			// Set when the points cover the entire file.
+} zip_SeekIndex;
+
 typedef struct zip_GPFileData {
 	off_t compressedSize;
 	off_t uncompressedSize;
@@ -64,6 +90,10 @@ typedef struct zip_GPFileData {
 	off_t headerOffset;  // start of the local header for this file
 #endif
 	off_t fileOffset;  // start of the compressed data in the .zip file
+	uio_uint32 crc;
+	zip_SeekIndex *volatile seekIndex;
+			// Complete, and read-only from the moment it is set; NULL
+			// until then. Shared by all handles to the file.
 	uid_t uid;
 	gid_t gid;
 	mode_t mode;
@@ -86,8 +116,59 @@ typedef struct zip_Handle {
 	off_t compressedOffset;
 			// seek location in the compressed stream, from the start
 			// of the compressed file
+	zip_SeekIndex *seekIndex;
+			// Built up as this handle reads the file, until it is complete
+			// and becomes the shared one. NULL until it's needed.
 } zip_Handle;
 
+#if zip_USE_HEADERS == zip_USE_CENTRAL_HEADERS
+// The directory index of an archive, as kept on disk, consists of a
+// header, and a record for each file and dir that was found in the
+// central directory, in the order in which they were found. Each record
+// is followed by the '\0'-terminated path, padded to a multiple of 4
+// bytes. All is in the native byte order.
+typedef struct zip_DirCacheHeader {
+	uio_uint32 magic;
+	uio_uint32 recordSize;
+			// sizeof (zip_DirCacheRecord), in case it changes
+	uio_uint32 archiveSize;
+	uio_sint32 archiveMTime;
+	char eocdr[24];
+			// The 'End of Central Directory Record' (22 bytes, padded)
+	uio_uint32 numRecords;
+	uio_uint32 dataSize;
+			// Of the records, not including this header
+} zip_DirCacheHeader;
+
+typedef struct zip_DirCacheRecord {
+	uio_uint32 compressedSize;
+	uio_uint32 uncompressedSize;
+	uio_uint32 headerOffset;
+	uio_uint32 crc;
+	uio_uint32 mode;
+	uio_uint32 uid;
+	uio_uint32 gid;
+	uio_sint32 atime;
+	uio_sint32 mtime;
+	uio_sint32 ctime;
+	uio_uint16 compressionFlags;
+	uio_uint16 compressionMethod;
+	uio_uint16 pathSize;
+			// Including the '\0' and the padding
+	uio_uint16 isDir;
+} zip_DirCacheRecord;
+
+// A directory index being built up in memory.
+typedef struct zip_DirCache {
+	zip_DirCacheHeader header;
+	char *data;
+	size_t dataSize;
+	size_t bufSize;
+	uio_bool failed;
+			// Set if the index can't be made for this archive
+} zip_DirCache;
+#endif
+
 
 uio_PRoot *zip_mount(uio_Handle *handle, int flags);
 int zip_umount(struct uio_PRoot *);
@@ -100,6 +181,9 @@ int zip_stat(uio_PDirHandle *pDirHandle, const char *name,
 		struct stat *statBuf);
 ssize_t zip_read(uio_Handle *handle, void *buf, size_t count);
 off_t zip_seek(uio_Handle *handle, off_t offset, int whence);
+void *zip_mmap(uio_Handle *handle, off_t offset, size_t length,
+		void **mapAddr, size_t *mapSize);
+int zip_munmap(uio_Handle *handle, void *addr, size_t size);
 
 
 
@@ -17,6 +17,13 @@
 /* DUCK video player
  *
  * Status: fully functional
+ *
+ * The frames are read and decoded ahead of time on a separate thread,
+ * into a ring of DUCK_DECODE_AHEAD buffers, so that a slow read (from a
+ * zip archive, say) does not hold up the presentation. DecodeNext() only
+ * takes the next decoded frame from the ring and converts it onto the
+ * canvas. The frames are independent of each other, so a seek simply
+ * makes the worker start over at the new frame.
  */
 
 #include "video.h"
@@ -24,9 +31,22 @@
 #include <stdio.h>
 #include <string.h>
 #include "libs/uio.h"
+#include "libs/log.h"
 #include "libs/memlib.h"
+#include "libs/threadlib.h"
+#include "libs/timelib.h"
 #include "endian_uqm.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#	define DUKV_SSE2
+		// Used if the CPU has it, whatever the compiler flags
+#	include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#	define DUKV_NEON
+		// Only when the compiler may assume it, as on AArch64
+#	include <arm_neon.h>
+#endif
+
 #define THIS_PTR    TFB_VideoDecoder* This
 
 static const char* dukv_GetName (void);
@@ -83,6 +103,19 @@ typedef struct tfb_duckvideodeltas
 
 } TFB_DuckVideoDeltas;
 
+#define DUCK_DECODE_AHEAD 8
+		// Number of frames decoded ahead; a little over half a second
+
+typedef struct tfb_duckvideoslot
+{
+	uint32* decbuf;
+	uint32 frame;
+	uint32 seek_gen;  // seek_gen at the time the frame was read
+	int result;       // as returned by DecodeNext()
+	sint32 error;
+
+} TFB_DuckVideoSlot;
+
 // specific video decoder struct derived from TFB_VideoDecoder
 // the only sane way in C one can :)
 typedef struct tfb_duckvideodecoder
@@ -105,8 +138,27 @@ typedef struct tfb_duckvideodecoder
 // generated
 	TFB_DuckVideoDeltas d;
 
-	uint8* inbuf;
-	uint32* decbuf;
+	uint8* inbuf;      // only used by the decode thread
+
+// decode-ahead ring
+	TFB_DuckVideoSlot ring[DUCK_DECODE_AHEAD];
+	uint32 ring_head;  // next slot to decode into; decode thread only
+	uint32 ring_tail;  // next slot to present; presenting thread only
+	uint32 ring_count; // protected by ring_guard
+	uint32 next_frame; // next frame to decode; protected by ring_guard
+	uint32 seek_gen;   // bumped on every seek; protected by ring_guard
+	Mutex ring_guard;
+	Semaphore free_sem;   // one count per free slot
+	Semaphore ready_sem;  // one count per decoded slot
+	Semaphore exit_sem;   // set when the decode thread is done
+	bool worker_started;
+	volatile bool worker_quit;
+	bool priming;      // the ring is filling up after a start or seek
+
+// statistics
+	uint32 frames_shown;
+	uint32 underruns;  // frames that were not decoded in time
+	TimeCount underrun_wait;
 
 } TFB_DuckVideoDecoder;
 
@@ -458,79 +510,490 @@ dukv_PixelConv (uint16 pix, const TFB_PixelFormat* fmt)
 		((b >> fmt->Bloss) << fmt->Bshift);
 }
 
+// Converts one row of decoded pixel pairs into two canvas lines.
+// A pair holds the pixel of the upper line in the high 16 bits, and
+// that of the lower line in the low 16 bits.
+typedef void (* DukVid_ConvertLineFunc) (const uint32* dec, void* dst0,
+		void* dst1, uint32 w, const TFB_PixelFormat* fmt);
+
 static void
-dukv_RenderFrame (THIS_PTR)
+dukv_ConvertLine16 (const uint32* dec, void* dst0, void* dst1, uint32 w,
+		const TFB_PixelFormat* fmt)
 {
-	TFB_DuckVideoDecoder* dukv = (TFB_DuckVideoDecoder*) This;
-	const TFB_PixelFormat* fmt = This->format;
-	uint32 h, x, y;
-	uint32* dec = dukv->decbuf;
+	uint16* d0 = (uint16*) dst0;
+	uint16* d1 = (uint16*) dst1;
+	uint32 x;
 
-	h = dukv->decoder.h / 2;
+	for (x = 0; x < w; ++x, ++dec, ++d0, ++d1)
+	{
+		uint32 pair = *dec;
+		*d0 = dukv_PixelConv ((uint16)(pair >> 16), fmt);
+		*d1 = dukv_PixelConv ((uint16)(pair & 0xffff), fmt);
+	}
+}
+
+static void
+dukv_ConvertLine24 (const uint32* dec, void* dst0, void* dst1, uint32 w,
+		const TFB_PixelFormat* fmt)
+{
+	uint8* d0 = (uint8*) dst0;
+	uint8* d1 = (uint8*) dst1;
+	uint32 x;
 
-	// separate bpp versions for speed
-	switch (fmt->BytesPerPixel)
+	for (x = 0; x < w; ++x, ++dec, d0 += 3, d1 += 3)
 	{
-	case 2:
+		uint32 pair = *dec;
+		*(uint32*)d0 = dukv_PixelConv ((uint16)(pair >> 16), fmt);
+		*(uint32*)d1 = dukv_PixelConv ((uint16)(pair & 0xffff), fmt);
+	}
+}
+
+static void
+dukv_ConvertLine32 (const uint32* dec, void* dst0, void* dst1, uint32 w,
+		const TFB_PixelFormat* fmt)
+{
+	uint32* d0 = (uint32*) dst0;
+	uint32* d1 = (uint32*) dst1;
+	uint32 x;
+
+	for (x = 0; x < w; ++x, ++dec, ++d0, ++d1)
 	{
-		for (y = 0; y < h; ++y)
-		{
-			uint16 *dst0, *dst1;
+		uint32 pair = *dec;
+		*d0 = dukv_PixelConv ((uint16)(pair >> 16), fmt);
+		*d1 = dukv_PixelConv ((uint16)(pair & 0xffff), fmt);
+	}
+}
 
-			dst0 = (uint16*) This->callbacks.GetCanvasLine (This, y * 2);
-			dst1 = (uint16*) This->callbacks.GetCanvasLine (This, y * 2 + 1);
+#ifdef DUKV_SSE2
+// 4 pixel pairs at a time; the channel shifts are the same for all
+// pixels, so they are done with the shift-by-register instructions.
 
-			for (x = 0; x < dukv->decoder.w; ++x, ++dec, ++dst0, ++dst1)
-			{
-				uint32 pair = *dec;
-				*dst0 = dukv_PixelConv ((uint16)(pair >> 16), fmt);
-				*dst1 = dukv_PixelConv ((uint16)(pair & 0xffff), fmt);
-			}
-		}
-		break;
+__attribute__((target("sse2")))
+static inline __m128i
+dukv_PixelConvSSE2 (__m128i pix, __m128i mask, const __m128i* shifts)
+{
+	__m128i r, g, b;
+
+	r = _mm_and_si128 (_mm_srli_epi32 (pix, 7), mask);
+	g = _mm_and_si128 (_mm_srli_epi32 (pix, 2), mask);
+	b = _mm_and_si128 (_mm_slli_epi32 (pix, 3), mask);
+
+	r = _mm_sll_epi32 (_mm_srl_epi32 (r, shifts[0]), shifts[1]);
+	g = _mm_sll_epi32 (_mm_srl_epi32 (g, shifts[2]), shifts[3]);
+	b = _mm_sll_epi32 (_mm_srl_epi32 (b, shifts[4]), shifts[5]);
+
+	return _mm_or_si128 (_mm_or_si128 (r, g), b);
+}
+
+__attribute__((target("sse2")))
+static void
+dukv_LoadShiftsSSE2 (__m128i* shifts, const TFB_PixelFormat* fmt)
+{
+	shifts[0] = _mm_cvtsi32_si128 (fmt->Rloss);
+	shifts[1] = _mm_cvtsi32_si128 (fmt->Rshift);
+	shifts[2] = _mm_cvtsi32_si128 (fmt->Gloss);
+	shifts[3] = _mm_cvtsi32_si128 (fmt->Gshift);
+	shifts[4] = _mm_cvtsi32_si128 (fmt->Bloss);
+	shifts[5] = _mm_cvtsi32_si128 (fmt->Bshift);
+}
+
+__attribute__((target("sse2")))
+static void
+dukv_ConvertLine16SSE2 (const uint32* dec, void* dst0, void* dst1,
+		uint32 w, const TFB_PixelFormat* fmt)
+{
+	uint16* d0 = (uint16*) dst0;
+	uint16* d1 = (uint16*) dst1;
+	const __m128i mask = _mm_set1_epi32 (0xf8);
+	const __m128i lo16 = _mm_set1_epi32 (0xffff);
+	__m128i shifts[6];
+	uint32 x;
+
+	dukv_LoadShiftsSSE2 (shifts, fmt);
+
+	for (x = 0; x + 4 <= w; x += 4)
+	{
+		__m128i pairs = _mm_loadu_si128 ((const __m128i*) (dec + x));
+		__m128i p0 = dukv_PixelConvSSE2 (_mm_srli_epi32 (pairs, 16),
+				mask, shifts);
+		__m128i p1 = dukv_PixelConvSSE2 (_mm_and_si128 (pairs, lo16),
+				mask, shifts);
+
+		// There is no unsigned 32 to 16 bit pack in SSE2; sign-extend
+		// the low halves, so that the signed pack leaves them as they
+		// are.
+		p0 = _mm_srai_epi32 (_mm_slli_epi32 (p0, 16), 16);
+		p1 = _mm_srai_epi32 (_mm_slli_epi32 (p1, 16), 16);
+		_mm_storel_epi64 ((__m128i*) (d0 + x), _mm_packs_epi32 (p0, p0));
+		_mm_storel_epi64 ((__m128i*) (d1 + x), _mm_packs_epi32 (p1, p1));
 	}
-	case 3:
+
+	dukv_ConvertLine16 (dec + x, d0 + x, d1 + x, w - x, fmt);
+}
+
+__attribute__((target("sse2")))
+static void
+dukv_ConvertLine32SSE2 (const uint32* dec, void* dst0, void* dst1,
+		uint32 w, const TFB_PixelFormat* fmt)
+{
+	uint32* d0 = (uint32*) dst0;
+	uint32* d1 = (uint32*) dst1;
+	const __m128i mask = _mm_set1_epi32 (0xf8);
+	const __m128i lo16 = _mm_set1_epi32 (0xffff);
+	__m128i shifts[6];
+	uint32 x;
+
+	dukv_LoadShiftsSSE2 (shifts, fmt);
+
+	for (x = 0; x + 4 <= w; x += 4)
 	{
-		for (y = 0; y < h; ++y)
-		{
-			uint8 *dst0, *dst1;
+		__m128i pairs = _mm_loadu_si128 ((const __m128i*) (dec + x));
+
+		_mm_storeu_si128 ((__m128i*) (d0 + x), dukv_PixelConvSSE2 (
+				_mm_srli_epi32 (pairs, 16), mask, shifts));
+		_mm_storeu_si128 ((__m128i*) (d1 + x), dukv_PixelConvSSE2 (
+				_mm_and_si128 (pairs, lo16), mask, shifts));
+	}
 
-			dst0 = (uint8*) This->callbacks.GetCanvasLine (This, y * 2);
-			dst1 = (uint8*) This->callbacks.GetCanvasLine (This, y * 2 + 1);
+	dukv_ConvertLine32 (dec + x, d0 + x, d1 + x, w - x, fmt);
+}
+#endif /* DUKV_SSE2 */
 
-			for (x = 0; x < dukv->decoder.w;
-					++x, ++dec, dst0 += 3, dst1 += 3)
-			{
-				uint32 pair = *dec;
-				*(uint32*)dst0 =
-						dukv_PixelConv ((uint16)(pair >> 16), fmt);
-				*(uint32*)dst1 =
-						dukv_PixelConv ((uint16)(pair & 0xffff), fmt);
-			}
-		}
-		break;
+#ifdef DUKV_NEON
+// 4 pixel pairs at a time. vshlq_u32() shifts right for negative counts.
+
+static inline uint32x4_t
+dukv_PixelConvNEON (uint32x4_t pix, const int32x4_t* shifts)
+{
+	const uint32x4_t mask = vdupq_n_u32 (0xf8);
+	uint32x4_t r, g, b;
+
+	r = vandq_u32 (vshrq_n_u32 (pix, 7), mask);
+	g = vandq_u32 (vshrq_n_u32 (pix, 2), mask);
+	b = vandq_u32 (vshlq_n_u32 (pix, 3), mask);
+
+	r = vshlq_u32 (vshlq_u32 (r, shifts[0]), shifts[1]);
+	g = vshlq_u32 (vshlq_u32 (g, shifts[2]), shifts[3]);
+	b = vshlq_u32 (vshlq_u32 (b, shifts[4]), shifts[5]);
+
+	return vorrq_u32 (vorrq_u32 (r, g), b);
+}
+
+static void
+dukv_LoadShiftsNEON (int32x4_t* shifts, const TFB_PixelFormat* fmt)
+{
+	shifts[0] = vdupq_n_s32 (-(sint32) fmt->Rloss);
+	shifts[1] = vdupq_n_s32 (fmt->Rshift);
+	shifts[2] = vdupq_n_s32 (-(sint32) fmt->Gloss);
+	shifts[3] = vdupq_n_s32 (fmt->Gshift);
+	shifts[4] = vdupq_n_s32 (-(sint32) fmt->Bloss);
+	shifts[5] = vdupq_n_s32 (fmt->Bshift);
+}
+
+static void
+dukv_ConvertLine16NEON (const uint32* dec, void* dst0, void* dst1,
+		uint32 w, const TFB_PixelFormat* fmt)
+{
+	uint16* d0 = (uint16*) dst0;
+	uint16* d1 = (uint16*) dst1;
+	const uint32x4_t lo16 = vdupq_n_u32 (0xffff);
+	int32x4_t shifts[6];
+	uint32 x;
+
+	dukv_LoadShiftsNEON (shifts, fmt);
+
+	for (x = 0; x + 4 <= w; x += 4)
+	{
+		uint32x4_t pairs = vld1q_u32 (dec + x);
+
+		vst1_u16 (d0 + x, vmovn_u32 (dukv_PixelConvNEON (
+				vshrq_n_u32 (pairs, 16), shifts)));
+		vst1_u16 (d1 + x, vmovn_u32 (dukv_PixelConvNEON (
+				vandq_u32 (pairs, lo16), shifts)));
+	}
+
+	dukv_ConvertLine16 (dec + x, d0 + x, d1 + x, w - x, fmt);
+}
+
+static void
+dukv_ConvertLine32NEON (const uint32* dec, void* dst0, void* dst1,
+		uint32 w, const TFB_PixelFormat* fmt)
+{
+	uint32* d0 = (uint32*) dst0;
+	uint32* d1 = (uint32*) dst1;
+	const uint32x4_t lo16 = vdupq_n_u32 (0xffff);
+	int32x4_t shifts[6];
+	uint32 x;
+
+	dukv_LoadShiftsNEON (shifts, fmt);
+
+	for (x = 0; x + 4 <= w; x += 4)
+	{
+		uint32x4_t pairs = vld1q_u32 (dec + x);
+
+		vst1q_u32 (d0 + x, dukv_PixelConvNEON (
+				vshrq_n_u32 (pairs, 16), shifts));
+		vst1q_u32 (d1 + x, dukv_PixelConvNEON (
+				vandq_u32 (pairs, lo16), shifts));
 	}
+
+	dukv_ConvertLine32 (dec + x, d0 + x, d1 + x, w - x, fmt);
+}
+#endif /* DUKV_NEON */
+
+typedef struct
+{
+	const char* name;
+	DukVid_ConvertLineFunc line16;
+	DukVid_ConvertLineFunc line32;
+} DukVid_Converter;
+
+// The plain C version first; the others in order of preference
+static const DukVid_Converter dukv_Converters[] =
+{
+	{"C", dukv_ConvertLine16, dukv_ConvertLine32},
+#ifdef DUKV_SSE2
+	{"SSE2", dukv_ConvertLine16SSE2, dukv_ConvertLine32SSE2},
+#endif
+#ifdef DUKV_NEON
+	{"NEON", dukv_ConvertLine16NEON, dukv_ConvertLine32NEON},
+#endif
+};
+
+#define DUKV_NUM_CONVERTERS \
+		(sizeof (dukv_Converters) / sizeof (dukv_Converters[0]))
+
+static const DukVid_Converter* dukv_converter = &dukv_Converters[0];
+
+static bool
+dukv_ConverterSupported (const DukVid_Converter* conv)
+{
+#ifdef DUKV_SSE2
+	if (conv->line32 == dukv_ConvertLine32SSE2)
+		return __builtin_cpu_supports ("sse2");
+#endif
+	(void) conv;
+	return true;
+}
+
+static DukVid_ConvertLineFunc
+dukv_GetConvertLine (const DukVid_Converter* conv, int bytesPerPixel)
+{
+	switch (bytesPerPixel)
+	{
+	case 2:
+		return conv->line16;
+	case 3:
+		return dukv_ConvertLine24;
 	case 4:
+		return conv->line32;
+	default:
+		return NULL;
+	}
+}
+
+static void
+dukv_RenderFrame (THIS_PTR, const uint32* dec)
+{
+	TFB_DuckVideoDecoder* dukv = (TFB_DuckVideoDecoder*) This;
+	const TFB_PixelFormat* fmt = This->format;
+	DukVid_ConvertLineFunc convertLine;
+	uint32 h, y;
+
+	convertLine = dukv_GetConvertLine (dukv_converter, fmt->BytesPerPixel);
+	if (!convertLine)
+		return;
+
+	h = dukv->decoder.h / 2;
+	for (y = 0; y < h; ++y, dec += dukv->decoder.w)
 	{
-		for (y = 0; y < h; ++y)
-		{
-			uint32 *dst0, *dst1;
+		convertLine (dec, This->callbacks.GetCanvasLine (This, y * 2),
+				This->callbacks.GetCanvasLine (This, y * 2 + 1),
+				dukv->decoder.w, fmt);
+	}
+}
 
-			dst0 = (uint32*) This->callbacks.GetCanvasLine (This, y * 2);
-			dst1 = (uint32*) This->callbacks.GetCanvasLine (This, y * 2 + 1);
+// Reads and decodes a frame into 'decbuf'.
+// Returns 1 on success, 0 at the end of the file, and -1 on an error;
+// in the last two cases, '*error' is set.
+static int
+dukv_ReadFrame (TFB_DuckVideoDecoder* dukv, uint32 frame, uint32* decbuf,
+		sint32* error)
+{
+	uint32 fh[2];
+	uint32 vofs;
+	uint32 vsize;
+	uint16 ver;
 
-			for (x = 0; x < dukv->decoder.w; ++x, ++dec, ++dst0, ++dst1)
-			{
-				uint32 pair = *dec;
-				*dst0 = dukv_PixelConv ((uint16)(pair >> 16), fmt);
-				*dst1 = dukv_PixelConv ((uint16)(pair & 0xffff), fmt);
-			}
-		}
-		break;
+	if (frame >= dukv->cframes)
+	{
+		*error = dukve_EOF;
+		return 0;
 	}
-	default:
-		;
+
+	uio_fseek (dukv->stream, dukv->frames[frame], SEEK_SET);
+	if (uio_fread (&fh, sizeof (fh), 1, dukv->stream) != 1)
+	{
+		*error = dukve_EOF;
+		return 0;
+	}
+
+	vofs = UQM_SwapBE32 (fh[0]);
+	vsize = UQM_SwapBE32 (fh[1]);
+	if (vsize > DUCK_MAX_FRAME_SIZE)
+	{
+		*error = dukve_OutOfBuf;
+		return -1;
+	}
+
+	uio_fseek (dukv->stream, vofs, SEEK_CUR);
+	if (uio_fread (dukv->inbuf, 1, vsize, dukv->stream) != vsize)
+	{
+		*error = dukve_EOF;
+		return 0;
+	}
+
+	ver = UQM_SwapBE16 (*(uint16*)dukv->inbuf);
+	if (ver == 0x0300)
+		dukv_DecodeFrameV3 (dukv->inbuf + 0x10, decbuf,
+				dukv->wb, dukv->hb, &dukv->d);
+	else
+		dukv_DecodeFrame (dukv->inbuf + 0x10, decbuf,
+				dukv->wb, dukv->hb, &dukv->d);
+
+	return 1;
+}
+
+static int
+dukv_DecodeThread (void* data)
+{
+	TFB_DuckVideoDecoder* dukv = (TFB_DuckVideoDecoder*) data;
+
+	for (;;)
+	{
+		TFB_DuckVideoSlot* slot;
+		uint32 frame;
+		uint32 seek_gen;
+
+		SetSemaphore (dukv->free_sem);
+		if (dukv->worker_quit)
+			break;
+
+		LockMutex (dukv->ring_guard);
+		frame = dukv->next_frame;
+		seek_gen = dukv->seek_gen;
+		if (frame < dukv->cframes)
+			dukv->next_frame++;
+		UnlockMutex (dukv->ring_guard);
+
+		slot = &dukv->ring[dukv->ring_head];
+		slot->frame = frame;
+		slot->seek_gen = seek_gen;
+		slot->error = dukve_None;
+		slot->result = dukv_ReadFrame (dukv, frame, slot->decbuf,
+				&slot->error);
+		dukv->ring_head = (dukv->ring_head + 1) % DUCK_DECODE_AHEAD;
+
+		LockMutex (dukv->ring_guard);
+		dukv->ring_count++;
+		UnlockMutex (dukv->ring_guard);
+		ClearSemaphore (dukv->ready_sem);
 	}
+
+	ClearSemaphore (dukv->exit_sem);
+	return 0;
+}
+
+static void
+dukv_StartWorker (TFB_DuckVideoDecoder* dukv)
+{
+	dukv->ring_guard = CreateMutex ("DukVid ring lock", SYNC_CLASS_VIDEO);
+	dukv->free_sem = CreateSemaphore (DUCK_DECODE_AHEAD, "DukVid free",
+			SYNC_CLASS_VIDEO);
+	dukv->ready_sem = CreateSemaphore (0, "DukVid ready", SYNC_CLASS_VIDEO);
+	dukv->exit_sem = CreateSemaphore (0, "DukVid exit", SYNC_CLASS_VIDEO);
+
+	dukv->ring_head = 0;
+	dukv->ring_tail = 0;
+	dukv->ring_count = 0;
+	dukv->next_frame = dukv->iframe;
+	dukv->seek_gen = 0;
+	dukv->worker_quit = false;
+	dukv->worker_started = true;
+	dukv->priming = true;
+	// Born asynchronously; until it runs, DecodeNext() simply waits.
+	StartThread (dukv_DecodeThread, dukv, 1024, "DukVid decoder");
+}
+
+static void
+dukv_StopWorker (TFB_DuckVideoDecoder* dukv)
+{
+	if (dukv->worker_started)
+	{
+		dukv->worker_quit = true;
+		ClearSemaphore (dukv->free_sem);
+				// in case it is waiting for a free slot
+		SetSemaphore (dukv->exit_sem);
+		dukv->worker_started = false;
+
+		log_add (log_Debug, "DukVid: %s: %lu frames shown, %lu not "
+				"decoded in time (waited %lu ms in total)",
+				dukv->basename, (unsigned long) dukv->frames_shown,
+				(unsigned long) dukv->underruns,
+				(unsigned long) (dukv->underrun_wait * 1000 / ONE_SECOND));
+	}
+
+	if (dukv->exit_sem)
+	{
+		DestroySemaphore (dukv->exit_sem);
+		dukv->exit_sem = NULL;
+	}
+	if (dukv->ready_sem)
+	{
+		DestroySemaphore (dukv->ready_sem);
+		dukv->ready_sem = NULL;
+	}
+	if (dukv->free_sem)
+	{
+		DestroySemaphore (dukv->free_sem);
+		dukv->free_sem = NULL;
+	}
+	if (dukv->ring_guard)
+	{
+		DestroyMutex (dukv->ring_guard);
+		dukv->ring_guard = NULL;
+	}
+}
+
+// Gives the slot at the tail of the ring back to the decode thread
+static void
+dukv_ReleaseSlot (TFB_DuckVideoDecoder* dukv)
+{
+	dukv->ring_tail = (dukv->ring_tail + 1) % DUCK_DECODE_AHEAD;
+
+	LockMutex (dukv->ring_guard);
+	dukv->ring_count--;
+	UnlockMutex (dukv->ring_guard);
+	ClearSemaphore (dukv->free_sem);
+}
+
+static int
+dukv_PresentFrame (THIS_PTR, const uint32* decbuf)
+{
+	TFB_DuckVideoDecoder* dukv = (TFB_DuckVideoDecoder*) This;
+
+	dukv->iframe++;
+	dukv->frames_shown++;
+	dukv->priming = false;
+
+	This->callbacks.BeginFrame (This);
+	dukv_RenderFrame (This, decbuf);
+	This->callbacks.EndFrame (This);
+
+	if (!This->audio_synced)
+	   This->callbacks.SetTimer (This, (uint32) (1000.0f / DUCK_GENERAL_FPS));
+
+	return 1;
 }
 
 static const char*
@@ -542,10 +1005,21 @@ dukv_GetName (void)
 static bool
 dukv_InitModule (int flags)
 {
+	int i;
+
 	// no flags are defined for now
-	return true;
-	
 	(void)flags; // dodge compiler warning
+
+	for (i = DUKV_NUM_CONVERTERS - 1; i > 0; --i)
+	{
+		if (dukv_ConverterSupported (&dukv_Converters[i]))
+			break;
+	}
+	dukv_converter = &dukv_Converters[i];
+	log_add (log_Info, "DukVid: using the %s pixel conversion",
+			dukv_converter->name);
+
+	return true;
 }
 
 static void
@@ -589,6 +1063,7 @@ dukv_Open (THIS_PTR, uio_DirHandle *dir, const char *filename)
 	char* pext;
 	sint32 lumas[8], chromas[8];
 	uint8* vectors;
+	int i;
 	
 	dukv->basedir = dir;
 	dukv->basename = HMalloc (strlen (filename) + 1);
@@ -618,8 +1093,11 @@ dukv_Open (THIS_PTR, uio_DirHandle *dir, const char *filename)
 	This->interframe_wait = (uint32) (1000.0 / DUCK_GENERAL_FPS);
 
 	dukv->inbuf = HMalloc (DUCK_MAX_FRAME_SIZE);
-	dukv->decbuf = HMalloc (
-			dukv->decoder.w * dukv->decoder.h * sizeof (uint16));
+	for (i = 0; i < DUCK_DECODE_AHEAD; ++i)
+	{
+		dukv->ring[i].decbuf = HMalloc (
+				dukv->decoder.w * dukv->decoder.h * sizeof (uint16));
+	}
 
 	return true;
 }
@@ -628,6 +1106,9 @@ static void
 dukv_Close (THIS_PTR)
 {
 	TFB_DuckVideoDecoder* dukv = (TFB_DuckVideoDecoder*) This;
+	int i;
+
+	dukv_StopWorker (dukv);
 
 	if (dukv->basename)
 	{
@@ -649,10 +1130,13 @@ dukv_Close (THIS_PTR)
 		HFree (dukv->inbuf);
 		dukv->inbuf = NULL;
 	}
-	if (dukv->decbuf)
+	for (i = 0; i < DUCK_DECODE_AHEAD; ++i)
 	{
-		HFree (dukv->decbuf);
-		dukv->decbuf = NULL;
+		if (dukv->ring[i].decbuf)
+		{
+			HFree (dukv->ring[i].decbuf);
+			dukv->ring[i].decbuf = NULL;
+		}
 	}
 }
 
@@ -660,54 +1144,53 @@ static int
 dukv_DecodeNext (THIS_PTR)
 {
 	TFB_DuckVideoDecoder* dukv = (TFB_DuckVideoDecoder*) This;
-	uint32 fh[2];
-	uint32 vofs;
-	uint32 vsize;
-	uint16 ver;
+	TFB_DuckVideoSlot* slot;
+	uint32 seek_gen;
+	bool ready;
+	int ret;
 
 	if (!dukv->stream || dukv->iframe >= dukv->cframes)
 		return 0;
 
-	uio_fseek (dukv->stream, dukv->frames[dukv->iframe], SEEK_SET);
-	if (uio_fread (&fh, sizeof (fh), 1, dukv->stream) != 1)
-	{
-		dukv->last_error = dukve_EOF;
-		return 0;
-	}
+	if (!dukv->worker_started)
+		dukv_StartWorker (dukv);
 
-	vofs = UQM_SwapBE32 (fh[0]);
-	vsize = UQM_SwapBE32 (fh[1]);
-	if (vsize > DUCK_MAX_FRAME_SIZE)
+	for (;;)
 	{
-		dukv->last_error = dukve_OutOfBuf;
-		return -1;
-	}
+		LockMutex (dukv->ring_guard);
+		ready = dukv->ring_count > 0;
+		seek_gen = dukv->seek_gen;
+		UnlockMutex (dukv->ring_guard);
 
-	uio_fseek (dukv->stream, vofs, SEEK_CUR);
-	if (uio_fread (dukv->inbuf, 1, vsize, dukv->stream) != vsize)
-	{
-		dukv->last_error = dukve_EOF;
-		return 0;
-	}
+		if (!ready && !dukv->priming)
+		{
+			TimeCount start = GetTimeCounter ();
 
-	ver = UQM_SwapBE16 (*(uint16*)dukv->inbuf);
-	if (ver == 0x0300)
-		dukv_DecodeFrameV3 (dukv->inbuf + 0x10, dukv->decbuf,
-				dukv->wb, dukv->hb, &dukv->d);
-	else
-		dukv_DecodeFrame (dukv->inbuf + 0x10, dukv->decbuf,
-				dukv->wb, dukv->hb, &dukv->d);
+			dukv->underruns++;
+			SetSemaphore (dukv->ready_sem);
+			dukv->underrun_wait += GetTimeCounter () - start;
+		}
+		else
+		{
+			SetSemaphore (dukv->ready_sem);
+		}
 
-	dukv->iframe++;
+		slot = &dukv->ring[dukv->ring_tail];
+		if (slot->seek_gen == seek_gen)
+			break;
 
-	This->callbacks.BeginFrame (This);
-	dukv_RenderFrame (This);
-	This->callbacks.EndFrame (This);
+		// Decoded before the last seek
+		dukv_ReleaseSlot (dukv);
+	}
 
-	if (!This->audio_synced)
-	   This->callbacks.SetTimer (This, (uint32) (1000.0f / DUCK_GENERAL_FPS));
+	ret = slot->result;
+	if (ret > 0)
+		dukv_PresentFrame (This, slot->decbuf);
+	else
+		dukv->last_error = slot->error;
+	dukv_ReleaseSlot (dukv);
 
-	return 1;
+	return ret;
 }
 
 static uint32
@@ -718,6 +1201,15 @@ dukv_SeekFrame (THIS_PTR, uint32 frame)
 	if (frame > dukv->cframes)
 		frame = dukv->cframes; // EOS
 
+	if (frame != dukv->iframe && dukv->worker_started)
+	{	// the frames in the ring are of no use anymore
+		LockMutex (dukv->ring_guard);
+		dukv->seek_gen++;
+		dukv->next_frame = frame;
+		UnlockMutex (dukv->ring_guard);
+		dukv->priming = true;
+	}
+
 	return dukv->iframe = frame;
 }
 
@@ -746,3 +1238,208 @@ dukv_GetTime (THIS_PTR)
 	
 	return (float) dukv->iframe / DUCK_GENERAL_FPS;
 }
+
+// Benchmark
+
+#define DUKV_BENCH_BATCH 64
+		// Frames decoded at a time; all of a video would not fit
+#define DUKV_BENCH_RUNS 8
+		// Timed conversions of every batch
+
+typedef struct
+{
+	const char* name;
+	TFB_PixelFormat fmt;
+} DukVid_BenchFormat;
+
+static const DukVid_BenchFormat dukv_BenchFormats[] =
+{
+	// BitsPerPixel, BytesPerPixel, masks (not used), shifts, losses
+	{"XRGB8888", {32, 4, 0, 0, 0, 0, 16, 8, 0, 0, 0, 0, 0, 0}},
+	{"XBGR8888", {32, 4, 0, 0, 0, 0, 0, 8, 16, 0, 0, 0, 0, 0}},
+	{"RGB565",   {16, 2, 0, 0, 0, 0, 11, 5, 0, 0, 3, 2, 3, 0}},
+	{"RGB555",   {16, 2, 0, 0, 0, 0, 10, 5, 0, 0, 3, 3, 3, 0}},
+};
+
+#define DUKV_NUM_BENCH_FORMATS \
+		(sizeof (dukv_BenchFormats) / sizeof (dukv_BenchFormats[0]))
+
+typedef struct
+{
+	TimeCount elapsed;
+	uint32 mismatches;  // frames that differ from the C version
+} DukVid_BenchResult;
+
+static void
+dukv_BenchConvertFrame (DukVid_ConvertLineFunc convertLine,
+		const uint32* dec, uint8* dst, uint32 w, uint32 h,
+		const TFB_PixelFormat* fmt)
+{
+	uint32 pitch = w * fmt->BytesPerPixel;
+	uint32 y;
+
+	for (y = 0; y < h / 2; ++y, dec += w)
+	{
+		convertLine (dec, dst + y * 2 * pitch, dst + (y * 2 + 1) * pitch,
+				w, fmt);
+	}
+}
+
+// Converts a batch of decoded frames with each of the converters,
+// checking that the results are identical to those of the C version.
+static void
+dukv_BenchConvertBatch (const uint32* frames, uint32 count, uint32 w,
+		uint32 h, uint8* ref, uint8* out,
+		DukVid_BenchResult results[][DUKV_NUM_CONVERTERS])
+{
+	uint32 frameSize = w * h / 2;
+	size_t fi, ci;
+
+	for (fi = 0; fi < DUKV_NUM_BENCH_FORMATS; ++fi)
+	{
+		const TFB_PixelFormat* fmt = &dukv_BenchFormats[fi].fmt;
+		DukVid_ConvertLineFunc refLine =
+				dukv_GetConvertLine (&dukv_Converters[0], fmt->BytesPerPixel);
+
+		for (ci = 0; ci < DUKV_NUM_CONVERTERS; ++ci)
+		{
+			DukVid_BenchResult* result = &results[fi][ci];
+			DukVid_ConvertLineFunc convertLine;
+			TimeCount start;
+			uint32 f, run;
+
+			if (!dukv_ConverterSupported (&dukv_Converters[ci]))
+				continue;
+			convertLine = dukv_GetConvertLine (&dukv_Converters[ci],
+					fmt->BytesPerPixel);
+
+			for (f = 0; ci > 0 && f < count; ++f)
+			{
+				const uint32* dec = frames + f * frameSize;
+
+				dukv_BenchConvertFrame (refLine, dec, ref, w, h, fmt);
+				dukv_BenchConvertFrame (convertLine, dec, out, w, h, fmt);
+				if (memcmp (ref, out, w * h * fmt->BytesPerPixel) != 0)
+					result->mismatches++;
+			}
+
+			start = GetTimeCounter ();
+			for (run = 0; run < DUKV_BENCH_RUNS; ++run)
+			{
+				for (f = 0; f < count; ++f)
+				{
+					dukv_BenchConvertFrame (convertLine,
+							frames + f * frameSize, out, w, h, fmt);
+				}
+			}
+			result->elapsed += GetTimeCounter () - start;
+		}
+	}
+}
+
+// Decodes all of a video, and converts every frame to a few common
+// pixel formats with each pixel conversion this CPU supports.
+// Returns 0 if all the conversions gave the same result as the plain C
+// version, 1 if not, and -1 if the video could not be read.
+int
+dukv_RunBenchmark (uio_DirHandle *dir, const char *filename)
+{
+	DukVid_BenchResult results[DUKV_NUM_BENCH_FORMATS][DUKV_NUM_CONVERTERS];
+	TFB_DuckVideoDecoder* dukv;
+	TFB_VideoDecoder* This;
+	uint32* frames;
+	uint8* ref;
+	uint8* out;
+	uint32 w, h;
+	uint32 frameSize;
+	uint32 mismatches = 0;
+	uint32 decoded = 0;
+	TimeCount decodeTime = 0;
+	size_t fi, ci;
+
+	dukv = HCalloc (sizeof (*dukv));
+	This = &dukv->decoder;
+	This->funcs = &dukv_DecoderVtbl;
+	if (!dukv_Open (This, dir, filename))
+	{
+		log_add (log_Error, "DukVid benchmark: cannot open '%s'", filename);
+		HFree (dukv);
+		return -1;
+	}
+
+	w = This->w;
+	h = This->h;
+	frameSize = w * h / 2;
+	frames = HMalloc (DUKV_BENCH_BATCH * frameSize * sizeof (uint32));
+	ref = HMalloc (w * h * 4);
+	out = HMalloc (w * h * 4);
+	memset (results, 0, sizeof (results));
+
+	while (decoded < dukv->cframes)
+	{
+		TimeCount start = GetTimeCounter ();
+		uint32 count;
+
+		for (count = 0; count < DUKV_BENCH_BATCH
+				&& decoded + count < dukv->cframes; ++count)
+		{
+			if (dukv_ReadFrame (dukv, decoded + count,
+					frames + count * frameSize, &dukv->last_error) <= 0)
+				break;
+		}
+		decodeTime += GetTimeCounter () - start;
+
+		if (count == 0)
+			break;
+		dukv_BenchConvertBatch (frames, count, w, h, ref, out, results);
+		decoded += count;
+	}
+
+	log_add (log_User, "%s: %ux%u, %u of %u frames; read and decoded in "
+			"%.3f ms per frame", filename, (unsigned) w, (unsigned) h,
+			(unsigned) decoded, (unsigned) dukv->cframes,
+			decoded ? (double) decodeTime * 1000.0 / ONE_SECOND / decoded
+			: 0.0);
+
+	for (fi = 0; decoded && fi < DUKV_NUM_BENCH_FORMATS; ++fi)
+	{
+		double nsRef = 0.0;
+
+		for (ci = 0; ci < DUKV_NUM_CONVERTERS; ++ci)
+		{
+			const DukVid_BenchResult* result = &results[fi][ci];
+			double ns;
+
+			if (!dukv_ConverterSupported (&dukv_Converters[ci]))
+				continue;
+
+			ns = (double) result->elapsed * 1000000000.0 / ONE_SECOND
+					/ ((double) DUKV_BENCH_RUNS * decoded * w * h);
+			if (ci == 0)
+				nsRef = ns;
+
+			log_add (log_User, "  %-8s %-5s %7.3f ns/px  %5.2fx  %s",
+					dukv_BenchFormats[fi].name, dukv_Converters[ci].name,
+					ns, ns > 0.0 ? nsRef / ns : 0.0,
+					ci == 0 ? "reference" :
+					(result->mismatches ? "MISMATCH" : "identical"));
+			mismatches += result->mismatches;
+		}
+	}
+
+	HFree (out);
+	HFree (ref);
+	HFree (frames);
+	dukv_Close (This);
+	HFree (dukv);
+
+	if (decoded == 0)
+		return -1;
+	if (mismatches)
+	{
+		log_add (log_Error, "DukVid benchmark: %u frame conversions "
+				"differ from the C version", (unsigned) mismatches);
+		return 1;
+	}
+	return 0;
+}
@@ -33,4 +33,9 @@ typedef enum
 	dukve_Other = -1000,
 } DukVid_Error;
 
+// Decodes the video 'filename' and benchmarks the pixel conversions on
+// its frames, checking them against the plain C version.
+// Returns 0 if they all match, 1 if not, and -1 if the file cannot be read.
+int dukv_RunBenchmark (uio_DirHandle *dir, const char *filename);
+
 #endif // LIBS_VIDEO_DUKVID_H_
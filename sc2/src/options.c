@@ -29,6 +29,7 @@
 #include "libs/uio.h"
 #include "libs/strlib.h"
 #include "libs/log.h"
+#include "libs/proflib.h"
 #include "libs/reslib.h"
 #include "libs/memlib.h"
 
@@ -57,6 +58,10 @@ BOOLEAN optRemixMusic;
 BOOLEAN optSpeech;
 BOOLEAN optSubtitles;
 BOOLEAN optStereoSFX;
+BOOLEAN optCompressSaves;
+int optSphereThreads;
+BOOLEAN optSphereStats;
+BOOLEAN optResStats;
 BOOLEAN optKeepAspectRatio;
 
 float optGamma;
@@ -252,6 +257,23 @@ prepareConfigDir (const char *configDirName) {
 				strerror (errno));
 		exit (EXIT_FAILURE);
 	}
+
+#ifdef HAVE_ZIP
+	{
+		uio_DirHandle *cacheDir;
+
+		// Mounting the content packages, and seeking in the deflated
+		// files in them, is quicker with the indices kept here.
+		uio_mkdir (configDir, "cache", 0777);
+				// May already exist
+		cacheDir = uio_openDirRelative (configDir, "cache", 0);
+		if (cacheDir != NULL)
+		{
+			uio_setZipCacheDir (cacheDir);
+			uio_closeDir (cacheDir);
+		}
+	}
+#endif
 }
 
 void
@@ -474,6 +496,8 @@ mountDirZips (uio_DirHandle *dirHandle, const char *mountPoint,
 		
 		for (i = 0; i < dirList->numNames; i++)
 		{
+			uint64 startTime = prof_now ();
+
 			if (uio_mountDir (repository, mountPoint, uio_FSTYPE_ZIP,
 					dirHandle, dirList->names[i], "/", autoMount,
 					relativeFlags | uio_MOUNT_RDONLY,
@@ -481,7 +505,11 @@ mountDirZips (uio_DirHandle *dirHandle, const char *mountPoint,
 			{
 				log_add (log_Warning, "Warning: Could not mount '%s': %s.",
 						dirList->names[i], strerror (errno));
+				continue;
 			}
+			log_add (log_Info, "Mounted '%s' in %.1f ms.",
+					dirList->names[i],
+					(double) (prof_now () - startTime) / 1000000.0);
 		}
 	}
 	uio_DirList_free (dirList);
@@ -633,6 +661,9 @@ unprepareAllDirs (void)
 		uio_closeDir (configDir);
 		configDir = 0;
 	}
+#ifdef HAVE_ZIP
+	uio_setZipCacheDir (NULL);
+#endif
 }
 
 bool
@@ -47,6 +47,10 @@ extern BOOLEAN optRemixMusic;
 extern BOOLEAN optSpeech;
 extern BOOLEAN optSubtitles;
 extern BOOLEAN optStereoSFX;
+extern BOOLEAN optCompressSaves;
+extern int optSphereThreads;
+extern BOOLEAN optSphereStats;
+extern BOOLEAN optResStats;
 extern BOOLEAN optKeepAspectRatio;
 
 #define GAMMA_SCALE  1000
@@ -31,6 +31,7 @@
 #include "libs/graphics/gfx_common.h"
 #include "libs/graphics/cmap.h"
 #include "libs/sound/sound.h"
+#include "libs/sound/mixer/mixer.h"
 #include "libs/input/input_common.h"
 #include "libs/inplib.h"
 #include "libs/tasklib.h"
@@ -44,6 +45,7 @@
 #include "libs/memlib.h"
 #include "libs/platform.h"
 #include "libs/log.h"
+#include "libs/proflib.h"
 #include "options.h"
 #include "uqmversion.h"
 #include "uqm/comm.h"
@@ -53,9 +55,15 @@
 #	include "libs/net.h"
 #	include "uqm/supermelee/netplay/netoptions.h"
 #	include "uqm/supermelee/netplay/netplay.h"
+#	include "uqm/supermelee/netplay/crc.h"
+#	include "uqm/supermelee/netplay/crcbench.h"
 #endif
 #include "uqm/setup.h"
+#include "uqm/starbench.h"
 #include "uqm/starcon.h"
+#include "uqm/supermelee/meleesim.h"
+#include "libs/video/video.h"
+#include "libs/video/dukvid.h"
 
 
 #if defined (GFXMODULE_SDL)
@@ -91,11 +99,22 @@ struct options_struct
 
 	// Commandline-only options
 	const char *logFile;
+	const char *profileFile;
 	enum {
 		runMode_normal,
 		runMode_usage,
 		runMode_version,
+		runMode_benchmark,
+		runMode_checksumBenchmark,
+		runMode_videoBenchmark,
+		runMode_starBenchmark,
+		runMode_mixerCheck,
 	} runMode;
+	const char *benchImage;
+	const char *benchVideo;
+	int benchStars;
+	int meleeSimBattles;
+	int meleeSimJobs;
 
 	const char *configDir;
 	const char *contentDir;
@@ -111,7 +130,11 @@ struct options_struct
 	DECL_CONFIG_OPTION(bool, fullscreen);
 	DECL_CONFIG_OPTION(bool, scanlines);
 	DECL_CONFIG_OPTION(int, scaler);
+	DECL_CONFIG_OPTION(int, scalerThreads);
 	DECL_CONFIG_OPTION(bool, showFps);
+	DECL_CONFIG_OPTION(int, sphereThreads);
+	DECL_CONFIG_OPTION(bool, sphereStats);
+	DECL_CONFIG_OPTION(bool, resStats);
 	DECL_CONFIG_OPTION(bool, keepAspectRatio);
 	DECL_CONFIG_OPTION(float, gamma);
 	DECL_CONFIG_OPTION(int, soundDriver);
@@ -128,6 +151,7 @@ struct options_struct
 	DECL_CONFIG_OPTION(int, meleeScale);
 	DECL_CONFIG_OPTION(bool, subtitles);
 	DECL_CONFIG_OPTION(bool, stereoSFX);
+	DECL_CONFIG_OPTION(bool, compressSaves);
 	DECL_CONFIG_OPTION(float, musicVolumeScale);
 	DECL_CONFIG_OPTION(float, sfxVolumeScale);
 	DECL_CONFIG_OPTION(float, speechVolumeScale);
@@ -227,13 +251,20 @@ static int InvalidArgument (const char *supplied, const char *opt_name);
 static const char *choiceOptString (const struct int_option *option);
 static const char *boolOptString (const struct bool_option *option);
 static const char *boolNotOptString (const struct bool_option *option);
+static int runVideoBenchmark (const char *file);
 
 int
 main (int argc, char *argv[])
 {
 	struct options_struct options = {
 		/* .logFile = */            NULL,
+		/* .profileFile = */        NULL,
 		/* .runMode = */            runMode_normal,
+		/* .benchImage = */         NULL,
+		/* .benchVideo = */         NULL,
+		/* .benchStars = */         STARBENCH_DEFAULT_STARS,
+		/* .meleeSimBattles = */    0,
+		/* .meleeSimJobs = */       1,
 		/* .configDir = */          NULL,
 		/* .contentDir = */         NULL,
 		/* .addonDir = */           NULL,
@@ -246,7 +277,11 @@ main (int argc, char *argv[])
 		INIT_CONFIG_OPTION(  fullscreen,        false ),
 		INIT_CONFIG_OPTION(  scanlines,         false ),
 		INIT_CONFIG_OPTION(  scaler,            0 ),
+		INIT_CONFIG_OPTION(  scalerThreads,     1 ),
 		INIT_CONFIG_OPTION(  showFps,           false ),
+		INIT_CONFIG_OPTION(  sphereThreads,     1 ),
+		INIT_CONFIG_OPTION(  sphereStats,       false ),
+		INIT_CONFIG_OPTION(  resStats,          false ),
 		INIT_CONFIG_OPTION(  keepAspectRatio,   false ),
 		INIT_CONFIG_OPTION(  gamma,             1.0f ),
 		INIT_CONFIG_OPTION(  soundDriver,       audio_DRIVER_MIXSDL ),
@@ -263,6 +298,7 @@ main (int argc, char *argv[])
 		INIT_CONFIG_OPTION(  meleeScale,        TFB_SCALE_TRILINEAR ),
 		INIT_CONFIG_OPTION(  subtitles,         true ),
 		INIT_CONFIG_OPTION(  stereoSFX,         false ),
+		INIT_CONFIG_OPTION(  compressSaves,     false ),
 		INIT_CONFIG_OPTION(  musicVolumeScale,  1.0f ),
 		INIT_CONFIG_OPTION(  sfxVolumeScale,    1.0f ),
 		INIT_CONFIG_OPTION(  speechVolumeScale, 1.0f ),
@@ -337,10 +373,86 @@ main (int argc, char *argv[])
 		return optionsResult;
 	}
 
+	if (options.runMode == runMode_benchmark)
+	{	// Headless, so none of the rest needs to be up
+		int result;
+
+		mem_init ();
+		InitThreadSystem ();
+		log_initThreads ();
+		InitTimeSystem ();
+		TFB_SetScalerThreads (options.scalerThreads.value);
+		result = TFB_RunGfxBenchmark (options.benchImage);
+		UnInitTimeSystem ();
+		UnInitThreadSystem ();
+		mem_uninit ();
+		HFree (options.addons);
+		return result;
+	}
+
+	if (options.runMode == runMode_mixerCheck)
+	{
+		int result;
+
+		mem_init ();
+		InitThreadSystem ();
+		log_initThreads ();
+		result = mixer_RunSelfCheck ();
+		UnInitThreadSystem ();
+		mem_uninit ();
+		HFree (options.addons);
+		return result;
+	}
+
+	if (options.runMode == runMode_starBenchmark)
+	{
+		int result;
+
+		mem_init ();
+		InitTimeSystem ();
+		result = RunStarIndexBenchmark ((DWORD) options.benchStars);
+		UnInitTimeSystem ();
+		mem_uninit ();
+		HFree (options.addons);
+		return result;
+	}
+
+#ifdef NETPLAY
+	if (options.runMode == runMode_checksumBenchmark)
+	{
+		int result;
+
+		mem_init ();
+		InitTimeSystem ();
+		result = crc_runBenchmark ();
+		UnInitTimeSystem ();
+		mem_uninit ();
+		HFree (options.addons);
+		return result;
+	}
+#endif
+
+	if (options.meleeSimBattles > 0)
+	{
+		int result;
+
+		if (MeleeSim_forkJobs ((COUNT) options.meleeSimJobs, &result))
+		{	// The child processes did the battles
+			HFree (options.addons);
+			return result;
+		}
+
+		// Nothing is shown, so there is no need for a window either
+		setenv ("SDL_VIDEODRIVER", "dummy", 0);
+	}
+
 	TFB_PreInit ();
 	mem_init ();
 	InitThreadSystem ();
 	log_initThreads ();
+	prof_nameThread ("main");
+	if (options.profileFile)
+		prof_start (options.profileFile);
 	initIO ();
 	prepareConfigDir (options.configDir);
 
@@ -375,6 +487,11 @@ main (int argc, char *argv[])
 	   thread doesn't work */
 	snddriver = options.soundDriver.value;
 	soundflags = options.soundQuality.value;
+	if (options.meleeSimBattles > 0)
+	{
+		snddriver = audio_DRIVER_NOSOUND;
+		meleeSimBattles = (COUNT) options.meleeSimBattles;
+	}
 
 	// Fill in global variables:
 	opt3doMusic = options.use3doMusic.value;
@@ -390,6 +507,10 @@ main (int argc, char *argv[])
 	optKeepAspectRatio = options.keepAspectRatio.value;
 	optSubtitles = options.subtitles.value;
 	optStereoSFX = options.stereoSFX.value;
+	optCompressSaves = options.compressSaves.value;
+	optSphereThreads = options.sphereThreads.value;
+	optSphereStats = options.sphereStats.value;
+	optResStats = options.resStats.value;
 	musicVolumeScale = options.musicVolumeScale.value;
 	sfxVolumeScale = options.sfxVolumeScale.value;
 	speechVolumeScale = options.speechVolumeScale.value;
@@ -404,6 +525,19 @@ main (int argc, char *argv[])
 #endif
 
 	InitTimeSystem ();
+
+	if (options.runMode == runMode_videoBenchmark)
+	{	// Only needs the content dirs, for the videos
+		int result = runVideoBenchmark (options.benchVideo);
+		UnInitTimeSystem ();
+		unprepareAllDirs ();
+		uninitIO ();
+		UnInitThreadSystem ();
+		mem_uninit ();
+		HFree (options.addons);
+		return result;
+	}
+
 	InitTaskSystem ();
 	
 	luaUqm_init ();
@@ -425,6 +559,7 @@ main (int argc, char *argv[])
 		gfxFlags |= TFB_GFXFLAGS_SCANLINES;
 	if (options.showFps.value)
 		gfxFlags |= TFB_GFXFLAGS_SHOWFPS;
+	TFB_SetScalerThreads (options.scalerThreads.value);
 	TFB_InitGraphics (gfxDriver, gfxFlags, options.graphicsBackend,
 			options.resolution.width, options.resolution.height);
 	if (options.gamma.set && setGammaCorrection (options.gamma.value))
@@ -465,6 +600,8 @@ main (int argc, char *argv[])
 		TFB_FlushGraphics ();
 	}
 
+	prof_stop ();
+
 	/* Currently, we use atexit() callbacks everywhere, so we
 	 *   cannot simply call unInitAudio() and the like, because other
 	 *   tasks might still be using it */
@@ -505,6 +642,48 @@ main (int argc, char *argv[])
 	return EXIT_SUCCESS;
 }
 
+// Benchmarks the Duck video decoder on 'file', or if that is NULL, on
+// the 3DO intro and ending videos, if they are there.
+static int
+runVideoBenchmark (const char *file)
+{
+	static const char *const defaultFiles[] = {
+		"addons/3dovideo/intro/intro.duk",
+		"addons/3dovideo/ending/victory.duk",
+	};
+	int result = EXIT_SUCCESS;
+	int numRun = 0;
+	size_t i;
+
+	if (file != NULL)
+	{
+		if (dukv_RunBenchmark (contentDir, file) != 0)
+			return EXIT_FAILURE;
+		return EXIT_SUCCESS;
+	}
+
+	for (i = 0; i < sizeof defaultFiles / sizeof defaultFiles[0]; ++i)
+	{
+		if (!fileExists2 (contentDir, defaultFiles[i]))
+		{
+			log_add (log_Warning, "'%s' not found; skipped. Is the "
+					"3dovideo addon installed?", defaultFiles[i]);
+			continue;
+		}
+		if (dukv_RunBenchmark (contentDir, defaultFiles[i]) != 0)
+			result = EXIT_FAILURE;
+		++numRun;
+	}
+
+	if (numRun == 0)
+	{
+		log_add (log_Error, "No videos to benchmark; use "
+				"--benchvideo=FILE.");
+		return EXIT_FAILURE;
+	}
+	return result;
+}
+
 static void
 saveErrorV (const char *fmt, va_list list)
 {
@@ -641,10 +820,24 @@ getUserConfigOptions (struct options_struct *options)
 	getBoolConfigValue (&options->opengl, "config.usegl");
 
 	getListConfigValue (&options->scaler, "config.scaler", scalerList);
+	if (res_IsInteger ("config.scalethreads") && !options->scalerThreads.set)
+	{
+		options->scalerThreads.value = res_GetInteger ("config.scalethreads");
+		options->scalerThreads.set = true;
+	}
 
 	getBoolConfigValue (&options->fullscreen, "config.fullscreen");
 	getBoolConfigValue (&options->scanlines, "config.scanlines");
 	getBoolConfigValue (&options->showFps, "config.showfps");
+	if (res_IsInteger ("config.spherethreads")
+			&& !options->sphereThreads.set)
+	{
+		options->sphereThreads.value =
+				res_GetInteger ("config.spherethreads");
+		options->sphereThreads.set = true;
+	}
+	getBoolConfigValue (&options->sphereStats, "config.spherestats");
+	getBoolConfigValue (&options->resStats, "config.resstats");
 	getBoolConfigValue (&options->keepAspectRatio, "config.keepaspectratio");
 	getGammaConfigValue (&options->gamma, "config.gamma");
 
@@ -675,6 +868,7 @@ getUserConfigOptions (struct options_struct *options)
 	getListConfigValue (&options->soundQuality, "config.audioquality",
 			audioQualityList);
 	getBoolConfigValue (&options->stereoSFX, "config.positionalsfx");
+	getBoolConfigValue (&options->compressSaves, "config.compresssaves");
 	getVolumeConfigValue (&options->musicVolumeScale, "config.musicvol");
 	getVolumeConfigValue (&options->sfxVolumeScale, "config.sfxvol");
 	getVolumeConfigValue (&options->speechVolumeScale, "config.speechvol");
@@ -718,12 +912,28 @@ enum
 	ACCEL_OPT,
 	SAFEMODE_OPT,
 	RENDERER_OPT,
+	SCALETHREADS_OPT,
+	BENCHGFX_OPT,
+	BENCHVIDEO_OPT,
+	BENCHSTARS_OPT,
+	CHECKMIXER_OPT,
+	PROFILE_OPT,
+	MELEESIM_OPT,
+	MELEEJOBS_OPT,
+	COMPRESSSAVES_OPT,
+	SPHERETHREADS_OPT,
+	SPHERESTATS_OPT,
+	RESSTATS_OPT,
 #ifdef NETPLAY
 	NETHOST1_OPT,
 	NETPORT1_OPT,
 	NETHOST2_OPT,
 	NETPORT2_OPT,
 	NETDELAY_OPT,
+	NETROLLBACK_OPT,
+	MELEEROLLBACK_OPT,
+	NETCHECKSUM_OPT,
+	BENCHCHECKSUM_OPT,
 #endif
 };
 
@@ -766,12 +976,28 @@ static struct option longOptions[] =
 	{"accel", 1, NULL, ACCEL_OPT},
 	{"safe", 0, NULL, SAFEMODE_OPT},
 	{"renderer", 1, NULL, RENDERER_OPT},
+	{"scalethreads", 1, NULL, SCALETHREADS_OPT},
+	{"benchgfx", 2, NULL, BENCHGFX_OPT},
+	{"benchvideo", 2, NULL, BENCHVIDEO_OPT},
+	{"benchstars", 2, NULL, BENCHSTARS_OPT},
+	{"checkmixer", 0, NULL, CHECKMIXER_OPT},
+	{"profile", 2, NULL, PROFILE_OPT},
+	{"meleesim", 1, NULL, MELEESIM_OPT},
+	{"meleejobs", 1, NULL, MELEEJOBS_OPT},
+	{"compresssaves", 0, NULL, COMPRESSSAVES_OPT},
+	{"spherethreads", 1, NULL, SPHERETHREADS_OPT},
+	{"spherestats", 0, NULL, SPHERESTATS_OPT},
+	{"resstats", 0, NULL, RESSTATS_OPT},
 #ifdef NETPLAY
 	{"nethost1", 1, NULL, NETHOST1_OPT},
 	{"netport1", 1, NULL, NETPORT1_OPT},
 	{"nethost2", 1, NULL, NETHOST2_OPT},
 	{"netport2", 1, NULL, NETPORT2_OPT},
 	{"netdelay", 1, NULL, NETDELAY_OPT},
+	{"netrollback", 0, NULL, NETROLLBACK_OPT},
+	{"meleerollback", 1, NULL, MELEEROLLBACK_OPT},
+	{"netchecksum", 1, NULL, NETCHECKSUM_OPT},
+	{"benchchecksum", 0, NULL, BENCHCHECKSUM_OPT},
 #endif
 	{0, 0, 0, 0}
 };
@@ -1033,6 +1259,33 @@ parseOptions (int argc, char *argv[], struct options_struct *options)
 			case STEREOSFX_OPT:
 				setBoolOption (&options->stereoSFX, true);
 				break;
+			case COMPRESSSAVES_OPT:
+				setBoolOption (&options->compressSaves, true);
+				break;
+			case SPHERETHREADS_OPT:
+			{
+				int temp;
+				if (parseIntOption (optarg, &temp, "sphere threads") == -1)
+				{
+					badArg = true;
+					break;
+				}
+				if (temp < 1)
+				{
+					InvalidArgument (optarg, "--spherethreads");
+					badArg = true;
+					break;
+				}
+				options->sphereThreads.value = temp;
+				options->sphereThreads.set = true;
+				break;
+			}
+			case SPHERESTATS_OPT:
+				setBoolOption (&options->sphereStats, true);
+				break;
+			case RESSTATS_OPT:
+				setBoolOption (&options->resStats, true);
+				break;
 			case ADDON_OPT:
 				options->numAddons++;
 				options->addons = HRealloc ((void *) options->addons,
@@ -1063,6 +1316,91 @@ parseOptions (int argc, char *argv[], struct options_struct *options)
 			case RENDERER_OPT:
 				options->graphicsBackend = optarg;
 				break;
+			case SCALETHREADS_OPT:
+			{
+				int temp;
+				if (parseIntOption (optarg, &temp, "scaler threads") == -1)
+				{
+					badArg = true;
+					break;
+				}
+				if (temp < 1)
+				{
+					InvalidArgument (optarg, "--scalethreads");
+					badArg = true;
+					break;
+				}
+				options->scalerThreads.value = temp;
+				options->scalerThreads.set = true;
+				break;
+			}
+			case BENCHGFX_OPT:
+				options->runMode = runMode_benchmark;
+				options->benchImage = optarg;
+				break;
+			case BENCHVIDEO_OPT:
+				options->runMode = runMode_videoBenchmark;
+				options->benchVideo = optarg;
+				break;
+			case CHECKMIXER_OPT:
+				options->runMode = runMode_mixerCheck;
+				break;
+			case BENCHSTARS_OPT:
+			{
+				int temp = STARBENCH_DEFAULT_STARS;
+				if (optarg && parseIntOption (optarg, &temp,
+						"number of stars") == -1)
+				{
+					badArg = true;
+					break;
+				}
+				if (temp < 1 || temp > 10000000)
+				{
+					InvalidArgument (optarg, "--benchstars");
+					badArg = true;
+					break;
+				}
+				options->runMode = runMode_starBenchmark;
+				options->benchStars = temp;
+				break;
+			}
+			case PROFILE_OPT:
+				options->profileFile = optarg ? optarg : "uqmtrace.json";
+				break;
+			case MELEESIM_OPT:
+			{
+				int temp;
+				if (parseIntOption (optarg, &temp, "melee battles") == -1)
+				{
+					badArg = true;
+					break;
+				}
+				if (temp < 1 || temp > (COUNT)~0)
+				{
+					InvalidArgument (optarg, "--meleesim");
+					badArg = true;
+					break;
+				}
+				options->meleeSimBattles = temp;
+				break;
+			}
+			case MELEEJOBS_OPT:
+			{
+				int temp;
+				if (parseIntOption (optarg, &temp, "melee jobs") == -1)
+				{
+					badArg = true;
+					break;
+				}
+				if (temp < 1 || temp > MELEESIM_MAX_JOBS)
+				{
+					InvalidArgument (optarg, "--meleejobs");
+					badArg = true;
+					break;
+				}
+				options->meleeSimJobs = temp;
+				break;
+			}
 #ifdef NETPLAY
 			case NETHOST1_OPT:
 				netplayOptions.peer[0].isServer = false;
@@ -1096,6 +1434,47 @@ parseOptions (int argc, char *argv[], struct options_struct *options)
 				}
 				break;
 			}
+			case NETROLLBACK_OPT:
+				netplayOptions.rollback = true;
+				break;
+			case MELEEROLLBACK_OPT:
+			{
+				int temp;
+				if (parseIntOption (optarg, &temp, "rollback test latency")
+						== -1)
+				{
+					badArg = true;
+					break;
+				}
+				if (temp < 0 || temp > BATTLE_FRAME_RATE)
+				{
+					InvalidArgument (optarg, "--meleerollback");
+					badArg = true;
+					break;
+				}
+				meleeSimRollback = TRUE;
+				meleeSimRollbackLatency = (COUNT) temp;
+				break;
+			}
+			case NETCHECKSUM_OPT:
+				if (!strcmp (optarg, "crc32"))
+				{
+					netplayOptions.checksumAlgorithms =
+							CRC_ALGORITHM_BIT (CrcAlgorithm_crc32);
+				}
+				else if (!strcmp (optarg, "crc32c"))
+				{
+					netplayOptions.checksumAlgorithms = CRC_ALGORITHMS_ALL;
+				}
+				else
+				{
+					InvalidArgument (optarg, "--netchecksum");
+					badArg = true;
+				}
+				break;
+			case BENCHCHECKSUM_OPT:
+				options->runMode = runMode_checksumBenchmark;
+				break;
 #endif
 			default:
 				saveError ("Error: Unknown option '%s'",
@@ -1199,6 +1578,8 @@ usage (FILE *out, const struct options_struct *defaults)
 			boolOptString (&defaults->keepAspectRatio));
 	log_add (log_User, "  -c, --scale=MODE (bilinear, biadapt, biadv, "
 			"triscan, hq or none (default) )");
+	log_add (log_User, "  --scalethreads=N (threads used by the scalers, "
+			"default 1)");
 	log_add (log_User, "  -b, --meleezoom=MODE (step, aka pc, or smooth, "
 			"aka 3do; default is 3do)");
 	log_add (log_User, "  -s, --scanlines (default %s)",
@@ -1228,6 +1609,39 @@ usage (FILE *out, const struct options_struct *defaults)
 	log_add (log_User, "  --stereosfx (enables positional sound effects, "
 			"currently only for openal)");
 	log_add (log_User, "  --safe (start in safe mode)");
+	log_add (log_User, "  --compresssaves (write save games "
+			"zlib-compressed; needs zip support)");
+	log_add (log_User, "  --spherethreads=N (threads used to render the "
+			"rotating planet, default 1)");
+	log_add (log_User, "  --spherestats (log the planet rotation render "
+			"time per frame; default %s)",
+			boolOptString (&defaults->sphereStats));
+	log_add (log_User, "  --resstats (log the time spent loading resources "
+			"on exit; default %s)", boolOptString (&defaults->resStats));
+	log_add (log_User, "  --profile[=FILE] (record where the time goes "
+			"in each thread, and write it as a Chrome trace to FILE, "
+			"default uqmtrace.json, on exit; in debug builds, the debug "
+			"key writes it too)");
+	log_add (log_User, "  --benchgfx[=FILE] (benchmark the software "
+			"scalers and blitters, optionally also on PNG image FILE, "
+			"check their output on synthetic images against the known "
+			"checksums and exit)");
+	log_add (log_User, "  --benchvideo[=FILE] (benchmark the 3DO video "
+			"pixel conversions on the intro and ending videos, or on "
+			"video FILE in the content dir, check them against the C "
+			"version and exit)");
+	log_add (log_User, "  --benchstars[=N] (benchmark the star index on "
+			"synthetic catalogues of the size of the game's and of N "
+			"stars, default %d, check it against a linear search and "
+			"exit)", STARBENCH_DEFAULT_STARS);
+	log_add (log_User, "  --checkmixer (mix test sounds with the audio "
+			"mixer and with its per-sample reference version, check that "
+			"they agree and exit)");
+	log_add (log_User, "  --meleesim=N (fight N headless computer-vs-"
+			"computer SuperMelee battles for every pair of ships, log the "
+			"results and exit)");
+	log_add (log_User, "  --meleejobs=N (split the --meleesim battles "
+			"over N processes; default 1)");
 #ifdef NETPLAY
 	log_add (log_User, "  --nethostN=HOSTNAME (server to connect to for "
 			"player N (1=bottom, 2=top)");
@@ -1235,6 +1649,18 @@ usage (FILE *out, const struct options_struct *defaults)
 			"player N (1=bottom, 2=top)");
 	log_add (log_User, "  --netdelay=FRAMES (number of frames to "
 			"buffer/delay network input for");
+	log_add (log_User, "  --netrollback (predict the network input "
+			"instead of waiting for it, and correct the battle when the "
+			"prediction was wrong)");
+	log_add (log_User, "  --meleerollback=FRAMES (with --meleesim: play "
+			"each battle in rollback mode with the top player's input "
+			"arriving FRAMES frames late, and check it against a replay "
+			"in lockstep)");
+	log_add (log_User, "  --netchecksum=crc32|crc32c (checksum for the "
+			"network sync checks; crc32c is used when both sides "
+			"support it, which is the default)");
+	log_add (log_User, "  --benchchecksum (benchmark the network sync "
+			"checksums and exit)");
 #endif
 	log_add (log_User, "The following options can take either '3do' or 'pc' "
 			"as an option:");
@@ -33,7 +33,9 @@
 #		include "supermelee/netplay/checksum.h"
 #	endif
 #	include "supermelee/netplay/notifyall.h"
+#	include "supermelee/netplay/rollback.h"
 #endif
+#include "supermelee/meleesim.h"
 #include "supermelee/pickmele.h"
 #include "resinst.h"
 #include "nameref.h"
@@ -141,6 +143,130 @@ frameInputHuman (HumanInputContext *context, STARSHIP *StarShipPtr)
 	return CurrentInputToBattleInput (context->playerNr);
 }
 
+static void
+ApplyShipInput (STARSHIP *StarShipPtr, size_t cur_player,
+		BATTLE_INPUT_STATE InputState, BOOLEAN CanRunAway)
+{
+	StarShipPtr->ship_input_state = 0;
+	if (StarShipPtr->RaceDescPtr->ship_info.crew_level)
+	{
+		if (InputState & BATTLE_LEFT)
+			StarShipPtr->ship_input_state |= LEFT;
+		else if (InputState & BATTLE_RIGHT)
+			StarShipPtr->ship_input_state |= RIGHT;
+		if (InputState & BATTLE_THRUST)
+			StarShipPtr->ship_input_state |= THRUST;
+		if (InputState & BATTLE_WEAPON)
+			StarShipPtr->ship_input_state |= WEAPON;
+		if (InputState & BATTLE_SPECIAL)
+			StarShipPtr->ship_input_state |= SPECIAL;
+
+		if (CanRunAway && cur_player == 0 &&
+				(InputState & BATTLE_ESCAPE))
+			DoRunAway (StarShipPtr);
+	}
+}
+
+#ifdef NETPLAY
+// Apply the given input of each side to its ships. Used in rollback mode,
+// where the input of a frame is known before the frame is played, and
+// frames may be played more than once.
+void
+ApplyBattleInputs (const BATTLE_INPUT_STATE *input)
+{
+	BOOLEAN CanRunAway;
+	size_t sideI;
+
+	CanRunAway = RunAwayAllowed ();
+
+	for (sideI = 0; sideI < NUM_SIDES; sideI++)
+	{
+		HSTARSHIP hBattleShip, hNextShip;
+		size_t cur_player = battleInputOrder[sideI];
+
+		for (hBattleShip = GetHeadLink (&race_q[cur_player]);
+				hBattleShip != 0; hBattleShip = hNextShip)
+		{
+			STARSHIP *StarShipPtr;
+
+			StarShipPtr = LockStarShip (&race_q[cur_player], hBattleShip);
+			hNextShip = _GetSuccLink (StarShipPtr);
+
+			if (StarShipPtr->hShip)
+			{
+				StarShipPtr->control = PlayerControl[cur_player];
+				ApplyShipInput (StarShipPtr, cur_player, input[cur_player],
+						CanRunAway);
+			}
+
+			UnlockStarShip (&race_q[cur_player], hBattleShip);
+		}
+	}
+}
+
+// The rollback counterpart of the loop in ProcessInput().
+// The local input is sent as usual, but instead of waiting for the
+// input of the remote side, its input is predicted.
+static void
+ProcessRollbackInput (void)
+{
+	BATTLE_INPUT_STATE input[NUM_SIDES];
+	size_t sideI;
+
+	if (Rollback_startLocalInput ())
+	{
+		// This is the first time the current frame is played.
+		for (sideI = 0; sideI < NUM_SIDES; sideI++)
+		{
+			HSTARSHIP hBattleShip, hNextShip;
+			size_t cur_player = battleInputOrder[sideI];
+
+			if (PlayerControl[cur_player] & NETWORK_CONTROL)
+				continue;
+
+			for (hBattleShip = GetHeadLink (&race_q[cur_player]);
+					hBattleShip != 0; hBattleShip = hNextShip)
+			{
+				BATTLE_INPUT_STATE InputState;
+				STARSHIP *StarShipPtr;
+				BattleInputBuffer *bib;
+
+				StarShipPtr = LockStarShip (&race_q[cur_player], hBattleShip);
+				hNextShip = _GetSuccLink (StarShipPtr);
+
+				if (StarShipPtr->hShip)
+				{
+					StarShipPtr->control = PlayerControl[cur_player];
+
+					InputState = PlayerInput[cur_player]->handlers->
+							frameInput (PlayerInput[cur_player], StarShipPtr);
+
+#if CREATE_JOURNAL
+					JournalInput (InputState);
+#endif /* CREATE_JOURNAL */
+					bib = getBattleInputBuffer(cur_player);
+					Netplay_NotifyAll_battleInput (InputState);
+
+					BattleInputBuffer_push (bib, InputState);
+					BattleInputBuffer_pop (bib, &InputState);
+					Rollback_setInput (cur_player, InputState);
+				}
+
+				UnlockStarShip (&race_q[cur_player], hBattleShip);
+			}
+		}
+	}
+
+	if (!Rollback_beginFrame ())
+		return;
+			// CHECK_ABORT has been set.
+
+	for (sideI = 0; sideI < NUM_SIDES; sideI++)
+		input[sideI] = Rollback_getInput (sideI);
+	ApplyBattleInputs (input);
+}
+#endif
+
 static void
 ProcessInput (void)
 {
@@ -148,7 +274,18 @@ ProcessInput (void)
 	size_t sideI;
 
 #ifdef NETPLAY
-	netInput ();
+	if (Rollback_active ())
+	{
+		ProcessRollbackInput ();
+		flushPacketQueues ();
+				// Anything that waits for the remote side flushes first
+				// (through netInput()); otherwise all that was queued in
+				// this frame goes out here, in one go.
+
+		if (GLOBAL (CurrentActivity) & (CHECK_LOAD | CHECK_ABORT))
+			GLOBAL (CurrentActivity) &= ~IN_BATTLE;
+		return;
+	}
 #endif
 
 	CanRunAway = RunAwayAllowed ();
@@ -184,7 +321,8 @@ ProcessInput (void)
 				{
 					BattleInputBuffer *bib = getBattleInputBuffer(cur_player);
 					Netplay_NotifyAll_battleInput (InputState);
-					flushPacketQueues ();
+							// Flushed at the end of the frame, or when
+							// waiting for a network controlled side.
 
 					BattleInputBuffer_push (bib, InputState);
 							// Add this input to the end of the buffer.
@@ -193,24 +331,8 @@ ProcessInput (void)
 				}
 #endif
 
-				StarShipPtr->ship_input_state = 0;
-				if (StarShipPtr->RaceDescPtr->ship_info.crew_level)
-				{
-					if (InputState & BATTLE_LEFT)
-						StarShipPtr->ship_input_state |= LEFT;
-					else if (InputState & BATTLE_RIGHT)
-						StarShipPtr->ship_input_state |= RIGHT;
-					if (InputState & BATTLE_THRUST)
-						StarShipPtr->ship_input_state |= THRUST;
-					if (InputState & BATTLE_WEAPON)
-						StarShipPtr->ship_input_state |= WEAPON;
-					if (InputState & BATTLE_SPECIAL)
-						StarShipPtr->ship_input_state |= SPECIAL;
-
-					if (CanRunAway && cur_player == 0 &&
-							(InputState & BATTLE_ESCAPE))
-						DoRunAway (StarShipPtr);
-				}
+				ApplyShipInput (StarShipPtr, cur_player, InputState,
+						CanRunAway);
 			}
 
 			UnlockStarShip (&race_q[cur_player], hBattleShip);
@@ -264,40 +386,31 @@ DoBattle (BATTLE_STATE *bs)
 
 	SetMenuSounds (MENU_SOUND_NONE, MENU_SOUND_NONE);
 
+#ifdef NETPLAY
+	netInput ();
+#endif
 #if defined (NETPLAY) && defined (NETPLAY_CHECKSUM)
-	if (getNumNetConnections() > 0 &&
+	// In rollback mode, the checksum of a frame is sent once the state
+	// is final, from Rollback_beginFrame().
+	if (getNumNetConnections() > 0 && !Rollback_active () &&
 			battleFrameCount % NETPLAY_CHECKSUM_INTERVAL == 0)
 	{
-		crc_State state;
-		Checksum checksum;
-
-		crc_init(&state);
-		crc_processState (&state);
-		checksum = (Checksum) crc_finish (&state);
+		Checksum checksum = getStateChecksum ();
 
 		Netplay_NotifyAll_checksum ((uint32) battleFrameCount,
 				(uint32) checksum);
-		flushPacketQueues ();
+				// Sent along with the input of this frame.
 		addLocalChecksum (battleFrameCount, checksum);
 	}
 #endif
 	ProcessInput ();
-			// Also calls NetInput()
 #if defined (NETPLAY) && defined (NETPLAY_CHECKSUM)
-	if (getNumNetConnections() > 0)
+	if (getNumNetConnections() > 0
+			&& !(GLOBAL (CurrentActivity) & CHECK_ABORT))
 	{
-		size_t delay = getBattleInputDelay();
-
-		if (battleFrameCount >= delay
-				&& (battleFrameCount - delay) % NETPLAY_CHECKSUM_INTERVAL == 0)
-		{
-			if (!(GLOBAL (CurrentActivity) & CHECK_ABORT))
-			{
-				if (!verifyChecksums (battleFrameCount - delay)) {
-					GLOBAL(CurrentActivity) |= CHECK_ABORT;
-					resetConnections (ResetReason_syncLoss);
-				}
-			}
+		if (!verifyDueChecksums ()) {
+			GLOBAL(CurrentActivity) |= CHECK_ABORT;
+			resetConnections (ResetReason_syncLoss);
 		}
 	}
 #endif
@@ -334,7 +447,8 @@ DoBattle (BATTLE_STATE *bs)
 	if (battle_speed == (BYTE)~0)
 	{	// maximum speed, nothing rendered at all
 		Async_process ();
-		TaskSwitch ();
+		if (!meleeSimActive)
+			TaskSwitch ();
 	}
 	else
 	{
@@ -396,7 +510,9 @@ BOOLEAN
 Battle (BattleFrameCallback *callback)
 {
 	SIZE num_ships;
-
+#ifdef NETPLAY
+	bool netRollback = false;
+#endif
 
 #if !(DEMO_MODE || CREATE_JOURNAL)
 	if (LOBYTE (GLOBAL (CurrentActivity)) != SUPER_MELEE) {
@@ -460,6 +576,8 @@ Battle (BattleFrameCallback *callback)
 				goto AbortBattle;
 			}
 		}
+		netRollback = initBattleRollback ();
+		startBattleStatistics ();
 #endif  /* NETPLAY */
 		bs.InputFunc = DoBattle;
 		bs.frame_cb = callback;
@@ -491,6 +609,9 @@ AbortBattle:
 		}
 
 #ifdef NETPLAY
+		reportBattleStatistics (battleFrameCount);
+		if (netRollback)
+			Rollback_uninit ();
 		uninitBattleInputBuffers();
 #ifdef NETPLAY_CHECKSUM
 		uninitChecksumBuffers ();
@@ -25,6 +25,8 @@ typedef DWORD BattleFrameCounter;
 
 #include "init.h"
 		// For NUM_SIDES
+#include "controls.h"
+		// For BATTLE_INPUT_STATE
 
 #if defined(__cplusplus)
 extern "C" {
@@ -53,6 +55,9 @@ COUNT GetPlayerOrder (COUNT i);
 #endif
 
 BOOLEAN Battle (BattleFrameCallback *);
+#ifdef NETPLAY
+void ApplyBattleInputs (const BATTLE_INPUT_STATE *input);
+#endif
 
 #define BATTLE_FRAME_RATE (ONE_SECOND / 24)
 
@@ -0,0 +1,272 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "battlesnap.h"
+
+#include "battle.h"
+#include "broadphase.h"
+#include "displist.h"
+#include "element.h"
+#include "globdata.h"
+#include "init.h"
+#include "process.h"
+#include "races.h"
+#include "setup.h"
+#include "status.h"
+#include "tactrans.h"
+#include "units.h"
+#include "libs/mathlib.h"
+#include "libs/memlib.h"
+
+#include <string.h>
+
+
+typedef struct
+{
+	RACE_DESC *RaceDescPtr;
+	SIZE playerNr;
+	RACE_DESC desc;
+	BYTE *data;
+			// Copy of desc.data
+	size_t data_alloc;
+} SHIP_SNAPSHOT;
+
+struct battle_snapshot
+{
+	QUEUE_SNAPSHOT *disp_q;
+	DISPLAY_SNAPSHOT *display;
+	QUEUE_SNAPSHOT *race_q[NUM_PLAYERS];
+	SHIP_SNAPSHOT ships[NUM_PLAYERS * MAX_SHIPS_PER_SIDE];
+	COUNT num_ships;
+	DWORD seed;
+	BYTE battle_counter[NUM_SIDES];
+	STARSHIP *winner;
+};
+
+
+BATTLE_SNAPSHOT *
+CreateBattleSnapshot (void)
+{
+	BATTLE_SNAPSHOT *snap;
+	COUNT i;
+
+	snap = HCalloc (sizeof (*snap));
+	if (!snap)
+		return NULL;
+
+	snap->disp_q = CreateQueueSnapshot ();
+	snap->display = CreateDisplaySnapshot ();
+	if (!snap->disp_q || !snap->display)
+		goto fail;
+	for (i = 0; i < NUM_PLAYERS; ++i)
+	{
+		snap->race_q[i] = CreateQueueSnapshot ();
+		if (!snap->race_q[i])
+			goto fail;
+	}
+
+	return snap;
+
+fail:
+	DestroyBattleSnapshot (snap);
+	return NULL;
+}
+
+void
+DestroyBattleSnapshot (BATTLE_SNAPSHOT *snap)
+{
+	COUNT i;
+
+	if (!snap)
+		return;
+
+	DestroyQueueSnapshot (snap->disp_q);
+	DestroyDisplaySnapshot (snap->display);
+	for (i = 0; i < NUM_PLAYERS; ++i)
+		DestroyQueueSnapshot (snap->race_q[i]);
+	for (i = 0; i < NUM_PLAYERS * MAX_SHIPS_PER_SIDE; ++i)
+		HFree (snap->ships[i].data);
+	HFree (snap);
+}
+
+static BOOLEAN
+SaveShip (SHIP_SNAPSHOT *ss, STARSHIP *StarShipPtr)
+{
+	RACE_DESC *RDPtr = StarShipPtr->RaceDescPtr;
+
+	ss->RaceDescPtr = RDPtr;
+	ss->playerNr = StarShipPtr->playerNr;
+	ss->desc = *RDPtr;
+
+	if (RDPtr->data && RDPtr->data_size)
+	{
+		if (RDPtr->data_size > ss->data_alloc)
+		{
+			BYTE *data = HRealloc (ss->data, RDPtr->data_size);
+			if (!data)
+				return FALSE;
+			ss->data = data;
+			ss->data_alloc = RDPtr->data_size;
+		}
+		memcpy (ss->data, RDPtr->data, RDPtr->data_size);
+	}
+
+	return TRUE;
+}
+
+static void
+RestoreShip (const SHIP_SNAPSHOT *ss)
+{
+	RACE_DESC *RDPtr = ss->RaceDescPtr;
+	SHIP_INFO *ShipInfoPtr = &RDPtr->ship_info;
+	void *data = RDPtr->data;
+	size_t data_size = RDPtr->data_size;
+
+	// The gauges are drawn incrementally; bring them to the old levels.
+	DeltaStatistics (ShipInfoPtr, status_y_offsets[ss->playerNr],
+			(SIZE)ss->desc.ship_info.crew_level - ShipInfoPtr->crew_level,
+			(SIZE)ss->desc.ship_info.energy_level
+			- ShipInfoPtr->energy_level);
+
+	*RDPtr = ss->desc;
+
+	// The ship code may have replaced its data since, and freed what
+	// the copied pointer points to. Keep what is there now.
+	if (ss->desc.data && ss->desc.data_size)
+	{
+		if (!data || data_size != ss->desc.data_size)
+		{
+			HFree (data);
+			data = HMalloc (ss->desc.data_size);
+		}
+		memcpy (data, ss->data, ss->desc.data_size);
+		data_size = ss->desc.data_size;
+	}
+	else if (!ss->desc.data)
+	{
+		HFree (data);
+		data = NULL;
+		data_size = 0;
+	}
+	// else: data of unknown size, which is left as it is.
+
+	RDPtr->data = data;
+	RDPtr->data_size = data_size;
+}
+
+BOOLEAN
+SaveBattleSnapshot (BATTLE_SNAPSHOT *snap)
+{
+	COUNT i;
+
+	if (!SnapshotQueue (&disp_q, snap->disp_q)
+			|| !SnapshotDisplayList (snap->display))
+		return FALSE;
+
+	snap->num_ships = 0;
+	for (i = 0; i < NUM_PLAYERS; ++i)
+	{
+		HSTARSHIP hStarShip, hNextShip;
+
+		if (!SnapshotQueue (&race_q[i], snap->race_q[i]))
+			return FALSE;
+
+		for (hStarShip = GetHeadLink (&race_q[i]); hStarShip;
+				hStarShip = hNextShip)
+		{
+			STARSHIP *StarShipPtr;
+			BOOLEAN ok = TRUE;
+
+			StarShipPtr = LockStarShip (&race_q[i], hStarShip);
+			hNextShip = _GetSuccLink (StarShipPtr);
+			if (StarShipPtr->RaceDescPtr)
+				ok = SaveShip (&snap->ships[snap->num_ships++], StarShipPtr);
+			UnlockStarShip (&race_q[i], hStarShip);
+
+			if (!ok)
+				return FALSE;
+		}
+	}
+
+	snap->seed = TFB_SeedRandom (0);
+	TFB_SeedRandom (snap->seed);
+	memcpy (snap->battle_counter, battle_counter, sizeof battle_counter);
+	snap->winner = GetWinnerStarShip ();
+
+	return TRUE;
+}
+
+void
+RestoreBattleSnapshot (const BATTLE_SNAPSHOT *snap)
+{
+	CONTEXT OldContext;
+	COUNT i;
+
+	RestoreQueue (&disp_q, snap->disp_q);
+	RestoreDisplayList (snap->display);
+	for (i = 0; i < NUM_PLAYERS; ++i)
+		RestoreQueue (&race_q[i], snap->race_q[i]);
+
+	OldContext = SetContext (StatusContext);
+	for (i = 0; i < snap->num_ships; ++i)
+		RestoreShip (&snap->ships[i]);
+	SetContext (OldContext);
+
+	TFB_SeedRandom (snap->seed);
+	memcpy (battle_counter, snap->battle_counter, sizeof battle_counter);
+	ResetWinnerStarShip ();
+	SetWinnerStarShip (snap->winner);
+
+	InvalidateBroadphase ();
+}
+
+// The frames that cannot be taken back are those in which a ship may be
+// destroyed or replaced (which involves the ship selection, and the
+// other side in a network game), or in which the battle may end.
+BOOLEAN
+BattleFrameReversible (void)
+{
+	HELEMENT hElement, hNextElement;
+	COUNT numShips = 0;
+
+	if (GLOBAL (CurrentActivity) & (CHECK_ABORT | CHECK_LOAD))
+		return FALSE;
+	if (GetWinnerStarShip () != NULL)
+		return FALSE;
+
+	for (hElement = GetHeadElement (); hElement; hElement = hNextElement)
+	{
+		ELEMENT *ElementPtr;
+		BOOLEAN settled = TRUE;
+
+		LockElement (hElement, &ElementPtr);
+		hNextElement = GetSuccElement (ElementPtr);
+		if (ElementPtr->state_flags & PLAYER_SHIP)
+		{
+			++numShips;
+			settled = ElementPtr->crew_level != 0
+					&& ElementPtr->life_span != 0
+					&& !(ElementPtr->state_flags
+					& (APPEARING | DISAPPEARING));
+		}
+		UnlockElement (hElement);
+
+		if (!settled)
+			return FALSE;
+	}
+
+	return numShips == NUM_SIDES;
+}
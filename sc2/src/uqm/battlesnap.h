@@ -0,0 +1,54 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef UQM_BATTLESNAP_H_
+#define UQM_BATTLESNAP_H_
+
+#include "libs/compiler.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Snapshots of the state of a battle, so that the battle can be taken
+// back to an earlier frame and played again from there.
+//
+// A snapshot holds everything a battle frame changes: the elements in
+// the disp_q (what crc_processState() checksums) and their display
+// primitives, the STARSHIPs in the race_q and their RACE_DESCs (with the
+// private ship data), the RNG seed, the ships left to each side, the
+// winner of the battle and the view (scroll position and zoom).
+//
+// Restoring a snapshot is only valid if no ship has been added to or
+// removed from the battle since it was taken; BattleFrameReversible()
+// tells whether the next frame may be taken back. The sounds played and
+// whatever was drawn in the frames taken back are not undone, except for
+// the crew and energy gauges in the status area.
+
+typedef struct battle_snapshot BATTLE_SNAPSHOT;
+
+extern BATTLE_SNAPSHOT *CreateBattleSnapshot (void);
+extern void DestroyBattleSnapshot (BATTLE_SNAPSHOT *snap);
+extern BOOLEAN SaveBattleSnapshot (BATTLE_SNAPSHOT *snap);
+extern void RestoreBattleSnapshot (const BATTLE_SNAPSHOT *snap);
+
+extern BOOLEAN BattleFrameReversible (void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif  /* UQM_BATTLESNAP_H_ */
@@ -0,0 +1,423 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "broadphase.h"
+
+#include "collide.h"
+#include "libs/graphics/drawable.h"
+#include "libs/memlib.h"
+#include "libs/log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+//#define DEBUG_BROADPHASE
+
+// Each cell is 64x64 display pixels. The grid itself is 64x64 cells and
+// is indexed modulo its size, which folds both the wrapping arena and
+// any out-of-range coordinates onto it. Folding can only add candidates,
+// never lose them.
+#define CELL_SHIFT 6
+#define GRID_SHIFT 6
+#define GRID_DIM (1 << GRID_SHIFT)
+#define GRID_MASK (GRID_DIM - 1)
+		// Added to coordinates before shifting so that the shift never
+		// sees a negative value. A multiple of the grid span, so it does
+		// not change which cell a coordinate hashes to.
+#define COORD_BIAS (1 << 20)
+
+#define NO_ENTRY ((DWORD)~0)
+
+typedef struct
+{
+	int left, top, right, bottom;
+} BP_BOX;
+
+typedef struct
+{
+	COUNT ordinal;
+			// Position of the element in disp_q at build time
+	DWORD next;
+			// Next entry in the same cell
+} BP_ENTRY;
+
+static BOOLEAN bp_active;
+		// Set between BeginBroadphase() and EndBroadphase()
+static BOOLEAN bp_valid;
+static BOOLEAN bp_disabled;
+		// Not worth (or not possible) using the grid for this frame
+static DWORD bp_generation;
+
+static DWORD bp_cells[GRID_DIM * GRID_DIM];
+static BP_ENTRY *bp_entries;
+static DWORD bp_num_entries;
+static DWORD bp_max_entries;
+
+		// All of these are indexed by ordinal
+static HELEMENT *bp_elements;
+static BP_BOX *bp_boxes;
+static DWORD *bp_marks;
+static COUNT *bp_found;
+static HELEMENT *bp_candidates;
+static COUNT bp_max_elements;
+static DWORD bp_stamp;
+
+		// Maps a disp_q link index to the ordinal of the element
+static COUNT *bp_slot_ordinal;
+static COUNT bp_num_slots;
+
+
+// The box DrawablesIntersect() sweeps the element's intersect frame over,
+// padded by a pixel. Returns FALSE for elements DrawablesIntersect()
+// always rejects.
+static BOOLEAN
+GetSweptBox (const ELEMENT *ElementPtr, BP_BOX *pBox)
+{
+	const INTERSECT_CONTROL *pControl;
+	FRAME FramePtr;
+	int x0, y0, x1, y1;
+
+	pControl = &ElementPtr->IntersectControl;
+	FramePtr = pControl->IntersectStamp.frame;
+	if (FramePtr == 0)
+		return FALSE;
+
+	x0 = pControl->IntersectStamp.origin.x - FramePtr->HotSpot.x;
+	y0 = pControl->IntersectStamp.origin.y - FramePtr->HotSpot.y;
+	x1 = pControl->EndPoint.x - FramePtr->HotSpot.x;
+	y1 = pControl->EndPoint.y - FramePtr->HotSpot.y;
+
+	pBox->left = (x0 < x1 ? x0 : x1) - 1;
+	pBox->top = (y0 < y1 ? y0 : y1) - 1;
+	pBox->right = (x0 < x1 ? x1 : x0) + GetFrameWidth (FramePtr);
+	pBox->bottom = (y0 < y1 ? y1 : y0) + GetFrameHeight (FramePtr);
+
+	return TRUE;
+}
+
+static inline BOOLEAN
+BoxesOverlap (const BP_BOX *pBox0, const BP_BOX *pBox1)
+{
+	return pBox0->left <= pBox1->right && pBox1->left <= pBox0->right
+			&& pBox0->top <= pBox1->bottom && pBox1->top <= pBox0->bottom;
+}
+
+static void
+GetCellSpan (const BP_BOX *pBox, COUNT *px, COUNT *py, COUNT *pnx,
+		COUNT *pny)
+{
+	int x0, y0, x1, y1;
+
+	x0 = (pBox->left + COORD_BIAS) >> CELL_SHIFT;
+	y0 = (pBox->top + COORD_BIAS) >> CELL_SHIFT;
+	x1 = (pBox->right + COORD_BIAS) >> CELL_SHIFT;
+	y1 = (pBox->bottom + COORD_BIAS) >> CELL_SHIFT;
+
+	*px = (COUNT)(x0 & GRID_MASK);
+	*py = (COUNT)(y0 & GRID_MASK);
+	*pnx = (COUNT)(x1 - x0 >= GRID_DIM ? GRID_DIM : x1 - x0 + 1);
+	*pny = (COUNT)(y1 - y0 >= GRID_DIM ? GRID_DIM : y1 - y0 + 1);
+}
+
+static BOOLEAN
+GrowElementArrays (COUNT num_elements)
+{
+	COUNT num_slots;
+
+	num_slots = GetQueueCapacity (&disp_q) + 1;
+	if (num_slots > bp_num_slots)
+	{
+		COUNT *slots = HRealloc (bp_slot_ordinal,
+				num_slots * sizeof (*slots));
+		if (!slots)
+			return FALSE;
+		bp_slot_ordinal = slots;
+		bp_num_slots = num_slots;
+	}
+
+	if (num_elements > bp_max_elements)
+	{
+		HELEMENT *elements;
+		BP_BOX *boxes;
+		DWORD *marks;
+		COUNT *found;
+		HELEMENT *candidates;
+
+		elements = HRealloc (bp_elements, num_elements * sizeof (*elements));
+		if (elements)
+			bp_elements = elements;
+		boxes = HRealloc (bp_boxes, num_elements * sizeof (*boxes));
+		if (boxes)
+			bp_boxes = boxes;
+		marks = HRealloc (bp_marks, num_elements * sizeof (*marks));
+		if (marks)
+			bp_marks = marks;
+		found = HRealloc (bp_found, num_elements * sizeof (*found));
+		if (found)
+			bp_found = found;
+		candidates = HRealloc (bp_candidates,
+				num_elements * sizeof (*candidates));
+		if (candidates)
+			bp_candidates = candidates;
+
+		if (!elements || !boxes || !marks || !found || !candidates)
+			return FALSE;
+		bp_max_elements = num_elements;
+	}
+
+	return TRUE;
+}
+
+static BOOLEAN
+AddEntry (COUNT cell, COUNT ordinal)
+{
+	if (bp_num_entries == bp_max_entries)
+	{
+		DWORD max_entries;
+		BP_ENTRY *entries;
+
+		max_entries = bp_max_entries ? bp_max_entries << 1 : 1024;
+		entries = HRealloc (bp_entries, max_entries * sizeof (*entries));
+		if (!entries)
+			return FALSE;
+		bp_entries = entries;
+		bp_max_entries = max_entries;
+	}
+
+	bp_entries[bp_num_entries].ordinal = ordinal;
+	bp_entries[bp_num_entries].next = bp_cells[cell];
+	bp_cells[cell] = bp_num_entries;
+	++bp_num_entries;
+
+	return TRUE;
+}
+
+void
+BeginBroadphase (void)
+{
+	bp_active = TRUE;
+	bp_disabled = FALSE;
+	InvalidateBroadphase ();
+}
+
+void
+EndBroadphase (void)
+{
+	InvalidateBroadphase ();
+	bp_active = FALSE;
+}
+
+void
+InvalidateBroadphase (void)
+{
+	if (bp_valid)
+	{
+		bp_valid = FALSE;
+		++bp_generation;
+	}
+}
+
+BOOLEAN
+BroadphaseValid (void)
+{
+	return bp_valid;
+}
+
+DWORD
+GetBroadphaseGeneration (void)
+{
+	return bp_generation;
+}
+
+// Fails if any element still has to be visited by a queue walk to get
+// PreProcess()ed, as the grid cannot stand in for that.
+BOOLEAN
+BuildBroadphase (ELEMENT_FLAGS process_flags)
+{
+	HELEMENT hElement, hNextElement;
+	COUNT num_elements;
+
+	if (!bp_active || bp_disabled)
+		return FALSE;
+
+	num_elements = 0;
+	for (hElement = GetHeadElement (); hElement; hElement = hNextElement)
+	{
+		ELEMENT *ElementPtr;
+		BOOLEAN processed;
+
+		LockElement (hElement, &ElementPtr);
+		processed = (ElementPtr->state_flags & process_flags) != 0;
+		hNextElement = GetSuccElement (ElementPtr);
+		UnlockElement (hElement);
+
+		if (!processed)
+			return FALSE;
+		++num_elements;
+	}
+
+	if (num_elements < BROADPHASE_MIN_ELEMENTS
+			|| !GrowElementArrays (num_elements))
+	{
+		bp_disabled = TRUE;
+		return FALSE;
+	}
+
+	memset (bp_cells, 0xff, sizeof (bp_cells));
+	memset (bp_marks, 0, num_elements * sizeof (*bp_marks));
+	bp_num_entries = 0;
+	bp_stamp = 0;
+
+	num_elements = 0;
+	for (hElement = GetHeadElement (); hElement; hElement = hNextElement)
+	{
+		ELEMENT *ElementPtr;
+		COUNT ordinal;
+
+		LockElement (hElement, &ElementPtr);
+		hNextElement = GetSuccElement (ElementPtr);
+
+		ordinal = num_elements++;
+		bp_elements[ordinal] = hElement;
+		bp_slot_ordinal[GetLinkIndex (&disp_q, hElement)] = ordinal;
+
+		if (CollidingElement (ElementPtr)
+				&& GetSweptBox (ElementPtr, &bp_boxes[ordinal]))
+		{
+			COUNT x, y, nx, ny, i, j;
+
+			GetCellSpan (&bp_boxes[ordinal], &x, &y, &nx, &ny);
+			for (j = 0; j < ny; ++j)
+			{
+				COUNT row = ((y + j) & GRID_MASK) << GRID_SHIFT;
+
+				for (i = 0; i < nx; ++i)
+				{
+					if (!AddEntry (row | ((x + i) & GRID_MASK), ordinal))
+					{
+						UnlockElement (hElement);
+						bp_disabled = TRUE;
+						return FALSE;
+					}
+				}
+			}
+		}
+
+		UnlockElement (hElement);
+	}
+
+#ifdef DEBUG_BROADPHASE
+	log_add (log_Debug, "BuildBroadphase: %u elements, %u entries",
+			num_elements, bp_num_entries);
+#endif /* DEBUG_BROADPHASE */
+
+	bp_valid = TRUE;
+	++bp_generation;
+
+	return TRUE;
+}
+
+static int
+CompareOrdinals (const void *p0, const void *p1)
+{
+	return (int)*(const COUNT *)p0 - (int)*(const COUNT *)p1;
+}
+
+// Returns the elements from hStartElement to the end of the queue that
+// may collide with ElementPtr, in queue order. The returned array is
+// only good until the next query or rebuild.
+COUNT
+QueryBroadphase (HELEMENT hStartElement, ELEMENT *ElementPtr,
+		HELEMENT **pCandidates)
+{
+	BP_BOX box;
+	COUNT start, x, y, nx, ny, i, j;
+	COUNT num_found;
+
+	*pCandidates = bp_candidates;
+
+	assert (bp_valid);
+	if (hStartElement == 0 || !GetSweptBox (ElementPtr, &box))
+		return 0;
+
+	start = bp_slot_ordinal[GetLinkIndex (&disp_q, hStartElement)];
+	if (++bp_stamp == 0)
+	{
+		memset (bp_marks, 0, bp_max_elements * sizeof (*bp_marks));
+		bp_stamp = 1;
+	}
+
+	num_found = 0;
+	GetCellSpan (&box, &x, &y, &nx, &ny);
+	for (j = 0; j < ny; ++j)
+	{
+		COUNT row = ((y + j) & GRID_MASK) << GRID_SHIFT;
+
+		for (i = 0; i < nx; ++i)
+		{
+			DWORD entry;
+
+			for (entry = bp_cells[row | ((x + i) & GRID_MASK)];
+					entry != NO_ENTRY; entry = bp_entries[entry].next)
+			{
+				COUNT ordinal = bp_entries[entry].ordinal;
+
+				if (ordinal < start || bp_marks[ordinal] == bp_stamp)
+					continue;
+
+				bp_marks[ordinal] = bp_stamp;
+				if (BoxesOverlap (&box, &bp_boxes[ordinal]))
+					bp_found[num_found++] = ordinal;
+			}
+		}
+	}
+
+	if (num_found > 1)
+		qsort (bp_found, num_found, sizeof (*bp_found), CompareOrdinals);
+	for (i = 0; i < num_found; ++i)
+		bp_candidates[i] = bp_elements[bp_found[i]];
+
+	return num_found;
+}
+
+void
+UninitBroadphase (void)
+{
+	bp_active = FALSE;
+	bp_valid = FALSE;
+
+	HFree (bp_entries);
+	bp_entries = NULL;
+	bp_num_entries = 0;
+	bp_max_entries = 0;
+
+	HFree (bp_elements);
+	bp_elements = NULL;
+	HFree (bp_boxes);
+	bp_boxes = NULL;
+	HFree (bp_marks);
+	bp_marks = NULL;
+	HFree (bp_found);
+	bp_found = NULL;
+	HFree (bp_candidates);
+	bp_candidates = NULL;
+	bp_max_elements = 0;
+
+	HFree (bp_slot_ordinal);
+	bp_slot_ordinal = NULL;
+	bp_num_slots = 0;
+}
@@ -0,0 +1,61 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef UQM_BROADPHASE_H_
+#define UQM_BROADPHASE_H_
+
+#include "element.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Broadphase for the collision pass in ProcessCollisions().
+//
+// The display queue is bucketed into a uniform grid (hashed onto a
+// power-of-two table, so the wrapping arena folds onto itself) by the
+// swept bounding box that DrawablesIntersect() would consider for each
+// element. A query returns, in display queue order, only the elements
+// whose boxes could overlap the box of the queried element. Every other
+// element of the walk would have been rejected by DrawablesIntersect()
+// without side effects on the simulation, so the collision order, and
+// with it the netplay checksum, is unchanged.
+//
+// The grid is only valid while nothing that could change the state of
+// any element has happened since it was built. PreProcess() and the
+// collision resolution code call InvalidateBroadphase() before touching
+// anything; walks in progress notice this through the generation number
+// and fall back to walking the queue.
+
+// Below this many elements, a linear walk is cheaper than the grid.
+#define BROADPHASE_MIN_ELEMENTS 32
+
+extern void BeginBroadphase (void);
+extern void EndBroadphase (void);
+extern BOOLEAN BuildBroadphase (ELEMENT_FLAGS process_flags);
+extern void InvalidateBroadphase (void);
+extern void UninitBroadphase (void);
+
+extern BOOLEAN BroadphaseValid (void);
+extern DWORD GetBroadphaseGeneration (void);
+extern COUNT QueryBroadphase (HELEMENT hStartElement, ELEMENT *ElementPtr,
+		HELEMENT **pCandidates);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* UQM_BROADPHASE_H_ */
@@ -62,6 +62,7 @@ extern COUNT RemoveSomeEscortShips (RACE_ID race, COUNT count);
 extern COUNT RemoveEscortShips (RACE_ID race);
 
 extern RACE_DESC *load_ship (SPECIES_ID SpeciesID, BOOLEAN LoadBattleData);
+extern void prefetch_ship (SPECIES_ID SpeciesID, BOOLEAN LoadBattleData);
 extern void free_ship (RACE_DESC *RaceDescPtr, BOOLEAN FreeIconData,
 		BOOLEAN FreeBattleData);
 
@@ -20,15 +20,18 @@
 #include "libs/reslib.h"
 #include "gamestr.h"
 #include "init.h"
+#include "broadphase.h"
 #include "element.h"
 #include "hyper.h"
 #include "planets/lander.h"
+#include "process.h"
 #include "starcon.h"
 #include "setup.h"
 #include "planets/solarsys.h"
 #include "sounds.h"
 #include "libs/sndlib.h"
 #include "libs/vidlib.h"
+#include "options.h"
 
 
 void
@@ -36,6 +39,8 @@ FreeKernel (void)
 {
 	UninitPlayerInput ();
 
+	if (optResStats)
+		res_LogLoadStats ();
 	UninitResourceSystem ();
 
 	DestroyDrawable (ReleaseDrawable (Screen));
@@ -50,7 +55,9 @@ FreeKernel (void)
 static void
 UninitContexts (void)
 {
+	UninitDisplayList ();
 	UninitQueue (&disp_q);
+	UninitBroadphase ();
 
 	DestroyContext (OffScreenContext);
 	DestroyContext (SpaceContext);
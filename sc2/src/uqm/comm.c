@@ -1400,6 +1400,12 @@ InitCommunication (CONVERSATION which_comm)
 		CommData = *LocDataPtr;
 	}
 
+	if (GET_GAME_STATE (BATTLE_SEGUE) != 0)
+	{	// Load what the choice may lead to while the encounter screen
+		// is up.
+		PrefetchEncounter (LocDataPtr);
+	}
+
 	if (GET_GAME_STATE (BATTLE_SEGUE) == 0)
 	{
 		// Not offered the chance to attack.
@@ -1456,6 +1462,8 @@ InitCommunication (CONVERSATION which_comm)
 	}
 
 	UninitEncounter ();
+	res_DropPrefetched ();
+			// What PrefetchEncounter() loaded for the choice not taken
 
 	return (status);
 }
@@ -19,8 +19,65 @@
 #include "displist.h"
 #include "libs/log.h"
 
+#include <string.h>
+
 #ifdef QUEUE_TABLE
 #define NULL_HANDLE NULL
+
+// Link storage of growable queues is aligned to a cache line.
+#define QUEUE_CHUNK_ALIGN 64
+// Link indices of growable queues have to fit in a COUNT.
+#define MAX_POOL_LINKS ((COUNT)0xFFFE)
+
+typedef struct
+{
+	BYTE *links;
+			// Start of the link storage, aligned to QUEUE_CHUNK_ALIGN
+	void *block;
+			// What the storage was carved out of
+	HLINK free_list;
+	COUNT num_free;
+	COUNT base;
+			// Index of the first link of this chunk in the queue
+} QUEUE_CHUNK;
+
+struct queue_pool
+{
+	QUEUE_CHUNK *chunks;
+			// In order of creation; links are handed out from the
+			// earliest chunk with room, to keep the queue compact
+	COUNT *by_addr;
+			// Indices in chunks[], sorted on link storage address
+	COUNT num_chunks;
+	COUNT chunk_links;
+	COUNT first_free;
+			// None of the chunks before this one has a free link
+	COUNT num_links;
+	COUNT high_water;
+};
+
+typedef struct
+{
+	HLINK free_list;
+	COUNT num_free;
+} QUEUE_CHUNK_STATE;
+
+struct queue_snapshot
+{
+	HLINK head;
+	HLINK tail;
+	HLINK free_list;
+	BYTE *links;
+			// The link storage of the queue; for a growable queue, that
+			// of all its chunks, one after the other
+	size_t links_size;
+	size_t links_alloc;
+	QUEUE_CHUNK_STATE *chunks;
+	COUNT num_chunks;
+	COUNT chunks_alloc;
+	COUNT first_free;
+	COUNT num_links;
+};
 #endif
 
 /*
@@ -40,6 +97,7 @@ InitQueue (QUEUE *pq, COUNT num_elements, OBJ_SIZE size)
 	return (TRUE);
 #else /* QUEUE_TABLE */
 	SetFreeList (pq, NULL_HANDLE);
+	pq->pool = NULL;
 #if 0	
 	log_add (log_Debug, "InitQueue(): num_elements = %d (%d)",
 			num_elements, (BYTE)num_elements);
@@ -57,6 +115,297 @@ InitQueue (QUEUE *pq, COUNT num_elements, OBJ_SIZE size)
 #endif /* QUEUE_TABLE */
 }
 
+#ifdef QUEUE_TABLE
+static void
+ResetQueueChunk (QUEUE *pq, QUEUE_CHUNK *chunk)
+{
+	COUNT i;
+
+	chunk->free_list = NULL_HANDLE;
+	for (i = pq->pool->chunk_links; i > 0; --i)
+	{
+		HLINK hLink;
+		LINK *LinkPtr;
+
+		hLink = (HLINK)(chunk->links + (COUNT)pq->object_size * (i - 1));
+		LinkPtr = (LINK*)hLink;
+		_SetSuccLink (LinkPtr, chunk->free_list);
+		chunk->free_list = hLink;
+	}
+	chunk->num_free = pq->pool->chunk_links;
+}
+
+static BOOLEAN
+AddQueueChunk (QUEUE *pq)
+{
+	QUEUE_POOL *pool = pq->pool;
+	QUEUE_CHUNK *chunks;
+	COUNT *by_addr;
+	QUEUE_CHUNK *chunk;
+	COUNT i;
+
+	if ((DWORD)(pool->num_chunks + 1) * pool->chunk_links > MAX_POOL_LINKS)
+		return (FALSE);
+
+	chunks = HRealloc (pool->chunks,
+			(pool->num_chunks + 1) * sizeof (*chunks));
+	if (!chunks)
+		return (FALSE);
+	pool->chunks = chunks;
+
+	by_addr = HRealloc (pool->by_addr,
+			(pool->num_chunks + 1) * sizeof (*by_addr));
+	if (!by_addr)
+		return (FALSE);
+	pool->by_addr = by_addr;
+
+	chunk = &chunks[pool->num_chunks];
+	chunk->block = HMalloc ((size_t)pq->object_size * pool->chunk_links
+			+ QUEUE_CHUNK_ALIGN - 1);
+	if (!chunk->block)
+		return (FALSE);
+	chunk->links = (BYTE *)(((uintptr_t)chunk->block
+			+ QUEUE_CHUNK_ALIGN - 1) & ~(uintptr_t)(QUEUE_CHUNK_ALIGN - 1));
+	chunk->base = pool->num_chunks * pool->chunk_links;
+	ResetQueueChunk (pq, chunk);
+
+	// Keep by_addr sorted
+	for (i = pool->num_chunks; i > 0
+			&& chunks[by_addr[i - 1]].links > chunk->links; --i)
+		by_addr[i] = by_addr[i - 1];
+	by_addr[i] = pool->num_chunks;
+
+	++pool->num_chunks;
+
+	return (TRUE);
+}
+
+static QUEUE_CHUNK *
+FindQueueChunk (const QUEUE *pq, HLINK hLink)
+{
+	const QUEUE_POOL *pool = pq->pool;
+	size_t chunk_bytes = (size_t)pq->object_size * pool->chunk_links;
+	COUNT lo, hi;
+
+	lo = 0;
+	hi = pool->num_chunks;
+	while (lo < hi)
+	{
+		COUNT mid = (lo + hi) >> 1;
+		QUEUE_CHUNK *chunk = &pool->chunks[pool->by_addr[mid]];
+
+		if ((BYTE*)hLink < chunk->links)
+			hi = mid;
+		else if ((BYTE*)hLink >= chunk->links + chunk_bytes)
+			lo = mid + 1;
+		else
+			return (chunk);
+	}
+
+	return (NULL);
+}
+
+// A growable queue has no upper limit on the number of links other than
+// what fits in a COUNT. Links are allocated in chunks of chunk_elements,
+// which are never moved or freed until UninitQueue(), so handles stay
+// valid as the queue grows.
+BOOLEAN
+InitGrowableQueue (QUEUE *pq, COUNT chunk_elements, OBJ_SIZE size)
+{
+	SetHeadLink (pq, NULL_HANDLE);
+	SetTailLink (pq, NULL_HANDLE);
+	SetLinkSize (pq, size);
+	SetFreeList (pq, NULL_HANDLE);
+	pq->pq_tab = NULL;
+	pq->num_objects = 0;
+
+	pq->pool = HCalloc (sizeof (*pq->pool));
+	if (!pq->pool)
+		return (FALSE);
+	pq->pool->chunk_links = chunk_elements;
+
+	if (!AddQueueChunk (pq))
+	{
+		UninitQueue (pq);
+		return (FALSE);
+	}
+
+	return (TRUE);
+}
+
+static void
+UninitQueuePool (QUEUE *pq)
+{
+	QUEUE_POOL *pool = pq->pool;
+	COUNT i;
+
+	for (i = 0; i < pool->num_chunks; ++i)
+		HFree (pool->chunks[i].block);
+	HFree (pool->chunks);
+	HFree (pool->by_addr);
+	HFree (pool);
+	pq->pool = NULL;
+}
+
+BOOLEAN
+_PoolOwnsLink (const QUEUE *pq, HLINK hLink)
+{
+	QUEUE_CHUNK *chunk = FindQueueChunk (pq, hLink);
+
+	return chunk && ((BYTE*)hLink - chunk->links) % pq->object_size == 0;
+}
+
+COUNT
+GetQueueCapacity (const QUEUE *pq)
+{
+	if (pq->pool)
+		return pq->pool->num_chunks * pq->pool->chunk_links;
+	return SizeQueueTab (pq);
+}
+
+// The largest number of links that have been in use at the same time.
+// Only tracked for growable queues.
+COUNT
+GetQueueHighWater (const QUEUE *pq)
+{
+	if (pq->pool)
+		return pq->pool->high_water;
+	return 0;
+}
+
+// Returns a number from 1 to GetQueueCapacity(), unique to the link,
+// like the index passed to GetLinkAddr().
+COUNT
+GetLinkIndex (const QUEUE *pq, HLINK hLink)
+{
+	if (pq->pool)
+	{
+		QUEUE_CHUNK *chunk = FindQueueChunk (pq, hLink);
+
+		assert (chunk != NULL);
+		return chunk->base + (COUNT)(((BYTE*)hLink - chunk->links)
+				/ pq->object_size) + 1;
+	}
+	return (COUNT)(((BYTE*)hLink - pq->pq_tab) / pq->object_size) + 1;
+}
+
+QUEUE_SNAPSHOT *
+CreateQueueSnapshot (void)
+{
+	return HCalloc (sizeof (QUEUE_SNAPSHOT));
+}
+
+void
+DestroyQueueSnapshot (QUEUE_SNAPSHOT *snap)
+{
+	if (!snap)
+		return;
+	HFree (snap->links);
+	HFree (snap->chunks);
+	HFree (snap);
+}
+
+BOOLEAN
+SnapshotQueue (const QUEUE *pq, QUEUE_SNAPSHOT *snap)
+{
+	COUNT num_chunks;
+	size_t size;
+
+	if (pq->pool)
+	{
+		num_chunks = pq->pool->num_chunks;
+		size = (size_t)pq->object_size * pq->pool->chunk_links * num_chunks;
+	}
+	else
+	{
+		num_chunks = 0;
+		size = (size_t)pq->object_size * SizeQueueTab (pq);
+	}
+
+	if (size > snap->links_alloc)
+	{
+		BYTE *links = HRealloc (snap->links, size);
+		if (!links)
+			return (FALSE);
+		snap->links = links;
+		snap->links_alloc = size;
+	}
+	if (num_chunks > snap->chunks_alloc)
+	{
+		QUEUE_CHUNK_STATE *chunks = HRealloc (snap->chunks,
+				num_chunks * sizeof (*chunks));
+		if (!chunks)
+			return (FALSE);
+		snap->chunks = chunks;
+		snap->chunks_alloc = num_chunks;
+	}
+
+	snap->head = GetHeadLink (pq);
+	snap->tail = GetTailLink (pq);
+	snap->free_list = GetFreeList (pq);
+	snap->links_size = size;
+	snap->num_chunks = num_chunks;
+
+	if (pq->pool)
+	{
+		const QUEUE_POOL *pool = pq->pool;
+		size_t chunk_bytes = (size_t)pq->object_size * pool->chunk_links;
+		COUNT i;
+
+		for (i = 0; i < num_chunks; ++i)
+		{
+			memcpy (snap->links + i * chunk_bytes, pool->chunks[i].links,
+					chunk_bytes);
+			snap->chunks[i].free_list = pool->chunks[i].free_list;
+			snap->chunks[i].num_free = pool->chunks[i].num_free;
+		}
+		snap->first_free = pool->first_free;
+		snap->num_links = pool->num_links;
+	}
+	else if (size)
+		memcpy (snap->links, pq->pq_tab, size);
+
+	return (TRUE);
+}
+
+// The queue must be the one the snapshot was taken of. A growable queue
+// may have grown since; the chunks it got were all free at the time of
+// the snapshot, so they are made free again.
+void
+RestoreQueue (QUEUE *pq, const QUEUE_SNAPSHOT *snap)
+{
+	SetHeadLink (pq, snap->head);
+	SetTailLink (pq, snap->tail);
+	SetFreeList (pq, snap->free_list);
+
+	if (pq->pool)
+	{
+		QUEUE_POOL *pool = pq->pool;
+		size_t chunk_bytes = (size_t)pq->object_size * pool->chunk_links;
+		COUNT i;
+
+		assert (snap->num_chunks <= pool->num_chunks);
+		for (i = 0; i < snap->num_chunks; ++i)
+		{
+			memcpy (pool->chunks[i].links, snap->links + i * chunk_bytes,
+					chunk_bytes);
+			pool->chunks[i].free_list = snap->chunks[i].free_list;
+			pool->chunks[i].num_free = snap->chunks[i].num_free;
+		}
+		for (; i < pool->num_chunks; ++i)
+			ResetQueueChunk (pq, &pool->chunks[i]);
+		pool->first_free = snap->first_free;
+		pool->num_links = snap->num_links;
+	}
+	else if (snap->links_size)
+	{
+		assert (snap->links_size ==
+				(size_t)pq->object_size * SizeQueueTab (pq));
+		memcpy (pq->pq_tab, snap->links, snap->links_size);
+	}
+}
+#endif /* QUEUE_TABLE */
+
 BOOLEAN
 UninitQueue (QUEUE *pq)
 {
@@ -64,6 +413,11 @@ UninitQueue (QUEUE *pq)
 	SetHeadLink (pq, NULL_HANDLE);
 	SetTailLink (pq, NULL_HANDLE);
 	SetFreeList (pq, NULL_HANDLE);
+	if (pq->pool)
+	{
+		UninitQueuePool (pq);
+		return (TRUE);
+	}
 	FreeQueueTab (pq);
 
 	return (TRUE);
@@ -88,6 +442,16 @@ ReinitQueue (QUEUE *pq)
 	SetHeadLink (pq, NULL_HANDLE);
 	SetTailLink (pq, NULL_HANDLE);
 #ifdef QUEUE_TABLE
+	if (pq->pool)
+	{
+		COUNT i;
+
+		for (i = 0; i < pq->pool->num_chunks; ++i)
+			ResetQueueChunk (pq, &pq->pool->chunks[i]);
+		pq->pool->first_free = 0;
+		pq->pool->num_links = 0;
+	}
+	else
 	{
 		COUNT num_elements;
 
@@ -105,11 +469,63 @@ ReinitQueue (QUEUE *pq)
 }
 
 #ifdef QUEUE_TABLE
+static HLINK
+AllocPoolLink (QUEUE *pq)
+{
+	QUEUE_POOL *pool = pq->pool;
+	QUEUE_CHUNK *chunk;
+	HLINK hLink;
+
+	while (pool->first_free < pool->num_chunks
+			&& pool->chunks[pool->first_free].num_free == 0)
+		++pool->first_free;
+
+	if (pool->first_free == pool->num_chunks && !AddQueueChunk (pq))
+	{
+		log_add (log_Warning, "AllocLink(): Cannot grow the queue beyond"
+				" %u elements", GetQueueCapacity (pq));
+		return (NULL_HANDLE);
+	}
+
+	chunk = &pool->chunks[pool->first_free];
+	hLink = chunk->free_list;
+	chunk->free_list = _GetSuccLink ((LINK*)hLink);
+	--chunk->num_free;
+
+	if (++pool->num_links > pool->high_water)
+		pool->high_water = pool->num_links;
+
+	return (hLink);
+}
+
+static void
+FreePoolLink (QUEUE *pq, HLINK hLink)
+{
+	QUEUE_POOL *pool = pq->pool;
+	QUEUE_CHUNK *chunk;
+	COUNT index;
+
+	chunk = FindQueueChunk (pq, hLink);
+	assert (chunk != NULL);
+
+	_SetSuccLink ((LINK*)hLink, chunk->free_list);
+	chunk->free_list = hLink;
+	++chunk->num_free;
+	--pool->num_links;
+
+	index = (COUNT)(chunk - pool->chunks);
+	if (index < pool->first_free)
+		pool->first_free = index;
+}
+
 HLINK
 AllocLink (QUEUE *pq)
 {
 	HLINK hLink;
 
+	if (pq->pool)
+		return AllocPoolLink (pq);
+
 	hLink = GetFreeList (pq);
 	if (hLink)
 	{
@@ -130,6 +546,12 @@ FreeLink (QUEUE *pq, HLINK hLink)
 {
 	LINK *LinkPtr;
 
+	if (pq->pool)
+	{
+		FreePoolLink (pq, hLink);
+		return;
+	}
+
 	LinkPtr = LockLink (pq, hLink);
 	_SetSuccLink (LinkPtr, GetFreeList (pq));
 	UnlockLink (pq, hLink);
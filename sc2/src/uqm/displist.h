@@ -49,6 +49,10 @@ typedef struct link
 	HLINK succ;
 } LINK;
 
+#ifdef QUEUE_TABLE
+typedef struct queue_pool QUEUE_POOL;
+#endif /* QUEUE_TABLE */
+
 typedef struct /* queue */
 {
 	HLINK head;
@@ -60,6 +64,10 @@ typedef struct /* queue */
 	COUNT object_size;
 #ifdef QUEUE_TABLE
 	BYTE num_objects;
+	QUEUE_POOL *pool;
+			// Only set for queues created with InitGrowableQueue().
+			// The links then live in the chunks of the pool, and pq_tab
+			// is not used.
 #endif /* QUEUE_TABLE */
 } QUEUE;
 
@@ -67,14 +75,23 @@ typedef struct /* queue */
 
 extern HLINK AllocLink (QUEUE *pq);
 extern void FreeLink (QUEUE *pq, HLINK hLink);
+extern BOOLEAN _PoolOwnsLink (const QUEUE *pq, HLINK h);
+
+static inline BOOLEAN
+QueueOwnsLink (const QUEUE *pq, HLINK h)
+{
+	if (pq->pool)
+		return _PoolOwnsLink (pq, h);
+	return pq->pq_tab && (BYTE*)h >= pq->pq_tab &&
+			(BYTE*)h < pq->pq_tab + pq->object_size * pq->num_objects;
+}
 
 static inline LINK *
 LockLink (const QUEUE *pq, HLINK h)
 {
 	if (h) // Apparently, h==0 is OK
 	{	// Make sure the link is actually in our queue!
-		assert (pq->pq_tab && (BYTE*)h >= pq->pq_tab &&
-				(BYTE*)h < pq->pq_tab + pq->object_size * pq->num_objects);
+		assert (QueueOwnsLink (pq, h));
 	}
 	return (LINK*)h;
 }
@@ -84,8 +101,7 @@ UnlockLink (const QUEUE *pq, HLINK h)
 {
 	if (h) // Apparently, h==0 is OK
 	{	// Make sure the link is actually in our queue!
-		assert (pq->pq_tab && (BYTE*)h >= pq->pq_tab &&
-				(BYTE*)h < pq->pq_tab + pq->object_size * pq->num_objects);
+		assert (QueueOwnsLink (pq, h));
 	}
 }
 
@@ -116,7 +132,27 @@ UnlockLink (const QUEUE *pq, HLINK h)
 #define _SetSuccLink(lpE,h) ((lpE)->succ = (h))
 
 extern BOOLEAN InitQueue (QUEUE *pq, COUNT num_elements, OBJ_SIZE size);
+#ifdef QUEUE_TABLE
+extern BOOLEAN InitGrowableQueue (QUEUE *pq, COUNT chunk_elements,
+		OBJ_SIZE size);
+extern COUNT GetQueueCapacity (const QUEUE *pq);
+extern COUNT GetQueueHighWater (const QUEUE *pq);
+extern COUNT GetLinkIndex (const QUEUE *pq, HLINK hLink);
+#endif /* QUEUE_TABLE */
 extern BOOLEAN UninitQueue (QUEUE *pq);
+#ifdef QUEUE_TABLE
+// A copy of the links of a queue, and of which of them are in use, so
+// that the queue can be put back the way it was. Links are copied byte
+// for byte, which is fine as they never move: any handle stored in them
+// is still valid after RestoreQueue(). A snapshot keeps its buffers
+// between uses, so taking one every frame does not allocate.
+typedef struct queue_snapshot QUEUE_SNAPSHOT;
+
+extern QUEUE_SNAPSHOT *CreateQueueSnapshot (void);
+extern void DestroyQueueSnapshot (QUEUE_SNAPSHOT *snap);
+extern BOOLEAN SnapshotQueue (const QUEUE *pq, QUEUE_SNAPSHOT *snap);
+extern void RestoreQueue (QUEUE *pq, const QUEUE_SNAPSHOT *snap);
+#endif /* QUEUE_TABLE */
 extern void ReinitQueue (QUEUE *pq);
 extern void PutQueue (QUEUE *pq, HLINK hLink);
 extern void InsertQueue (QUEUE *pq, HLINK hLink, HLINK hRefLink);
@@ -176,18 +176,23 @@ elementsOfSamePlayer (ELEMENT *ElementPtr0, ELEMENT *ElementPtr1)
 }
 
 extern QUEUE disp_q;
-// The maximum number of elements is chosen to provide a slight margin.
-// Currently, it is maximum *known used* in Melee + 30
-#define MAX_DISPLAY_ELEMENTS 150
+// Both the display queue and the display primitives grow on demand,
+// by these amounts at a time. The initial sizes cover the maximum
+// *known used* in Melee with a slight margin.
+// Elements are allocated in chunks which never move, so an HELEMENT stays
+// valid as the queue grows. Primitives are referred to by their index in
+// DisplayArray; the array itself may move when it grows, so do not hold
+// on to a PRIMITIVE pointer across AllocElement() or AllocDisplayPrim().
+#define DISPLAY_ELEMENT_CHUNK 64
+#define DISPLAY_PRIM_CHUNK 128
+#define INITIAL_DISPLAY_PRIMS (3 * DISPLAY_PRIM_CHUNK)
+#define MAX_DISPLAY_PRIMS END_OF_LIST
 
-#define MAX_DISPLAY_PRIMS 330
 extern COUNT DisplayFreeList;
-extern PRIMITIVE DisplayArray[MAX_DISPLAY_PRIMS];
+extern PRIMITIVE *DisplayArray;
 
-#define AllocDisplayPrim() DisplayFreeList; \
-								DisplayFreeList = GetSuccLink (GetPrimLinks (&DisplayArray[DisplayFreeList]))
-#define FreeDisplayPrim(p) SetPrimLinks (&DisplayArray[p], END_OF_LIST, DisplayFreeList); \
-								DisplayFreeList = (p)
+extern COUNT AllocDisplayPrim (void);
+extern void FreeDisplayPrim (COUNT p);
 
 #define GetElementStarShip(e,ppsd) do { *(ppsd) = (e)->pParent; } while (0)
 #define SetElementStarShip(e,psd)  do { (e)->pParent = psd; } while (0)
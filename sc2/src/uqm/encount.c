@@ -44,6 +44,7 @@
 #include "libs/mathlib.h"
 #include "libs/inplib.h"
 #include "libs/misc.h"
+#include "libs/reslib.h"
 
 
 static void DrawFadeText (const UNICODE *str1, const UNICODE *str2,
@@ -252,6 +253,49 @@ UpdateShipFragCrew (STARSHIP *StarShipPtr)
 	}
 }
 
+/*
+ * Starts loading, in the background, what may be needed once the player
+ * has decided what to do at the encounter screen: the communication
+ * screen of the race, if there is one, and the battle data of the ships
+ * of the enemy fleet. InitCommunication() drops whatever goes unused.
+ */
+void
+PrefetchEncounter (const LOCDATA *LocDataPtr)
+{
+	BOOLEAN seen[NUM_SPECIES_ID];
+	HSTARSHIP hStarShip, hNextShip;
+
+	if (LocDataPtr)
+	{
+		res_PrefetchResource (PLAYER_FONT);
+		res_PrefetchResource (LocDataPtr->AlienFrameRes);
+		res_PrefetchResource (LocDataPtr->AlienFontRes);
+		res_PrefetchResource (LocDataPtr->AlienColorMapRes);
+		res_PrefetchResource (LocDataPtr->AlienSongRes);
+		res_PrefetchResource (LocDataPtr->ConversationPhrasesRes);
+	}
+
+	res_PrefetchResource (GAME_SOUNDS);
+	memset (seen, 0, sizeof seen);
+	for (hStarShip = GetHeadLink (&race_q[NPC_PLAYER_NUM]);
+			hStarShip != 0; hStarShip = hNextShip)
+	{
+		STARSHIP *StarShipPtr;
+		SPECIES_ID SpeciesID;
+
+		StarShipPtr = LockStarShip (&race_q[NPC_PLAYER_NUM], hStarShip);
+		hNextShip = _GetSuccLink (StarShipPtr);
+		SpeciesID = StarShipPtr->SpeciesID;
+		UnlockStarShip (&race_q[NPC_PLAYER_NUM], hStarShip);
+
+		if (SpeciesID < NUM_SPECIES_ID && !seen[SpeciesID])
+		{
+			seen[SpeciesID] = TRUE;
+			prefetch_ship (SpeciesID, TRUE);
+		}
+	}
+}
+
 /*
  * Encountering an alien.
  * Draws the encounter screen, plays the red alert music, and
@@ -101,6 +101,7 @@ enum
 
 extern void EncounterBattle (void);
 extern void BuildBattle (COUNT which_player);
+extern void PrefetchEncounter (const LOCDATA *LocDataPtr);
 extern COUNT InitEncounter (void);
 extern COUNT UninitEncounter (void);
 extern BOOLEAN FleetIsInfinite (COUNT playerNr);
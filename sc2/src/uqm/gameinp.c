@@ -26,6 +26,7 @@
 #endif
 #include "settings.h"
 #include "sounds.h"
+#include "supermelee/meleesim.h"
 #include "tactrans.h"
 #include "uqmdebug.h"
 #include "libs/async.h"
@@ -366,7 +367,9 @@ DoInput (void *pInputState, BOOLEAN resetInput)
 	{
 		MENU_SOUND_FLAGS soundFlags;
 		Async_process ();
-		TaskSwitch ();
+		if (!meleeSimActive)
+			TaskSwitch ();
+				// A headless simulation runs flat out.
 
 		UpdateInputState ();
 
@@ -469,7 +469,7 @@ InterplanetaryTransition (ELEMENT *ElementPtr)
 		GLOBAL (autopilot.y) = ~0;
 
 		ElementToUniverse (ElementPtr, &pt);
-		CurStarDescPtr = FindStar (NULL, &pt, 5, 5);
+		CurStarDescPtr = FindNearestStar (&pt, 5);
 		if (CurStarDescPtr->star_pt.x == ARILOU_HOME_X
 				&& CurStarDescPtr->star_pt.y == ARILOU_HOME_Y)
 		{
@@ -679,7 +679,7 @@ hyper_collision (ELEMENT *ElementPtr0, POINT *pPt0,
 
 		ElementToUniverse (ElementPtr0, &pt);
 
-		SDPtr = FindStar (NULL, &pt, 5, 5);
+		SDPtr = FindNearestStar (&pt, 5);
 
 		GetElementStarShip (ElementPtr1, &StarShipPtr);
 		GetCurrentVelocityComponents (&ElementPtr1->velocity, &dx, &dy);
@@ -1386,8 +1386,10 @@ SeedUniverse (void)
 		DrawHyperGrid (universe.x, universe.y, ox, oy);
 
 		{
-			SDPtr = 0;
-			while ((SDPtr = FindStar (SDPtr, &universe, XOFFS, YOFFS)))
+			STAR_SEARCH search;
+
+			StartStarSearch (&search, &universe, XOFFS, YOFFS);
+			while ((SDPtr = NextFoundStar (&search)))
 			{
 				BYTE star_type;
 
@@ -1406,6 +1408,7 @@ SeedUniverse (void)
 						star_type + 2);
 				DrawStamp (&s);
 			}
+			EndStarSearch (&search);
 		}
 	}
 
@@ -1515,21 +1518,15 @@ SeedUniverse (void)
 	}
 
 	{
-		SDPtr = 0;
-		while ((SDPtr = FindStar (SDPtr, &universe, XOFFS, YOFFS)))
+		STAR_SEARCH search;
+
+		// Only the stars within a radar screen of the ship are in play.
+		StartStarSearch (&search, &universe, XOFFS / NUM_RADAR_SCREENS,
+				YOFFS / NUM_RADAR_SCREENS);
+		while ((SDPtr = NextFoundStar (&search)))
 		{
 			BYTE star_type;
 
-			ex = SDPtr->star_pt.x - universe.x;
-			if (ex < 0)
-				ex = -ex;
-			ey = SDPtr->star_pt.y - universe.y;
-			if (ey < 0)
-				ey = -ey;
-			if (ex > (XOFFS / NUM_RADAR_SCREENS)
-					|| ey > (YOFFS / NUM_RADAR_SCREENS))
-				continue;
-
 			hHyperSpaceElement = AllocHyperElement (&SDPtr->star_pt);
 			if (hHyperSpaceElement == 0)
 				continue;
@@ -1560,6 +1557,7 @@ SeedUniverse (void)
 
 			InsertElement (hHyperSpaceElement, GetHeadElement ());
 		}
+		EndStarSearch (&search);
 		ProcessEncounters (&universe, ox, oy);
 	}
 
@@ -22,6 +22,7 @@
 #include "controls.h"
 #include "globdata.h"
 #include "setup.h"
+#include "supermelee/meleesim.h"
 #include "libs/log.h"
 
 #include <stdio.h>
@@ -58,7 +59,8 @@ computer_intelligence (ComputerInputContext *context, STARSHIP *StarShipPtr)
 		{
 			case SUPER_MELEE:
 			{
-				SleepThread (ONE_SECOND >> 1);
+				if (!meleeSimActive)
+					SleepThread (ONE_SECOND >> 1);
 				InputState = BATTLE_WEAPON; /* pick a random ship */
 				break;
 			}
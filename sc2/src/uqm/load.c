@@ -26,6 +26,7 @@
 #include "globdata.h"
 #include "options.h"
 #include "save.h"
+#include "savefile.h"
 #include "setup.h"
 #include "state.h"
 #include "grpintrn.h"
@@ -41,10 +42,12 @@ ACTIVITY NextActivity;
 static inline size_t
 read_8 (void *fp, BYTE *v)
 {
-	BYTE t;
-	if (!v) /* read value ignored */
-		v = &t;
-	return ReadResFile (v, 1, 1, fp);
+	const BYTE *p = SaveBuffer_read (fp, 1);
+	if (!p)
+		return 0;
+	if (v)
+		*v = p[0];
+	return 1;
 }
 
 static inline size_t
@@ -100,8 +103,14 @@ read_32s (void *fp, SDWORD *v)
 static inline size_t
 read_a8 (void *fp, BYTE *ar, COUNT count)
 {
+	const BYTE *p;
+
 	assert (ar != NULL);
-	return ReadResFile (ar, 1, count, fp) == count;
+	p = SaveBuffer_read (fp, count);
+	if (!p)
+		return 0;
+	memcpy (ar, p, count);
+	return 1;
 }
 
 static inline size_t
@@ -111,15 +120,9 @@ read_a8s (void *fp, char *ar, COUNT count)
 }
 
 static inline size_t
-skip_8 (void *fp, COUNT count)
+skip_8 (void *fp, DWORD count)
 {
-	int i;
-	for (i = 0; i < count; ++i)
-	{
-		if (read_8(fp, NULL) != 1)
-			return 0;
-	}
-	return 1;
+	return SaveBuffer_read (fp, count) != NULL;
 }
 
 static inline size_t
@@ -410,6 +413,10 @@ LoadSisState (SIS_STATE *SSPtr, void *fp)
 	return TRUE;
 }
 
+#define SUMMARY_READ_SIZE (12 + 160 + SAVE_NAME_SIZE)
+		// The file tag, the summary chunk header, and the longest summary
+		// that SaveSummary() writes
+
 static BOOLEAN
 LoadSummary (SUMMARY_DESC *SummPtr, void *fp)
 {
@@ -478,7 +485,7 @@ LoadStarDesc (STAR_DESC *SDPtr, void *fh)
 }
 
 static void
-LoadScanInfo (uio_Stream *fh, DWORD flen)
+LoadScanInfo (SAVE_BUFFER *fh, DWORD flen)
 {
 	GAME_STATE_FILE *fp = OpenStateFile (STARINFO_FILE, "wb");
 	if (fp)
@@ -495,7 +502,7 @@ LoadScanInfo (uio_Stream *fh, DWORD flen)
 }
 
 static void
-LoadGroupList (uio_Stream *fh, DWORD chunksize)
+LoadGroupList (SAVE_BUFFER *fh, DWORD chunksize)
 {
 	GAME_STATE_FILE *fp = OpenStateFile (RANDGRPINFO_FILE, "rb");
 	if (fp)
@@ -568,7 +575,7 @@ SetBattleGroupOffset (int encounterIndex, DWORD offset)
 }
 
 static void
-LoadBattleGroup (uio_Stream *fh, DWORD chunksize)
+LoadBattleGroup (SAVE_BUFFER *fh, DWORD chunksize)
 {
 	GAME_STATE_FILE *fp;
 	GROUP_HEADER h;
@@ -660,10 +667,32 @@ LoadBattleGroup (uio_Stream *fh, DWORD chunksize)
 	}
 }
 
+// Checks that the image is a sequence of chunks that ends exactly at the
+// end of the image, with the star descriptor that SaveGame() writes last.
+static BOOLEAN
+IsCompleteSave (SAVE_BUFFER *sb)
+{
+	DWORD magic;
+	DWORD chunk = 0;
+	DWORD chunkSize;
+
+	if (read_32 (sb, &magic) != 1 || magic != SAVEFILE_TAG)
+		return FALSE;
+
+	while (sb->pos < sb->size)
+	{
+		if (read_32 (sb, &chunk) != 1 || read_32 (sb, &chunkSize) != 1
+				|| skip_8 (sb, chunkSize) != 1)
+			return FALSE;
+	}
+	return chunk == STAR_TAG;
+}
+
 BOOLEAN
 LoadGame (COUNT which_game, SUMMARY_DESC *SummPtr)
 {
-	uio_Stream *in_fp;
+	SAVE_BUFFER sb;
+	SAVE_BUFFER *in_fp = &sb;
 	char file[PATH_MAX];
 	SUMMARY_DESC loc_sd;
 	COUNT num_links;
@@ -673,13 +702,21 @@ LoadGame (COUNT which_game, SUMMARY_DESC *SummPtr)
 	BOOLEAN first_group_spec = TRUE;
 
 	sprintf (file, "uqmsave.%02u", which_game);
-	in_fp = res_OpenResFile (saveDir, file, "rb");
-	if (!in_fp)
+	SaveBuffer_recoverFile (saveDir, file, IsCompleteSave);
+	if (SummPtr)
+	{	// only need the summary, which comes first
+		if (!SaveBuffer_readFileHead (&sb, saveDir, file,
+				SUMMARY_READ_SIZE))
+			return LoadLegacyGame (which_game, SummPtr);
+	}
+	else if (!SaveBuffer_readFile (&sb, saveDir, file))
+	{
 		return LoadLegacyGame (which_game, SummPtr);
+	}
 
 	if (!LoadSummary (&loc_sd, in_fp))
 	{
-		res_CloseResFile (in_fp);
+		SaveBuffer_uninit (&sb);
 		return LoadLegacyGame (which_game, SummPtr);
 	}
 
@@ -690,7 +727,7 @@ LoadGame (COUNT which_game, SUMMARY_DESC *SummPtr)
 	else
 	{	// only need summary for displaying to user
 		memcpy (SummPtr, &loc_sd, sizeof (*SummPtr));
-		res_CloseResFile (in_fp);
+		SaveBuffer_uninit (&sb);
 		return TRUE;
 	}
 
@@ -710,7 +747,7 @@ LoadGame (COUNT which_game, SUMMARY_DESC *SummPtr)
 	Activity = GLOBAL (CurrentActivity);
 	if (!LoadGameState (&GlobData.Game_state, in_fp))
 	{
-		res_CloseResFile (in_fp);
+		SaveBuffer_uninit (&sb);
 		return FALSE;
 	}
 	NextActivity = GLOBAL (CurrentActivity);
@@ -725,7 +762,7 @@ LoadGame (COUNT which_game, SUMMARY_DESC *SummPtr)
 		}
 		if (read_32(in_fp, &chunkSize) != 1)
 		{
-			res_CloseResFile (in_fp);
+			SaveBuffer_uninit (&sb);
 			return FALSE;
 		}
 		switch (chunk)
@@ -812,13 +849,13 @@ LoadGame (COUNT which_game, SUMMARY_DESC *SummPtr)
 			log_add (log_Debug, "Skipping chunk of tag %08X (size %u)", chunk, chunkSize);
 			if (skip_8(in_fp, chunkSize) != 1)
 			{
-				res_CloseResFile (in_fp);
+				SaveBuffer_uninit (&sb);
 				return FALSE;
 			}
 			break;
 		}
 	}
-	res_CloseResFile (in_fp);
+	SaveBuffer_uninit (&sb);
 
 	EncounterGroup = 0;
 	EncounterRace = -1;
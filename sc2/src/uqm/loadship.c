@@ -166,6 +166,46 @@ BadLoad:
 	goto ExitFunc;
 }
 
+// Starts loading the data that load_ship() will want, in the background.
+// Only the code resource, which holds the names of the rest, is loaded on
+// the spot.
+void
+prefetch_ship (SPECIES_ID SpeciesID, BOOLEAN LoadBattleData)
+{
+	RACE_DESC *RDPtr = 0;
+	void *CodeRef;
+
+	if (SpeciesID >= NUM_SPECIES_ID)
+		return;
+
+	CodeRef = CaptureCodeRes (LoadCodeRes (code_resources[SpeciesID]),
+			&GlobData, (void **)(&RDPtr));
+	if (!CodeRef)
+		return;
+
+	res_PrefetchResource (RDPtr->ship_info.icons_rsc);
+	res_PrefetchResource (RDPtr->ship_info.melee_icon_rsc);
+	res_PrefetchResource (RDPtr->ship_info.race_strings_rsc);
+
+	if (LoadBattleData)
+	{
+		DATA_STUFF *RawPtr = &RDPtr->ship_data;
+		COUNT i;
+
+		for (i = 0; i < NUM_VIEWS; ++i)
+		{
+			res_PrefetchResource (RawPtr->ship_rsc[i]);
+			res_PrefetchResource (RawPtr->weapon_rsc[i]);
+			res_PrefetchResource (RawPtr->special_rsc[i]);
+		}
+		res_PrefetchResource (RawPtr->captain_control.captain_rsc);
+		res_PrefetchResource (RawPtr->victory_ditty_rsc);
+		res_PrefetchResource (RawPtr->ship_sounds_rsc);
+	}
+
+	DestroyCodeRes (ReleaseCodeRes (CodeRef));
+}
+
 void
 free_ship (RACE_DESC *raceDescPtr, BOOLEAN FreeIconData,
 		BOOLEAN FreeBattleData)
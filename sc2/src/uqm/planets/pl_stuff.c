@@ -101,6 +101,8 @@ UninitSphereRotation (void)
 {
 	PLANET_ORBIT *Orbit = &pSolarSysState->Orbit;
 
+	StopSphereWorkers ();
+
 	if (Orbit->WorkFrame)
 	{
 		DestroyDrawable (ReleaseDrawable (Orbit->ObjectFrame));
@@ -296,6 +296,7 @@ extern void PrepareNextRotationFrame (void);
 extern void DrawPlanetSphere (int x, int y);
 extern void DrawDefaultPlanetSphere (void);
 extern void RenderPlanetSphere (FRAME Frame, int offset, BOOLEAN doThrob);
+extern void StopSphereWorkers (void);
 extern void SetShieldThrobEffect (FRAME FromFrame, int offset, FRAME ToFrame);
 
 extern void ZoomInPlanetSphere (void);
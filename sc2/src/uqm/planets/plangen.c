@@ -18,6 +18,7 @@
 
 #include "planets.h"
 #include "scan.h"
+#include "surfcache.h"
 #include "../nameref.h"
 #include "../resinst.h"
 #include "../setup.h"
@@ -27,12 +28,11 @@
 #include "libs/mathlib.h"
 #include "libs/log.h"
 #include "libs/memlib.h"
+#include "libs/threadlib.h"
+#include "libs/timelib.h"
 #include <math.h>
-#include <time.h>
 
 
-#undef PROFILE_ROTATION
-
 // define USE_ALPHA_SHIELD to use an aloha overlay instead of
 // an additive overlay for the shield effect
 #undef USE_ALPHA_SHIELD
@@ -80,7 +80,73 @@ typedef struct
 	DWORD m[4];
 } MAP3D_POINT;
 
-MAP3D_POINT map_rotate[DIAMETER][DIAMETER];
+// A point of the sphere, flattened for rendering
+typedef struct
+{
+	UWORD pix[4];
+			// Offsets of the blended points in the topo colours
+	DWORD m[4];
+			// Their weights; an exact pixel has all the weight on pix[0]
+	UWORD elev_row;
+	UWORD elev_x;
+			// Row offset and column of the first point in the elevations
+	DWORD msum;
+			// Sum of the weights
+} SPHERE_POINT;
+
+static SPHERE_POINT sphere_point[DIAMETER][DIAMETER];
+
+#define SPHERE_MAX_THREADS 8
+#define SPHERE_BAND_ROWS 8
+		// Rows handed to a thread at a time
+
+typedef struct
+{
+	int x0, x1;
+			// Only the pixels x0 <= x < x1 of the row can be lit
+} SPHERE_SPAN;
+
+static SPHERE_SPAN sphere_span[DIAMETER];
+
+typedef struct
+{
+	const Color *pixels;
+	const SBYTE *elevs;
+	int offset;
+	BOOLEAN shielded;
+	int shieldLevel;
+			// THROB_MAX_LEVEL when the shield does not throb
+	Color *dst;
+	int nextRow;
+			// protected by sphereLock
+} SPHERE_JOB;
+
+// The lit span of a sphere row, gathered for lighting
+typedef struct
+{
+	DWORD diffus[DIAMETER];
+	int lvf[DIAMETER];
+			// light variance factor
+	int r[DIAMETER];
+	int g[DIAMETER];
+	int b[DIAMETER];
+} SPHERE_ROW;
+
+static SPHERE_JOB sphereJob;
+
+static Mutex sphereLock;
+static Semaphore sphereWork;
+		// one count per worker that is to pick up bands
+static Semaphore sphereDone;
+		// one count per worker that has run out of bands
+static Semaphore sphereExit;
+		// one count per worker that has exited
+
+static int sphereWorkersStarted;
+		// only touched by the rendering thread
+static int sphereWorkersRunning;
+		// protected by sphereLock
+static volatile BOOLEAN sphereWorkersQuit;
 
 typedef struct
 {
@@ -319,6 +385,19 @@ GenerateSphereMask (POINT loc)
 			light_diff[pt.y][pt.x] = diff_int;
 		}
 	}
+
+	// Only the lit span of each row needs rendering
+	for (y = 0; y < DIAMETER; ++y)
+	{
+		SPHERE_SPAN *span = &sphere_span[y];
+
+		for (span->x0 = 0; span->x0 < DIAMETER
+				&& light_diff[y][span->x0] == 0; ++span->x0)
+			;
+		for (span->x1 = DIAMETER; span->x1 > span->x0
+				&& light_diff[y][span->x1 - 1] == 0; --span->x1)
+			;
+	}
 }
 
 //create_aa_points creates weighted averages for
@@ -395,46 +474,28 @@ create_aa_points (MAP3D_POINT *ppt, double x, double y)
 		ppt->m[i] = (DWORD)(m[i] * (1 << AA_WEIGHT_BITS) + 0.5);
 }
 
-static inline BYTE
-get_color_channel (Color c, int channel)
+// Flattens the mapping of one sphere point for RenderSphereRow()
+static void
+set_sphere_point (SPHERE_POINT *sp, const MAP3D_POINT *ppt)
 {
-	switch (channel)
-	{
-		case 0:
-			return c.r;
-		case 1:
-			return c.g;
-		case 2:
-			return c.b;
-		default:
-			return 0;
-	}
-}
+	int i;
 
-// Creates either a red, green, or blue value by
-// computing the weighted averages of the 4 points in p
-static BYTE
-get_avg_channel (Color p[4], DWORD mult[4], int channel)
-{
-	COUNT j;
-	DWORD ci = 0;
-	
-	//sum(mult[])==65536
-	//c is the red/green/blue value of this pixel
-	for (j = 0; j < 4; j++)
+	for (i = 0; i < 4; i++)
 	{
-		BYTE c = get_color_channel (p[j], channel);
-		ci += c * mult[j];
+		const POINT *pt = &ppt->p[ppt->m[0] == 0 ? 0 : i];
+
+		sp->pix[i] = pt->y * (MAP_WIDTH + SPHERE_SPAN_X) + pt->x;
+		if (ppt->m[0] == 0)
+			sp->m[i] = i == 0 ? 1 << AA_WEIGHT_BITS : 0;
+		else
+			sp->m[i] = ppt->m[i];
 	}
-	ci >>= AA_WEIGHT_BITS;
-	//check for overflow
-	if (ci > 255)
-		ci = 255;
-	
-	return ((UBYTE)ci);
+	sp->msum = sp->m[0] + sp->m[1] + sp->m[2] + sp->m[3];
+	sp->elev_row = ppt->p[0].y * MAP_WIDTH;
+	sp->elev_x = ppt->p[0].x;
 }
 
-// CreateSphereTiltMap creates 'map_rotate' to map the topo data
+// CreateSphereTiltMap creates 'sphere_point' to map the topo data
 //  for a tilted planet.  It also does the sphere->plane mapping
 static void
 CreateSphereTiltMap (int angle)
@@ -453,7 +514,9 @@ CreateSphereTiltMap (int angle)
 			double dx, dy, newx, newy;
 			double da, rad, rad_2;
 			double xa, ya;
-			MAP3D_POINT *ppt = &map_rotate[y + RADIUS][x + RADIUS];
+			MAP3D_POINT mpt;
+			MAP3D_POINT *ppt = &mpt;
+			SPHERE_POINT *sp = &sphere_point[y + RADIUS][x + RADIUS];
 			
 			rad_2 = x * x + y_2;
 
@@ -462,6 +525,7 @@ CreateSphereTiltMap (int angle)
 				ppt->p[0].x = x + RADIUS;
 				ppt->p[0].y = y + RADIUS;
 				ppt->m[0] = 0;
+				set_sphere_point (sp, ppt);
 
 				continue;
 			}
@@ -489,6 +553,7 @@ CreateSphereTiltMap (int angle)
 				newx = xadj + ((newx - xadj) / sin (ya));
 
 			create_aa_points (ppt, newx, newy);
+			set_sphere_point (sp, ppt);
 		}
 	}
 }
@@ -684,147 +749,321 @@ calc_map_light (UBYTE val, DWORD dif, int lvf)
 	return ((UBYTE)i);
 }
 
-static inline Color
-get_map_pixel (Color *pixels, int x, int y)
+// Gathers the colour and the light variance factor of each pixel in
+// the lit span of sphere row 'y' into 'row'. Every pixel is blended from
+// 4 points, an exact one with all the weight on the first.
+static void
+GatherSphereRow (SPHERE_ROW *row, const SPHERE_JOB *job, int y)
 {
-	return pixels[y * (MAP_WIDTH + SPHERE_SPAN_X) + x];
+	const SPHERE_SPAN *span = &sphere_span[y];
+	const Color *pixels = job->pixels;
+	int i, x;
+
+	for (i = 0, x = span->x0; x < span->x1; ++i, ++x)
+	{
+		const SPHERE_POINT *sp = &sphere_point[y][x];
+		const Color *p0 = pixels + sp->pix[0];
+		const Color *p1 = pixels + sp->pix[1];
+		const Color *p2 = pixels + sp->pix[2];
+		const Color *p3 = pixels + sp->pix[3];
+		DWORD r, g, b;
+		int ex;
+
+		r = p0->r * sp->m[0] + p1->r * sp->m[1]
+				+ p2->r * sp->m[2] + p3->r * sp->m[3];
+		g = p0->g * sp->m[0] + p1->g * sp->m[1]
+				+ p2->g * sp->m[2] + p3->g * sp->m[3];
+		b = p0->b * sp->m[0] + p1->b * sp->m[1]
+				+ p2->b * sp->m[2] + p3->b * sp->m[3];
+		r >>= AA_WEIGHT_BITS;
+		g >>= AA_WEIGHT_BITS;
+		b >>= AA_WEIGHT_BITS;
+		//check for overflow
+		row->r[i] = r > 255 ? 255 : r;
+		row->g[i] = g > 255 ? 255 : g;
+		row->b[i] = b > 255 ? 255 : b;
+
+		// The light variance is only taken from the first point,
+		// but weighed as if blended
+		ex = sp->elev_x + job->offset;
+		if (ex >= MAP_WIDTH)
+			ex -= MAP_WIDTH;
+		row->lvf[i] = (int)(job->elevs[sp->elev_row + ex] * sp->msum)
+				>> AA_WEIGHT_BITS;
+
+		row->diffus[i] = light_diff[y][x];
+	}
 }
 
-static inline int
-get_map_elev (SBYTE *elevs, int x, int y, int offset)
+// Applies the lighting model to the 'n' gathered pixels of 'row'.
+// The loops have no data-dependent branches, so that the compiler can
+// vectorize them.
+static void
+LightSphereRow (SPHERE_ROW *row, const SPHERE_JOB *job, int n)
 {
-	return elevs[y * MAP_WIDTH + (offset + x) % MAP_WIDTH];
+	int i;
+
+	if (job->shielded)
+	{
+		for (i = 0; i < n; ++i)
+		{
+			int r;
+
+			// add lite red filter (3/4) component
+			row->g[i] = (row->g[i] >> 1) + (row->g[i] >> 2);
+			row->b[i] = (row->b[i] >> 1) + (row->b[i] >> 2);
+
+			row->r[i] = calc_map_light (row->r[i], row->diffus[i],
+					row->lvf[i]);
+			row->g[i] = calc_map_light (row->g[i], row->diffus[i],
+					row->lvf[i]);
+			row->b[i] = calc_map_light (row->b[i], row->diffus[i],
+					row->lvf[i]);
+
+			// The shield is glow + reflect (+ filter for others)
+			r = calc_map_light (SHIELD_REFLECT_COMP, row->diffus[i], 0);
+			r += SHIELD_GLOW_COMP;
+			// adjust red level for throbbing shield
+			r = r * job->shieldLevel / THROB_MAX_LEVEL;
+
+			r += row->r[i];
+			if (r > 255)
+				r = 255;
+			row->r[i] = r;
+		}
+	}
+	else
+	{
+		for (i = 0; i < n; ++i)
+		{
+			row->r[i] = calc_map_light (row->r[i], row->diffus[i],
+					row->lvf[i]);
+			row->g[i] = calc_map_light (row->g[i], row->diffus[i],
+					row->lvf[i]);
+			row->b[i] = calc_map_light (row->b[i], row->diffus[i],
+					row->lvf[i]);
+		}
+	}
+}
+
+static void
+RenderSphereRow (const SPHERE_JOB *job, int y)
+{
+	const SPHERE_SPAN *span = &sphere_span[y];
+	const Color clear = BUILD_COLOR_RGBA (0, 0, 0, 0);
+	Color *pix = job->dst + y * DIAMETER;
+	SPHERE_ROW row;
+	int n = span->x1 - span->x0;
+	int i, x;
+
+	for (x = 0; x < span->x0; ++x)
+		pix[x] = clear;
+	for (x = span->x1; x < DIAMETER; ++x)
+		pix[x] = clear;
+	if (n <= 0)
+		return;
+
+	GatherSphereRow (&row, job, y);
+	LightSphereRow (&row, job, n);
+
+	// Zero diffusion within the span is the antialiased edge
+	for (i = 0, pix += span->x0; i < n; ++i, ++pix)
+	{
+		if (row.diffus[i] == 0)
+			*pix = clear;
+		else
+			*pix = BUILD_COLOR_RGBA (row.r[i], row.g[i], row.b[i], 0xff);
+	}
+}
+
+static void
+RenderSphereBands (void)
+{
+	for (;;)
+	{
+		int y0, y1;
+
+		LockMutex (sphereLock);
+		y0 = sphereJob.nextRow;
+		if (y0 < DIAMETER)
+			sphereJob.nextRow += SPHERE_BAND_ROWS;
+		UnlockMutex (sphereLock);
+
+		if (y0 >= DIAMETER)
+			break;
+
+		y1 = y0 + SPHERE_BAND_ROWS;
+		if (y1 > DIAMETER)
+			y1 = DIAMETER;
+		for (; y0 < y1; ++y0)
+			RenderSphereRow (&sphereJob, y0);
+	}
+}
+
+static int
+SphereWorkerFunc (void *data)
+{
+	LockMutex (sphereLock);
+	sphereWorkersRunning++;
+	UnlockMutex (sphereLock);
+
+	for (;;)
+	{
+		SetSemaphore (sphereWork);
+		if (sphereWorkersQuit)
+			break;
+
+		RenderSphereBands ();
+		ClearSemaphore (sphereDone);
+	}
+
+	ClearSemaphore (sphereExit);
+	(void) data;
+	return 0;
+}
+
+// Workers are started lazily. They are born asynchronously (see
+// StartThread()), and until they are running the calling thread simply
+// renders more of the bands itself.
+static void
+StartSphereWorkers (int count)
+{
+	if (!sphereLock)
+	{
+		sphereLock = CreateMutex ("Sphere job lock", SYNC_CLASS_VIDEO);
+		sphereWork = CreateSemaphore (0, "Sphere work", SYNC_CLASS_VIDEO);
+		sphereDone = CreateSemaphore (0, "Sphere done", SYNC_CLASS_VIDEO);
+		sphereExit = CreateSemaphore (0, "Sphere exit", SYNC_CLASS_VIDEO);
+	}
+
+	for (; sphereWorkersStarted < count; ++sphereWorkersStarted)
+		StartThread (SphereWorkerFunc, NULL, 1024, "sphere worker");
+}
+
+void
+StopSphereWorkers (void)
+{
+	int running;
+	int i;
+
+	if (!sphereLock)
+		return;
+
+	LockMutex (sphereLock);
+	sphereWorkersQuit = TRUE;
+	running = sphereWorkersRunning;
+	UnlockMutex (sphereLock);
+
+	for (i = 0; i < sphereWorkersStarted; ++i)
+		ClearSemaphore (sphereWork);
+	for (i = 0; i < running; ++i)
+		SetSemaphore (sphereExit);
+
+	if (running != sphereWorkersStarted)
+	{	// A worker that was never born would still wake up to find
+		// the lock gone. Leave the synchronization objects alone, and
+		// render on the calling thread only from now on.
+		log_add (log_Warning, "StopSphereWorkers(): %d of %d sphere "
+				"workers never started", sphereWorkersStarted - running,
+				sphereWorkersStarted);
+		return;
+	}
+
+	DestroySemaphore (sphereExit);
+	DestroySemaphore (sphereDone);
+	DestroySemaphore (sphereWork);
+	DestroyMutex (sphereLock);
+	sphereExit = sphereDone = sphereWork = NULL;
+	sphereLock = NULL;
+	sphereWorkersStarted = 0;
+	sphereWorkersRunning = 0;
+	sphereWorkersQuit = FALSE;
+}
+
+// Reports the time spent rendering the sphere, once per revolution.
+// The time counter is coarser than a frame, but the rounding errors
+// even out over the revolution.
+static void
+UpdateSphereStats (TimePeriod elapsed, int threads)
+{
+	static TimePeriod total;
+	static COUNT frames;
+
+	total += elapsed;
+	if (++frames < MAP_WIDTH)
+		return;
+
+	log_add (log_User, "Planet rotation: %u frames in %lu ms, "
+			"%.3f ms/frame, %d thread(s)", frames,
+			(unsigned long) total * 1000 / ONE_SECOND,
+			(double) total * 1000 / ONE_SECOND / frames, threads);
+	total = 0;
+	frames = 0;
 }
 
 // RenderPlanetSphere builds a frame for the rotating planet view
 // offset is effectively the angle of rotation around the planet's axis
-// We use the SDL routines to directly write to the SDL_Surface to improve performance
+// The rows are independent; with optSphereThreads > 1 they are rendered
+// in bands on a small pool of worker threads, the calling thread taking
+// a share of the bands itself.
 void
 RenderPlanetSphere (FRAME MaskFrame, int offset, BOOLEAN doThrob)
 {
 	PLANET_ORBIT *Orbit = &pSolarSysState->Orbit;
-	POINT pt;
-	Color *pix;
-	Color clear;
-	int x, y;
-	Color *pixels;
-	SBYTE *elevs;
-	int shLevel;
-
-#if PROFILE_ROTATION
-	static clock_t t = 0;
-	static int frames_done = 1;
-	clock_t t1;
-	t1 = clock ();
-#endif
-
-
-	shLevel = shield_level (offset);
-
-	pix = Orbit->ScratchArray;
-	clear = BUILD_COLOR_RGBA (0, 0, 0, 0);
-	pixels = Orbit->TopoColors + offset;
-	elevs = Orbit->lpTopoData;
-	
-	for (pt.y = 0, y = -RADIUS; pt.y <= TWORADIUS; ++pt.y, ++y)
+	int threads = optSphereThreads;
+	int helpers = 0;
+	int i;
+	TimeCount start = 0;
+
+	if (optSphereStats)
+		start = GetTimeCounter ();
+
+	sphereJob.pixels = Orbit->TopoColors + offset;
+	sphereJob.elevs = Orbit->lpTopoData;
+	sphereJob.offset = offset;
+	sphereJob.shielded = (pSolarSysState->pOrbitalDesc->data_index
+			& PLANET_SHIELDED) != 0;
+	sphereJob.shieldLevel = doThrob ? shield_level (offset)
+			: THROB_MAX_LEVEL;
+	sphereJob.dst = Orbit->ScratchArray;
+	sphereJob.nextRow = 0;
+
+	if (threads > SPHERE_MAX_THREADS)
+		threads = SPHERE_MAX_THREADS;
+	if (threads > 1 && !sphereWorkersQuit)
 	{
-		for (pt.x = 0, x = -RADIUS; pt.x <= TWORADIUS; ++pt.x, ++x, ++pix)
-		{
-			Color c;
-			DWORD diffus = light_diff[pt.y][pt.x];
-			int i;
-			MAP3D_POINT *ppt = &map_rotate[pt.y][pt.x];
-			int lvf; // light variance factor
-	
-			if (diffus == 0)
-			{	// full diffusion
-				*pix = clear;
-				continue;
-			}
+		StartSphereWorkers (threads - 1);
 
-			// get pixel from topo map and factor from light variance map
-			if (ppt->m[0] == 0) 
-			{	// exact pixel from the topo map
-				c = get_map_pixel (pixels, ppt->p[0].x, ppt->p[0].y);
-				lvf = get_map_elev (elevs, ppt->p[0].x, ppt->p[0].y, offset);
-			}
-			else
-			{	// fractional pixel -- blend from 4
-				Color p[4];
-				int lvsum;
-
-				// compute 'ideal' pixel
-				for (i = 0; i < 4; i++)
-					p[i] = get_map_pixel (pixels, ppt->p[i].x, ppt->p[i].y);
-				
-				c.r = get_avg_channel (p, ppt->m, 0);
-				c.g = get_avg_channel (p, ppt->m, 1);
-				c.b = get_avg_channel (p, ppt->m, 2);
-
-				// compute 'ideal' light variance
-				for (i = 0, lvsum = 0; i < 4; i++)
-					lvsum += get_map_elev (elevs, ppt->p[0].x, ppt->p[0].y,
-							offset) * ppt->m[i];
-				lvf = lvsum >> AA_WEIGHT_BITS;
-			}
-		
-			// Apply the lighting model.  This also bounds the sphere
-			// to make it circular.
-			if (pSolarSysState->pOrbitalDesc->data_index & PLANET_SHIELDED)
-			{
-				int r;
-				
-				// add lite red filter (3/4) component
-				c.g = (c.g >> 1) + (c.g >> 2);
-				c.b = (c.b >> 1) + (c.b >> 2);
+		LockMutex (sphereLock);
+		helpers = sphereWorkersRunning;
+		UnlockMutex (sphereLock);
+		if (helpers > threads - 1)
+			helpers = threads - 1;
+	}
 
-				c.r = calc_map_light (c.r, diffus, lvf);
-				c.g = calc_map_light (c.g, diffus, lvf);
-				c.b = calc_map_light (c.b, diffus, lvf);
+	if (helpers < 1)
+	{
+		int y;
 
-				// The shield is glow + reflect (+ filter for others)
-				r = calc_map_light (SHIELD_REFLECT_COMP, diffus, 0);
-				r += SHIELD_GLOW_COMP;
-				
-				if (doThrob)
-				{	// adjust red level for throbbing shield
-					r = r * shLevel / THROB_MAX_LEVEL;
-				}
+		for (y = 0; y < DIAMETER; ++y)
+			RenderSphereRow (&sphereJob, y);
+	}
+	else
+	{
+		for (i = 0; i < helpers; ++i)
+			ClearSemaphore (sphereWork);
 
-				r += c.r;
-				if (r > 255)
-					r = 255;
-				c.r = r;
-			} 
-			else
-			{
-				c.r = calc_map_light (c.r, diffus, lvf);
-				c.g = calc_map_light (c.g, diffus, lvf);
-				c.b = calc_map_light (c.b, diffus, lvf);
-			}
+		RenderSphereBands ();
 
-			c.a = 0xff;
-			*pix = c;
-		}
+		for (i = 0; i < helpers; ++i)
+			SetSemaphore (sphereDone);
 	}
 	
 	WriteFramePixelColors (MaskFrame, Orbit->ScratchArray, DIAMETER, DIAMETER);
 	SetFrameHot (MaskFrame, MAKE_HOT_SPOT (RADIUS + 1, RADIUS + 1));
 
-#if PROFILE_ROTATION
-	t += clock() - t1;
-	if (frames_done == MAP_WIDTH)
-	{
-		log_add (log_Debug, "Rotation frames/sec: %d/%ld(msec)=%f",
-				frames_done,
-				(long int) (((double)t / CLOCKS_PER_SEC) * 1000.0 + 0.5),
-				frames_done / ((double)t / CLOCKS_PER_SEC + 0.5));
-		frames_done = 1;
-		t = clock () - t1;
-	}
-	else
-		frames_done++;
-#endif
+	if (optSphereStats)
+		UpdateSphereStats (GetTimeCounter () - start, helpers + 1);
 }
 
 
@@ -1731,6 +1970,10 @@ GeneratePlanetSurface (PLANET_DESC *pPlanetDesc, FRAME SurfDefFrame)
 	CONTEXT TopoContext;
 	PLANET_ORBIT *Orbit = &pSolarSysState->Orbit;
 	BOOLEAN shielded = (pPlanetDesc->data_index & PLANET_SHIELDED) != 0;
+	BOOLEAN cached = FALSE;
+	PLANET_SURFACE surf;
+	SBYTE *pGenTopo = NULL;
+	SBYTE *pScaledTopo = NULL;
 
 	RandomContext_SeedRandom (SysGenRNG, pPlanetDesc->rand_seed);
 
@@ -1797,6 +2040,14 @@ GeneratePlanetSurface (PLANET_DESC *pPlanetDesc, FRAME SurfDefFrame)
 		r.corner.x = r.corner.y = 0;
 		r.extent.width = MAP_WIDTH;
 		r.extent.height = MAP_HEIGHT;
+		cached = FindPlanetSurface (pPlanetDesc->data_index,
+				pPlanetDesc->rand_seed, &surf);
+		if (cached)
+		{	// Seen before; the colours are still rendered below, as
+			// they depend on the temperature
+			memcpy (Orbit->lpTopoData, surf.topo, MAP_WIDTH * MAP_HEIGHT);
+		}
+		else
 		{
 			memset (Orbit->lpTopoData, 0, MAP_WIDTH * MAP_HEIGHT);
 			switch (PLANALGO (PlanDataPtr->Type))
@@ -1857,6 +2108,12 @@ GeneratePlanetSurface (PLANET_DESC *pPlanetDesc, FRAME SurfDefFrame)
 					ValidateMap (Orbit->lpTopoData);
 					break;
 			}
+
+			// The light map replaces the elevation data below; keep it
+			// for the cache
+			pGenTopo = HMalloc (MAP_WIDTH * MAP_HEIGHT);
+			if (pGenTopo)
+				memcpy (pGenTopo, Orbit->lpTopoData, MAP_WIDTH * MAP_HEIGHT);
 		}
 		pSolarSysState->TopoFrame = CaptureDrawable (
 				CreateDrawable (WANT_PIXMAP, (SIZE)MAP_WIDTH,
@@ -1889,16 +2146,23 @@ GeneratePlanetSurface (PLANET_DESC *pPlanetDesc, FRAME SurfDefFrame)
 	if (!shielded && PlanetInfo->AtmoDensity != GAS_GIANT_ATMOSPHERE)
 	{	// produce 4x scaled topo image for Planetside
 		// for the planets that we can land on
-		SBYTE *pScaledTopo = HMalloc (MAP_WIDTH * 4 * MAP_HEIGHT * 4);
-		if (pScaledTopo)
+		if (cached && surf.zoom)
 		{
-			TopoScale4x (pScaledTopo, Orbit->lpTopoData,
-					PlanDataPtr->num_faults, PlanDataPtr->fault_depth
-					* (PLANALGO (PlanDataPtr->Type) == CRATERED_ALGO ? 2 : 1  ));
-			RenderTopography (Orbit->TopoZoomFrame, pScaledTopo,
+			RenderTopography (Orbit->TopoZoomFrame, (SBYTE *)surf.zoom,
 					MAP_WIDTH * 4, MAP_HEIGHT * 4);
-
-			HFree (pScaledTopo);
+		}
+		else
+		{
+			pScaledTopo = HMalloc (MAP_WIDTH * 4 * MAP_HEIGHT * 4);
+			if (pScaledTopo)
+			{
+				TopoScale4x (pScaledTopo, Orbit->lpTopoData,
+						PlanDataPtr->num_faults, PlanDataPtr->fault_depth
+						* (PLANALGO (PlanDataPtr->Type) == CRATERED_ALGO
+						? 2 : 1  ));
+				RenderTopography (Orbit->TopoZoomFrame, pScaledTopo,
+						MAP_WIDTH * 4, MAP_HEIGHT * 4);
+			}
 		}
 	}
 
@@ -1915,7 +2179,11 @@ GeneratePlanetSurface (PLANET_DESC *pPlanetDesc, FRAME SurfDefFrame)
 		memcpy (Orbit->TopoColors + y + MAP_WIDTH, Orbit->TopoColors + y,
 				SPHERE_SPAN_X * sizeof (Orbit->TopoColors[0]));
 
-	if (PLANALGO (PlanDataPtr->Type) != GAS_GIANT_ALGO)
+	if (cached)
+	{
+		memcpy (Orbit->lpTopoData, surf.light, MAP_WIDTH * MAP_HEIGHT);
+	}
+	else if (PLANALGO (PlanDataPtr->Type) != GAS_GIANT_ALGO)
 	{	// convert topo data to a light map, based on relative
 		// map point elevations
 		GenerateLightMap (Orbit->lpTopoData, MAP_WIDTH, MAP_HEIGHT);
@@ -1924,6 +2192,17 @@ GeneratePlanetSurface (PLANET_DESC *pPlanetDesc, FRAME SurfDefFrame)
 	{	// gas giants are pretty much flat
 		memset (Orbit->lpTopoData, 0, MAP_WIDTH * MAP_HEIGHT);
 	}
+
+	if (pGenTopo)
+	{	// Freshly generated; keep it for the next visit
+		surf.topo = pGenTopo;
+		surf.light = Orbit->lpTopoData;
+		surf.zoom = pScaledTopo;
+		AddPlanetSurface (pPlanetDesc->data_index, pPlanetDesc->rand_seed,
+				&surf);
+		HFree (pGenTopo);
+	}
+	HFree (pScaledTopo);
 			
 	if (pSolarSysState->pOrbitalDesc->pPrevDesc ==
 			&pSolarSysState->SunDesc[0])
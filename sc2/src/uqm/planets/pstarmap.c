@@ -700,12 +700,14 @@ UpdateCursorInfo (UNICODE *prevbuf)
 	POINT pt;
 	STAR_DESC *SDPtr;
 	STAR_DESC *BestSDPtr;
+	STAR_SEARCH search;
 
 	pt.x = UNIVERSE_TO_DISPX (cursorLoc.x);
 	pt.y = UNIVERSE_TO_DISPY (cursorLoc.y);
 
-	SDPtr = BestSDPtr = 0;
-	while ((SDPtr = FindStar (SDPtr, &cursorLoc, 75, 75)))
+	BestSDPtr = 0;
+	StartStarSearch (&search, &cursorLoc, 75, 75);
+	while ((SDPtr = NextFoundStar (&search)))
 	{
 		if (UNIVERSE_TO_DISPX (SDPtr->star_pt.x) == pt.x
 				&& UNIVERSE_TO_DISPY (SDPtr->star_pt.y) == pt.y
@@ -713,6 +715,7 @@ UpdateCursorInfo (UNICODE *prevbuf)
 				|| STAR_TYPE (SDPtr->Type) >= STAR_TYPE (BestSDPtr->Type)))
 			BestSDPtr = SDPtr;
 	}
+	EndStarSearch (&search);
 
 	if (BestSDPtr)
 	{
@@ -0,0 +1,496 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "surfcache.h"
+
+#include "planets.h"
+#include "options.h"
+#include "libs/log.h"
+#include "libs/memlib.h"
+#include "libs/reslib.h"
+#include "libs/uio.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_ZIP
+#	include <zlib.h>
+#endif
+
+#define SURF_TAG 0x46525350
+		// "PSRF"
+#define SURF_HEADER_SIZE 32
+#define SURF_COMPRESSED (1 << 0)
+#define SURF_HAS_ZOOM   (1 << 1)
+
+#define SURF_DIR "cache"
+#define SURF_EXT ".topo"
+
+#define TOPO_SIZE (MAP_WIDTH * MAP_HEIGHT)
+#define ZOOM_SIZE (MAP_WIDTH * 4 * MAP_HEIGHT * 4)
+
+typedef struct surf_entry SURF_ENTRY;
+
+struct surf_entry
+{
+	SURF_ENTRY *prev;
+	SURF_ENTRY *next;
+			// In order of use, most recent first
+	BYTE data_index;
+	DWORD rand_seed;
+	size_t size;
+			// Size of the entry including the maps
+	PLANET_SURFACE surf;
+	SBYTE data[1];
+			// topo, then light, then zoom
+};
+
+static SURF_ENTRY *surf_head;
+static SURF_ENTRY *surf_tail;
+static size_t surf_mem_size;
+
+static uio_DirHandle *surfDir;
+static BOOLEAN surfDirFailed;
+static long surfDirSize = -1;
+		// Bytes in the files in surfDir; -1 until they have been counted
+
+
+static void
+unlinkEntry (SURF_ENTRY *e)
+{
+	if (e->prev)
+		e->prev->next = e->next;
+	else
+		surf_head = e->next;
+	if (e->next)
+		e->next->prev = e->prev;
+	else
+		surf_tail = e->prev;
+	surf_mem_size -= e->size;
+}
+
+static void
+linkEntry (SURF_ENTRY *e)
+{
+	e->prev = NULL;
+	e->next = surf_head;
+	if (surf_head)
+		surf_head->prev = e;
+	else
+		surf_tail = e;
+	surf_head = e;
+	surf_mem_size += e->size;
+}
+
+static SURF_ENTRY *
+findEntry (BYTE data_index, DWORD rand_seed)
+{
+	SURF_ENTRY *e;
+
+	for (e = surf_head; e; e = e->next)
+	{
+		if (e->data_index == data_index && e->rand_seed == rand_seed)
+			return e;
+	}
+	return NULL;
+}
+
+static SURF_ENTRY *
+allocEntry (BYTE data_index, DWORD rand_seed, BOOLEAN hasZoom)
+{
+	SURF_ENTRY *e;
+	size_t size;
+
+	size = sizeof (*e) + TOPO_SIZE * 2 + (hasZoom ? ZOOM_SIZE : 0);
+	e = HMalloc (size);
+	if (!e)
+		return NULL;
+
+	e->data_index = data_index;
+	e->rand_seed = rand_seed;
+	e->size = size;
+	e->surf.topo = e->data;
+	e->surf.light = e->data + TOPO_SIZE;
+	e->surf.zoom = hasZoom ? e->data + TOPO_SIZE * 2 : NULL;
+	return e;
+}
+
+static size_t
+entryDataSize (const SURF_ENTRY *e)
+{
+	return TOPO_SIZE * 2 + (e->surf.zoom ? ZOOM_SIZE : 0);
+}
+
+// Puts 'e' in front, and drops the least recently used entries that do
+// not fit anymore. 'e' itself is always kept.
+static void
+addEntry (SURF_ENTRY *e)
+{
+	linkEntry (e);
+	while (surf_mem_size > PLANSURF_MEM_SIZE && surf_tail != e)
+	{
+		SURF_ENTRY *old = surf_tail;
+		unlinkEntry (old);
+		HFree (old);
+	}
+}
+
+static void
+surfFileName (char *buf, size_t size, BYTE data_index, DWORD rand_seed)
+{
+	snprintf (buf, size, "%02x-%08lx" SURF_EXT, data_index,
+			(unsigned long) rand_seed);
+}
+
+static uio_DirHandle *
+openSurfDir (void)
+{
+	if (surfDir || surfDirFailed)
+		return surfDir;
+
+	if (configDir)
+	{
+		uio_mkdir (configDir, SURF_DIR, 0777);
+				// May already exist
+		surfDir = uio_openDirRelative (configDir, SURF_DIR, 0);
+	}
+	if (!surfDir)
+	{
+		log_add (log_Warning, "Planet surface cache: could not open the "
+				"'" SURF_DIR "' dir; surfaces will not be kept on disk");
+		surfDirFailed = TRUE;
+	}
+	return surfDir;
+}
+
+static void
+storeLE32 (BYTE *p, DWORD v)
+{
+	p[0] = (BYTE)( v        & 0xff);
+	p[1] = (BYTE)((v >>  8) & 0xff);
+	p[2] = (BYTE)((v >> 16) & 0xff);
+	p[3] = (BYTE)((v >> 24) & 0xff);
+}
+
+static DWORD
+loadLE32 (const BYTE *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((DWORD) p[3] << 24);
+}
+
+static SURF_ENTRY *
+readSurfFile (BYTE data_index, DWORD rand_seed)
+{
+	uio_DirHandle *dir;
+	char file[32];
+	uio_Stream *fp;
+	BYTE header[SURF_HEADER_SIZE];
+	BYTE *buf = NULL;
+	size_t len;
+	DWORD flags;
+	SURF_ENTRY *e = NULL;
+
+	dir = openSurfDir ();
+	if (!dir)
+		return NULL;
+
+	surfFileName (file, sizeof file, data_index, rand_seed);
+	fp = res_OpenResFile (dir, file, "rb");
+	if (!fp)
+		return NULL;
+
+	len = LengthResFile (fp);
+	if (len < SURF_HEADER_SIZE
+			|| ReadResFile (header, 1, SURF_HEADER_SIZE, fp)
+			!= SURF_HEADER_SIZE)
+		goto out;
+	len -= SURF_HEADER_SIZE;
+
+	flags = loadLE32 (header + 24);
+	if (loadLE32 (header) != SURF_TAG
+			|| loadLE32 (header + 4) != PLANSURF_VERSION
+			|| loadLE32 (header + 8) != data_index
+			|| loadLE32 (header + 12) != rand_seed
+			|| loadLE32 (header + 16) != MAP_WIDTH
+			|| loadLE32 (header + 20) != MAP_HEIGHT)
+		goto out;  // Stale; it will be replaced
+
+	e = allocEntry (data_index, rand_seed, (flags & SURF_HAS_ZOOM) != 0);
+	if (!e || loadLE32 (header + 28) != entryDataSize (e))
+		goto fail;
+
+	if (flags & SURF_COMPRESSED)
+	{
+#ifdef HAVE_ZIP
+		uLongf ulen = entryDataSize (e);
+
+		buf = HMalloc (len);
+		if (!buf || ReadResFile (buf, 1, len, fp) != len
+				|| uncompress ((Bytef *) e->data, &ulen, buf, len) != Z_OK
+				|| ulen != entryDataSize (e))
+			goto fail;
+#else
+		goto fail;
+#endif
+	}
+	else if (len != entryDataSize (e)
+			|| ReadResFile (e->data, 1, len, fp) != len)
+	{
+		goto fail;
+	}
+	goto out;
+
+fail:
+	log_add (log_Warning, "Planet surface cache: '%s' is corrupt or "
+			"unreadable; regenerating", file);
+	HFree (e);
+	e = NULL;
+out:
+	HFree (buf);
+	res_CloseResFile (fp);
+	return e;
+}
+
+// Writes the tag of a file over itself, so that its modification time
+// tells pruneSurfDir() that it was used recently.
+static void
+touchSurfFile (BYTE data_index, DWORD rand_seed)
+{
+	uio_DirHandle *dir;
+	char file[32];
+	uio_Handle *handle;
+	BYTE tag[4];
+
+	dir = openSurfDir ();
+	if (!dir)
+		return;
+
+	surfFileName (file, sizeof file, data_index, rand_seed);
+	handle = uio_open (dir, file, O_WRONLY
+#ifdef WIN32
+			| O_BINARY
+#endif
+			, 0);
+	if (!handle)
+		return;
+	storeLE32 (tag, SURF_TAG);
+	uio_write (handle, tag, sizeof tag);
+	uio_close (handle);
+}
+
+// Counts the bytes in the files in the dir. If there are more than
+// PLANSURF_DISK_SIZE, drops the least recently used files until those
+// left take up no more than 7/8 of that, so that a number of new files
+// fit before the dir has to be gone through again.
+static void
+pruneSurfDir (uio_DirHandle *dir)
+{
+	uio_DirList *list;
+	struct stat *st;
+	long total = 0;
+	long keep;
+	int i;
+
+	list = uio_getDirList (dir, "", SURF_EXT, match_MATCH_SUFFIX);
+	if (!list)
+		return;
+
+	st = HMalloc (sizeof (*st) * (list->numNames + 1));
+	if (!st)
+	{
+		uio_DirList_free (list);
+		return;
+	}
+
+	for (i = 0; i < list->numNames; ++i)
+	{
+		if (uio_stat (dir, list->names[i], &st[i]) == 0)
+			total += st[i].st_size;
+		else
+			st[i].st_size = 0;
+	}
+
+	keep = total;
+	if (total > PLANSURF_DISK_SIZE)
+		keep = PLANSURF_DISK_SIZE - PLANSURF_DISK_SIZE / 8;
+	while (total > keep)
+	{
+		int oldest = -1;
+
+		for (i = 0; i < list->numNames; ++i)
+		{
+			if (st[i].st_size == 0)
+				continue;
+			if (oldest < 0 || st[i].st_mtime < st[oldest].st_mtime)
+				oldest = i;
+		}
+		if (oldest < 0)
+			break;
+
+		DeleteResFile (dir, list->names[oldest]);
+		total -= st[oldest].st_size;
+		st[oldest].st_size = 0;
+	}
+
+	surfDirSize = total;
+
+	HFree (st);
+	uio_DirList_free (list);
+}
+
+static void
+writeSurfFile (const SURF_ENTRY *e)
+{
+	uio_DirHandle *dir;
+	char file[32];
+	uio_Stream *fp;
+	BYTE header[SURF_HEADER_SIZE];
+	const BYTE *data = (const BYTE *) e->data;
+	size_t len = entryDataSize (e);
+	DWORD flags = e->surf.zoom ? SURF_HAS_ZOOM : 0;
+	BOOLEAN ok;
+	struct stat sb;
+	long oldSize = 0;
+#ifdef HAVE_ZIP
+	BYTE *packed;
+	uLongf zlen = compressBound (len);
+#endif
+
+	dir = openSurfDir ();
+	if (!dir)
+		return;
+
+#ifdef HAVE_ZIP
+	packed = HMalloc (zlen);
+	if (packed && compress2 (packed, &zlen, data, len,
+			Z_BEST_SPEED) == Z_OK)
+	{
+		data = packed;
+		len = zlen;
+		flags |= SURF_COMPRESSED;
+	}
+#endif
+
+	storeLE32 (header, SURF_TAG);
+	storeLE32 (header + 4, PLANSURF_VERSION);
+	storeLE32 (header + 8, e->data_index);
+	storeLE32 (header + 12, e->rand_seed);
+	storeLE32 (header + 16, MAP_WIDTH);
+	storeLE32 (header + 20, MAP_HEIGHT);
+	storeLE32 (header + 24, flags);
+	storeLE32 (header + 28, entryDataSize (e));
+
+	surfFileName (file, sizeof file, e->data_index, e->rand_seed);
+	if (uio_stat (dir, file, &sb) == 0)
+		oldSize = sb.st_size;
+			// A stale file that is replaced
+	fp = res_OpenResFile (dir, file, "wb");
+	if (fp)
+	{
+		if (surfDirSize >= 0)
+			surfDirSize -= oldSize;
+
+		ok = WriteResFile (header, 1, SURF_HEADER_SIZE, fp)
+				== SURF_HEADER_SIZE
+				&& WriteResFile (data, 1, len, fp) == len;
+		if (uio_fclose (fp) != 0)
+			ok = FALSE;
+		if (!ok)
+		{
+			log_add (log_Warning, "Planet surface cache: could not "
+					"write '%s'", file);
+			DeleteResFile (dir, file);
+		}
+		else if (surfDirSize >= 0)
+			surfDirSize += SURF_HEADER_SIZE + len;
+
+		if (surfDirSize < 0 || surfDirSize > PLANSURF_DISK_SIZE)
+			pruneSurfDir (dir);
+	}
+
+#ifdef HAVE_ZIP
+	HFree (packed);
+#endif
+}
+
+BOOLEAN
+FindPlanetSurface (BYTE data_index, DWORD rand_seed, PLANET_SURFACE *surf)
+{
+	SURF_ENTRY *e;
+
+	e = findEntry (data_index, rand_seed);
+	if (e)
+	{
+		unlinkEntry (e);
+	}
+	else
+	{
+		e = readSurfFile (data_index, rand_seed);
+		if (!e)
+			return FALSE;
+	}
+
+	addEntry (e);
+	touchSurfFile (data_index, rand_seed);
+	*surf = e->surf;
+	return TRUE;
+}
+
+void
+AddPlanetSurface (BYTE data_index, DWORD rand_seed,
+		const PLANET_SURFACE *surf)
+{
+	SURF_ENTRY *e;
+
+	e = findEntry (data_index, rand_seed);
+	if (e)
+	{
+		unlinkEntry (e);
+		HFree (e);
+	}
+
+	e = allocEntry (data_index, rand_seed, surf->zoom != NULL);
+	if (!e)
+		return;
+
+	memcpy (e->data, surf->topo, TOPO_SIZE);
+	memcpy (e->data + TOPO_SIZE, surf->light, TOPO_SIZE);
+	if (surf->zoom)
+		memcpy (e->data + TOPO_SIZE * 2, surf->zoom, ZOOM_SIZE);
+
+	addEntry (e);
+	writeSurfFile (e);
+}
+
+void
+UninitPlanetSurfaceCache (void)
+{
+	while (surf_head)
+	{
+		SURF_ENTRY *e = surf_head;
+		unlinkEntry (e);
+		HFree (e);
+	}
+
+	if (surfDir)
+	{
+		uio_closeDir (surfDir);
+		surfDir = NULL;
+	}
+	surfDirFailed = FALSE;
+	surfDirSize = -1;
+}
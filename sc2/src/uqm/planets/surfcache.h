@@ -0,0 +1,71 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef UQM_PLANETS_SURFCACHE_H_
+#define UQM_PLANETS_SURFCACHE_H_
+
+#include "libs/compiler.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Cache of generated planet surfaces.
+//
+// A generated surface only depends on the planet type (data_index,
+// including the PLANET_SHIELDED bit) and on its rand_seed, so the
+// output of the generator is kept, in memory and in the "cache" dir
+// in the config dir, and reused when the planet is visited again.
+// What is kept is the elevation map, the light map made from it and the
+// 4x scaled elevation map for planetside, if the planet has one. The
+// colours depend on the planet temperature and are rendered from these
+// every time.
+//
+// The cache in memory is limited to PLANSURF_MEM_SIZE bytes and drops
+// the least recently used surfaces first. The cache on disk is limited
+// to PLANSURF_DISK_SIZE bytes and drops the least recently used files
+// first.
+// PLANSURF_VERSION must be increased whenever the generator changes its
+// output; files of another version are ignored and replaced.
+
+#define PLANSURF_VERSION 1
+
+#define PLANSURF_MEM_SIZE  (4 * 1024 * 1024)
+#define PLANSURF_DISK_SIZE (32 * 1024 * 1024)
+
+typedef struct
+{
+	const SBYTE *topo;
+			// Elevation map, MAP_WIDTH x MAP_HEIGHT
+	const SBYTE *light;
+			// Light map, MAP_WIDTH x MAP_HEIGHT
+	const SBYTE *zoom;
+			// 4x scaled elevation map, (MAP_WIDTH * 4) x (MAP_HEIGHT * 4),
+			// or NULL if the planet has none
+} PLANET_SURFACE;
+
+// The data returned stays valid until the next call to any of these.
+extern BOOLEAN FindPlanetSurface (BYTE data_index, DWORD rand_seed,
+		PLANET_SURFACE *surf);
+extern void AddPlanetSurface (BYTE data_index, DWORD rand_seed,
+		const PLANET_SURFACE *surf);
+extern void UninitPlanetSurfaceCache (void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif  /* UQM_PLANETS_SURFCACHE_H_ */
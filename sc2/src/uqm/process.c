@@ -19,6 +19,7 @@
 #include "process.h"
 
 #include "races.h"
+#include "broadphase.h"
 #include "collide.h"
 #include "options.h"
 #include "settings.h"
@@ -33,12 +34,16 @@
 #include "libs/graphics/gfx_common.h"
 #include "libs/log.h"
 #include "libs/misc.h"
+#include "libs/proflib.h"
 
 
 //#define DEBUG_PROCESS
 
 COUNT DisplayFreeList;
-PRIMITIVE DisplayArray[MAX_DISPLAY_PRIMS];
+PRIMITIVE *DisplayArray;
+static COUNT DisplayArraySize;
+static COUNT DisplayPrimsUsed;
+static COUNT DisplayPrimsHighWater;
 extern POINT SpaceOrg;
 
 SIZE zoom_out = 1 << ZOOM_SHIFT;
@@ -73,6 +78,127 @@ CALC_ZOOM_STUFF (COUNT* idx, COUNT* sc)
 }
 #endif
 
+// Adds DISPLAY_PRIM_CHUNK primitives to the head of the free list.
+static BOOLEAN
+GrowDisplayArray (void)
+{
+	PRIMITIVE *NewArray;
+	COUNT NewSize, i;
+
+	if (DisplayArraySize >= MAX_DISPLAY_PRIMS - DISPLAY_PRIM_CHUNK)
+		return FALSE;
+
+	NewSize = DisplayArraySize + DISPLAY_PRIM_CHUNK;
+	NewArray = HRealloc (DisplayArray, NewSize * sizeof (PRIMITIVE));
+	if (NewArray == NULL)
+		return FALSE;
+
+	DisplayArray = NewArray;
+	GLOBAL (DisplayArray) = DisplayArray;
+
+	for (i = DisplayArraySize; i < NewSize; ++i)
+		SetPrimLinks (&DisplayArray[i], END_OF_LIST, i + 1);
+	SetPrimLinks (&DisplayArray[NewSize - 1], END_OF_LIST, DisplayFreeList);
+	DisplayFreeList = DisplayArraySize;
+	DisplayArraySize = NewSize;
+
+	return TRUE;
+}
+
+COUNT
+AllocDisplayPrim (void)
+{
+	COUNT p;
+
+	if (DisplayFreeList == END_OF_LIST && !GrowDisplayArray ())
+		return END_OF_LIST;
+
+	p = DisplayFreeList;
+	DisplayFreeList = GetSuccLink (GetPrimLinks (&DisplayArray[p]));
+
+	if (++DisplayPrimsUsed > DisplayPrimsHighWater)
+		DisplayPrimsHighWater = DisplayPrimsUsed;
+
+	return p;
+}
+
+void
+FreeDisplayPrim (COUNT p)
+{
+	SetPrimLinks (&DisplayArray[p], END_OF_LIST, DisplayFreeList);
+	DisplayFreeList = p;
+	--DisplayPrimsUsed;
+}
+
+struct display_snapshot
+{
+	PRIMITIVE *prims;
+	COUNT num_prims;
+	COUNT prims_alloc;
+	COUNT free_list;
+	COUNT prims_used;
+	SIZE zoom_out;
+	POINT SpaceOrg;
+};
+
+DISPLAY_SNAPSHOT *
+CreateDisplaySnapshot (void)
+{
+	return HCalloc (sizeof (DISPLAY_SNAPSHOT));
+}
+
+void
+DestroyDisplaySnapshot (DISPLAY_SNAPSHOT *snap)
+{
+	if (!snap)
+		return;
+	HFree (snap->prims);
+	HFree (snap);
+}
+
+BOOLEAN
+SnapshotDisplayList (DISPLAY_SNAPSHOT *snap)
+{
+	if (DisplayArraySize > snap->prims_alloc)
+	{
+		PRIMITIVE *prims = HRealloc (snap->prims,
+				DisplayArraySize * sizeof (PRIMITIVE));
+		if (!prims)
+			return FALSE;
+		snap->prims = prims;
+		snap->prims_alloc = DisplayArraySize;
+	}
+
+	memcpy (snap->prims, DisplayArray, DisplayArraySize * sizeof (PRIMITIVE));
+	snap->num_prims = DisplayArraySize;
+	snap->free_list = DisplayFreeList;
+	snap->prims_used = DisplayPrimsUsed;
+	snap->zoom_out = zoom_out;
+	snap->SpaceOrg = SpaceOrg;
+
+	return TRUE;
+}
+
+// The display array may have grown since the snapshot was taken. It is
+// not shrunk again; the primitives it got are put on the free list.
+void
+RestoreDisplayList (const DISPLAY_SNAPSHOT *snap)
+{
+	COUNT i;
+
+	assert (snap->num_prims <= DisplayArraySize);
+	memcpy (DisplayArray, snap->prims, snap->num_prims * sizeof (PRIMITIVE));
+	DisplayFreeList = snap->free_list;
+	for (i = snap->num_prims; i < DisplayArraySize; ++i)
+	{
+		SetPrimLinks (&DisplayArray[i], END_OF_LIST, DisplayFreeList);
+		DisplayFreeList = i;
+	}
+	DisplayPrimsUsed = snap->prims_used;
+	zoom_out = snap->zoom_out;
+	SpaceOrg = snap->SpaceOrg;
+}
+
 HELEMENT
 AllocElement (void)
 {
@@ -130,6 +256,8 @@ PreProcess (ELEMENT *ElementPtr)
 {
 	ELEMENT_FLAGS state_flags;
 
+	InvalidateBroadphase ();
+
 	if (ElementPtr->life_span == 0)
 	{
 		if (ElementPtr->pParent) /* untarget this dead element */
@@ -363,11 +491,39 @@ ProcessCollisions (HELEMENT hSuccElement, ELEMENT *ElementPtr,
 		TIME_VALUE min_time, ELEMENT_FLAGS process_flags)
 {
 	HELEMENT hTestElement;
+	HELEMENT *Candidates = NULL;
+	COUNT num_candidates = 0, next_candidate = 0;
+	DWORD generation = 0;
+	BOOLEAN use_broadphase;
+
+	// Only visit the elements the broadphase says could be hit, for as
+	// long as nothing has changed since it was built. After that, carry
+	// on walking the queue from the last element visited.
+	use_broadphase = BroadphaseValid ();
+	if (use_broadphase)
+	{
+		generation = GetBroadphaseGeneration ();
+		num_candidates = QueryBroadphase (hSuccElement, ElementPtr,
+				&Candidates);
+	}
 
-	while ((hTestElement = hSuccElement) != 0)
+	for (;;)
 	{
 		ELEMENT *TestElementPtr;
 
+		if (use_broadphase
+				&& generation != GetBroadphaseGeneration ())
+			use_broadphase = FALSE;
+
+		if (use_broadphase)
+		{
+			if (next_candidate == num_candidates)
+				break;
+			hTestElement = Candidates[next_candidate++];
+		}
+		else if ((hTestElement = hSuccElement) == 0)
+			break;
+
 		LockElement (hTestElement, &TestElementPtr);
 		if (!(TestElementPtr->state_flags & process_flags))
 			PreProcess (TestElementPtr);
@@ -398,6 +554,7 @@ ProcessCollisions (HELEMENT hSuccElement, ELEMENT *ElementPtr,
 						&TestElementPtr->IntersectControl, min_time)) == 1
 						&& !((state_flags | test_state_flags) & FINITE_LIFE))
 				{
+					InvalidateBroadphase ();
 #ifdef DEBUG_PROCESS
 					log_add (log_Debug, "BAD NEWS 0x%x <--> 0x%x", ElementPtr,
 							TestElementPtr);
@@ -520,6 +677,8 @@ ProcessCollisions (HELEMENT hSuccElement, ELEMENT *ElementPtr,
 			{
 				POINT SavePt, TestSavePt;
 
+				InvalidateBroadphase ();
+
 #ifdef DEBUG_PROCESS
 				log_add (log_Debug, "0x%x <--> 0x%x at %u", ElementPtr,
 						TestElementPtr, time_val);
@@ -634,7 +793,9 @@ PreProcessQueue (SIZE *pscroll_x, SIZE *pscroll_y)
 	POINT Origin;
 	HELEMENT hElement;
 	COUNT ships_alive;
+	VIEW_STATE view_state;
 
+	PROF_BEGIN ("PreProcessQueue");
 #ifdef KDEBUG
 	log_add (log_Debug, "PreProcess:");
 #endif
@@ -649,6 +810,8 @@ PreProcessQueue (SIZE *pscroll_x, SIZE *pscroll_y)
 	Origin.x = (COORD)(LOG_SPACE_WIDTH >> 1);
 	Origin.y = (COORD)(LOG_SPACE_HEIGHT >> 1);
 
+	BeginBroadphase ();
+
 	hElement = GetHeadElement ();
 	ships_alive = 0;
 	while (hElement != 0)
@@ -664,8 +827,12 @@ PreProcessQueue (SIZE *pscroll_x, SIZE *pscroll_y)
 
 		if (CollidingElement (ElementPtr)
 				&& !(ElementPtr->state_flags & COLLISION))
+		{
+			if (!BroadphaseValid ())
+				BuildBroadphase (PRE_PROCESS);
 			ProcessCollisions (hNextElement, ElementPtr,
 					MAX_TIME_VALUE, PRE_PROCESS);
+		}
 
 		if (ElementPtr->state_flags & PLAYER_SHIP)
 		{
@@ -729,6 +896,8 @@ PreProcessQueue (SIZE *pscroll_x, SIZE *pscroll_y)
 		hElement = hNextElement;
 	}
 
+	EndBroadphase ();
+
 	if ((min_reduction > opt_max_zoom_out || min_reduction <= max_reduction)
 			&& (min_reduction = max_reduction) > opt_max_zoom_out
 			&& (min_reduction = zoom_out) > opt_max_zoom_out)
@@ -742,7 +911,10 @@ PreProcessQueue (SIZE *pscroll_x, SIZE *pscroll_y)
 #ifdef KDEBUG
 	log_add (log_Debug, "PreProcess: exit");
 #endif
-	return (CalcView (&Origin, min_reduction, pscroll_x, pscroll_y, ships_alive));
+	view_state = CalcView (&Origin, min_reduction, pscroll_x, pscroll_y,
+			ships_alive);
+	PROF_END ();
+	return (view_state);
 }
 
 void
@@ -803,6 +975,7 @@ PostProcessQueue (VIEW_STATE view_state, SIZE scroll_x,
 	SIZE reduction;
 	HELEMENT hElement;
 
+	PROF_BEGIN ("PostProcessQueue");
 #ifdef KDEBUG
 	log_add (log_Debug, "PostProcess:");
 #endif
@@ -980,6 +1153,7 @@ PostProcessQueue (VIEW_STATE view_state, SIZE scroll_x,
 #ifdef KDEBUG
 	log_add (log_Debug, "PostProcess: exit");
 #endif
+	PROF_END ();
 }
 
 void
@@ -1000,13 +1174,41 @@ InitDisplayList (void)
 
 	ReinitQueue (&disp_q);
 
-	for (i = 0; i < MAX_DISPLAY_PRIMS; ++i)
+	while (DisplayArraySize < INITIAL_DISPLAY_PRIMS)
+	{
+		if (!GrowDisplayArray ())
+		{
+			log_add (log_Fatal, "InitDisplayList: Could not allocate"
+					" display prims!");
+			explode ();
+		}
+	}
+
+	// Some code (InitGalaxy()) relies on the first primitives allocated
+	// being at the start of the array, in order.
+	for (i = 0; i < DisplayArraySize; ++i)
 		SetPrimLinks (&DisplayArray[i], END_OF_LIST, i + 1);
 	SetPrimLinks (&DisplayArray[i - 1], END_OF_LIST, END_OF_LIST);
 	DisplayFreeList = 0;
+	DisplayPrimsUsed = 0;
 	DisplayLinks = MakeLinks (END_OF_LIST, END_OF_LIST);
 }
 
+void
+UninitDisplayList (void)
+{
+	log_add (log_Info, "Display list high-water marks: %u elements (of %u),"
+			" %u primitives (of %u)", GetQueueHighWater (&disp_q),
+			GetQueueCapacity (&disp_q), DisplayPrimsHighWater,
+			DisplayArraySize);
+
+	HFree (DisplayArray);
+	DisplayArray = NULL;
+	GLOBAL (DisplayArray) = NULL;
+	DisplayArraySize = 0;
+	DisplayFreeList = END_OF_LIST;
+}
+
 UWORD nth_frame = 0;
 
 void
@@ -1060,6 +1262,27 @@ RedrawQueue (BOOLEAN clear)
 	DisplayLinks = MakeLinks (END_OF_LIST, END_OF_LIST);
 }
 
+// Advance the battle by one frame, as RedrawQueue() does, but without
+// drawing anything or playing the sounds of the frame. This is for
+// frames that have been shown already and are being recomputed.
+void
+SimulateQueue (void)
+{
+	SIZE scroll_x, scroll_y;
+	VIEW_STATE view_state;
+
+	SetContext (StatusContext);
+
+	view_state = PreProcessQueue (&scroll_x, &scroll_y);
+	PostProcessQueue (view_state, scroll_x, scroll_y);
+
+	SetContext (SpaceContext);
+	ProcessSound ((SOUND)~0, NULL);
+	FlushSounds ();
+
+	DisplayLinks = MakeLinks (END_OF_LIST, END_OF_LIST);
+}
+
 // Set the hTarget field to 0 for all elements in the display list that
 // have hTarget set to ElementPtr.
 void
@@ -26,10 +26,21 @@ extern "C" {
 #endif
 
 extern void RedrawQueue (BOOLEAN clear);
+extern void SimulateQueue (void);
 extern void InitDisplayList (void);
+extern void UninitDisplayList (void);
 extern void SetUpElement (ELEMENT *ElementPtr);
 extern void InsertPrim (PRIM_LINKS *pLinks, COUNT primIndex, COUNT iPI);
 
+// The display primitives of the elements and the view on the battle
+// (scroll position and zoom), to go with a snapshot of the disp_q.
+typedef struct display_snapshot DISPLAY_SNAPSHOT;
+
+extern DISPLAY_SNAPSHOT *CreateDisplaySnapshot (void);
+extern void DestroyDisplaySnapshot (DISPLAY_SNAPSHOT *snap);
+extern BOOLEAN SnapshotDisplayList (DISPLAY_SNAPSHOT *snap);
+extern void RestoreDisplayList (const DISPLAY_SNAPSHOT *snap);
+
 #if defined(__cplusplus)
 }
 #endif
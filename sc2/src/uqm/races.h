@@ -225,6 +225,10 @@ struct race_desc
 	void* data;  // private ship data, ship code owns this
 
 	void *CodeRef;
+
+	size_t data_size;
+			// Size of 'data'. It is plain data and is copied as such when
+			// a battle snapshot is taken (see battlesnap.h).
 };
 
 #define SHIP_BASE_COMMON \
@@ -19,6 +19,7 @@
 #include <assert.h>
 
 #include "save.h"
+#include "savefile.h"
 
 #include "build.h"
 #include "controls.h"
@@ -41,16 +42,16 @@
 #include "libs/inplib.h"
 #include "libs/log.h"
 #include "libs/memlib.h"
+#include "libs/timelib.h"
 
-// Status boolean. If for some insane reason you need to
-// save games in different threads, you'll need to
-// protect your calls to SaveGame with a mutex.
+// The save game is built in a SAVE_BUFFER and written to disk in one go
+// by SaveGame(). The write_*() helpers below append to that buffer; a
+// failed allocation clears sb->ok, after which SaveBuffer_writeFile()
+// refuses to write the image, so the result only needs to be checked at
+// the end.
 
-// It's arguably over-paranoid to check for error on
-// every single write, but this preserves the older
-// behavior.
-
-static BOOLEAN io_ok = TRUE;
+#define SAVE_BUFFER_SIZE (64 * 1024)
+		// Initial size of the image; it grows if needed.
 
 // This defines the order and the number of bits in which the game state
 // properties are saved.
@@ -702,59 +703,62 @@ const GameStateBitMap gameStateBitMap[] = {
 };
 
 
-// XXX: these should handle endian conversions later
 static inline void
-write_8 (void *fp, BYTE v)
+write_8 (SAVE_BUFFER *fp, BYTE v)
 {
-	if (io_ok)
-		if (WriteResFile (&v, 1, 1, fp) != 1)
-			io_ok = FALSE;
+	BYTE *p = SaveBuffer_append (fp, 1);
+	if (p)
+		p[0] = v;
 }
 
 static inline void
-write_16 (void *fp, UWORD v)
+write_16 (SAVE_BUFFER *fp, UWORD v)
 {
-	write_8 (fp, (BYTE)( v        & 0xff));
-	write_8 (fp, (BYTE)((v >>  8) & 0xff));
+	BYTE *p = SaveBuffer_append (fp, 2);
+	if (p)
+	{
+		p[0] = (BYTE)( v        & 0xff);
+		p[1] = (BYTE)((v >>  8) & 0xff);
+	}
 }
 
 static inline void
-write_32 (void *fp, DWORD v)
+write_32 (SAVE_BUFFER *fp, DWORD v)
 {
-	write_8 (fp, (BYTE)( v        & 0xff));
-	write_8 (fp, (BYTE)((v >>  8) & 0xff));
-	write_8 (fp, (BYTE)((v >> 16) & 0xff));
-	write_8 (fp, (BYTE)((v >> 24) & 0xff));
+	BYTE *p = SaveBuffer_append (fp, 4);
+	if (p)
+	{
+		p[0] = (BYTE)( v        & 0xff);
+		p[1] = (BYTE)((v >>  8) & 0xff);
+		p[2] = (BYTE)((v >> 16) & 0xff);
+		p[3] = (BYTE)((v >> 24) & 0xff);
+	}
 }
 
 static inline void
-write_a8 (void *fp, const BYTE *ar, COUNT count)
+write_a8 (SAVE_BUFFER *fp, const BYTE *ar, COUNT count)
 {
-	if (io_ok)
-		if (WriteResFile (ar, 1, count, fp) != count)
-			io_ok = FALSE;
+	BYTE *p = SaveBuffer_append (fp, count);
+	if (p)
+		memcpy (p, ar, count);
 }
 
 static inline void
-write_str (void *fp, const char *str, COUNT count)
+write_str (SAVE_BUFFER *fp, const char *str, COUNT count)
 {
 	// no type conversion needed for strings
 	write_a8 (fp, (const BYTE *)str, count);
 }
 
 static inline void
-write_a16 (void *fp, const UWORD *ar, COUNT count)
+write_a16 (SAVE_BUFFER *fp, const UWORD *ar, COUNT count)
 {
 	for ( ; count > 0; --count, ++ar)
-	{
-		if (!io_ok)
-			break;
 		write_16 (fp, *ar);
-	}
 }
 
 static void
-SaveShipQueue (uio_Stream *fh, QUEUE *pQueue, DWORD tag)
+SaveShipQueue (SAVE_BUFFER *fh, QUEUE *pQueue, DWORD tag)
 {
 	COUNT num_links;
 	HSHIPFRAG hStarShip;
@@ -795,7 +799,7 @@ SaveShipQueue (uio_Stream *fh, QUEUE *pQueue, DWORD tag)
 }
 
 static void
-SaveRaceQueue (uio_Stream *fh, QUEUE *pQueue)
+SaveRaceQueue (SAVE_BUFFER *fh, QUEUE *pQueue)
 {
 	COUNT num_links;
 	HFLEETINFO hFleet;
@@ -847,7 +851,7 @@ SaveRaceQueue (uio_Stream *fh, QUEUE *pQueue)
 }
 
 static void
-SaveGroupQueue (uio_Stream *fh, QUEUE *pQueue)
+SaveGroupQueue (SAVE_BUFFER *fh, QUEUE *pQueue)
 {
 	HIPGROUP hGroup, hNextGroup;
 	COUNT num_links;
@@ -881,7 +885,7 @@ SaveGroupQueue (uio_Stream *fh, QUEUE *pQueue)
 }
 
 static void
-SaveEncounters (uio_Stream *fh)
+SaveEncounters (SAVE_BUFFER *fh)
 {
 	COUNT num_links;
 	HENCOUNTER hEncounter;
@@ -933,7 +937,7 @@ SaveEncounters (uio_Stream *fh)
 }
 
 static void
-SaveEvents (uio_Stream *fh)
+SaveEvents (SAVE_BUFFER *fh)
 {
 	COUNT num_links;
 	HEVENT hEvent;
@@ -964,7 +968,7 @@ SaveEvents (uio_Stream *fh)
 
 /* The clock state is folded in with the game state chunk. */
 static void
-SaveClockState (const CLOCK_STATE *ClockPtr, uio_Stream *fh)
+SaveClockState (const CLOCK_STATE *ClockPtr, SAVE_BUFFER *fh)
 {
 	write_8   (fh, ClockPtr->day_index);
 	write_8   (fh, ClockPtr->month_index);
@@ -977,7 +981,7 @@ SaveClockState (const CLOCK_STATE *ClockPtr, uio_Stream *fh)
  * State chunk is fixed size, but the Game State tag can be extended
  * by modders. */
 static BOOLEAN
-SaveGameState (const GAME_STATE *GSPtr, uio_Stream *fh)
+SaveGameState (const GAME_STATE *GSPtr, SAVE_BUFFER *fh)
 {
 	write_32  (fh, GLOBAL_STATE_TAG);
 	write_32  (fh, 75);
@@ -1033,7 +1037,7 @@ SaveGameState (const GAME_STATE *GSPtr, uio_Stream *fh)
 
 /* This is folded into the Summary chunk */
 static void
-SaveSisState (const SIS_STATE *SSPtr, void *fp)
+SaveSisState (const SIS_STATE *SSPtr, SAVE_BUFFER *fp)
 {
 	write_32  (fp, SSPtr->log_x);
 	write_32  (fp, SSPtr->log_y);
@@ -1056,7 +1060,7 @@ SaveSisState (const SIS_STATE *SSPtr, void *fp)
 /* Write out the Summary Chunk. This is variable length because of the
    savegame name */
 static void
-SaveSummary (const SUMMARY_DESC *SummPtr, void *fp)
+SaveSummary (const SUMMARY_DESC *SummPtr, SAVE_BUFFER *fp)
 {
 	write_32 (fp, SUMMARY_TAG);
 	write_32 (fp, 160 + strlen(SummPtr->SaveName));
@@ -1080,7 +1084,7 @@ SaveSummary (const SUMMARY_DESC *SummPtr, void *fp)
  * the Star *Info* chunk, which records which planetary features you
  * have exploited with your lander */
 static void
-SaveStarDesc (const STAR_DESC *SDPtr, uio_Stream *fh)
+SaveStarDesc (const STAR_DESC *SDPtr, SAVE_BUFFER *fh)
 {
 	write_32 (fh, STAR_TAG);
 	write_32 (fh, 8);
@@ -1250,7 +1254,7 @@ SaveFlagshipState (void)
 }
 
 static void
-SaveStarInfo (uio_Stream *fh)
+SaveStarInfo (SAVE_BUFFER *fh)
 {
 	GAME_STATE_FILE *fp;
 	fp = OpenStateFile (STARINFO_FILE, "rb");
@@ -1278,7 +1282,7 @@ SaveStarInfo (uio_Stream *fh)
 }
 
 static void
-SaveBattleGroup (GAME_STATE_FILE *fp, DWORD encounter_id, DWORD grpoffs, uio_Stream *fh)
+SaveBattleGroup (GAME_STATE_FILE *fp, DWORD encounter_id, DWORD grpoffs, SAVE_BUFFER *fh)
 {
 	GROUP_HEADER h;
 	DWORD size = 12;
@@ -1359,7 +1363,7 @@ GetBattleGroupOffset (int encounterIndex)
 }
 
 static void
-SaveGroups (uio_Stream *fh)
+SaveGroups (SAVE_BUFFER *fh)
 {
 	GAME_STATE_FILE *fp;
 	fp = OpenStateFile (RANDGRPINFO_FILE, "rb");
@@ -1414,20 +1418,25 @@ SaveGroups (uio_Stream *fh)
 	}
 }
 
-// This function first writes to a memory file, and then writes the whole
-// lot to the actual save file at once.
+// This function first builds the save game in memory, and then writes the
+// whole lot to the actual save file at once.
 BOOLEAN
 SaveGame (COUNT which_game, SUMMARY_DESC *SummPtr, const char *name)
 {
-	uio_Stream *out_fp;
+	SAVE_BUFFER sb;
+	BOOLEAN ok;
 	POINT pt;
 	STAR_DESC SD;
 	char file[PATH_MAX];
+	TimeCount start;
+
 	if (CurStarDescPtr)
 		SD = *CurStarDescPtr;
 	else
 		memset (&SD, 0, sizeof (SD));
 
+	start = GetTimeCounter ();
+
 	// XXX: Backup: SaveFlagshipState() overwrites ip_location
 	pt = GLOBAL (ip_location);
 	SaveFlagshipState ();
@@ -1436,66 +1445,60 @@ SaveGame (COUNT which_game, SUMMARY_DESC *SummPtr, const char *name)
 			& (START_ENCOUNTER | START_INTERPLANETARY)))
 		PutGroupInfo (GROUPS_RANDOM, GROUP_SAVE_IP);
 
-	// Write the memory file to the actual savegame file.
-	sprintf (file, "uqmsave.%02u", which_game);
-	if ((out_fp = res_OpenResFile (saveDir, file, "wb")))
-	{
-		io_ok = TRUE;
-		write_32 (out_fp, SAVEFILE_TAG);
-
-		PrepareSummary (SummPtr, name);
-		SaveSummary (SummPtr, out_fp);
-
-		if (!SaveGameState (&GlobData.Game_state, out_fp))
-			io_ok = FALSE;
-
-		// XXX: Restore
-		GLOBAL (ip_location) = pt;
-		// Only relevant when loading a game and must be cleaned
-		GLOBAL (in_orbit) = 0;
-
-		SaveRaceQueue (out_fp, &GLOBAL (avail_race_q));
-		// START_INTERPLANETARY is only set when saving from Homeworld
-		//   encounter screen. When the game is loaded, the
-		//   GenerateOrbitalFunction for the current star system
-		//   create the encounter anew and populate the npc queue.
-		if (!(GLOBAL (CurrentActivity) & START_INTERPLANETARY))
-		{
-			if (GLOBAL (CurrentActivity) & START_ENCOUNTER)
-				SaveShipQueue (out_fp, &GLOBAL (npc_built_ship_q), NPC_SHIP_Q_TAG);
-			else if (LOBYTE (GLOBAL (CurrentActivity)) == IN_INTERPLANETARY)
-				// XXX: Technically, this queue does not need to be
-				//   saved/loaded at all. IP groups will be reloaded
-				//   from group state files. But the original code did,
-				//   and so will we until we can prove we do not need to.
-				SaveGroupQueue (out_fp, &GLOBAL (ip_group_q));
-		}
-		SaveShipQueue (out_fp, &GLOBAL (built_ship_q), SHIP_Q_TAG);
+	SaveBuffer_init (&sb, SAVE_BUFFER_SIZE);
+	write_32 (&sb, SAVEFILE_TAG);
 
-		// Save the game event chunk
-		SaveEvents (out_fp);
+	PrepareSummary (SummPtr, name);
+	SaveSummary (SummPtr, &sb);
 
-		// Save the encounter chunk (black globes in HS/QS)
-		SaveEncounters (out_fp);
+	if (!SaveGameState (&GlobData.Game_state, &sb))
+		sb.ok = FALSE;
 
-		// Save out the data that used to be in state files
-		SaveStarInfo (out_fp);
-		SaveGroups (out_fp);
+	// XXX: Restore
+	GLOBAL (ip_location) = pt;
+	// Only relevant when loading a game and must be cleaned
+	GLOBAL (in_orbit) = 0;
 
-		// Save out the Star Descriptor
-		SaveStarDesc (&SD, out_fp);
-		
-		res_CloseResFile (out_fp);
-		if (!io_ok)
-		{
-			DeleteResFile(saveDir, file);
-			return FALSE;
-		}
-	}
-	else
+	SaveRaceQueue (&sb, &GLOBAL (avail_race_q));
+	// START_INTERPLANETARY is only set when saving from Homeworld
+	//   encounter screen. When the game is loaded, the
+	//   GenerateOrbitalFunction for the current star system
+	//   create the encounter anew and populate the npc queue.
+	if (!(GLOBAL (CurrentActivity) & START_INTERPLANETARY))
 	{
-		return FALSE;
+		if (GLOBAL (CurrentActivity) & START_ENCOUNTER)
+			SaveShipQueue (&sb, &GLOBAL (npc_built_ship_q), NPC_SHIP_Q_TAG);
+		else if (LOBYTE (GLOBAL (CurrentActivity)) == IN_INTERPLANETARY)
+			// XXX: Technically, this queue does not need to be
+			//   saved/loaded at all. IP groups will be reloaded
+			//   from group state files. But the original code did,
+			//   and so will we until we can prove we do not need to.
+			SaveGroupQueue (&sb, &GLOBAL (ip_group_q));
 	}
+	SaveShipQueue (&sb, &GLOBAL (built_ship_q), SHIP_Q_TAG);
 
-	return TRUE;
+	// Save the game event chunk
+	SaveEvents (&sb);
+
+	// Save the encounter chunk (black globes in HS/QS)
+	SaveEncounters (&sb);
+
+	// Save out the data that used to be in state files
+	SaveStarInfo (&sb);
+	SaveGroups (&sb);
+
+	// Save out the Star Descriptor
+	SaveStarDesc (&SD, &sb);
+
+	log_add (log_Debug, "Built save game %u: %lu bytes in %lu ms",
+			which_game, (unsigned long) sb.size,
+			(unsigned long) ((GetTimeCounter () - start) * 1000
+			/ ONE_SECOND));
+
+	// Write the memory image to the actual savegame file.
+	sprintf (file, "uqmsave.%02u", which_game);
+	ok = SaveBuffer_writeFile (&sb, saveDir, file, optCompressSaves);
+	SaveBuffer_uninit (&sb);
+
+	return ok;
 }
@@ -0,0 +1,375 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "savefile.h"
+
+#include <errno.h>
+#include "libs/file.h"
+#include "libs/reslib.h"
+#include "libs/log.h"
+#include "libs/memlib.h"
+#include "libs/timelib.h"
+
+#ifdef HAVE_ZIP
+#	include <zlib.h>
+#endif
+
+#define SAVEFILE_Z_HEADER_SIZE 8
+		// SAVEFILE_Z_TAG and the uncompressed size
+
+#define SAVEFILE_MAX_SIZE (64 * 1024 * 1024)
+		// Sanity limit for the uncompressed size of a compressed save
+
+#define TICKS_TO_MS(t) ((unsigned long) ((t) * 1000 / ONE_SECOND))
+
+
+void
+SaveBuffer_init (SAVE_BUFFER *sb, DWORD capacity)
+{
+	sb->data = capacity ? HMalloc (capacity) : NULL;
+	sb->size = 0;
+	sb->capacity = sb->data ? capacity : 0;
+	sb->pos = 0;
+	sb->ok = TRUE;
+}
+
+void
+SaveBuffer_uninit (SAVE_BUFFER *sb)
+{
+	HFree (sb->data);
+	sb->data = NULL;
+	sb->size = 0;
+	sb->capacity = 0;
+	sb->pos = 0;
+}
+
+BOOLEAN
+SaveBuffer_grow (SAVE_BUFFER *sb, DWORD count)
+{
+	DWORD capacity;
+	BYTE *data;
+
+	if (!sb->ok)
+		return FALSE;
+
+	capacity = sb->capacity ? sb->capacity : 4096;
+	while (capacity < sb->size + count)
+		capacity *= 2;
+
+	data = HRealloc (sb->data, capacity);
+	if (!data)
+	{
+		log_add (log_Error, "SaveBuffer: could not grow to %lu bytes",
+				(unsigned long) capacity);
+		sb->ok = FALSE;
+		return FALSE;
+	}
+
+	sb->data = data;
+	sb->capacity = capacity;
+	return TRUE;
+}
+
+static void
+storeLE32 (BYTE *p, DWORD v)
+{
+	p[0] = (BYTE)( v        & 0xff);
+	p[1] = (BYTE)((v >>  8) & 0xff);
+	p[2] = (BYTE)((v >> 16) & 0xff);
+	p[3] = (BYTE)((v >> 24) & 0xff);
+}
+
+static DWORD
+loadLE32 (const BYTE *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((DWORD) p[3] << 24);
+}
+
+// Returns a newly allocated compressed image in 'out',
+// or FALSE if compression is not available or failed.
+static BOOLEAN
+compressImage (const SAVE_BUFFER *sb, SAVE_BUFFER *out)
+{
+#ifdef HAVE_ZIP
+	uLongf zlen = compressBound (sb->size);
+	BYTE *p;
+
+	SaveBuffer_init (out, SAVEFILE_Z_HEADER_SIZE + zlen);
+	p = SaveBuffer_append (out, SAVEFILE_Z_HEADER_SIZE + zlen);
+	if (!p)
+	{
+		SaveBuffer_uninit (out);
+		return FALSE;
+	}
+
+	storeLE32 (p, SAVEFILE_Z_TAG);
+	storeLE32 (p + 4, sb->size);
+	if (compress2 (p + SAVEFILE_Z_HEADER_SIZE, &zlen, sb->data, sb->size,
+			Z_DEFAULT_COMPRESSION) != Z_OK)
+	{
+		log_add (log_Warning, "SaveBuffer: compression failed; saving "
+				"uncompressed");
+		SaveBuffer_uninit (out);
+		return FALSE;
+	}
+	out->size = SAVEFILE_Z_HEADER_SIZE + zlen;
+	return TRUE;
+#else
+	(void) sb;
+	(void) out;
+	return FALSE;
+#endif
+}
+
+// Replaces the compressed image in 'sb' by the uncompressed one, or by
+// its first 'limit' bytes if 'limit' is not 0.
+static BOOLEAN
+uncompressImage (SAVE_BUFFER *sb, DWORD limit)
+{
+#ifdef HAVE_ZIP
+	SAVE_BUFFER out;
+	z_stream zs;
+	DWORD len;
+	BOOLEAN whole;
+	int err;
+
+	len = loadLE32 (sb->data + 4);
+	if (len > SAVEFILE_MAX_SIZE)
+	{
+		log_add (log_Warning, "SaveBuffer: corrupt compressed save game "
+				"(size %lu)", (unsigned long) len);
+		return FALSE;
+	}
+	whole = !limit || limit >= len;
+	if (!whole)
+		len = limit;
+	SaveBuffer_init (&out, len);
+	if (len && !SaveBuffer_append (&out, len))
+	{
+		SaveBuffer_uninit (&out);
+		return FALSE;
+	}
+
+	memset (&zs, 0, sizeof zs);
+	zs.next_in = sb->data + SAVEFILE_Z_HEADER_SIZE;
+	zs.avail_in = sb->size - SAVEFILE_Z_HEADER_SIZE;
+	zs.next_out = out.data;
+	zs.avail_out = len;
+	err = inflateInit (&zs);
+	if (err == Z_OK)
+	{
+		// Stops when the output is full, so only as much is uncompressed
+		// as was asked for.
+		err = inflate (&zs, Z_SYNC_FLUSH);
+		inflateEnd (&zs);
+	}
+	if (zs.avail_out != 0 || (err != Z_STREAM_END && (whole || err != Z_OK)))
+	{
+		log_add (log_Warning, "SaveBuffer: corrupt compressed save game "
+				"(zlib error %d)", err);
+		SaveBuffer_uninit (&out);
+		return FALSE;
+	}
+
+	SaveBuffer_uninit (sb);
+	*sb = out;
+	return TRUE;
+#else
+	(void) sb;
+	(void) limit;
+	log_add (log_Warning, "SaveBuffer: this is a compressed save game, "
+			"but this build has no zlib support");
+	return FALSE;
+#endif
+}
+
+BOOLEAN
+SaveBuffer_writeFile (SAVE_BUFFER *sb, uio_DirHandle *dir, const char *file,
+		BOOLEAN compress)
+{
+	SAVE_BUFFER packed;
+	const SAVE_BUFFER *image = sb;
+	char tmpFile[PATH_MAX];
+	uio_Stream *fp;
+	BOOLEAN ok;
+	TimeCount start;
+	TimeCount compressTime;
+	TimeCount writeTime;
+
+	if (!sb->ok)
+		return FALSE;
+
+	start = GetTimeCounter ();
+	if (compress && compressImage (sb, &packed))
+		image = &packed;
+	else
+		compress = FALSE;
+	compressTime = GetTimeCounter () - start;
+
+	start = GetTimeCounter ();
+	snprintf (tmpFile, sizeof tmpFile, "%s.tmp", file);
+	fp = res_OpenResFile (dir, tmpFile, "wb");
+	if (!fp)
+	{
+		log_add (log_Error, "SaveBuffer: could not create '%s'", tmpFile);
+		ok = FALSE;
+	}
+	else
+	{
+		ok = WriteResFile (image->data, 1, image->size, fp) == image->size;
+		// The data has to be on the disk before the rename, or a crash
+		// could leave an empty file where the old save was.
+		if (ok && (uio_fflush (fp) != 0
+				|| uio_fsync (uio_streamHandle (fp)) != 0))
+			ok = FALSE;
+		// uio_fclose() flushes; it reports a failure to do so.
+		if (uio_fclose (fp) != 0)
+			ok = FALSE;
+
+		if (!ok)
+		{
+			log_add (log_Error, "SaveBuffer: could not write '%s'",
+					tmpFile);
+			DeleteResFile (dir, tmpFile);
+		}
+		else if (uio_renameReplace (dir, tmpFile, dir, file) != 0)
+		{
+			// The new save is complete, so it is kept for
+			// SaveBuffer_recoverFile().
+			log_add (log_Error, "SaveBuffer: could not rename '%s' to "
+					"'%s': %s", tmpFile, file, strerror (errno));
+			ok = FALSE;
+		}
+	}
+	writeTime = GetTimeCounter () - start;
+
+	log_add (log_Debug, "Saved '%s': %lu bytes, %lu on disk; "
+			"compress %lu ms, write %lu ms", file,
+			(unsigned long) sb->size, (unsigned long) image->size,
+			TICKS_TO_MS (compressTime), TICKS_TO_MS (writeTime));
+
+	if (compress)
+		SaveBuffer_uninit (&packed);
+	return ok;
+}
+
+// Reads 'file' in 'dir' into an uninitialized buffer, uncompressed,
+// keeping only the first 'limit' bytes of the image if 'limit' is not 0.
+static BOOLEAN
+readImage (SAVE_BUFFER *sb, uio_DirHandle *dir, const char *file,
+		DWORD limit)
+{
+	uio_Stream *fp;
+	size_t len;
+	size_t count;
+	BYTE *p;
+
+	SaveBuffer_init (sb, 0);
+
+	fp = res_OpenResFile (dir, file, "rb");
+	if (!fp)
+		return FALSE;
+
+	len = LengthResFile (fp);
+	count = len;
+	if (limit && count > limit + SAVEFILE_Z_HEADER_SIZE)
+		count = limit + SAVEFILE_Z_HEADER_SIZE;
+	p = SaveBuffer_append (sb, count);
+	if (!p || ReadResFile (p, 1, count, fp) != count)
+		goto err;
+
+	if (sb->size >= SAVEFILE_Z_HEADER_SIZE
+			&& loadLE32 (sb->data) == SAVEFILE_Z_TAG)
+	{
+		// The limit is on the uncompressed image; all of the compressed
+		// one is needed for that.
+		if (count < len)
+		{
+			p = SaveBuffer_append (sb, len - count);
+			if (!p || ReadResFile (p, 1, len - count, fp) != len - count)
+				goto err;
+		}
+		res_CloseResFile (fp);
+
+		if (!uncompressImage (sb, limit))
+		{
+			SaveBuffer_uninit (sb);
+			return FALSE;
+		}
+		return TRUE;
+	}
+
+	res_CloseResFile (fp);
+	if (limit && sb->size > limit)
+		sb->size = limit;
+	return TRUE;
+
+err:
+	res_CloseResFile (fp);
+	SaveBuffer_uninit (sb);
+	return FALSE;
+}
+
+BOOLEAN
+SaveBuffer_readFile (SAVE_BUFFER *sb, uio_DirHandle *dir, const char *file)
+{
+	return readImage (sb, dir, file, 0);
+}
+
+BOOLEAN
+SaveBuffer_readFileHead (SAVE_BUFFER *sb, uio_DirHandle *dir,
+		const char *file, DWORD count)
+{
+	return readImage (sb, dir, file, count);
+}
+
+BOOLEAN
+SaveBuffer_recoverFile (uio_DirHandle *dir, const char *file,
+		SaveBuffer_CheckFunc *check)
+{
+	char tmpFile[PATH_MAX];
+	struct stat statBuf;
+	SAVE_BUFFER sb;
+	BOOLEAN complete;
+
+	if (uio_stat (dir, file, &statBuf) == 0)
+		return FALSE;
+
+	snprintf (tmpFile, sizeof tmpFile, "%s.tmp", file);
+	if (uio_stat (dir, tmpFile, &statBuf) != 0)
+		return FALSE;
+
+	// The temp file may also be left from a crash during the write.
+	complete = SaveBuffer_readFile (&sb, dir, tmpFile) && check (&sb);
+	SaveBuffer_uninit (&sb);
+	if (!complete)
+	{
+		log_add (log_Warning, "SaveBuffer: '%s' is incomplete; deleting "
+				"it.", tmpFile);
+		DeleteResFile (dir, tmpFile);
+		return FALSE;
+	}
+
+	if (uio_rename (dir, tmpFile, dir, file) != 0)
+	{
+		log_add (log_Warning, "SaveBuffer: could not rename '%s' to "
+				"'%s': %s", tmpFile, file, strerror (errno));
+		return FALSE;
+	}
+	log_add (log_Info, "Recovered save game '%s' from '%s'.", file,
+			tmpFile);
+	return TRUE;
+}
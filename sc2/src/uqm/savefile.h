@@ -0,0 +1,125 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef UQM_SAVEFILE_H_
+#define UQM_SAVEFILE_H_
+
+#include <string.h>
+#include "port.h"
+#include "libs/compiler.h"
+#include "libs/uio.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// In-memory image of a save game file.
+//
+// SaveGame() serializes everything into one of these and then writes it
+// out with a single write call; LoadGame() reads the whole file into one
+// and parses it from memory. Either way the file is touched just once,
+// instead of once for every field.
+//
+// A save game may be stored zlib-compressed: the file then starts with
+// SAVEFILE_Z_TAG, followed by the (little-endian) size of the
+// uncompressed image and the zlib stream. SaveBuffer_readFile() undoes
+// this transparently, so the parser always sees the plain image.
+
+#define SAVEFILE_Z_TAG 0x5a534d55 // "UMSZ": zlib-compressed UQM Save
+
+typedef struct
+{
+	BYTE *data;
+	DWORD size;
+			// Number of bytes in use
+	DWORD capacity;
+			// Number of bytes allocated
+	DWORD pos;
+			// Read position
+	BOOLEAN ok;
+			// Cleared when an allocation or a read fails. Later appends
+			// may still succeed, but SaveBuffer_writeFile() will not
+			// write the image then, so that savers only need to check at
+			// the end, like they did with the per-field file writes.
+} SAVE_BUFFER;
+
+extern void SaveBuffer_init (SAVE_BUFFER *sb, DWORD capacity);
+extern void SaveBuffer_uninit (SAVE_BUFFER *sb);
+extern BOOLEAN SaveBuffer_grow (SAVE_BUFFER *sb, DWORD count);
+
+// Returns TRUE if 'sb' holds a whole image, rather than the start of one.
+typedef BOOLEAN SaveBuffer_CheckFunc (SAVE_BUFFER *sb);
+
+// Write the image to 'file' in 'dir', compressed if 'compress' is set.
+// The image goes to 'file'.tmp first, and is synced to the disk before
+// it replaces 'file'. So a failed write, or a crash, leaves the previous
+// save game intact. If only the replacing fails, 'file'.tmp is kept.
+extern BOOLEAN SaveBuffer_writeFile (SAVE_BUFFER *sb, uio_DirHandle *dir,
+		const char *file, BOOLEAN compress);
+// Read all of 'file' in 'dir' into an uninitialized buffer. Returns FALSE
+// (with 'sb' left empty) if the file cannot be opened or read.
+extern BOOLEAN SaveBuffer_readFile (SAVE_BUFFER *sb, uio_DirHandle *dir,
+		const char *file);
+// Like SaveBuffer_readFile(), but only the first 'count' bytes of the
+// image are read, or fewer if it is shorter. A compressed file is only
+// uncompressed that far.
+extern BOOLEAN SaveBuffer_readFileHead (SAVE_BUFFER *sb, uio_DirHandle *dir,
+		const char *file, DWORD count);
+// If 'file' in 'dir' is missing, but the 'file'.tmp that
+// SaveBuffer_writeFile() writes first is there, rename it to 'file' if
+// 'check' finds it complete, and delete it otherwise. Returns TRUE if it
+// was renamed.
+extern BOOLEAN SaveBuffer_recoverFile (uio_DirHandle *dir, const char *file,
+		SaveBuffer_CheckFunc *check);
+
+// Returns room for 'count' more bytes at the end of the buffer,
+// or NULL if the buffer could not grow.
+static inline BYTE *
+SaveBuffer_append (SAVE_BUFFER *sb, DWORD count)
+{
+	BYTE *p;
+
+	if (sb->size + count > sb->capacity && !SaveBuffer_grow (sb, count))
+		return NULL;
+
+	p = sb->data + sb->size;
+	sb->size += count;
+	return p;
+}
+
+// Returns the next 'count' bytes at the read position,
+// or NULL if there are not that many left.
+static inline const BYTE *
+SaveBuffer_read (SAVE_BUFFER *sb, DWORD count)
+{
+	const BYTE *p;
+
+	if (count > sb->size - sb->pos)
+	{
+		sb->ok = FALSE;
+		return NULL;
+	}
+
+	p = sb->data + sb->pos;
+	sb->pos += count;
+	return p;
+}
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* UQM_SAVEFILE_H_ */
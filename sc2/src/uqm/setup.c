@@ -180,7 +180,7 @@ InitContexts (void)
 	if (OffScreenContext == NULL)
 		return FALSE;
 
-	if (!InitQueue (&disp_q, MAX_DISPLAY_ELEMENTS, sizeof (ELEMENT)))
+	if (!InitGrowableQueue (&disp_q, DISPLAY_ELEMENT_CHUNK, sizeof (ELEMENT)))
 		return FALSE;
 
 	return TRUE;
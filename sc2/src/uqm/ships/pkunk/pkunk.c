@@ -134,7 +134,10 @@ typedef struct
 	ElementProcessFunc *saved_preprocess_func;
 	ElementProcessFunc *saved_postprocess_func;
 	ElementProcessFunc *saved_death_func;
-	
+	COUNT LastSound;
+			// Index of the last taunt played, so that the next one is
+			// a different one. Kept with the ship rather than in a static,
+			// so that it is part of the battle state.
 } PKUNK_DATA;
 
 // Local typedef
@@ -159,6 +162,7 @@ SetCustomShipData (RACE_DESC *pRaceDesc, const CustomShipData_t *data)
 	{
 		HFree (pRaceDesc->data);
 		pRaceDesc->data = NULL;
+		pRaceDesc->data_size = 0;
 	}
 
 	if (data) // In with the new
@@ -166,6 +170,7 @@ SetCustomShipData (RACE_DESC *pRaceDesc, const CustomShipData_t *data)
 		CustomShipData_t* newData = HMalloc (sizeof (*data));
 		*newData = *data;
 		pRaceDesc->data = newData;
+		pRaceDesc->data_size = sizeof (*data);
 	}
 }
 
@@ -571,15 +576,15 @@ pkunk_preprocess (ELEMENT *ElementPtr)
 		}
 	}
 }
-		
-static COUNT LastSound = 0;
 
 static void
 pkunk_postprocess (ELEMENT *ElementPtr)
 {
 	STARSHIP *StarShipPtr;
+	PKUNK_DATA *PkunkData;
 
 	GetElementStarShip (ElementPtr, &StarShipPtr);
+	PkunkData = GetCustomShipData (StarShipPtr->RaceDescPtr);
 	if (StarShipPtr->RaceDescPtr->characteristics.special_wait)
 		--StarShipPtr->RaceDescPtr->characteristics.special_wait;
 	else if ((StarShipPtr->cur_status_flags & SPECIAL)
@@ -593,11 +598,11 @@ pkunk_postprocess (ELEMENT *ElementPtr)
 			CurSound =
 					2 + ((COUNT)TFB_Random ()
 					% (GetSoundCount (StarShipPtr->RaceDescPtr->ship_data.ship_sounds) - 2));
-		} while (CurSound == LastSound);
+		} while (CurSound == PkunkData->LastSound);
 		ProcessSound (SetAbsSoundIndex (
 				StarShipPtr->RaceDescPtr->ship_data.ship_sounds, CurSound
 				), ElementPtr);
-		LastSound = CurSound;
+		PkunkData->LastSound = CurSound;
 
 		DeltaEnergy (ElementPtr, SPECIAL_ENERGY_COST);
 
@@ -632,10 +637,5 @@ init_pkunk (void)
 
 	RaceDescPtr = &new_pkunk_desc;
 
-	LastSound = 0;
-			// We need to reinitialise it at least each battle, to ensure
-			// that NetPlay is synchronised if one player played another
-			// game before playing against a networked opponent.
-
 	return (RaceDescPtr);
 }
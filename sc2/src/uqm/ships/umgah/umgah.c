@@ -149,6 +149,7 @@ SetCustomShipData (RACE_DESC *pRaceDesc, const CustomShipData_t *data)
 	{
 		HFree (pRaceDesc->data);
 		pRaceDesc->data = NULL;
+		pRaceDesc->data_size = 0;
 	}
 
 	if (data) // In with the new
@@ -156,6 +157,7 @@ SetCustomShipData (RACE_DESC *pRaceDesc, const CustomShipData_t *data)
 		CustomShipData_t* newData = HMalloc (sizeof (*data));
 		*newData = *data;
 		pRaceDesc->data = newData;
+		pRaceDesc->data_size = sizeof (*data);
 	}
 }
 
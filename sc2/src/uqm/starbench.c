@@ -0,0 +1,422 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+// Micro-benchmark of the star index.
+//
+// Times the range and nearest star queries of the star index against
+// the way FindStar() does them (a binary search on y, then a scan of
+// every star in that band of y), over synthetic star catalogues the size
+// of the one of the game and of a much larger one. The index must
+// return the same stars in the same order; the benchmark fails if it
+// does not.
+//
+// Started with --benchstars[=N], N being the size of the larger
+// catalogue.
+
+#include "starbench.h"
+
+#include "starindex.h"
+#include "starmap.h"
+#include "units.h"
+#include "libs/log.h"
+#include "libs/memlib.h"
+#include "libs/timelib.h"
+
+#include <stdlib.h>
+
+
+#define BENCH_MIN_RUNS 4
+#define BENCH_MIN_TIME (ONE_SECOND / 4)
+
+#define BENCH_POINTS 4096
+		// Query points per run
+#define BENCH_MARGIN 100
+		// The query points reach this far outside of the universe
+
+typedef struct
+{
+	const char *name;
+	SIZE bounds;
+	BOOLEAN nearest;
+} BENCH_QUERY;
+
+static const BENCH_QUERY benchQueries[] =
+{
+	{"range 5", 5, FALSE},
+	{"range 75", 75, FALSE},
+	{"range 500", 500, FALSE},
+	{"nearest 5", 5, TRUE},
+	{"nearest 75", 75, TRUE},
+};
+
+static DWORD benchSeed;
+
+static COUNT
+benchRandom (void)
+{
+	benchSeed = benchSeed * 1103515245 + 12345;
+	return (COUNT)(benchSeed >> 16);
+}
+
+static COORD
+benchCoord (COORD lo, COORD hi)
+{
+	DWORD r = ((DWORD)benchRandom () << 16) | benchRandom ();
+	return (COORD)(lo + (long)(r % (DWORD)(hi - lo + 1)));
+}
+
+static int
+compareStarY (const void *ptr1, const void *ptr2)
+{
+	const STAR_DESC *SDPtr1 = ptr1;
+	const STAR_DESC *SDPtr2 = ptr2;
+
+	if (SDPtr1->star_pt.y != SDPtr2->star_pt.y)
+		return SDPtr1->star_pt.y - SDPtr2->star_pt.y;
+	return SDPtr1->star_pt.x - SDPtr2->star_pt.x;
+}
+
+// A catalogue like star_array: sorted on y, and followed by a star
+// that is beyond every query.
+static STAR_DESC *
+makeStars (DWORD count)
+{
+	STAR_DESC *stars;
+	DWORD i;
+
+	stars = HCalloc ((count + 1) * sizeof (*stars));
+	if (!stars)
+		return NULL;
+	for (i = 0; i < count; ++i)
+	{
+		stars[i].star_pt.x = benchCoord (0, MAX_X_UNIVERSE);
+		stars[i].star_pt.y = benchCoord (0, MAX_Y_UNIVERSE);
+		stars[i].Type = (BYTE)benchRandom ();
+	}
+	qsort (stars, count, sizeof (*stars), compareStarY);
+	stars[count].star_pt.x = MAX_X_UNIVERSE << 1;
+	stars[count].star_pt.y = MAX_Y_UNIVERSE << 1;
+	return stars;
+}
+
+// FindStar(), on any catalogue, with room for more than 32767 stars.
+static STAR_DESC *
+linearFindStar (STAR_DESC *BaseSDPtr, DWORD count, STAR_DESC *LastSDPtr,
+		const POINT *puniverse, SIZE xbounds, SIZE ybounds)
+{
+	long min_x, max_x, min_y, max_y;
+	long lo, hi;
+
+	hi = (long)count - 1;
+	if (LastSDPtr == NULL)
+		lo = 0;
+	else if ((lo = LastSDPtr - BaseSDPtr + 1) > hi)
+		return NULL;
+	else
+		hi = lo;
+
+	min_y = puniverse->y - ybounds;
+	max_y = puniverse->y + ybounds;
+
+	while (lo < hi)
+	{
+		long mid;
+
+		mid = (lo + hi) >> 1;
+		if (BaseSDPtr[mid].star_pt.y >= min_y)
+			hi = mid - 1;
+		else
+			lo = mid + 1;
+	}
+
+	LastSDPtr = &BaseSDPtr[lo];
+	if (LastSDPtr->star_pt.y <= max_y)
+	{
+		min_x = puniverse->x - xbounds;
+		max_x = puniverse->x + xbounds;
+
+		do
+		{
+			if (LastSDPtr->star_pt.y >= min_y
+					&& LastSDPtr->star_pt.x >= min_x
+					&& LastSDPtr->star_pt.x <= max_x)
+				return LastSDPtr;
+		} while ((++LastSDPtr)->star_pt.y <= max_y);
+	}
+
+	return NULL;
+}
+
+static STAR_DESC *
+linearNearestStar (STAR_DESC *stars, DWORD count, const POINT *pt,
+		SIZE bounds)
+{
+	STAR_DESC *SDPtr, *BestSDPtr;
+	DWORD best_d2 = 0;
+
+	SDPtr = BestSDPtr = NULL;
+	while ((SDPtr = linearFindStar (stars, count, SDPtr, pt, bounds,
+			bounds)))
+	{
+		long dx = SDPtr->star_pt.x - pt->x;
+		long dy = SDPtr->star_pt.y - pt->y;
+		DWORD d2 = (DWORD)(dx * dx + dy * dy);
+
+		if (!BestSDPtr || d2 < best_d2)
+		{
+			BestSDPtr = SDPtr;
+			best_d2 = d2;
+		}
+	}
+	return BestSDPtr;
+}
+
+// Returns the number of stars found, for the average.
+static DWORD
+runLinear (STAR_DESC *stars, DWORD count, const POINT *points,
+		const BENCH_QUERY *query, DWORD *sum)
+{
+	DWORD found = 0;
+	COUNT i;
+
+	for (i = 0; i < BENCH_POINTS; ++i)
+	{
+		STAR_DESC *SDPtr;
+
+		if (query->nearest)
+		{
+			SDPtr = linearNearestStar (stars, count, &points[i],
+					query->bounds);
+			if (SDPtr)
+			{
+				*sum += (DWORD)(SDPtr - stars);
+				++found;
+			}
+			continue;
+		}
+
+		SDPtr = NULL;
+		while ((SDPtr = linearFindStar (stars, count, SDPtr, &points[i],
+				query->bounds, query->bounds)))
+		{
+			*sum += (DWORD)(SDPtr - stars);
+			++found;
+		}
+	}
+	return found;
+}
+
+static DWORD
+runIndex (const STAR_INDEX *index, STAR_DESC *stars, const POINT *points,
+		const BENCH_QUERY *query, DWORD *sum)
+{
+	STAR_SEARCH search;
+	DWORD found = 0;
+	COUNT i;
+
+	for (i = 0; i < BENCH_POINTS; ++i)
+	{
+		STAR_DESC *SDPtr;
+
+		if (query->nearest)
+		{
+			SDPtr = NearestInStarIndex (index, &points[i], query->bounds);
+			if (SDPtr)
+			{
+				*sum += (DWORD)(SDPtr - stars);
+				++found;
+			}
+			continue;
+		}
+
+		SearchStarIndex (index, &search, &points[i], query->bounds,
+				query->bounds);
+		while ((SDPtr = NextFoundStar (&search)))
+		{
+			*sum += (DWORD)(SDPtr - stars);
+			++found;
+		}
+		EndStarSearch (&search);
+	}
+	return found;
+}
+
+// Returns FALSE if the index finds other stars than the linear search.
+static BOOLEAN
+verifyQuery (const STAR_INDEX *index, STAR_DESC *stars, DWORD count,
+		const POINT *points, const BENCH_QUERY *query)
+{
+	COUNT i;
+
+	for (i = 0; i < BENCH_POINTS; ++i)
+	{
+		STAR_SEARCH search;
+		STAR_DESC *SDPtr, *IndexSDPtr;
+
+		if (query->nearest)
+		{
+			SDPtr = linearNearestStar (stars, count, &points[i],
+					query->bounds);
+			IndexSDPtr = NearestInStarIndex (index, &points[i],
+					query->bounds);
+			if (SDPtr != IndexSDPtr)
+				goto mismatch;
+			continue;
+		}
+
+		SearchStarIndex (index, &search, &points[i], query->bounds,
+				query->bounds);
+		SDPtr = NULL;
+		do
+		{
+			SDPtr = linearFindStar (stars, count, SDPtr, &points[i],
+					query->bounds, query->bounds);
+			IndexSDPtr = NextFoundStar (&search);
+		} while (SDPtr && SDPtr == IndexSDPtr);
+		EndStarSearch (&search);
+
+		if (SDPtr != IndexSDPtr)
+			goto mismatch;
+	}
+	return TRUE;
+
+mismatch:
+	log_add (log_Error, "The star index differs from the linear search "
+			"for %s at (%d, %d).", query->name, points[i].x, points[i].y);
+	return FALSE;
+}
+
+static double
+timeBuild (STAR_DESC *stars, DWORD count)
+{
+	TimeCount start;
+	TimeCount elapsed;
+	DWORD runs = 0;
+
+	start = GetTimeCounter ();
+	do
+	{
+		DestroyStarIndex (CreateStarIndex (stars, count));
+		runs++;
+		elapsed = GetTimeCounter () - start;
+	} while (runs < BENCH_MIN_RUNS || elapsed < BENCH_MIN_TIME);
+
+	return (double)elapsed * 1e6 / ONE_SECOND / runs;
+}
+
+static BOOLEAN
+benchStarCount (DWORD count)
+{
+	STAR_DESC *stars;
+	POINT *points;
+	STAR_INDEX *index;
+	BOOLEAN ok = TRUE;
+	COUNT q, i;
+
+	stars = makeStars (count);
+	points = HMalloc (BENCH_POINTS * sizeof (*points));
+	index = stars ? CreateStarIndex (stars, count) : NULL;
+	if (!stars || !points || !index)
+	{
+		log_add (log_Error, "Out of memory.");
+		DestroyStarIndex (index);
+		HFree (points);
+		HFree (stars);
+		return FALSE;
+	}
+
+	for (i = 0; i < BENCH_POINTS; ++i)
+	{
+		points[i].x = benchCoord (-BENCH_MARGIN,
+				MAX_X_UNIVERSE + BENCH_MARGIN);
+		points[i].y = benchCoord (-BENCH_MARGIN,
+				MAX_Y_UNIVERSE + BENCH_MARGIN);
+	}
+
+	log_add (log_User, "%7lu stars  building the index  %10.1f us",
+			(unsigned long) count, timeBuild (stars, count));
+
+	for (q = 0; q < sizeof benchQueries / sizeof benchQueries[0]; ++q)
+	{
+		const BENCH_QUERY *query = &benchQueries[q];
+		double ns[2];
+		DWORD sums[2];
+		DWORD found = 0;
+		int method;
+
+		if (!verifyQuery (index, stars, count, points, query))
+			ok = FALSE;
+
+		for (method = 0; method < 2; ++method)
+		{
+			TimeCount start;
+			TimeCount elapsed;
+			DWORD runs = 0;
+
+			start = GetTimeCounter ();
+			do
+			{
+				sums[method] = 0;
+				if (method == 0)
+					found = runLinear (stars, count, points, query,
+							&sums[method]);
+				else
+					found = runIndex (index, stars, points, query,
+							&sums[method]);
+				runs++;
+				elapsed = GetTimeCounter () - start;
+			} while (runs < BENCH_MIN_RUNS || elapsed < BENCH_MIN_TIME);
+
+			ns[method] = (double)elapsed * 1e9 / ONE_SECOND / runs
+					/ BENCH_POINTS;
+		}
+
+		if (sums[0] != sums[1])
+			ok = FALSE;
+
+		log_add (log_User, "%7lu stars  %-12s  linear %10.0f ns/query  "
+				"index %10.0f ns/query  %7.2fx  (%.2f stars/query)",
+				(unsigned long) count, query->name, ns[0], ns[1],
+				ns[1] > 0.0 ? ns[0] / ns[1] : 0.0,
+				(double)found / BENCH_POINTS);
+	}
+
+	DestroyStarIndex (index);
+	HFree (points);
+	HFree (stars);
+	return ok;
+}
+
+int
+RunStarIndexBenchmark (DWORD numStars)
+{
+	BOOLEAN ok = TRUE;
+
+	log_add (log_User, "Star index benchmark; %u query points per run.",
+			BENCH_POINTS);
+
+	benchSeed = NUM_SOLAR_SYSTEMS;
+	if (!benchStarCount (NUM_SOLAR_SYSTEMS))
+		ok = FALSE;
+	if (numStars != NUM_SOLAR_SYSTEMS)
+	{
+		benchSeed = numStars;
+		if (!benchStarCount (numStars))
+			ok = FALSE;
+	}
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -32,20 +32,24 @@
 #include "master.h"
 #include "controls.h"
 #include "starcon.h"
+#include "starmap.h"
 #include "clock.h"
 		// for GameClockTick()
 #include "hyper.h"
 		// for SeedUniverse()
 #include "planets/planets.h"
+#include "planets/surfcache.h"
 		// for ExploreSolarSys()
 #include "uqmdebug.h"
 #include "uqm/lua/luastate.h"
+#include "supermelee/meleesim.h"
 #include "libs/tasklib.h"
 #include "libs/log.h"
 #include "libs/gfxlib.h"
 #include "libs/graphics/gfx_common.h"
 #include "libs/graphics/tfb_draw.h"
 #include "libs/misc.h"
+#include "libs/proflib.h"
 #include "libs/scriptlib.h"
 
 #include "uqmversion.h"
@@ -159,6 +163,7 @@ Starcon2Main (void *threadArg)
 #ifdef DEBUG_SLEEP
 	mainThreadId = SDL_ThreadID();
 #endif
+	prof_nameThread ("game");
 
 #if CREATE_JOURNAL
 {
@@ -206,11 +211,19 @@ while (--ac > 0)
 
 	GLOBAL (CurrentActivity) = 0;
 	luaUqm_initState ();
-	// show splash and init the kernel in the meantime
-	SplashScreen (BackgroundInitKernel);
+	if (meleeSimBattles)
+	{	// Headless battles instead of the game
+		BackgroundInitKernel (0);
+		MeleeSim ();
+	}
+	else
+	{
+		// show splash and init the kernel in the meantime
+		SplashScreen (BackgroundInitKernel);
+	}
 
 //	OpenJournal ();
-	while (StartGame ())
+	while (!meleeSimBattles && StartGame ())
 	{
 		// Initialise a new game
 		if (!SetPlayerInputAll ()) {
@@ -319,6 +332,8 @@ while (--ac > 0)
 	luaUqm_uninitState ();
 
 	UninitGameKernel ();
+	UninitPlanetSurfaceCache ();
+	UninitStarIndex ();
 	FreeMasterShipList ();
 	FreeKernel ();
 
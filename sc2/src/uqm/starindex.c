@@ -0,0 +1,565 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "starindex.h"
+
+#include "libs/memlib.h"
+#include "libs/log.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// Below this many results, an insertion sort is cheaper than qsort().
+#define INSERTION_SORT_MAX 32
+
+struct star_index
+{
+	STAR_DESC *stars;
+	DWORD count;
+	long minX, minY;
+			// Top left corner of the grid, in universe coordinates
+	long cellSize;
+			// Width and height of a cell, in universe units
+	long cols, rows;
+	DWORD *cellStart;
+			// cols * rows + 1 entries; the stars of cell i are
+			// cellStars[cellStart[i]] up to cellStars[cellStart[i + 1]]
+	DWORD *cellStars;
+			// Catalogue positions of the stars, in catalogue order within
+			// each cell
+	POINT *cellPts;
+			// Positions of the same stars, so that the queries do not
+			// need to look at the catalogue for those they skip
+	DWORD *rowFirst;
+	DWORD *rowLast;
+			// First and last catalogue position of the stars of each row
+			// of cells; rowFirst > rowLast for a row without stars
+};
+
+typedef struct
+{
+	long min_x, max_x;
+	long min_y, max_y;
+} STAR_BOX;
+
+
+static inline long
+floorDiv (long a, long b)
+{
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+STAR_INDEX *
+CreateStarIndex (STAR_DESC *stars, DWORD count)
+{
+	STAR_INDEX *index;
+	long maxX, maxY;
+	double area;
+	DWORD numCells;
+	DWORD *fill;
+	DWORD i;
+
+	index = HCalloc (sizeof (*index));
+	if (!index)
+		return NULL;
+	index->stars = stars;
+	index->count = count;
+
+	if (count == 0)
+		return index;
+
+	index->minX = maxX = stars[0].star_pt.x;
+	index->minY = maxY = stars[0].star_pt.y;
+	for (i = 1; i < count; ++i)
+	{
+		long x = stars[i].star_pt.x;
+		long y = stars[i].star_pt.y;
+
+		if (x < index->minX)
+			index->minX = x;
+		if (x > maxX)
+			maxX = x;
+		if (y < index->minY)
+			index->minY = y;
+		if (y > maxY)
+			maxY = y;
+	}
+
+	area = (double)(maxX - index->minX + 1) * (maxY - index->minY + 1);
+	index->cellSize = (long) ceil (sqrt (area * STAR_INDEX_CELL_STARS
+			/ count));
+	if (index->cellSize < 1)
+		index->cellSize = 1;
+	index->cols = (maxX - index->minX) / index->cellSize + 1;
+	index->rows = (maxY - index->minY) / index->cellSize + 1;
+	numCells = (DWORD)(index->cols * index->rows);
+
+	index->cellStart = HCalloc ((numCells + 1) * sizeof (DWORD));
+	index->cellStars = HMalloc (count * sizeof (DWORD));
+	index->cellPts = HMalloc (count * sizeof (POINT));
+	index->rowFirst = HMalloc (index->rows * sizeof (DWORD));
+	index->rowLast = HCalloc (index->rows * sizeof (DWORD));
+	fill = HMalloc (numCells * sizeof (DWORD));
+	if (!index->cellStart || !index->cellStars || !index->cellPts
+			|| !index->rowFirst
+			|| !index->rowLast || !fill)
+	{
+		log_add (log_Warning, "Warning: out of memory building the "
+				"index of %lu stars.", (unsigned long) count);
+		HFree (fill);
+		DestroyStarIndex (index);
+		return NULL;
+	}
+
+	// Counting sort of the stars into their cells, which keeps them in
+	// catalogue order within each cell.
+	for (i = 0; i < (DWORD)index->rows; ++i)
+		index->rowFirst[i] = ~(DWORD)0;
+	for (i = 0; i < count; ++i)
+	{
+		long cx = (stars[i].star_pt.x - index->minX) / index->cellSize;
+		long cy = (stars[i].star_pt.y - index->minY) / index->cellSize;
+		++index->cellStart[cy * index->cols + cx + 1];
+		if (index->rowFirst[cy] == ~(DWORD)0)
+			index->rowFirst[cy] = i;
+		index->rowLast[cy] = i;
+	}
+	for (i = 0; i < numCells; ++i)
+	{
+		index->cellStart[i + 1] += index->cellStart[i];
+		fill[i] = index->cellStart[i];
+	}
+	for (i = 0; i < count; ++i)
+	{
+		long cx = (stars[i].star_pt.x - index->minX) / index->cellSize;
+		long cy = (stars[i].star_pt.y - index->minY) / index->cellSize;
+		DWORD pos = fill[cy * index->cols + cx]++;
+		index->cellStars[pos] = i;
+		index->cellPts[pos] = stars[i].star_pt;
+	}
+
+	HFree (fill);
+	return index;
+}
+
+void
+DestroyStarIndex (STAR_INDEX *index)
+{
+	if (!index)
+		return;
+	HFree (index->cellStart);
+	HFree (index->cellStars);
+	HFree (index->cellPts);
+	HFree (index->rowFirst);
+	HFree (index->rowLast);
+	HFree (index);
+}
+
+void
+InitStarSearch (STAR_SEARCH *search)
+{
+	search->found = search->buf;
+	search->count = 0;
+	search->next = 0;
+	search->alloc = STAR_SEARCH_BUF_SIZE;
+}
+
+BOOLEAN
+AddFoundStar (STAR_SEARCH *search, STAR_DESC *SDPtr)
+{
+	if (search->count == search->alloc)
+	{
+		DWORD alloc = search->alloc * 2;
+		STAR_DESC **found;
+
+		if (search->found == search->buf)
+		{
+			found = HMalloc (alloc * sizeof (*found));
+			if (found)
+				memcpy (found, search->buf, sizeof (search->buf));
+		}
+		else
+			found = HRealloc (search->found, alloc * sizeof (*found));
+		if (!found)
+			return FALSE;
+		search->found = found;
+		search->alloc = alloc;
+	}
+
+	search->found[search->count++] = SDPtr;
+	return TRUE;
+}
+
+STAR_DESC *
+NextFoundStar (STAR_SEARCH *search)
+{
+	if (search->next >= search->count)
+		return NULL;
+	return search->found[search->next++];
+}
+
+void
+EndStarSearch (STAR_SEARCH *search)
+{
+	if (search->found != search->buf)
+		HFree (search->found);
+	InitStarSearch (search);
+}
+
+static int
+compareStarPtrs (const void *ptr1, const void *ptr2)
+{
+	const STAR_DESC *SDPtr1 = *(STAR_DESC *const *) ptr1;
+	const STAR_DESC *SDPtr2 = *(STAR_DESC *const *) ptr2;
+
+	return SDPtr1 < SDPtr2 ? -1 : SDPtr1 > SDPtr2;
+}
+
+static inline DWORD
+runEnd (STAR_DESC **found, DWORD i, DWORD count)
+{
+	if (i >= count)
+		return count;
+	for (++i; i < count && found[i - 1] < found[i]; ++i)
+		;
+	return i;
+}
+
+// Merge sort that starts from the runs that are in order already; the
+// stars of each cell are, and if the catalogue is sorted on y, as
+// star_array is, so are those of the cells of successive rows.
+static void
+mergeStarPtrs (STAR_DESC **found, DWORD count)
+{
+	STAR_DESC **buf, **src, **dst, **tmp;
+	DWORD runs;
+
+	buf = HMalloc (count * sizeof (*buf));
+	if (!buf)
+	{
+		qsort (found, count, sizeof (*found), compareStarPtrs);
+		return;
+	}
+
+	src = found;
+	dst = buf;
+	do
+	{
+		DWORD i = 0;
+
+		runs = 0;
+		while (i < count)
+		{
+			DWORD mid = runEnd (src, i, count);
+			DWORD end = mid < count ? runEnd (src, mid, count) : mid;
+			DWORD a = i, b = mid;
+
+			while (a < mid && b < end)
+				dst[i++] = src[a] < src[b] ? src[a++] : src[b++];
+			while (a < mid)
+				dst[i++] = src[a++];
+			while (b < end)
+				dst[i++] = src[b++];
+			++runs;
+		}
+
+		tmp = src;
+		src = dst;
+		dst = tmp;
+	} while (runs > 1);
+
+	if (src != found)
+		memcpy (found, src, count * sizeof (*found));
+	HFree (buf);
+}
+
+static void
+sortStarPtrs (STAR_DESC **found, DWORD count)
+{
+	DWORD i;
+
+	if (runEnd (found, 0, count) >= count)
+		return;
+
+	if (count > INSERTION_SORT_MAX)
+	{
+		mergeStarPtrs (found, count);
+		return;
+	}
+
+	for (i = 1; i < count; ++i)
+	{
+		STAR_DESC *SDPtr = found[i];
+		DWORD j;
+
+		for (j = i; j > 0 && found[j - 1] > SDPtr; --j)
+			found[j] = found[j - 1];
+		found[j] = SDPtr;
+	}
+}
+
+// Works out the range [*min, *max] of a coordinate 'v' with the given
+// bounds, and the range of cells [*c0, *c1] that it covers.
+// Returns FALSE if it is outside of the grid altogether.
+static BOOLEAN
+getCellRange (long v, SIZE bounds, long origin, long cellSize, long cells,
+		long *min, long *max, long *c0, long *c1)
+{
+	if (bounds < 0)
+	{
+		*min = origin;
+		*max = origin + cells * cellSize - 1;
+		*c0 = 0;
+		*c1 = cells - 1;
+		return TRUE;
+	}
+
+	*min = v - bounds;
+	*max = v + bounds;
+	*c0 = floorDiv (*min - origin, cellSize);
+	*c1 = floorDiv (*max - origin, cellSize);
+	if (*c1 < 0 || *c0 >= cells)
+		return FALSE;
+	if (*c0 < 0)
+		*c0 = 0;
+	if (*c1 >= cells)
+		*c1 = cells - 1;
+	return TRUE;
+}
+
+static inline BOOLEAN
+inBox (const POINT *pt, const STAR_BOX *box)
+{
+	return pt->x >= box->min_x && pt->x <= box->max_x
+			&& pt->y >= box->min_y && pt->y <= box->max_y;
+}
+
+// Position of the lowest bit set in 'bits', which must not be 0.
+static inline DWORD
+lowestBit (DWORD bits)
+{
+	static const BYTE deBruijnBits[32] =
+	{
+		0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+		31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9,
+	};
+
+	return deBruijnBits[((bits & (0 - bits)) * 0x077CB531UL & 0xffffffff)
+			>> 27];
+}
+
+// The stars of a row of cells from columns cx0 to cx1, in catalogue
+// order. Those of the cells come each in catalogue order but mixed up
+// with each other, so when the row does not span too many catalogue
+// positions they are ordered through a bitmap of those positions, and
+// else sorted.
+static BOOLEAN
+searchRow (const STAR_INDEX *index, STAR_SEARCH *search, long cy,
+		long cx0, long cx1, const STAR_BOX *box)
+{
+	DWORD first = index->rowFirst[cy];
+	DWORD span;
+	const DWORD *cellStart = &index->cellStart[cy * index->cols];
+	long cx;
+
+	if (first > index->rowLast[cy])
+		return TRUE;
+	span = index->rowLast[cy] - first + 1;
+
+	if (span <= STAR_SEARCH_BITS)
+	{
+		DWORD words = (span + 31) >> 5;
+		DWORD w;
+
+		memset (search->bits, 0, words * sizeof (search->bits[0]));
+		for (cx = cx0; cx <= cx1; ++cx)
+		{
+			DWORD i;
+
+			for (i = cellStart[cx]; i < cellStart[cx + 1]; ++i)
+			{
+				if (inBox (&index->cellPts[i], box))
+				{
+					DWORD star = index->cellStars[i] - first;
+
+					search->bits[star >> 5] |= (DWORD)1 << (star & 31);
+				}
+			}
+		}
+
+		for (w = 0; w < words; ++w)
+		{
+			DWORD bits = search->bits[w];
+
+			while (bits)
+			{
+				DWORD star = first + (w << 5) + lowestBit (bits);
+
+				if (!AddFoundStar (search, &index->stars[star]))
+					return FALSE;
+				bits &= bits - 1;
+			}
+		}
+	}
+	else
+	{
+		DWORD rowStart = search->count;
+
+		for (cx = cx0; cx <= cx1; ++cx)
+		{
+			DWORD i;
+
+			for (i = cellStart[cx]; i < cellStart[cx + 1]; ++i)
+			{
+				if (inBox (&index->cellPts[i], box) && !AddFoundStar (search,
+						&index->stars[index->cellStars[i]]))
+					return FALSE;
+			}
+		}
+
+		sortStarPtrs (search->found + rowStart, search->count - rowStart);
+	}
+
+	return TRUE;
+}
+
+void
+SearchStarIndex (const STAR_INDEX *index, STAR_SEARCH *search,
+		const POINT *pt, SIZE xbounds, SIZE ybounds)
+{
+	STAR_BOX box;
+	long cx0, cx1, cy0, cy1;
+	long cy;
+
+	InitStarSearch (search);
+
+	if (index->count == 0
+			|| !getCellRange (pt->x, xbounds, index->minX, index->cellSize,
+				index->cols, &box.min_x, &box.max_x, &cx0, &cx1)
+			|| !getCellRange (pt->y, ybounds, index->minY, index->cellSize,
+				index->rows, &box.min_y, &box.max_y, &cy0, &cy1))
+		return;
+
+	for (cy = cy0; cy <= cy1; ++cy)
+	{
+		if (!searchRow (index, search, cy, cx0, cx1, &box))
+		{
+			log_add (log_Warning, "Warning: out of memory in star "
+					"search; results truncated.");
+			break;
+		}
+	}
+
+	// The rows follow each other in the catalogue if it is sorted on y,
+	// as star_array is; then this finds them in order already.
+	sortStarPtrs (search->found, search->count);
+}
+
+// The cells are searched in square rings of increasing size around the
+// cell that the point is in (which may be outside of the grid). Every
+// star in ring r is more than (r - 1) * cellSize away from the point
+// along one axis, so the search stops as soon as the best star found is
+// at least that close, or that is further away than the bounds.
+STAR_DESC *
+NearestInStarIndex (const STAR_INDEX *index, const POINT *pt, SIZE bounds)
+{
+	STAR_DESC *BestSDPtr = NULL;
+	uint64 best_d2 = 0;
+	long cx, cy;
+	long bx0, bx1, by0, by1;
+			// The cells that the bounds cover
+	long min, max;
+	long maxRing;
+	long r;
+
+	if (index->count == 0
+			|| !getCellRange (pt->x, bounds, index->minX, index->cellSize,
+				index->cols, &min, &max, &bx0, &bx1)
+			|| !getCellRange (pt->y, bounds, index->minY, index->cellSize,
+				index->rows, &min, &max, &by0, &by1))
+		return NULL;
+
+	cx = floorDiv (pt->x - index->minX, index->cellSize);
+	cy = floorDiv (pt->y - index->minY, index->cellSize);
+	maxRing = cx;
+	if (index->cols - 1 - cx > maxRing)
+		maxRing = index->cols - 1 - cx;
+	if (cy > maxRing)
+		maxRing = cy;
+	if (index->rows - 1 - cy > maxRing)
+		maxRing = index->rows - 1 - cy;
+
+	for (r = 0; r <= maxRing; ++r)
+	{
+		long minDist = (r - 1) * index->cellSize;
+		long y;
+
+		if (r > 0)
+		{
+			if (bounds >= 0 && minDist >= bounds)
+				break;
+			if (BestSDPtr && best_d2 <= (uint64)minDist * minDist)
+				break;
+		}
+
+		for (y = cy - r; y <= cy + r; ++y)
+		{
+			long x, step;
+
+			if (y < by0 || y > by1)
+				continue;
+
+			// The top and bottom rows of the ring are visited whole,
+			// the rows in between only at both ends.
+			step = (y == cy - r || y == cy + r || r == 0) ? 1 : 2 * r;
+			for (x = cx - r; x <= cx + r; x += step)
+			{
+				DWORD cell;
+				DWORD i;
+
+				if (x < bx0 || x > bx1)
+					continue;
+
+				cell = (DWORD)(y * index->cols + x);
+				for (i = index->cellStart[cell];
+						i < index->cellStart[cell + 1]; ++i)
+				{
+					STAR_DESC *SDPtr;
+					long dx = (long)index->cellPts[i].x - pt->x;
+					long dy = (long)index->cellPts[i].y - pt->y;
+					uint64 d2;
+
+					if (bounds >= 0 && (dx > bounds || dx < -bounds
+							|| dy > bounds || dy < -bounds))
+						continue;
+
+					d2 = (uint64)((sint64)dx * dx + (sint64)dy * dy);
+					SDPtr = &index->stars[index->cellStars[i]];
+					if (!BestSDPtr || d2 < best_d2
+							|| (d2 == best_d2 && SDPtr < BestSDPtr))
+					{
+						BestSDPtr = SDPtr;
+						best_d2 = d2;
+					}
+				}
+			}
+		}
+	}
+
+	return BestSDPtr;
+}
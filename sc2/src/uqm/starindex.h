@@ -0,0 +1,80 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef UQM_STARINDEX_H_
+#define UQM_STARINDEX_H_
+
+#include "libs/compiler.h"
+#include "planets/planets.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Spatial index over a star catalogue.
+//
+// The stars are bucketed into a uniform grid over their bounding box,
+// sized so that a cell holds STAR_INDEX_CELL_STARS stars on average.
+// The index is built once and never changes; it refers to the stars by
+// their position in the catalogue, which must outlive it.
+//
+// A range query returns the stars within a box around a point, in
+// catalogue order, which is the order in which repeated FindStar() calls
+// would return them. A nearest query returns the star closest to a point
+// (the one earliest in the catalogue, if there are several).
+//
+// A bound of 0 matches the coordinate of the point exactly; a negative
+// bound matches any coordinate.
+
+#define STAR_INDEX_CELL_STARS 2
+
+#define STAR_SEARCH_BUF_SIZE 64
+		// Results that fit in the search itself; more are put on the heap
+#define STAR_SEARCH_BITS 4096
+		// Rows of cells that span up to this many catalogue positions are
+		// put in order through a bitmap, others are sorted
+
+typedef struct star_index STAR_INDEX;
+
+typedef struct
+{
+	STAR_DESC **found;
+			// Points to buf[] or to memory on the heap
+	DWORD count;
+	DWORD next;
+	DWORD alloc;
+	STAR_DESC *buf[STAR_SEARCH_BUF_SIZE];
+	DWORD bits[STAR_SEARCH_BITS / 32];
+} STAR_SEARCH;
+
+extern STAR_INDEX *CreateStarIndex (STAR_DESC *stars, DWORD count);
+extern void DestroyStarIndex (STAR_INDEX *index);
+
+extern void SearchStarIndex (const STAR_INDEX *index, STAR_SEARCH *search,
+		const POINT *pt, SIZE xbounds, SIZE ybounds);
+extern STAR_DESC *NearestInStarIndex (const STAR_INDEX *index,
+		const POINT *pt, SIZE bounds);
+
+extern void InitStarSearch (STAR_SEARCH *search);
+extern BOOLEAN AddFoundStar (STAR_SEARCH *search, STAR_DESC *SDPtr);
+extern STAR_DESC *NextFoundStar (STAR_SEARCH *search);
+extern void EndStarSearch (STAR_SEARCH *search);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* UQM_STARINDEX_H_ */
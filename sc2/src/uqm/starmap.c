@@ -25,6 +25,13 @@
 STAR_DESC *star_array;
 STAR_DESC *CurStarDescPtr = 0;
 
+static STAR_INDEX *starIndex;
+		// Over the solar systems
+static STAR_INDEX *vortexIndex;
+		// Over the QuasiSpace portals
+static STAR_DESC *indexedStars;
+		// The star_array that the indices were built over
+
 STAR_DESC*
 FindStar (STAR_DESC *LastSDPtr, POINT *puniverse, SIZE xbounds,
 		SIZE ybounds)
@@ -40,7 +47,6 @@ FindStar (STAR_DESC *LastSDPtr, POINT *puniverse, SIZE xbounds,
 	}
 	else
 	{
-#define NUM_HYPER_VORTICES 15
 		BaseSDPtr = &star_array[NUM_SOLAR_SYSTEMS + 1];
 		hi = (NUM_HYPER_VORTICES + 1) - 1;
 	}
@@ -98,6 +104,88 @@ FindStar (STAR_DESC *LastSDPtr, POINT *puniverse, SIZE xbounds,
 	return (0);
 }
 
+void
+UninitStarIndex (void)
+{
+	DestroyStarIndex (starIndex);
+	starIndex = NULL;
+	DestroyStarIndex (vortexIndex);
+	vortexIndex = NULL;
+	indexedStars = NULL;
+}
+
+// Returns NULL if the index could not be built, in which case the
+// callers fall back to FindStar().
+static const STAR_INDEX *
+GetStarIndex (void)
+{
+	if (indexedStars != star_array)
+	{
+		UninitStarIndex ();
+		if (!star_array)
+			return NULL;
+		starIndex = CreateStarIndex (star_array, NUM_SOLAR_SYSTEMS);
+		vortexIndex = CreateStarIndex (&star_array[NUM_SOLAR_SYSTEMS + 1],
+				NUM_HYPER_VORTICES + 1);
+		indexedStars = star_array;
+	}
+
+	if (GET_GAME_STATE (ARILOU_SPACE_SIDE) <= 1)
+		return starIndex;
+	else
+		return vortexIndex;
+}
+
+void
+StartStarSearch (STAR_SEARCH *search, const POINT *puniverse, SIZE xbounds,
+		SIZE ybounds)
+{
+	const STAR_INDEX *index = GetStarIndex ();
+	POINT pt = *puniverse;
+	STAR_DESC *SDPtr;
+
+	if (index)
+	{
+		SearchStarIndex (index, search, &pt, xbounds, ybounds);
+		return;
+	}
+
+	InitStarSearch (search);
+	SDPtr = 0;
+	while ((SDPtr = FindStar (SDPtr, &pt, xbounds, ybounds)))
+	{
+		if (!AddFoundStar (search, SDPtr))
+			break;
+	}
+}
+
+STAR_DESC *
+FindNearestStar (const POINT *puniverse, SIZE bounds)
+{
+	const STAR_INDEX *index = GetStarIndex ();
+	POINT pt = *puniverse;
+	STAR_DESC *SDPtr, *BestSDPtr;
+	DWORD best_d2 = 0;
+
+	if (index)
+		return NearestInStarIndex (index, &pt, bounds);
+
+	SDPtr = BestSDPtr = 0;
+	while ((SDPtr = FindStar (SDPtr, &pt, bounds, bounds)))
+	{
+		long dx = SDPtr->star_pt.x - pt.x;
+		long dy = SDPtr->star_pt.y - pt.y;
+		DWORD d2 = (DWORD)(dx * dx + dy * dy);
+
+		if (!BestSDPtr || d2 < best_d2)
+		{
+			BestSDPtr = SDPtr;
+			best_d2 = d2;
+		}
+	}
+	return BestSDPtr;
+}
+
 void
 GetClusterName (const STAR_DESC *pSD, UNICODE buf[])
 {
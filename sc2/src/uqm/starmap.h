@@ -19,6 +19,7 @@
 
 #include "libs/compiler.h"
 #include "planets/planets.h"
+#include "starindex.h"
 
 #if defined(__cplusplus)
 extern "C" {
@@ -28,10 +29,23 @@ extern STAR_DESC *CurStarDescPtr;
 extern STAR_DESC *star_array;
 
 #define NUM_SOLAR_SYSTEMS 502
+#define NUM_HYPER_VORTICES 15
+		// The QuasiSpace portals and the vortices of HyperSpace that lead
+		// to them, which follow the solar systems in star_array
 
 extern STAR_DESC* FindStar (STAR_DESC *pLastStar, POINT *puniverse,
 		SIZE xbounds, SIZE ybounds);
 
+// The same as calling FindStar() repeatedly, but through a spatial index
+// of the stars of the current side of space. Use NextFoundStar() to get
+// the stars, and EndStarSearch() when done.
+extern void StartStarSearch (STAR_SEARCH *search, const POINT *puniverse,
+		SIZE xbounds, SIZE ybounds);
+// Returns the star closest to puniverse, no further than 'bounds' away
+// along either axis, or NULL if there is none.
+extern STAR_DESC *FindNearestStar (const POINT *puniverse, SIZE bounds);
+extern void UninitStarIndex (void);
+
 extern void GetClusterName (const STAR_DESC *pSD, UNICODE buf[]);
 
 #if defined(__cplusplus)
@@ -0,0 +1,854 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "meleesim.h"
+
+#include "melee.h"
+#include "meleesetup.h"
+#include "meleeship.h"
+#include "pickmele.h"
+#include "../battle.h"
+#include "../build.h"
+#include "../cons_res.h"
+#include "../globdata.h"
+#include "../init.h"
+#include "../intel.h"
+#include "../master.h"
+#include "../nameref.h"
+#include "../resinst.h"
+#include "../setup.h"
+#include "../sounds.h"
+#include "../planets/planets.h"
+#include "libs/inplib.h"
+#include "libs/log.h"
+#include "libs/mathlib.h"
+#include "libs/memlib.h"
+#include "libs/timelib.h"
+#ifdef NETPLAY
+#	include "netplay/rollback.h"
+#endif
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef WIN32
+#	include <sys/types.h>
+#	include <sys/wait.h>
+#	include <unistd.h>
+#endif
+
+
+COUNT meleeSimBattles = 0;
+BOOLEAN meleeSimActive = FALSE;
+
+// The share of the matchups this process fights; set by
+// MeleeSim_forkJobs() in the child processes.
+static COUNT meleeSimJob = 0;
+static COUNT meleeSimJobs = 1;
+static int meleeSimTallyFd = -1;
+		// Where a child process sends its tally; -1 if this process
+		// reports the results itself.
+
+typedef enum
+{
+	MELEESIM_DRAW,
+	MELEESIM_BOTTOM_WINS,
+	MELEESIM_TOP_WINS,
+	MELEESIM_TIMEOUT,
+
+	MELEESIM_NUM_RESULTS
+} MELEESIM_RESULT;
+
+static const char *resultNames[MELEESIM_NUM_RESULTS] =
+{
+	"draw",
+	"bottom",
+	"top",
+	"timeout",
+};
+
+typedef struct
+{
+	DWORD frames;
+	TimeCount lastFrameTime;
+	TimePeriod maxFrameTime;
+	BOOLEAN timedOut;
+} MELEESIM_BATTLE;
+
+static MELEESIM_BATTLE curBattle;
+
+#define MELEESIM_NAME_SIZE 32
+
+// Plain data only; it is sent as is from the child processes to the
+// parent, which runs the same executable.
+typedef struct
+{
+	DWORD results[NUM_MELEE_SHIPS][NUM_MELEE_SHIPS][MELEESIM_NUM_RESULTS];
+			// Indexed by bottom ship, top ship and result.
+	DWORD battles;
+	DWORD frames;
+	DWORD time;
+			// Time spent in the battles, in ticks.
+	char shipNames[NUM_MELEE_SHIPS][MELEESIM_NAME_SIZE];
+	DWORD rollbackChecks;
+	DWORD rollbackMismatches;
+			// Only with meleeSimRollback.
+} MELEESIM_TALLY;
+
+static MELEESIM_TALLY tally;
+
+#define TICKS_TO_USEC(t) ((DWORD)((t) * (1000000.0 / ONE_SECOND)))
+
+#ifdef NETPLAY
+BOOLEAN meleeSimRollback = FALSE;
+COUNT meleeSimRollbackLatency = 0;
+
+#define MELEESIM_ROLLBACK_FRAMES (MELEESIM_MAX_FRAMES + 2)
+		// Room for the input and checksums of the longest battle.
+
+typedef enum
+{
+	ROLLBACK_PASS_PREDICT,
+			// Rollback mode; the input of the top player is delayed.
+	ROLLBACK_PASS_REPLAY,
+			// Both players "remote", with the input recorded in the
+			// first pass.
+} MELEESIM_ROLLBACK_PASS;
+
+typedef struct
+{
+	MELEESIM_ROLLBACK_PASS pass;
+
+	// The input of the top player on its way, in the first pass.
+	BATTLE_INPUT_STATE *sent;
+	DWORD *sentAt;
+			// The frame (as counted by MeleeSim_frameCallback()) each
+			// input was sent in.
+	DWORD numSent;
+	DWORD numReceived;
+	BOOLEAN forceReceive;
+
+	// The final input of each frame, recorded in the first pass.
+	BATTLE_INPUT_STATE (*input)[NUM_PLAYERS];
+	DWORD numInput;
+	DWORD replayed[NUM_PLAYERS];
+
+	// The checksums of the final states, per pass.
+	Checksum *checksums[2];
+	DWORD numChecksums[2];
+
+	// The scripted input.
+	BattleInputHandlers handlers[NUM_PLAYERS];
+	DWORD scriptState[NUM_PLAYERS];
+	BATTLE_INPUT_STATE scriptInput[NUM_PLAYERS];
+} MELEESIM_ROLLBACK;
+
+static MELEESIM_ROLLBACK rb;
+#endif  /* NETPLAY */
+
+
+static void
+MeleeSim_frameCallback (void)
+{
+	TimeCount now = GetTimeCounter ();
+
+	if (curBattle.frames > 0)
+	{
+		TimePeriod period = now - curBattle.lastFrameTime;
+		if (period > curBattle.maxFrameTime)
+			curBattle.maxFrameTime = period;
+	}
+	curBattle.lastFrameTime = now;
+	curBattle.frames++;
+
+	if (curBattle.frames > MELEESIM_MAX_FRAMES)
+	{	// Neither AI is going to win this one. Battle() clears
+		// CHECK_ABORT again on its way out of a SuperMelee battle.
+		curBattle.timedOut = TRUE;
+		GLOBAL (CurrentActivity) |= CHECK_ABORT;
+	}
+}
+
+static const char *
+MeleeSim_shipName (MeleeShip ship)
+{
+	HMASTERSHIP hMasterShip;
+	MASTER_SHIP_INFO *MasterPtr;
+	const char *name;
+
+	hMasterShip = GetStarShipFromIndex (&master_q, ship);
+	MasterPtr = LockMasterShip (&master_q, hMasterShip);
+	name = GetStringAddress (SetAbsStringTableIndex (
+			MasterPtr->ShipInfo.race_strings, 2));
+	UnlockMasterShip (&master_q, hMasterShip);
+
+	return name;
+}
+
+#ifdef NETPLAY
+// Takes the place of the computer players' frameInput handler. Holds
+// each input for a random number of frames, so that the predictions
+// are right most of the time, as they would be with a human player.
+static BATTLE_INPUT_STATE
+MeleeSim_scriptedInput (InputContext *context, STARSHIP *StarShipPtr)
+{
+	COUNT playerNr = context->playerNr;
+	DWORD *state = &rb.scriptState[playerNr];
+
+	*state = *state * 1103515245 + 12345;
+	if (((*state >> 16) & 0x07) == 0)
+	{
+		rb.scriptInput[playerNr] = (BATTLE_INPUT_STATE) ((*state >> 20)
+				& (BATTLE_LEFT | BATTLE_RIGHT | BATTLE_THRUST
+				| BATTLE_WEAPON | BATTLE_SPECIAL));
+	}
+
+	(void) StarShipPtr;
+	return rb.scriptInput[playerNr];
+}
+
+static bool
+MeleeSim_rollbackPollInput (size_t player, BATTLE_INPUT_STATE *input)
+{
+	if (rb.pass == ROLLBACK_PASS_REPLAY)
+	{
+		if (rb.replayed[player] >= rb.numInput)
+			return false;
+		*input = rb.input[rb.replayed[player]++][player];
+		return true;
+	}
+
+	if (rb.numReceived >= rb.numSent)
+		return false;
+	if (!rb.forceReceive && rb.sentAt[rb.numReceived]
+			+ meleeSimRollbackLatency > curBattle.frames)
+		return false;
+
+	rb.forceReceive = FALSE;
+	*input = rb.sent[rb.numReceived++];
+	return true;
+}
+
+static bool
+MeleeSim_rollbackWaitInput (void)
+{
+	if (rb.pass == ROLLBACK_PASS_PREDICT && rb.numReceived < rb.numSent)
+	{	// Let the next input "arrive" early.
+		rb.forceReceive = TRUE;
+		return true;
+	}
+
+	// Ran out of input. In the replay this is where the first pass was
+	// called off; anything else is a bug.
+	if (rb.pass == ROLLBACK_PASS_PREDICT || !curBattle.timedOut)
+		log_add (log_Error, "MeleeSim: rollback check ran out of input "
+				"in frame %lu.", (unsigned long) battleFrameCount);
+	GLOBAL (CurrentActivity) |= CHECK_ABORT;
+	return false;
+}
+
+static void
+MeleeSim_rollbackSendInput (size_t player, BATTLE_INPUT_STATE input)
+{
+	if (rb.pass != ROLLBACK_PASS_PREDICT)
+		return;
+
+	assert (player == 1);
+	if (rb.numSent < MELEESIM_ROLLBACK_FRAMES)
+	{
+		rb.sent[rb.numSent] = input;
+		rb.sentAt[rb.numSent] = curBattle.frames;
+		rb.numSent++;
+	}
+	(void) player;
+}
+
+static void
+MeleeSim_rollbackStateChecksum (BattleFrameCounter frameNr,
+		Checksum checksum)
+{
+	DWORD *num = &rb.numChecksums[rb.pass];
+
+	assert (frameNr == *num * NETPLAY_CHECKSUM_INTERVAL);
+	if (*num < MELEESIM_ROLLBACK_FRAMES)
+		rb.checksums[rb.pass][(*num)++] = checksum;
+	(void) frameNr;
+}
+
+static void
+MeleeSim_rollbackFrameInput (BattleFrameCounter frameNr,
+		const BATTLE_INPUT_STATE *input)
+{
+	if (rb.pass != ROLLBACK_PASS_PREDICT)
+		return;
+
+	assert (frameNr == rb.numInput);
+	if (rb.numInput < MELEESIM_ROLLBACK_FRAMES)
+	{
+		memcpy (rb.input[rb.numInput], input,
+				NUM_PLAYERS * sizeof *input);
+		rb.numInput++;
+	}
+	(void) frameNr;
+}
+
+static const RollbackTransport meleeSimRollbackTransport =
+{
+	/* .pollInput     = */ MeleeSim_rollbackPollInput,
+	/* .waitInput     = */ MeleeSim_rollbackWaitInput,
+	/* .sendInput     = */ MeleeSim_rollbackSendInput,
+	/* .stateChecksum = */ MeleeSim_rollbackStateChecksum,
+	/* .frameInput    = */ MeleeSim_rollbackFrameInput,
+};
+
+static BOOLEAN
+MeleeSim_allocRollback (void)
+{
+	rb.sent = HMalloc (MELEESIM_ROLLBACK_FRAMES * sizeof *rb.sent);
+	rb.sentAt = HMalloc (MELEESIM_ROLLBACK_FRAMES * sizeof *rb.sentAt);
+	rb.input = HMalloc (MELEESIM_ROLLBACK_FRAMES * sizeof *rb.input);
+	rb.checksums[0] = HMalloc (MELEESIM_ROLLBACK_FRAMES
+			* sizeof *rb.checksums[0]);
+	rb.checksums[1] = HMalloc (MELEESIM_ROLLBACK_FRAMES
+			* sizeof *rb.checksums[1]);
+
+	return rb.sent && rb.sentAt && rb.input && rb.checksums[0]
+			&& rb.checksums[1];
+}
+
+static void
+MeleeSim_freeRollback (void)
+{
+	HFree (rb.sent);
+	HFree (rb.sentAt);
+	HFree (rb.input);
+	HFree (rb.checksums[0]);
+	HFree (rb.checksums[1]);
+	memset (&rb, 0, sizeof rb);
+}
+
+// Called between setting up the players and the battle.
+static void
+MeleeSim_startRollback (DWORD seed)
+{
+	bool remote[NUM_PLAYERS];
+	COUNT playerNr;
+
+	for (playerNr = 0; playerNr < NUM_PLAYERS; playerNr++)
+	{
+		rb.handlers[playerNr] = *PlayerInput[playerNr]->handlers;
+		rb.handlers[playerNr].frameInput = MeleeSim_scriptedInput;
+		PlayerInput[playerNr]->handlers = &rb.handlers[playerNr];
+		rb.scriptState[playerNr] = seed * 2 + playerNr;
+		rb.scriptInput[playerNr] = 0;
+
+		remote[playerNr] = rb.pass == ROLLBACK_PASS_REPLAY || playerNr == 1;
+		rb.replayed[playerNr] = 0;
+	}
+
+	rb.numSent = 0;
+	rb.numReceived = 0;
+	rb.forceReceive = FALSE;
+	rb.numChecksums[rb.pass] = 0;
+	if (rb.pass == ROLLBACK_PASS_PREDICT)
+		rb.numInput = 0;
+
+	if (!Rollback_init (&meleeSimRollbackTransport, remote))
+		GLOBAL (CurrentActivity) |= CHECK_ABORT;
+}
+#endif  /* NETPLAY */
+
+static MELEESIM_RESULT
+MeleeSim_battle (MeleeSetup *setup, DWORD seed, TimePeriod *elapsed)
+{
+	TimeCount start;
+
+	memset (&curBattle, 0, sizeof curBattle);
+
+	TFB_SeedRandom (seed);
+	start = GetTimeCounter ();
+
+	if (!SetPlayerInputAll ())
+	{
+		log_add (log_Error, "MeleeSim: could not set player input.");
+		GLOBAL (CurrentActivity) |= CHECK_ABORT;
+		*elapsed = 0;
+		return MELEESIM_DRAW;
+	}
+	FillPickMeleeFrame (setup);
+			// Also builds the race_q for each player.
+#ifdef NETPLAY
+	if (meleeSimRollback)
+		MeleeSim_startRollback (seed);
+#endif
+
+	load_gravity_well ((BYTE)((COUNT)TFB_Random () %
+				NUMBER_OF_PLANET_TYPES));
+	Battle (&MeleeSim_frameCallback);
+	free_gravity_well ();
+#ifdef NETPLAY
+	if (meleeSimRollback)
+		Rollback_uninit ();
+#endif
+	ClearPlayerInputAll ();
+
+	*elapsed = GetTimeCounter () - start;
+
+	if (curBattle.timedOut)
+		return MELEESIM_TIMEOUT;
+	if (battle_counter[0] && !battle_counter[1])
+		return MELEESIM_BOTTOM_WINS;
+	if (battle_counter[1] && !battle_counter[0])
+		return MELEESIM_TOP_WINS;
+	return MELEESIM_DRAW;
+}
+
+#ifdef NETPLAY
+// Fights the battle that was just fought again, in lockstep with the
+// recorded input, and compares the states.
+// Returns FALSE if they differ.
+static BOOLEAN
+MeleeSim_checkRollback (MeleeSetup *setup, DWORD seed)
+{
+	MELEESIM_BATTLE predicted = curBattle;
+	TimePeriod elapsed;
+	DWORD num;
+	DWORD i;
+
+	rb.pass = ROLLBACK_PASS_REPLAY;
+	MeleeSim_battle (setup, seed, &elapsed);
+	rb.pass = ROLLBACK_PASS_PREDICT;
+
+	num = rb.numChecksums[0];
+	if (rb.numChecksums[1] < num)
+		num = rb.numChecksums[1];
+	for (i = 0; i < num; i++)
+	{
+		if (rb.checksums[0][i] != rb.checksums[1][i])
+		{
+			log_add (log_Error, "MeleeSim: rollback check failed; the "
+					"state differs from frame %lu on.",
+					(unsigned long) (i * NETPLAY_CHECKSUM_INTERVAL));
+			curBattle = predicted;
+			return FALSE;
+		}
+	}
+
+	// Unless the battle was called off, both should have ended in the
+	// same frame.
+	if (!predicted.timedOut && !curBattle.timedOut
+			&& rb.numChecksums[0] != rb.numChecksums[1])
+	{
+		log_add (log_Error, "MeleeSim: rollback check failed; the battle "
+				"lasted %lu frames, and %lu in the replay.",
+				(unsigned long) rb.numChecksums[0],
+				(unsigned long) rb.numChecksums[1]);
+		curBattle = predicted;
+		return FALSE;
+	}
+
+	curBattle = predicted;
+	return TRUE;
+}
+#endif  /* NETPLAY */
+
+static double
+percentage (DWORD part, DWORD whole)
+{
+	return whole ? 100.0 * part / whole : 0.0;
+}
+
+static void
+MeleeSim_report (const MELEESIM_TALLY *t)
+{
+	COUNT ship0, ship1;
+
+	log_add (log_User, "MeleeSim: %lu battles, %lu frames in %lu ms of "
+			"simulation (%lu frames/s).", (unsigned long) t->battles,
+			(unsigned long) t->frames,
+			(unsigned long) (t->time * 1000 / ONE_SECOND),
+			(unsigned long) (t->time ?
+			(double) t->frames * ONE_SECOND / t->time : 0));
+
+	if (t->rollbackChecks > 0)
+	{
+		log_add (log_User, "MeleeSim: rollback mode checked in %lu "
+				"battles; %lu failed.", (unsigned long) t->rollbackChecks,
+				(unsigned long) t->rollbackMismatches);
+	}
+
+	log_add (log_User, "bottom,top,battles,bottom wins %%,top wins %%,"
+			"draws %%,timeouts %%");
+	for (ship0 = 0; ship0 < NUM_MELEE_SHIPS; ship0++)
+	{
+		for (ship1 = 0; ship1 < NUM_MELEE_SHIPS; ship1++)
+		{
+			const DWORD *r = t->results[ship0][ship1];
+			DWORD battles = r[MELEESIM_DRAW] + r[MELEESIM_BOTTOM_WINS]
+					+ r[MELEESIM_TOP_WINS] + r[MELEESIM_TIMEOUT];
+
+			if (battles == 0)
+				continue;
+
+			log_add (log_User, "%s,%s,%lu,%.1f,%.1f,%.1f,%.1f",
+					t->shipNames[ship0], t->shipNames[ship1],
+					(unsigned long) battles,
+					percentage (r[MELEESIM_BOTTOM_WINS], battles),
+					percentage (r[MELEESIM_TOP_WINS], battles),
+					percentage (r[MELEESIM_DRAW], battles),
+					percentage (r[MELEESIM_TIMEOUT], battles));
+		}
+	}
+
+	// Overall, over both sides and all opponents. Mirror matches count
+	// once for each side.
+	log_add (log_User, "ship,battles,wins %%");
+	for (ship0 = 0; ship0 < NUM_MELEE_SHIPS; ship0++)
+	{
+		DWORD battles = 0;
+		DWORD wins = 0;
+		int res;
+
+		for (ship1 = 0; ship1 < NUM_MELEE_SHIPS; ship1++)
+		{
+			for (res = 0; res < MELEESIM_NUM_RESULTS; res++)
+			{
+				battles += t->results[ship0][ship1][res];
+				battles += t->results[ship1][ship0][res];
+			}
+			wins += t->results[ship0][ship1][MELEESIM_BOTTOM_WINS];
+			wins += t->results[ship1][ship0][MELEESIM_TOP_WINS];
+		}
+
+		if (battles == 0)
+			continue;
+
+		log_add (log_User, "%s,%lu,%.1f", t->shipNames[ship0],
+				(unsigned long) battles, percentage (wins, battles));
+	}
+}
+
+#ifndef WIN32
+static BOOLEAN
+writeAll (int fd, const void *buf, size_t size)
+{
+	const char *ptr = buf;
+
+	while (size > 0)
+	{
+		ssize_t n = write (fd, ptr, size);
+		if (n == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			return FALSE;
+		}
+		ptr += n;
+		size -= n;
+	}
+	return TRUE;
+}
+
+static BOOLEAN
+readAll (int fd, void *buf, size_t size)
+{
+	char *ptr = buf;
+
+	while (size > 0)
+	{
+		ssize_t n = read (fd, ptr, size);
+		if (n == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			return FALSE;
+		}
+		if (n == 0)
+			return FALSE;  // EOF; the child did not finish
+		ptr += n;
+		size -= n;
+	}
+	return TRUE;
+}
+#endif  /* !WIN32 */
+
+void
+MeleeSim (void)
+{
+	extern UWORD nth_frame;
+	MeleeSetup *setup;
+	COUNT numShips;
+	MeleeShip ship0, ship1;
+	COUNT matchup;
+
+	InitGlobData ();
+	GLOBAL (CurrentActivity) = SUPER_MELEE;
+	meleeSimActive = TRUE;
+
+	GameSounds = CaptureSound (LoadSound (GAME_SOUNDS));
+	BuildPickMeleeFrame ();
+	InitSpace ();
+
+	setup = MeleeSetup_new ();
+	PlayerControl[0] = COMPUTER_CONTROL | AWESOME_RATING;
+	PlayerControl[1] = COMPUTER_CONTROL | AWESOME_RATING;
+	nth_frame = MAKE_WORD (1, (BYTE)~0);
+			// Maximum speed, nothing rendered.
+
+	memset (&tally, 0, sizeof tally);
+	numShips = CountLinks (&master_q);
+	if (numShips > NUM_MELEE_SHIPS)
+		numShips = NUM_MELEE_SHIPS;
+	for (ship0 = 0; ship0 < numShips; ship0++)
+	{
+		strncpy (tally.shipNames[ship0], MeleeSim_shipName (ship0),
+				MELEESIM_NAME_SIZE - 1);
+	}
+
+	log_add (log_User, "MeleeSim: %u ships, %u battles per matchup, "
+			"job %u of %u.", numShips, meleeSimBattles,
+			meleeSimJob + 1, meleeSimJobs);
+#ifdef NETPLAY
+	if (meleeSimRollback)
+	{
+		if (MeleeSim_allocRollback ())
+		{
+			log_add (log_User, "MeleeSim: checking rollback mode with a "
+					"latency of %u frames.", meleeSimRollbackLatency);
+		}
+		else
+		{
+			log_add (log_Error, "MeleeSim: out of memory; not checking "
+					"rollback mode.");
+			MeleeSim_freeRollback ();
+			meleeSimRollback = FALSE;
+		}
+	}
+#endif
+	log_add (log_User, "bottom,top,seed,winner,frames,ms,"
+			"usec/frame,max usec/frame");
+
+	matchup = 0;
+	for (ship0 = 0; ship0 < numShips; ship0++)
+	{
+		for (ship1 = 0; ship1 < numShips; ship1++, matchup++)
+		{
+			COUNT battleI;
+
+			if (matchup % meleeSimJobs != meleeSimJob)
+				continue;
+
+			MeleeSetup_setShip (setup, 0, 0, ship0);
+			MeleeSetup_setShip (setup, 1, 0, ship1);
+
+			for (battleI = 0; battleI < meleeSimBattles; battleI++)
+			{
+				DWORD seed = battleI + 1;
+				TimePeriod elapsed;
+				MELEESIM_RESULT result;
+
+				result = MeleeSim_battle (setup, seed, &elapsed);
+				if (QuitPosted || (GLOBAL (CurrentActivity) & CHECK_ABORT))
+					goto done;
+#ifdef NETPLAY
+				if (meleeSimRollback)
+				{
+					tally.rollbackChecks++;
+					if (!MeleeSim_checkRollback (setup, seed))
+						tally.rollbackMismatches++;
+					if (QuitPosted)
+						goto done;
+				}
+#endif
+
+				log_add (log_User, "%s,%s,%lu,%s,%lu,%lu,%lu,%lu",
+						tally.shipNames[ship0], tally.shipNames[ship1],
+						(unsigned long) seed, resultNames[result],
+						(unsigned long) curBattle.frames,
+						(unsigned long) (elapsed * 1000 / ONE_SECOND),
+						(unsigned long) (curBattle.frames ?
+						TICKS_TO_USEC (elapsed) / curBattle.frames : 0),
+						(unsigned long) TICKS_TO_USEC (
+						curBattle.maxFrameTime));
+
+				tally.results[ship0][ship1][result]++;
+				tally.battles++;
+				tally.frames += curBattle.frames;
+				tally.time += elapsed;
+			}
+		}
+	}
+
+done:
+#ifndef WIN32
+	if (meleeSimTallyFd != -1)
+	{	// The parent process reports the results of all jobs
+		if (!writeAll (meleeSimTallyFd, &tally, sizeof tally))
+			log_add (log_Error, "MeleeSim: could not send the results "
+					"of job %u: %s.", meleeSimJob + 1, strerror (errno));
+		close (meleeSimTallyFd);
+		meleeSimTallyFd = -1;
+	}
+	else
+#endif
+		MeleeSim_report (&tally);
+
+#ifdef NETPLAY
+	if (meleeSimRollback)
+		MeleeSim_freeRollback ();
+#endif
+	nth_frame = MAKE_WORD (0, 0);
+	MeleeSetup_delete (setup);
+
+	UninitSpace ();
+	DestroyPickMeleeFrame ();
+	DestroySound (ReleaseSound (GameSounds));
+	GameSounds = 0;
+
+	meleeSimActive = FALSE;
+}
+
+// Splits the matchups over 'jobs' child processes, each of which fights
+// its share in its own copy of the game. Must be called before anything
+// is initialised beyond the logging, as the children carry on with the
+// normal start-up from here.
+// Returns FALSE in a child process (or if no child could be started; the
+// calling process then runs all of the matchups itself).
+// Returns TRUE in the parent process once all of the children have
+// finished and their combined results have been reported; *exitCode is
+// then the exit code for the parent.
+#ifndef WIN32
+BOOLEAN
+MeleeSim_forkJobs (COUNT jobs, int *exitCode)
+{
+	static MELEESIM_TALLY part;
+	int fds[MELEESIM_MAX_JOBS];
+	pid_t pids[MELEESIM_MAX_JOBS];
+	COUNT started;
+	COUNT job;
+	COUNT failed;
+
+	if (jobs > MELEESIM_MAX_JOBS)
+		jobs = MELEESIM_MAX_JOBS;
+	if (jobs <= 1)
+		return FALSE;
+
+	fflush (NULL);
+			// Or whatever is buffered would be written by every child.
+
+	for (started = 0; started < jobs; started++)
+	{
+		int pipeFds[2];
+		pid_t pid;
+
+		if (pipe (pipeFds) == -1)
+		{
+			log_add (log_Error, "MeleeSim: pipe() failed: %s.",
+					strerror (errno));
+			break;
+		}
+
+		pid = fork ();
+		if (pid == -1)
+		{
+			log_add (log_Error, "MeleeSim: fork() failed: %s.",
+					strerror (errno));
+			close (pipeFds[0]);
+			close (pipeFds[1]);
+			break;
+		}
+
+		if (pid == 0)
+		{	// Child
+			close (pipeFds[0]);
+			for (job = 0; job < started; job++)
+				close (fds[job]);
+
+			meleeSimJob = started;
+			meleeSimJobs = jobs;
+			meleeSimTallyFd = pipeFds[1];
+			return FALSE;
+		}
+
+		close (pipeFds[1]);
+		fds[started] = pipeFds[0];
+		pids[started] = pid;
+	}
+
+	if (started == 0)
+	{
+		log_add (log_Warning, "MeleeSim: running in a single process.");
+		return FALSE;
+	}
+
+	memset (&tally, 0, sizeof tally);
+	failed = jobs - started;
+	for (job = 0; job < started; job++)
+	{
+		COUNT ship0, ship1;
+		int res;
+		int status;
+		BOOLEAN ok;
+
+		ok = readAll (fds[job], &part, sizeof part);
+		close (fds[job]);
+		while (waitpid (pids[job], &status, 0) == -1 && errno == EINTR)
+			continue;
+
+		if (!ok)
+		{
+			log_add (log_Error, "MeleeSim: job %u did not finish.",
+					job + 1);
+			failed++;
+			continue;
+		}
+
+		for (ship0 = 0; ship0 < NUM_MELEE_SHIPS; ship0++)
+		{
+			if (tally.shipNames[ship0][0] == '\0')
+				memcpy (tally.shipNames[ship0], part.shipNames[ship0],
+						MELEESIM_NAME_SIZE);
+			for (ship1 = 0; ship1 < NUM_MELEE_SHIPS; ship1++)
+				for (res = 0; res < MELEESIM_NUM_RESULTS; res++)
+					tally.results[ship0][ship1][res] +=
+							part.results[ship0][ship1][res];
+		}
+		tally.battles += part.battles;
+		tally.frames += part.frames;
+		tally.time += part.time;
+		tally.rollbackChecks += part.rollbackChecks;
+		tally.rollbackMismatches += part.rollbackMismatches;
+	}
+
+	if (failed)
+		log_add (log_Error, "MeleeSim: %u of %u jobs failed; the results "
+				"are incomplete.", failed, jobs);
+	MeleeSim_report (&tally);
+
+	*exitCode = failed ? EXIT_FAILURE : EXIT_SUCCESS;
+	return TRUE;
+}
+#else  /* WIN32 */
+BOOLEAN
+MeleeSim_forkJobs (COUNT jobs, int *exitCode)
+{
+	if (jobs > 1)
+		log_add (log_Warning, "MeleeSim: parallel jobs are not supported "
+				"on this platform; running in a single process.");
+	(void) exitCode;
+	return FALSE;
+}
+#endif  /* WIN32 */
@@ -0,0 +1,79 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef UQM_SUPERMELEE_MELEESIM_H_
+#define UQM_SUPERMELEE_MELEESIM_H_
+
+#include "libs/compiler.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Headless SuperMelee simulation.
+//
+// Every ship is pitted against every other ship (and itself), both sides
+// under computer control, a fixed number of times per matchup. Battle
+// number 'n' of a matchup is seeded with 'n', so a run can be repeated
+// exactly. Nothing is drawn, no sound is played and none of the real-time
+// waits of the normal melee (computer 'thinking' time, fades, the victory
+// ditty, the game over screen) are observed, so the battles run as fast
+// as the simulation allows.
+//
+// One line is logged per battle. At the end the win rates are reported
+// per matchup and per ship.
+//
+// The matchups can be split over several processes with
+// MeleeSim_forkJobs(); the parent process collects and reports the
+// results of all of them. The game keeps its state in globals throughout
+// (GlobData, the display queue, the RNG, the loaded resources, the
+// graphics contexts), so separate processes are the way to run battles
+// side by side; they are not run on threads. Windows has no fork(), so
+// there all matchups run one after another in the one process.
+
+// Battles to fight per matchup. Set from the command line; when it is
+// non-zero, Starcon2Main() runs MeleeSim() instead of the game.
+extern COUNT meleeSimBattles;
+
+// Set while MeleeSim() runs. The places that would otherwise wait for
+// the player or for the wall clock test this.
+extern BOOLEAN meleeSimActive;
+
+#ifdef NETPLAY
+// Set from the command line. Every battle is then fought in rollback mode
+// (see netplay/rollback.h), with the input of the top player arriving
+// 'meleeSimRollbackLatency' frames late, and fought again in lockstep
+// with the same input. The states of both are compared frame by frame.
+// The ships are steered by scripted input rather than the computer
+// players, as these draw on the battle's RNG.
+extern BOOLEAN meleeSimRollback;
+extern COUNT meleeSimRollbackLatency;
+#endif
+
+// Battles taking longer than this many frames are called off as a draw.
+#define MELEESIM_MAX_FRAMES (24 * 60 * 10)
+		// Ten minutes at the normal battle frame rate.
+
+#define MELEESIM_MAX_JOBS 64
+
+extern void MeleeSim (void);
+extern BOOLEAN MeleeSim_forkJobs (COUNT jobs, int *exitCode);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* UQM_SUPERMELEE_MELEESIM_H_ */
@@ -38,46 +38,29 @@ ChecksumBuffer_getCurrentFrameNr(void) {
 }
 
 void
-ChecksumBuffer_init(ChecksumBuffer *cb, size_t delay, size_t interval) {
-	// The input buffer lags BattleInput_inputDelay frames behind,
-	// but only every interval frames will there be a checksum to be
-	// checked.
-
+ChecksumBuffer_init(ChecksumBuffer *cb, size_t window, size_t interval) {
 	// Checksums will be checked when 'frameNr % interval == 0'.
 	// (and frameNr is zero-based).
-	// The checksum of frame n will be processed in frame 'n + delay'.
-
-	// In the worst case, side 1 processes frames 'n' through 'n + delay - 1',
-	// then blocks in frame 'n + delay' (after sending a checksum, if that's
-	// pertinent for that frame).
-	// Then side 2 receives all this input and these checksums, and
-	// progresses to 'delay' frames after the last frame the received input
-	// originated from, and blocks in the frame after it (after sending a
-	// checksum, if that's pertinent for the frame).
-	// So it sent input and checksums for frames 'n' through
-	// 'n + delay + delay + 1'.
-	// The input and checksums for these '2*delay + 2' frames are still
-	// unhandled by side 1, so it needs buffer space for this.
-	// With checksums only sent every interval frames, the buffer space
-	// needed will be 'roundUp(2*delay + 2)' spaces.
-
-	size_t bufSize = ((2 * delay + 2) + (interval - 1)) / interval;
+	// A checksum may have to be kept for 'window' frames; from the
+	// moment it is received or computed until the moment it is compared
+	// (see getChecksumDelay()). With checksums only sent every interval
+	// frames, the buffer space needed is 'window / interval', rounded up.
+	// One more entry is added so that an entry is never overwritten by
+	// the checksum for the frame 'window' frames later.
+
+	size_t bufSize = (window + (interval - 1)) / interval + 1;
 
 	{
-#ifdef NETPLAY_DEBUG
 		size_t i;
-#endif
 
 		cb->checksums = malloc(bufSize * sizeof (ChecksumEntry));
 		cb->maxSize = bufSize;
 		cb->interval = interval;
 
-#ifdef NETPLAY_DEBUG
 		for (i = 0; i < bufSize; i++) {
 			cb->checksums[i].checksum = 0;
 			cb->checksums[i].frameNr = (BattleFrameCounter) -1;
 		}
-#endif
 	}
 }
 
@@ -115,14 +98,12 @@ ChecksumBuffer_addChecksum(ChecksumBuffer *cb, BattleFrameCounter frameNr,
 
 	entry = ChecksumBuffer_getChecksumEntry(cb, frameNr);
 
-#ifdef NETPLAY_DEBUG
 	entry->frameNr = frameNr;
-#endif
 	entry->checksum = checksum;
 	return true;
 }
 
-// Pre: frameNr is within the range of the checksums stored in cb.
+// Returns false if there is no checksum for the frame.
 bool
 ChecksumBuffer_getChecksum(ChecksumBuffer *cb, BattleFrameCounter frameNr,
 		Checksum *result) {
@@ -130,14 +111,12 @@ ChecksumBuffer_getChecksum(ChecksumBuffer *cb, BattleFrameCounter frameNr,
 
 	entry = ChecksumBuffer_getChecksumEntry(cb, frameNr);
 	
-#ifdef NETPLAY_DEBUG
 	if (frameNr != entry->frameNr) {
 		log_add(log_Error, "Checksum buffer entry for requested frame %u "
 				"(still?) contains a checksum for frame %u.\n",
 				frameNr, entry->frameNr);
 		return false;
 	}
-#endif
 
 	*result = entry->checksum;
 	return true;
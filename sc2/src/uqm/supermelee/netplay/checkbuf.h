@@ -40,15 +40,12 @@ extern "C" {
 
 
 struct ChecksumEntry {
-#ifdef NETPLAY_DEBUG
 	BattleFrameCounter frameNr;
 			// The number of the frame this checksum originated from.
-			// If the checksumming code is working correctly, the checksum
-			// can only come from one frame, so this value is not needed
-			// for normal operation.
-			// Its only use is to detect some cases where checksumming code
-			// is *not* working correctly.
-#endif
+			// A checksum may arrive well before or after the frame it
+			// is for is compared (see getChecksumDelay()); this tells
+			// whether the entry holds the checksum asked for, or that
+			// of an earlier frame.
 	Checksum checksum;
 };
 
@@ -63,7 +60,7 @@ struct ChecksumBuffer {
 	size_t interval;
 };
 
-void ChecksumBuffer_init(ChecksumBuffer *cb, size_t delay, size_t interval);
+void ChecksumBuffer_init(ChecksumBuffer *cb, size_t window, size_t interval);
 void ChecksumBuffer_uninit(ChecksumBuffer *cb);
 bool ChecksumBuffer_addChecksum(ChecksumBuffer *cb,
 		BattleFrameCounter frameNr, Checksum checksum);
@@ -28,10 +28,18 @@
 		// for DUMP_CRC_OPS
 #include "netconnection.h"
 #include "netmelee.h"
+#include "rollback.h"
 #include "libs/log.h"
 #include "libs/mathlib.h"
 
+#include <stdlib.h>
+
 ChecksumBuffer localChecksumBuffer;
+static BattleFrameCounter nextVerifyFrame;
+static CrcAlgorithm battleChecksumAlgorithm = CrcAlgorithm_crc32;
+
+static uint8 *stateBuf;
+static size_t stateBufSize;
 
 void
 crc_processEXTENT(crc_State *state, const EXTENT *val) {
@@ -195,9 +203,242 @@ crc_processState(crc_State *state) {
 #endif
 }
 
+static inline uint8 *
+packUint8(uint8 *buf, uint8 val) {
+	buf[0] = val;
+	return buf + 1;
+}
+
+static inline uint8 *
+packUint16(uint8 *buf, uint16 val) {
+	buf[0] = (uint8) (val & 0xff);
+	buf[1] = (uint8) (val >> 8);
+	return buf + 2;
+}
+
+static inline uint8 *
+packUint32(uint8 *buf, uint32 val) {
+	buf[0] = (uint8) (val & 0xff);
+	buf[1] = (uint8) ((val >> 8) & 0xff);
+	buf[2] = (uint8) ((val >> 16) & 0xff);
+	buf[3] = (uint8) (val >> 24);
+	return buf + 4;
+}
+
+static inline uint8 *
+packEXTENT(uint8 *buf, const EXTENT *val) {
+	buf = packUint16(buf, (uint16) val->width);
+	return packUint16(buf, (uint16) val->height);
+}
+
+static inline uint8 *
+packPOINT(uint8 *buf, const POINT *val) {
+	buf = packUint16(buf, (uint16) val->x);
+	return packUint16(buf, (uint16) val->y);
+}
+
+// Write the checksummed fields of an element to 'buf', which must have
+// room for CHECKSUM_ELEMENT_SIZE bytes.
+// The bytes are the ones, in the same order, that crc_processELEMENT()
+// processes, so a CRC-32 over them is the same as with that function.
+// Returns the number of bytes written; 0 for elements that are not
+// checksummed.
+size_t
+crc_packELEMENT(uint8 *buf, const ELEMENT *val) {
+	uint8 *start = buf;
+
+	if (val->state_flags & BACKGROUND_OBJECT)
+		return 0;
+
+	buf = packUint16(buf, (uint16) val->state_flags);
+	buf = packUint16(buf, (uint16) val->life_span);
+	buf = packUint16(buf, (uint16) val->crew_level);
+	buf = packUint8(buf, (uint8) val->mass_points);
+	buf = packUint8(buf, (uint8) val->turn_wait);
+	buf = packUint8(buf, (uint8) val->thrust_wait);
+	buf = packUint16(buf, (uint16) val->velocity.TravelAngle);
+	buf = packEXTENT(buf, &val->velocity.vector);
+	buf = packEXTENT(buf, &val->velocity.fract);
+	buf = packEXTENT(buf, &val->velocity.error);
+	buf = packEXTENT(buf, &val->velocity.incr);
+	buf = packPOINT(buf, &val->current.location);
+	buf = packPOINT(buf, &val->next.location);
+
+	assert((size_t) (buf - start) == CHECKSUM_ELEMENT_SIZE);
+	return (size_t) (buf - start);
+}
+
+static bool
+reserveStateBuf(size_t size) {
+	uint8 *newBuf;
+	size_t newSize;
+
+	if (size <= stateBufSize)
+		return true;
+
+	newSize = stateBufSize != 0 ? stateBufSize : 4096;
+	while (newSize < size)
+		newSize *= 2;
+
+	newBuf = realloc(stateBuf, newSize);
+	if (newBuf == NULL)
+		return false;
+
+	stateBuf = newBuf;
+	stateBufSize = newSize;
+	return true;
+}
+
+// Write everything that crc_processState() processes to stateBuf.
+// Returns the number of bytes, or (size_t) -1 if out of memory.
+static size_t
+packState(void) {
+	HELEMENT element;
+	HELEMENT nextElement;
+	DWORD seed;
+	size_t used;
+
+	if (!reserveStateBuf(4 + 64 * CHECKSUM_ELEMENT_SIZE))
+		return (size_t) -1;
+
+	seed = TFB_SeedRandom(0);
+	TFB_SeedRandom(seed);
+	packUint32(stateBuf, (uint32) seed);
+	used = 4;
+
+	for (element = GetHeadElement(); element != 0; element = nextElement) {
+		ELEMENT *elementPtr;
+
+		if (!reserveStateBuf(used + CHECKSUM_ELEMENT_SIZE))
+			return (size_t) -1;
+
+		LockElement(element, &elementPtr);
+		used += crc_packELEMENT(stateBuf + used, elementPtr);
+		nextElement = GetSuccElement(elementPtr);
+		UnlockElement(element);
+	}
+
+	return used;
+}
+
+// Process the bytes that packState() would write, one element at a time,
+// without the need for stateBuf.
+static void
+processPackedState(crc_State *state, CrcAlgorithm algorithm) {
+	uint8 buf[CHECKSUM_ELEMENT_SIZE];
+	HELEMENT element;
+	HELEMENT nextElement;
+	DWORD seed;
+
+	seed = TFB_SeedRandom(0);
+	TFB_SeedRandom(seed);
+	packUint32(buf, (uint32) seed);
+	crc_processBuffer(state, algorithm, buf, 4);
+
+	for (element = GetHeadElement(); element != 0; element = nextElement) {
+		ELEMENT *elementPtr;
+		size_t size;
+
+		LockElement(element, &elementPtr);
+		size = crc_packELEMENT(buf, elementPtr);
+		nextElement = GetSuccElement(elementPtr);
+		UnlockElement(element);
+
+		crc_processBuffer(state, algorithm, buf, size);
+	}
+}
+
+// Returns the checksum of the current state of the battle, using the
+// algorithm agreed on for this battle.
+Checksum
+getStateChecksum(void) {
+	crc_State state;
+	size_t size;
+
+	crc_init(&state);
+#ifdef DUMP_CRC_OPS
+	// Go field by field, so that each step is logged.
+	if (battleChecksumAlgorithm == CrcAlgorithm_crc32) {
+		crc_processState(&state);
+		return (Checksum) crc_finish(&state);
+	}
+#endif
+
+	size = packState();
+	if (size == (size_t) -1) {
+		// Out of memory. Slower, but the same checksum.
+		log_add(log_Warning, "NETPLAY: Out of memory while computing "
+				"a checksum.");
+		processPackedState(&state, battleChecksumAlgorithm);
+	} else {
+		crc_processBuffer(&state, battleChecksumAlgorithm, stateBuf, size);
+	}
+	return (Checksum) crc_finish(&state);
+}
+
+// Returns the checksum algorithms this side offers to the other sides.
+uint16
+getLocalChecksumAlgorithms(void) {
+	return (uint16) (netplayOptions.checksumAlgorithms |
+			CRC_ALGORITHM_BIT(CrcAlgorithm_crc32)) & CRC_ALGORITHMS_ALL;
+}
+
+// Pick the checksum algorithm for the next battle; the best one that all
+// connected sides support.
+static void
+setupChecksumAlgorithm(void) {
+	uint16 algorithms = getLocalChecksumAlgorithms();
+	size_t player;
+
+	for (player = 0; player < NETPLAY_NUM_PLAYERS; player++) {
+		NetConnection *conn = netConnections[player];
+		if (conn == NULL)
+			continue;
+
+		algorithms &= NetConnection_getChecksumAlgorithms(conn);
+	}
+
+	battleChecksumAlgorithm = crc_chooseAlgorithm(algorithms);
+#ifdef NETPLAY_DEBUG
+	log_add(log_Debug, "NETPLAY: Using %s checksums.",
+			crc_algorithmName(battleChecksumAlgorithm));
+#endif
+}
+
+CrcAlgorithm
+getChecksumAlgorithm(void) {
+	return battleChecksumAlgorithm;
+}
+
+// The number of frames after the state of a frame has become final that
+// its checksums are compared.
+// A side sends its checksum for a frame once its own state for that
+// frame is final. In lockstep that is at the start of the frame; in
+// rollback mode it may be up to ROLLBACK_MAX_FRAMES later, as the
+// state may be a prediction until then. Either way, it sends the
+// checksum before it sends the input for the frame after that.
+// That input is needed to get 'delay + 1' frames further, so once the
+// local state is this many frames further, the checksum has arrived.
+size_t
+getChecksumDelay(void) {
+	return getBattleInputDelay() + ROLLBACK_MAX_FRAMES + 2;
+}
+
 void
 initChecksumBuffers(void) {
 	size_t player;
+	size_t window;
+
+	// A local checksum is kept from the moment its frame is final
+	// until the moment it is compared. As the final frame can advance
+	// ROLLBACK_MAX_FRAMES at once, that may be up to
+	// 'getChecksumDelay() + ROLLBACK_MAX_FRAMES' frames. A remote
+	// checksum may be received up to 'delay + ROLLBACK_MAX_FRAMES + 2'
+	// frames before its frame is final here (see
+	// PacketHandler_Checksum()). Both fit in:
+	window = 2 * getChecksumDelay() + 2;
+	nextVerifyFrame = 0;
+	setupChecksumAlgorithm();
 
 	for (player = 0; player < NETPLAY_NUM_PLAYERS; player++)
 	{
@@ -209,11 +450,10 @@ initChecksumBuffers(void) {
 			continue;
 
 		cb = NetConnection_getChecksumBuffer(conn);
-		ChecksumBuffer_init(cb, getBattleInputDelay(),
-				NETPLAY_CHECKSUM_INTERVAL);
+		ChecksumBuffer_init(cb, window, NETPLAY_CHECKSUM_INTERVAL);
 	}
 
-	ChecksumBuffer_init(&localChecksumBuffer, getBattleInputDelay(),
+	ChecksumBuffer_init(&localChecksumBuffer, window,
 			NETPLAY_CHECKSUM_INTERVAL);
 }
 
@@ -237,11 +477,15 @@ uninitChecksumBuffers(void)
 	}
 	
 	ChecksumBuffer_uninit(&localChecksumBuffer);
+
+	free(stateBuf);
+	stateBuf = NULL;
+	stateBufSize = 0;
 }
 
 void
 addLocalChecksum(BattleFrameCounter frameNr, Checksum checksum) {
-	assert(frameNr == battleFrameCount);
+	assert(frameNr <= Rollback_getFinalFrame());
 
 	ChecksumBuffer_addChecksum(&localChecksumBuffer, frameNr, checksum);
 }
@@ -251,8 +495,9 @@ addRemoteChecksum(NetConnection *conn, BattleFrameCounter frameNr,
 		Checksum checksum) {
 	ChecksumBuffer *cb;
 	
-	assert(frameNr <= battleFrameCount + getBattleInputDelay() + 1);
-	assert(frameNr + getBattleInputDelay() >= battleFrameCount);
+	assert(frameNr <= Rollback_getFinalFrame() + getBattleInputDelay()
+			+ ROLLBACK_MAX_FRAMES + 2);
+	assert(frameNr + getChecksumDelay() >= Rollback_getFinalFrame());
 
 	cb = NetConnection_getChecksumBuffer(conn);
 	ChecksumBuffer_addChecksum(cb, frameNr, checksum);
@@ -295,6 +540,22 @@ verifyChecksums(BattleFrameCounter frameNr) {
 	return true;
 }
 
+// Compare the checksums of the frames that are due, as determined by
+// getChecksumDelay().
+// Returns false if a checksum differs or is missing.
+bool
+verifyDueChecksums(void) {
+	BattleFrameCounter finalFrame = Rollback_getFinalFrame();
+	size_t delay = getChecksumDelay();
+
+	while (nextVerifyFrame + delay <= finalFrame) {
+		if (!verifyChecksums(nextVerifyFrame))
+			return false;
+		nextVerifyFrame += NETPLAY_CHECKSUM_INTERVAL;
+	}
+	return true;
+}
+
 
 #endif  /* NETPLAY_CHECKSUM */
 
@@ -84,13 +84,22 @@ void crc_processDispQueue(crc_State *state);
 void crc_processRNG(crc_State *state);
 void crc_processState(crc_State *state);
 
+#define CHECKSUM_ELEMENT_SIZE 35
+		// Bytes per element written by crc_packELEMENT().
+size_t crc_packELEMENT(uint8 *buf, const ELEMENT *val);
+Checksum getStateChecksum(void);
+uint16 getLocalChecksumAlgorithms(void);
+CrcAlgorithm getChecksumAlgorithm(void);
 
+
+size_t getChecksumDelay(void);
 void initChecksumBuffers(void);
 void uninitChecksumBuffers(void);
 void addLocalChecksum(BattleFrameCounter frameNr, Checksum checksum);
 void addRemoteChecksum(NetConnection *conn, BattleFrameCounter frameNr,
 		Checksum checksum);
 bool verifyChecksums(BattleFrameCounter frameNr);
+bool verifyDueChecksums(void);
 
 #if defined(__cplusplus)
 }
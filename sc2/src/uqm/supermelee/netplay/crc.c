@@ -25,6 +25,15 @@
 #	include "libs/log.h"
 #endif
 
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#	define CRC32C_SSE42
+		// The crc32 instruction of SSE 4.2 computes CRC-32C. It is used
+		// if the CPU has it, whatever the compiler flags.
+#	include <nmmintrin.h>
+#endif
+
 
 // CRC table for Polynomial 0x04c11db7 (0xedb88320 reversed)
 uint32 crcTable[256] = {
@@ -73,18 +82,121 @@ uint32 crcTable[256] = {
 	0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
 };
 
+// Tables for processing 8 bytes at a time ("slicing-by-8"). Entry 'i' of
+// table 'k' is the CRC of byte 'i' followed by 'k' zero bytes.
+static uint32 crc32Tables[8][256];
+static uint32 crc32cTables[8][256];
+static bool crcTablesInitialised = false;
+#ifdef CRC32C_SSE42
+static bool haveSse42 = false;
+#endif
+
+static void
+crc_makeTables(uint32 tables[8][256], uint32 poly) {
+	int i;
+	int k;
+
+	for (i = 0; i < 256; i++) {
+		uint32 crc = (uint32) i;
+		for (k = 0; k < 8; k++)
+			crc = (crc >> 1) ^ ((crc & 1) ? poly : 0);
+		tables[0][i] = crc;
+	}
+
+	for (k = 1; k < 8; k++) {
+		for (i = 0; i < 256; i++) {
+			uint32 prev = tables[k - 1][i];
+			tables[k][i] = (prev >> 8) ^ tables[0][prev & 0xff];
+		}
+	}
+}
+
+static void
+crc_initTables(void) {
+	if (crcTablesInitialised)
+		return;
+
+	crc_makeTables(crc32Tables, 0xedb88320);
+	crc_makeTables(crc32cTables, 0x82f63b78);
+#ifdef CRC32C_SSE42
+	haveSse42 = __builtin_cpu_supports("sse4.2");
+#endif
+	crcTablesInitialised = true;
+}
+
+static inline uint32
+crc_load32(const uint8 *buf) {
+	return (uint32) buf[0] | ((uint32) buf[1] << 8) |
+			((uint32) buf[2] << 16) | ((uint32) buf[3] << 24);
+}
+
+static uint32
+crc_sliceBy8(const uint32 tables[8][256], uint32 crc, const uint8 *buf,
+		size_t bufLen) {
+	while (bufLen >= 8) {
+		uint32 lo = crc ^ crc_load32(buf);
+		uint32 hi = crc_load32(buf + 4);
+
+		crc = tables[7][lo & 0xff] ^ tables[6][(lo >> 8) & 0xff] ^
+				tables[5][(lo >> 16) & 0xff] ^ tables[4][lo >> 24] ^
+				tables[3][hi & 0xff] ^ tables[2][(hi >> 8) & 0xff] ^
+				tables[1][(hi >> 16) & 0xff] ^ tables[0][hi >> 24];
+		buf += 8;
+		bufLen -= 8;
+	}
+
+	while (bufLen > 0) {
+		crc = (crc >> 8) ^ tables[0][(crc ^ *buf) & 0xff];
+		buf++;
+		bufLen--;
+	}
+
+	return crc;
+}
+
+#ifdef CRC32C_SSE42
+__attribute__((target("sse4.2")))
+static uint32
+crc_crc32cSse42(uint32 crc, const uint8 *buf, size_t bufLen) {
+#ifdef __x86_64__
+	unsigned long long crc64 = crc;
+
+	while (bufLen >= 8) {
+		unsigned long long val;
+		memcpy(&val, buf, sizeof val);
+		crc64 = _mm_crc32_u64(crc64, val);
+		buf += 8;
+		bufLen -= 8;
+	}
+	crc = (uint32) crc64;
+#endif
+	while (bufLen >= 4) {
+		uint32 val;
+		memcpy(&val, buf, sizeof val);
+		crc = _mm_crc32_u32(crc, val);
+		buf += 4;
+		bufLen -= 4;
+	}
+	while (bufLen > 0) {
+		crc = _mm_crc32_u8(crc, *buf);
+		buf++;
+		bufLen--;
+	}
+	return crc;
+}
+#endif
+
 void
 crc_init(crc_State *state) {
 	state->crc = 0xffffffff;
 }
 
 void
-crc_processBytes(crc_State *state, uint8 *buf, size_t bufLen) {
-	uint8 *end = buf + bufLen;
-	uint32 newCrc = state->crc;
+crc_processBytes(crc_State *state, const uint8 *buf, size_t bufLen) {
+	uint32 newCrc;
 
-	while (buf < end)
-		newCrc = (newCrc >> 8) ^ crcTable[(newCrc ^ *buf) & 0xff];
+	crc_initTables();
+	newCrc = crc_sliceBy8(crc32Tables, state->crc, buf, bufLen);
 
 #ifdef DUMP_CRC_OPS
 	crc_log("crc_processBytes(%08x, [%zu bytes]) --> %08x.",
@@ -93,6 +205,39 @@ crc_processBytes(crc_State *state, uint8 *buf, size_t bufLen) {
 	state->crc = newCrc;
 }
 
+void
+crc_processBytesCrc32c(crc_State *state, const uint8 *buf, size_t bufLen) {
+	uint32 newCrc;
+
+	crc_initTables();
+#ifdef CRC32C_SSE42
+	if (haveSse42)
+		newCrc = crc_crc32cSse42(state->crc, buf, bufLen);
+	else
+#endif
+		newCrc = crc_sliceBy8(crc32cTables, state->crc, buf, bufLen);
+
+#ifdef DUMP_CRC_OPS
+	crc_log("crc_processBytesCrc32c(%08x, [%zu bytes]) --> %08x.",
+			state->crc, bufLen, newCrc);
+#endif
+	state->crc = newCrc;
+}
+
+void
+crc_processBuffer(crc_State *state, CrcAlgorithm algorithm,
+		const uint8 *buf, size_t bufLen) {
+	switch (algorithm) {
+		case CrcAlgorithm_crc32c:
+			crc_processBytesCrc32c(state, buf, bufLen);
+			break;
+		case CrcAlgorithm_crc32:
+		default:
+			crc_processBytes(state, buf, bufLen);
+			break;
+	}
+}
+
 void
 crc_processUint8(crc_State *state, uint8 val) {
 	uint32 newCrc = state->crc;
@@ -139,4 +284,36 @@ crc_finish(const crc_State *state) {
 	return ~state->crc;
 }
 
+// Pick the algorithm to use from a mask of CRC_ALGORITHM_BIT()s that are
+// supported by all sides. Both sides of a connection come to the same
+// choice. CRC-32 is always supported.
+CrcAlgorithm
+crc_chooseAlgorithm(uint16 algorithms) {
+	if (algorithms & CRC_ALGORITHM_BIT(CrcAlgorithm_crc32c))
+		return CrcAlgorithm_crc32c;
+	return CrcAlgorithm_crc32;
+}
+
+const char *
+crc_algorithmName(CrcAlgorithm algorithm) {
+	switch (algorithm) {
+		case CrcAlgorithm_crc32:
+			return "crc32";
+		case CrcAlgorithm_crc32c:
+			return "crc32c";
+		default:
+			return "unknown";
+	}
+}
+
+bool
+crc_haveHardwareCrc32c(void) {
+#ifdef CRC32C_SSE42
+	crc_initTables();
+	return haveSse42;
+#else
+	return false;
+#endif
+}
+
 
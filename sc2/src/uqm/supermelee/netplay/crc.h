@@ -33,13 +33,36 @@ struct crc_State {
 	uint32 crc;
 };
 
+// The checksum algorithms that can be used for the netplay sync checks.
+// The sides of a connection tell each other which ones they support, as
+// a bit mask; see crc_chooseAlgorithm().
+typedef enum {
+	CrcAlgorithm_crc32,
+			// CRC-32 (IEEE 802.3). Supported by every version.
+	CrcAlgorithm_crc32c,
+			// CRC-32C (Castagnoli); hardware accelerated on x86 with
+			// SSE 4.2.
+	CrcAlgorithm_num
+} CrcAlgorithm;
+
+#define CRC_ALGORITHM_BIT(alg) ((uint16) (1 << (alg)))
+#define CRC_ALGORITHMS_ALL ((uint16) ((1 << CrcAlgorithm_num) - 1))
+
 void crc_init(crc_State *state);
-void crc_processBytes(crc_State *state, uint8 *buf, size_t bufLen);
+void crc_processBytes(crc_State *state, const uint8 *buf, size_t bufLen);
+void crc_processBytesCrc32c(crc_State *state, const uint8 *buf,
+		size_t bufLen);
+void crc_processBuffer(crc_State *state, CrcAlgorithm algorithm,
+		const uint8 *buf, size_t bufLen);
 void crc_processUint8(crc_State *state, uint8 val);
 void crc_processUint16(crc_State *state, uint16 val);
 void crc_processUint32(crc_State *state, uint32 val);
 uint32 crc_finish(const crc_State *state);
 
+CrcAlgorithm crc_chooseAlgorithm(uint16 algorithms);
+const char *crc_algorithmName(CrcAlgorithm algorithm);
+bool crc_haveHardwareCrc32c(void);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -0,0 +1,212 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Micro-benchmark of the ways to checksum the battle state.
+//
+// Times the field by field CRC-32 of crc_processState() against the
+// packed state with the CRC-32 and CRC-32C backends, over synthetic
+// display queues of a few sizes. The packed CRC-32 must give the same
+// result as the field by field one, as both are used on the wire; the
+// benchmark fails if it does not.
+//
+// Started with --benchchecksum
+
+#ifdef NETPLAY
+
+#include "crcbench.h"
+
+#include "netplay.h"
+#include "checksum.h"
+#include "crc.h"
+#include "libs/log.h"
+#include "libs/timelib.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_MIN_RUNS 16
+#define BENCH_MIN_TIME (ONE_SECOND / 4)
+
+typedef enum {
+	BenchMethod_fields,
+	BenchMethod_packedCrc32,
+	BenchMethod_packedCrc32c,
+
+	BenchMethod_num
+} BenchMethod;
+
+static const char *benchMethodNames[BenchMethod_num] = {
+	"field by field crc32",
+	"packed crc32",
+	"packed crc32c",
+};
+
+static uint32 benchSeed;
+
+static uint16
+benchRandom(void) {
+	benchSeed = benchSeed * 1103515245 + 12345;
+	return (uint16) (benchSeed >> 16);
+}
+
+// Elements with arbitrary contents; some are background objects, which
+// are left out of the checksum.
+static void
+makeElements(ELEMENT *elements, size_t count) {
+	size_t i;
+
+	memset(elements, 0, count * sizeof *elements);
+	for (i = 0; i < count; i++) {
+		ELEMENT *e = &elements[i];
+
+		e->state_flags = (ELEMENT_FLAGS) benchRandom();
+		if (i % 8 != 0)
+			e->state_flags &= ~BACKGROUND_OBJECT;
+		else
+			e->state_flags |= BACKGROUND_OBJECT;
+		e->life_span = (COUNT) benchRandom();
+		e->crew_level = (COUNT) benchRandom();
+		e->mass_points = (BYTE) benchRandom();
+		e->turn_wait = (BYTE) benchRandom();
+		e->thrust_wait = (BYTE) benchRandom();
+		e->velocity.TravelAngle = (COUNT) benchRandom();
+		e->velocity.vector.width = (COORD) benchRandom();
+		e->velocity.vector.height = (COORD) benchRandom();
+		e->velocity.fract.width = (COORD) benchRandom();
+		e->velocity.fract.height = (COORD) benchRandom();
+		e->velocity.error.width = (COORD) benchRandom();
+		e->velocity.error.height = (COORD) benchRandom();
+		e->velocity.incr.width = (COORD) benchRandom();
+		e->velocity.incr.height = (COORD) benchRandom();
+		e->current.location.x = (COORD) benchRandom();
+		e->current.location.y = (COORD) benchRandom();
+		e->next.location.x = (COORD) benchRandom();
+		e->next.location.y = (COORD) benchRandom();
+	}
+}
+
+// Checksum the elements, the way getStateChecksum() does it for the
+// display queue. 'buf' has room for all of them.
+static uint32
+checksumElements(BenchMethod method, const ELEMENT *elements, size_t count,
+		uint8 *buf, size_t *bytes) {
+	crc_State state;
+	size_t used;
+	size_t i;
+
+	crc_init(&state);
+
+	if (method == BenchMethod_fields) {
+		crc_processUint32(&state, benchSeed);
+		for (i = 0; i < count; i++)
+			crc_processELEMENT(&state, &elements[i]);
+		*bytes = 0;
+		return crc_finish(&state);
+	}
+
+	buf[0] = (uint8) (benchSeed & 0xff);
+	buf[1] = (uint8) ((benchSeed >> 8) & 0xff);
+	buf[2] = (uint8) ((benchSeed >> 16) & 0xff);
+	buf[3] = (uint8) (benchSeed >> 24);
+	used = 4;
+	for (i = 0; i < count; i++)
+		used += crc_packELEMENT(buf + used, &elements[i]);
+	*bytes = used;
+
+	crc_processBuffer(&state, method == BenchMethod_packedCrc32c ?
+			CrcAlgorithm_crc32c : CrcAlgorithm_crc32, buf, used);
+	return crc_finish(&state);
+}
+
+// Returns false if the checksums do not match.
+static bool
+benchElementCount(size_t count) {
+	ELEMENT *elements;
+	uint8 *buf;
+	uint32 results[BenchMethod_num];
+	double nsFields = 0.0;
+	bool ok = true;
+	int method;
+
+	elements = malloc(count * sizeof *elements);
+	buf = malloc(4 + count * CHECKSUM_ELEMENT_SIZE);
+	if (elements == NULL || buf == NULL) {
+		log_add(log_Error, "Out of memory.");
+		free(elements);
+		free(buf);
+		return false;
+	}
+	makeElements(elements, count);
+
+	for (method = 0; method < BenchMethod_num; method++) {
+		TimeCount start;
+		TimeCount elapsed;
+		DWORD runs = 0;
+		size_t bytes = 0;
+		double ns;
+
+		start = GetTimeCounter();
+		do {
+			results[method] = checksumElements((BenchMethod) method,
+					elements, count, buf, &bytes);
+			runs++;
+			elapsed = GetTimeCounter() - start;
+		} while (runs < BENCH_MIN_RUNS || elapsed < BENCH_MIN_TIME);
+
+		ns = (double) elapsed * 1e9 / ONE_SECOND / runs;
+		if (method == BenchMethod_fields)
+			nsFields = ns;
+
+		log_add(log_User, "%5lu elements  %-22s %10.0f ns/state  "
+				"%6.2fx  (%lu bytes, checksum %08lx)",
+				(unsigned long) count, benchMethodNames[method], ns,
+				ns > 0.0 ? nsFields / ns : 0.0, (unsigned long) bytes,
+				(unsigned long) results[method]);
+	}
+
+	if (results[BenchMethod_packedCrc32] != results[BenchMethod_fields]) {
+		log_add(log_Error, "The packed CRC-32 differs from the field by "
+				"field one (%08lx vs %08lx).",
+				(unsigned long) results[BenchMethod_packedCrc32],
+				(unsigned long) results[BenchMethod_fields]);
+		ok = false;
+	}
+
+	free(buf);
+	free(elements);
+	return ok;
+}
+
+int
+crc_runBenchmark(void) {
+	static const size_t counts[] = { 16, 64, 256, 1024 };
+	bool ok = true;
+	size_t i;
+
+	log_add(log_User, "Checksum benchmark; CRC-32C is computed %s.",
+			crc_haveHardwareCrc32c() ? "with SSE 4.2" : "in software");
+
+	for (i = 0; i < sizeof counts / sizeof counts[0]; i++) {
+		benchSeed = (uint32) counts[i];
+		if (!benchElementCount(counts[i]))
+			ok = false;
+	}
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif  /* NETPLAY */
+
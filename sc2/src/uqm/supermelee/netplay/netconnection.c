@@ -141,6 +141,8 @@ NetConnection_open(int player, const NetplayPeerOptions *options,
 	conn->stateFlags.inputDelay = 0;
 #ifdef NETPLAY_CHECKSUM
 	conn->stateFlags.checksumInterval = NETPLAY_CHECKSUM_INTERVAL;
+	conn->stateFlags.checksumAlgorithms =
+			CRC_ALGORITHM_BIT(CrcAlgorithm_crc32);
 #endif
 
 #ifdef NETPLAY_STATISTICS
@@ -149,6 +151,9 @@ NetConnection_open(int player, const NetplayPeerOptions *options,
 		
 		conn->statistics.packetsReceived = 0;
 		conn->statistics.packetsSent = 0;
+		conn->statistics.bytesSent = 0;
+		conn->statistics.sendCalls = 0;
+		conn->statistics.flushes = 0;
 		for (i = 0; i < PACKET_NUM; i++)
 		{
 			conn->statistics.packetTypeReceived[i] = 0;
@@ -367,6 +372,11 @@ size_t
 NetConnection_getChecksumInterval(const NetConnection *conn) {
 	return conn->stateFlags.checksumInterval;
 }
+
+uint16
+NetConnection_getChecksumAlgorithms(const NetConnection *conn) {
+	return conn->stateFlags.checksumAlgorithms;
+}
 #endif  /* NETPLAY_CHECKSUM */
 
 #ifdef NETPLAY_STATISTICS
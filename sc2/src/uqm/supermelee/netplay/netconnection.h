@@ -77,6 +77,11 @@ struct NetStatistics {
 	size_t packetTypeReceived[PACKET_NUM];
 	size_t packetsSent;
 	size_t packetTypeSent[PACKET_NUM];
+	size_t bytesSent;
+	size_t sendCalls;
+			// Calls to send(), including those that were interrupted.
+	size_t flushes;
+			// Flushes of the packet queue that had something to send.
 };
 #endif
 
@@ -139,6 +144,10 @@ typedef struct {
 			 * connection. Use getBattleInputDelay() to get at it. */
 #ifdef NETPLAY_CHECKSUM
 	size_t checksumInterval;
+	uint16 checksumAlgorithms;
+			/* The checksum algorithms the remote side supports, as
+			 * a mask of CRC_ALGORITHM_BIT()s. Received in the Init
+			 * packet. */
 #endif
 } NetStateFlags;
 
@@ -228,6 +237,7 @@ int NetConnection_getPlayerNr(const NetConnection *conn);
 size_t NetConnection_getInputDelay(const NetConnection *conn);
 #ifdef NETPLAY_CHECKSUM
 ChecksumBuffer *NetConnection_getChecksumBuffer(NetConnection *conn);
+uint16 NetConnection_getChecksumAlgorithms(const NetConnection *conn);
 size_t NetConnection_getChecksumInterval(const NetConnection *conn);
 #endif
 #ifdef NETPLAY_STATISTICS
@@ -21,6 +21,8 @@
 
 #include "netplay.h"
 #include "netinput.h"
+#include "rollback.h"
+		// for ROLLBACK_MAX_FRAMES
 
 #include "../../intel.h"
 		// for NETWORK_CONTROL
@@ -68,7 +70,7 @@ BattleInputBuffer_uninit(BattleInputBuffer *bib) {
 void
 initBattleInputBuffers(void) {
 	size_t player;
-	int bufSize = BattleInput_inputDelay * 2 + 2;
+	int bufSize = BattleInput_inputDelay * 2 + 2 + 2 * ROLLBACK_MAX_FRAMES;
 	
 	// The input of frame n will be processed in frame 'n + delay'.
 	//
@@ -81,6 +83,10 @@ initBattleInputBuffers(void) {
 	// The input for these '2*delay + 2' frames are still
 	// unhandled by side 1, so it needs buffer space for this.
 	//
+	// In rollback mode, either side may play up to ROLLBACK_MAX_FRAMES
+	// frames beyond the input it has of the other side, which adds
+	// twice that.
+	//
 	// Initially the buffer is filled with inputDelay zeroes,
 	// so that a party can process at least that much frames.
 
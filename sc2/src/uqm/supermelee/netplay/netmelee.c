@@ -27,7 +27,9 @@
 #include "netmisc.h"
 #include "netsend.h"
 #include "notify.h"
+#include "notifyall.h"
 #include "packetq.h"
+#include "rollback.h"
 #include "proto/npconfirm.h"
 #include "proto/ready.h"
 #include "proto/reset.h"
@@ -40,6 +42,10 @@
 		// for NUM_PLAYERS
 #include "../../globdata.h"
 		// for GLOBAL
+#include "../../intel.h"
+		// for NETWORK_CONTROL
+#include "../../setup.h"
+		// for PlayerControl
 
 #include <errno.h>
 #include <stdlib.h>
@@ -368,6 +374,121 @@ networkBattleInput(NetworkInputContext *context, STARSHIP *StarShipPtr) {
 	return result;
 }
 
+static bool
+rollbackPollInput(size_t player, BATTLE_INPUT_STATE *input) {
+	return BattleInputBuffer_pop(getBattleInputBuffer(player), input);
+}
+
+// Like the waiting part of networkBattleInput(), for all connections.
+static bool
+rollbackWaitInput(void) {
+	size_t player;
+
+	netInput();
+	for (player = 0; player < NUM_PLAYERS; player++) {
+		NetConnection *conn = netConnections[player];
+		if (conn != NULL && !NetConnection_isConnected(conn)) {
+			// Connection aborted.
+			GLOBAL(CurrentActivity) |= CHECK_ABORT;
+			return false;
+		}
+	}
+
+	if (GLOBAL(CurrentActivity) & CHECK_ABORT)
+		return false;
+
+	netInputBlocking(MAX_BLOCK_TIME);
+	return true;
+}
+
+static void
+rollbackStateChecksum(BattleFrameCounter frameNr, Checksum checksum) {
+#ifdef NETPLAY_CHECKSUM
+	Netplay_NotifyAll_checksum((uint32) frameNr, (uint32) checksum);
+			// Sent along with the input of the frame.
+	addLocalChecksum(frameNr, checksum);
+#else
+	(void) frameNr;
+	(void) checksum;
+#endif
+}
+
+static const RollbackTransport netRollbackTransport = {
+	/* .pollInput     = */ rollbackPollInput,
+	/* .waitInput     = */ rollbackWaitInput,
+	/* .sendInput     = */ NULL,
+	/* .stateChecksum = */ rollbackStateChecksum,
+	/* .frameInput    = */ NULL,
+};
+
+// Start rollback mode for the battle that is about to start, if it is
+// enabled and some side is network controlled.
+// Returns true if rollback mode was started.
+bool
+initBattleRollback(void) {
+	bool remote[NUM_PLAYERS];
+	size_t player;
+
+	if (!netplayOptions.rollback || getNumNetConnections() == 0)
+		return false;
+
+	for (player = 0; player < NUM_PLAYERS; player++)
+		remote[player] = (PlayerControl[player] & NETWORK_CONTROL) != 0;
+
+	return Rollback_init(&netRollbackTransport, remote);
+}
+
+#ifdef NETPLAY_STATISTICS
+static NetStatistics battleStartStatistics[NUM_PLAYERS];
+#endif
+
+// Remember the traffic counters of the connections at the start of
+// a battle, for reportBattleStatistics().
+void
+startBattleStatistics(void) {
+#ifdef NETPLAY_STATISTICS
+	COUNT player;
+
+	for (player = 0; player < NUM_PLAYERS; player++) {
+		NetConnection *conn = netConnections[player];
+		if (conn != NULL)
+			battleStartStatistics[player] = *NetConnection_getStatistics(conn);
+	}
+#endif
+}
+
+// Log how much was sent over each connection per frame in the battle
+// that has just ended, which lasted 'frameCount' frames.
+void
+reportBattleStatistics(BattleFrameCounter frameCount) {
+#ifdef NETPLAY_STATISTICS
+	COUNT player;
+
+	if (frameCount == 0)
+		return;
+
+	for (player = 0; player < NUM_PLAYERS; player++) {
+		NetConnection *conn = netConnections[player];
+		const NetStatistics *start = &battleStartStatistics[player];
+		const NetStatistics *now;
+
+		if (conn == NULL)
+			continue;
+
+		now = NetConnection_getStatistics(conn);
+		log_add(log_Debug, "NETPLAY: [%d] Sent in %lu battle frames: "
+				"%.2f packets, %.1f bytes, %.2f flushes, %.2f send calls "
+				"per frame.", player, (unsigned long) frameCount,
+				(double) (now->packetsSent - start->packetsSent) / frameCount,
+				(double) (now->bytesSent - start->bytesSent) / frameCount,
+				(double) (now->flushes - start->flushes) / frameCount,
+				(double) (now->sendCalls - start->sendCalls) / frameCount);
+	}
+#else
+	(void) frameCount;
+#endif
+}
+
 static void
 deleteConnectionCallback(NetConnection *conn) {
 	removeNetConnection(NetConnection_getPlayerNr(conn));
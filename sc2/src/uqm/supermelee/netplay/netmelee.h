@@ -24,6 +24,8 @@
 #include "netconnection.h"
 #include "packetsenders.h"
 
+#include "../../battle.h"
+		// for BattleFrameCounter
 #include "../../battlecontrols.h"
 		// for NetworkInputContext
 #include "../../controls.h"
@@ -64,6 +66,9 @@ void setBattleStateConnections(struct battlestate_struct *bs);
 
 BATTLE_INPUT_STATE networkBattleInput(NetworkInputContext *context,
 		STARSHIP *StarShipPtr);
+bool initBattleRollback(void);
+void startBattleStatistics(void);
+void reportBattleStatistics(BattleFrameCounter frameCount);
 
 NetConnection *openPlayerNetworkConnection(COUNT player, void *extra);
 void closePlayerNetworkConnection(COUNT player);
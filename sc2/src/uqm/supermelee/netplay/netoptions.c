@@ -17,6 +17,8 @@
  */
 
 #include "netoptions.h"
+#include "crc.h"
+		// for CRC_ALGORITHMS_ALL
 
 NetplayOptions netplayOptions = {
 	/* .metaServer = */ "uqm.stack.nl",
@@ -34,6 +36,8 @@ NetplayOptions netplayOptions = {
 		},
 	},
 	/* .inputDelay = */ 2,
+	/* .rollback   = */ false,
+	/* .checksumAlgorithms = */ CRC_ALGORITHMS_ALL,
 };
 
 
@@ -45,6 +45,13 @@ typedef struct {
 			// May be given as a service name.
 	NetplayPeerOptions peer[NETPLAY_NUM_PLAYERS];
 	size_t inputDelay;
+	bool rollback;
+			// Predict the remote input instead of waiting for it.
+			// See rollback.h.
+	uint16 checksumAlgorithms;
+			// The checksum algorithms to offer for the sync checks, as
+			// a mask of CRC_ALGORITHM_BIT()s (see crc.h). CRC-32 is
+			// always offered.
 } NetplayOptions;
 extern NetplayOptions netplayOptions;
 
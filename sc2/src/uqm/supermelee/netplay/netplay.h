@@ -25,7 +25,7 @@
 #define NETPLAY_FULL  2
 
 #define NETPLAY_PROTOCOL_VERSION_MAJOR 0
-#define NETPLAY_PROTOCOL_VERSION_MINOR 4
+#define NETPLAY_PROTOCOL_VERSION_MINOR 6
 
 #define NETPLAY_MIN_UQM_VERSION_MAJOR 0
 #define NETPLAY_MIN_UQM_VERSION_MINOR 6
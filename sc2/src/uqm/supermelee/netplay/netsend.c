@@ -32,38 +32,30 @@
 #include <string.h>
 
 
+// Send 'len' bytes from 'data' over the connection. All the data is sent,
+// unless an error occurs, in which case -1 is returned, with errno set.
+// The number of bytes that were sent is stored in '*sent' in either case.
 int
-sendPacket(NetConnection *conn, Packet *packet) {
+sendData(NetConnection *conn, const void *data, size_t len, size_t *sent) {
 	ssize_t sendResult;
-	size_t len;
+	size_t done = 0;
 	Socket *socket;
 		
 	assert(NetConnection_isConnected(conn));
 
-#ifdef NETPLAY_DEBUG
-	//if (packetType(packet) != PACKET_BATTLEINPUT && 
-	//		packetType(packet) != PACKET_CHECKSUM) {
-	//	// Reporting BattleInput or Checksum would get so spammy that it
-	//	// would slow down the battle.
-	//	log_add(log_Debug, "NETPLAY: [%d] ==> Sending packet of type %s.\n",
-	//			conn->player, packetTypeData[packetType(packet)].name);
-	//}
-#ifdef NETPLAY_DEBUG_FILE
-	if (conn->debugFile != NULL) {
-		uio_fprintf(conn->debugFile,
-				"NETPLAY: [%d] ==> Sending packet of type %s.\n",
-				conn->player, packetTypeData[packetType(packet)].name);
-	}
-#endif  /* NETPLAY_DEBUG_FILE */
-#endif  /* NETPLAY_DEBUG */
-
 	socket = NetDescriptor_getSocket(conn->nd);
 
-	len = packetLength(packet);
-	while (len > 0) {
-		sendResult = Socket_send(socket, (void *) packet, len, 0);
+	while (done < len) {
+		sendResult = Socket_send(socket, (const char *) data + done,
+				len - done, 0);
+#ifdef NETPLAY_STATISTICS
+		NetConnection_getStatistics(conn)->sendCalls++;
+#endif
 		if (sendResult >= 0) {
-			len -= sendResult;
+#ifdef NETPLAY_STATISTICS
+			NetConnection_getStatistics(conn)->bytesSent += sendResult;
+#endif
+			done += sendResult;
 			continue;
 		}
 
@@ -72,6 +64,7 @@ sendPacket(NetConnection *conn, Packet *packet) {
 				continue;
 			case ECONNRESET: {  // Connection reset by peer.
 				// keep errno
+				*sent = done;
 				return -1;
 			}
 			default: {
@@ -79,17 +72,13 @@ sendPacket(NetConnection *conn, Packet *packet) {
 				int savedErrno = errno;
 				log_add(log_Error, "send() failed: %s.\n", strerror(errno));
 				errno = savedErrno;
+				*sent = done;
 				return -1;
 			}
 		}
 	}
 
-#ifdef NETPLAY_STATISTICS
-	NetConnection_getStatistics(conn)->packetsSent++;
-	NetConnection_getStatistics(conn)->packetTypeSent[packetType(packet)]++;
-#endif
-
+	*sent = done;
 	return 0;
 }
 
-
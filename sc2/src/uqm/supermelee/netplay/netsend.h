@@ -21,11 +21,14 @@
 
 #include "packet.h"
 
+#include <sys/types.h>
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
 
-int sendPacket(NetConnection *conn, Packet *packet);
+int sendData(NetConnection *conn, const void *data, size_t len,
+		size_t *sent);
 
 
 #if defined(__cplusplus)
@@ -56,9 +56,53 @@ PacketTypeData packetTypeData[PACKET_NUM] = {
 	DEFINE_PACKETDATA(Reset),
 };
 
+// Most packets are small, and they are created and deleted at a high
+// rate during a battle. Blocks for those are recycled through a free list,
+// instead of going through malloc() and free() each time.
+#define PACKET_POOL_BLOCK_SIZE 64
+		// Large enough for every packet type, except for Fleet and
+		// TeamName packets with a lot of extra data.
+#define PACKET_POOL_MAX_FREE 64
+		// The maximum number of free blocks to hold on to.
+
+typedef union PacketPoolBlock PacketPoolBlock;
+union PacketPoolBlock {
+	PacketPoolBlock *next;
+	uint8 data[PACKET_POOL_BLOCK_SIZE];
+};
+
+static PacketPoolBlock *packetPoolFree = NULL;
+static size_t packetPoolNumFree = 0;
+
 static inline void *
 Packet_alloc(size_t size) {
-	return malloc(size);
+	PacketPoolBlock *block;
+
+	if (size > PACKET_POOL_BLOCK_SIZE)
+		return malloc(size);
+
+	block = packetPoolFree;
+	if (block == NULL)
+		return malloc(sizeof (PacketPoolBlock));
+
+	packetPoolFree = block->next;
+	packetPoolNumFree--;
+	return block;
+}
+
+static inline void
+Packet_free(void *ptr, size_t size) {
+	PacketPoolBlock *block = (PacketPoolBlock *) ptr;
+
+	if (size > PACKET_POOL_BLOCK_SIZE ||
+			packetPoolNumFree >= PACKET_POOL_MAX_FREE) {
+		free(ptr);
+		return;
+	}
+
+	block->next = packetPoolFree;
+	packetPoolFree = block;
+	packetPoolNumFree++;
 }
 
 static Packet *
@@ -78,16 +122,16 @@ Packet_create(PacketType type, size_t extraSize) {
 
 void
 Packet_delete(Packet *packet) {
-	free(packet);
+	Packet_free(packet, packetLength(packet));
 }
 
 Packet_Init *
-Packet_Init_create(void) {
+Packet_Init_create(uint16 checksumAlgorithms) {
 	Packet_Init *packet = (Packet_Init *) Packet_create(PACKET_INIT, 0);
 
 	packet->protoVersion.major = NETPLAY_PROTOCOL_VERSION_MAJOR;
 	packet->protoVersion.minor = NETPLAY_PROTOCOL_VERSION_MINOR;
-	packet->padding0 = 0;
+	packet->checksumAlgorithms = hton16(checksumAlgorithms);
 	packet->uqmVersion.major = UQM_MAJOR_VERSION;
 	packet->uqmVersion.minor = UQM_MINOR_VERSION;
 	packet->uqmVersion.patch = UQM_PATCH_VERSION;
@@ -139,7 +139,9 @@ typedef struct {
 		uint8 major;
 		uint8 minor;
 	} protoVersion; /* Protocol version */
-	uint16 padding0;  /* Set to 0 */
+	uint16 checksumAlgorithms;
+			/* The checksum algorithms supported by the sender; a mask of
+			 * CRC_ALGORITHM_BIT()s. */
 	struct {
 		uint8 major;
 		uint8 minor;
@@ -270,7 +272,7 @@ typedef struct {
 
 #ifndef PACKET_H_STANDALONE
 void Packet_delete(Packet *packet);
-Packet_Init *Packet_Init_create(void);
+Packet_Init *Packet_Init_create(uint16 checksumAlgorithms);
 Packet_Ping *Packet_Ping_create(uint32 id);
 Packet_Ack *Packet_Ack_create(uint32 id);
 Packet_Ready *Packet_Ready_create(void);
@@ -26,6 +26,7 @@
 #include "netinput.h"
 #include "netmisc.h"
 #include "packetsenders.h"
+#include "rollback.h"
 #include "proto/npconfirm.h"
 #include "proto/ready.h"
 #include "proto/reset.h"
@@ -118,6 +119,11 @@ PacketHandler_Init(NetConnection *conn, const Packet_Init *packet) {
 		return -1;
 	}
 
+#ifdef NETPLAY_CHECKSUM
+	conn->stateFlags.checksumAlgorithms =
+			ntoh16(packet->checksumAlgorithms) & CRC_ALGORITHMS_ALL;
+#endif
+
 	Netplay_remoteReady(conn);
 	
 	return 0;
@@ -556,6 +562,7 @@ PacketHandler_Checksum(NetConnection *conn, const Packet_Checksum *packet) {
 	uint32 checksum;
 	size_t delay;
 	size_t interval;
+	BattleFrameCounter finalFrame;
 #endif
 
 	if (conn->stateFlags.reset.localReset)
@@ -584,33 +591,33 @@ PacketHandler_Checksum(NetConnection *conn, const Packet_Checksum *packet) {
 				// essential.
 	}
 
-	// The checksum is sent at the beginning of a frame.
-	// If we're in frame n and have sent our input already,
-	// the remote side has got enough input to progress delay + 1 frames from
-	// frame n. The next frame is then n + delay + 1, for which we can
-	// receive a checksum.
-	if (frameNr > battleFrameCount + delay + 1) {
+	// The checksum is sent once the state of the frame is final; at the
+	// beginning of the frame in lockstep, up to ROLLBACK_MAX_FRAMES later
+	// in rollback mode.
+	// If the last frame of which our state is final is n, we have given
+	// our input for at most ROLLBACK_MAX_FRAMES + 1 frames after it.
+	// With the input delay, this lets the remote side get the state of
+	// frame n + delay + ROLLBACK_MAX_FRAMES + 1 final, at most.
+	finalFrame = Rollback_getFinalFrame();
+	if (frameNr > finalFrame + delay + ROLLBACK_MAX_FRAMES + 2) {
 		log_add(log_Warning, "NETPLAY: [%d] <== Received checksum "
-				"for a frame too far in the future (frame %u, current "
+				"for a frame too far in the future (frame %u, final "
 				"is %u, input delay is %u) -- discarding.", conn->player,
-				(unsigned int) frameNr, (unsigned int) battleFrameCount, (unsigned int) delay);
+				(unsigned int) frameNr, (unsigned int) finalFrame,
+				(unsigned int) delay);
 		return 0;
 				// No need to close the connection; checksums are not
 				// essential.
 	}
 
-	// We can progress delay more frames after the last frame for which we
-	// received input. If we call that frame n, we can complete frames
-	// n through n + delay - 1. While we are waiting for the next input,
-	// in frame n + delay,  we will first receive the checksum that the
-	// remote side sent at the start of frame n + 1.
-	// In this situation frameNr is n + 1, and battleFrameCount is
-	// n + delay.
-	if (frameNr + delay < battleFrameCount) {
+	// The checksums of a frame are compared getChecksumDelay() frames
+	// after it, by which time the remote checksum has arrived.
+	if (frameNr + getChecksumDelay() < finalFrame) {
 		log_add(log_Warning, "NETPLAY: [%d] <== Received checksum "
-				"for a frame too far in the past (frame %u, current "
+				"for a frame too far in the past (frame %u, final "
 				"is %u, input delay is %u) -- discarding.", conn->player,
-				(unsigned int) frameNr, (unsigned int) battleFrameCount, (unsigned int) delay);
+				(unsigned int) frameNr, (unsigned int) finalFrame,
+				(unsigned int) delay);
 		return 0;
 				// No need to close the connection; checksums are not
 				// essential.
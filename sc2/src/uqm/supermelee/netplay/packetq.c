@@ -30,15 +30,35 @@
 #include <stdlib.h>
 #include <string.h>
 
+#define PACKETQUEUE_MAX_FREE_LINKS 64
+		// The maximum number of unused links to hold on to.
+#define PACKETQUEUE_MIN_SENDBUF_SIZE 512
+
+// Links are recycled; a queue gets a few of them in every battle frame.
+static PacketQueueLink *freeLinks = NULL;
+static size_t numFreeLinks = 0;
+
 static inline PacketQueueLink *
 PacketQueueLink_alloc(void) {
-	// XXX: perhaps keep a pool of links?
-	return malloc(sizeof (PacketQueueLink));
+	PacketQueueLink *link = freeLinks;
+	if (link == NULL)
+		return malloc(sizeof (PacketQueueLink));
+
+	freeLinks = link->next;
+	numFreeLinks--;
+	return link;
 }
 
 static inline void
 PacketQueueLink_delete(PacketQueueLink *link) {
-	free(link);
+	if (numFreeLinks >= PACKETQUEUE_MAX_FREE_LINKS) {
+		free(link);
+		return;
+	}
+
+	link->next = freeLinks;
+	freeLinks = link;
+	numFreeLinks++;
 }
 
 // 'maxSize' should at least be 1
@@ -47,6 +67,10 @@ PacketQueue_init(PacketQueue *queue) {
 	queue->size = 0;
 	queue->first = NULL;
 	queue->end = &queue->first;
+	queue->sendBuf = NULL;
+	queue->sendBufSize = 0;
+	queue->sendStart = 0;
+	queue->sendEnd = 0;
 }
 
 static void
@@ -62,6 +86,7 @@ PacketQueue_deleteLinks(PacketQueueLink *link) {
 void
 PacketQueue_uninit(PacketQueue *queue) {
 	PacketQueue_deleteLinks(queue->first);
+	free(queue->sendBuf);
 }
 
 void
@@ -102,44 +127,122 @@ queuePacket(NetConnection *conn, Packet *packet) {
 #endif  /* NETPLAY_DEBUG */
 }
 
-// If an error occurs during sending, we leave the unsent packets in
-// the queue, and let the caller decide what to do with them.
-// This function may return -1 with errno EAGAIN or EWOULDBLOCK
-// if we're waiting for the other party to act first.
-static int
-flushPacketQueueLinks(NetConnection *conn, PacketQueueLink **first) {
+// Make room in the send buffer for 'len' more bytes.
+static bool
+PacketQueue_reserve(PacketQueue *queue, size_t len) {
+	size_t newSize;
+	uint8 *newBuf;
+
+	if (queue->sendStart > 0) {
+		// Move the unsent remainder of an earlier flush to the front.
+		memmove(queue->sendBuf, queue->sendBuf + queue->sendStart,
+				queue->sendEnd - queue->sendStart);
+		queue->sendEnd -= queue->sendStart;
+		queue->sendStart = 0;
+	}
+
+	if (queue->sendEnd + len <= queue->sendBufSize)
+		return true;
+
+	newSize = queue->sendBufSize;
+	if (newSize < PACKETQUEUE_MIN_SENDBUF_SIZE)
+		newSize = PACKETQUEUE_MIN_SENDBUF_SIZE;
+	while (newSize < queue->sendEnd + len)
+		newSize *= 2;
+
+	newBuf = realloc(queue->sendBuf, newSize);
+	if (newBuf == NULL)
+		return false;
+
+	queue->sendBuf = newBuf;
+	queue->sendBufSize = newSize;
+	return true;
+}
+
+// Move the queued packets to the send buffer, in order.
+// If there is not enough memory, the packets that did not fit are left
+// in the queue.
+static bool
+PacketQueue_fillSendBuf(NetConnection *conn) {
+	PacketQueue *queue = &conn->queue;
 	PacketQueueLink *link;
 	PacketQueueLink *next;
-	PacketQueue *queue = &conn->queue;
-	
-	for (link = *first; link != NULL; link = next) {
-		if (sendPacket(conn, link->packet) == -1) {
-			// Errno is set.
-			*first = link;
-			return -1;
+	size_t len = 0;
+
+	for (link = queue->first; link != NULL; link = link->next)
+		len += packetLength(link->packet);
+	if (len == 0)
+		return true;
+
+	if (!PacketQueue_reserve(queue, len))
+		return false;
+
+	for (link = queue->first; link != NULL; link = next) {
+		Packet *packet = link->packet;
+		size_t packetLen = packetLength(packet);
+
+#ifdef NETPLAY_DEBUG_FILE
+		if (conn->debugFile != NULL) {
+			uio_fprintf(conn->debugFile,
+					"NETPLAY: [%d] ==> Sending packet of type %s.\n",
+					conn->player, packetTypeData[packetType(packet)].name);
 		}
-		
+#endif  /* NETPLAY_DEBUG_FILE */
+#ifdef NETPLAY_STATISTICS
+		NetConnection_getStatistics(conn)->packetsSent++;
+		NetConnection_getStatistics(conn)->packetTypeSent[
+				packetType(packet)]++;
+#endif
+
+		memcpy(queue->sendBuf + queue->sendEnd, packet, packetLen);
+		queue->sendEnd += packetLen;
+
 		next = link->next;
-		Packet_delete(link->packet);
+		Packet_delete(packet);
 		PacketQueueLink_delete(link);
 		queue->size--;
 	}
 
-	*first = link;
-	return 0;
+	queue->first = NULL;
+	queue->end = &queue->first;
+	return true;
 }
 
+// All the packets that are queued are sent together, with as few system
+// calls as possible.
+// If an error occurs during sending, the unsent data is kept, and it
+// will be sent first on the next flush; the caller decides whether there
+// is going to be one.
+// This function may return -1 with errno EAGAIN or EWOULDBLOCK
+// if we're waiting for the other party to act first.
 int
 flushPacketQueue(NetConnection *conn) {
-	int flushResult;
 	PacketQueue *queue = &conn->queue;
+	size_t sent;
+	int sendResult;
 	
 	assert(NetConnection_isConnected(conn));
 
-	flushResult = flushPacketQueueLinks(conn, &queue->first);
-	if (queue->first == NULL)
-		queue->end = &queue->first;
-	if (flushResult == -1) {
+	if (!PacketQueue_fillSendBuf(conn)) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	if (queue->sendStart == queue->sendEnd)
+		return 0;
+
+#ifdef NETPLAY_STATISTICS
+	NetConnection_getStatistics(conn)->flushes++;
+#endif
+	sendResult = sendData(conn, queue->sendBuf + queue->sendStart,
+			queue->sendEnd - queue->sendStart, &sent);
+	queue->sendStart += sent;
+	if (queue->sendStart == queue->sendEnd) {
+		queue->sendStart = 0;
+		queue->sendEnd = 0;
+	}
+
+	if (sendResult == -1) {
 		// errno is set
 		return -1;
 	}
@@ -43,6 +43,16 @@ struct PacketQueue {
 
 	// first points to the first entry in the queue
 	// end points to the location where the next message should be inserted.
+
+	uint8 *sendBuf;
+	size_t sendBufSize;
+	size_t sendStart;
+	size_t sendEnd;
+
+	// On a flush, the queued packets are copied to sendBuf, so that they
+	// can be sent together in one go.
+	// sendStart and sendEnd delimit the part of sendBuf that has not been
+	// sent yet. This is only non-empty between flushes if a send failed.
 };
 
 void PacketQueue_init(PacketQueue *queue);
@@ -22,13 +22,20 @@
 #include "packet.h"
 #include "packetq.h"
 #include "netsend.h"
+#ifdef NETPLAY_CHECKSUM
+#	include "checksum.h"
+#endif
 
 
 void
 sendInit(NetConnection *conn) {
 	Packet_Init *packet;
 
-	packet = Packet_Init_create();
+#ifdef NETPLAY_CHECKSUM
+	packet = Packet_Init_create(getLocalChecksumAlgorithms());
+#else
+	packet = Packet_Init_create(0);
+#endif
 	queuePacket(conn, (Packet *) packet);
 }
 
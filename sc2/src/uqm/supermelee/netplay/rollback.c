@@ -0,0 +1,399 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef NETPLAY
+
+#include "rollback.h"
+
+#include "netplay.h"
+#include "checksum.h"
+#include "../../battle.h"
+#include "../../battlesnap.h"
+#include "../../init.h"
+		// for NUM_PLAYERS
+#include "../../process.h"
+		// for SimulateQueue()
+#include "libs/log.h"
+
+#include <string.h>
+
+
+#define ROLLBACK_RING (ROLLBACK_MAX_FRAMES + 2)
+		// Room for the frames from the first one of which the input is
+		// not final, up to the current one, and the local input given
+		// before the battle was taken back to an earlier frame.
+#define NO_FRAME ((BattleFrameCounter) -1)
+
+typedef struct {
+	BattleFrameCounter frameNr;
+			// The frame the snapshot is of, or NO_FRAME.
+	BATTLE_SNAPSHOT *snapshot;
+	Checksum checksum;
+			// Of the state at the start of the frame.
+	BATTLE_INPUT_STATE input[NUM_PLAYERS];
+			// The input the frame is played with. For a remote player
+			// whose input has not arrived yet, this is the prediction.
+} RollbackFrame;
+
+static bool rollbackActive = false;
+static const RollbackTransport *rollbackTransport;
+static bool remotePlayer[NUM_PLAYERS];
+static RollbackFrame rollbackFrames[ROLLBACK_RING];
+
+static BattleFrameCounter remoteInputCount[NUM_PLAYERS];
+		// For each remote player, the number of frames for which its
+		// input has arrived.
+static BATTLE_INPUT_STATE lastRemoteInput[NUM_PLAYERS];
+		// The last input to arrive from each remote player. This is the
+		// prediction for the frames after it.
+static BattleFrameCounter localInputCount;
+		// The number of frames for which the local input is known. When
+		// the battle has been taken back to a frame before the current
+		// one, the local input that was already given (and sent) for the
+		// frames after it is used again.
+static BattleFrameCounter nextChecksumFrame;
+static BattleFrameCounter nextInputFrame;
+
+static struct {
+	DWORD frames;
+	DWORD predicted;
+	DWORD rollbacks;
+	DWORD replayed;
+	DWORD rewinds;
+	DWORD stalls;
+	BattleFrameCounter maxDepth;
+} rollbackStats;
+
+
+static inline RollbackFrame *
+getFrame(BattleFrameCounter frameNr) {
+	return &rollbackFrames[frameNr % ROLLBACK_RING];
+}
+
+// Returns the number of frames for which the input of all players is
+// final.
+static BattleFrameCounter
+getInputCount(void) {
+	BattleFrameCounter count = localInputCount;
+	size_t player;
+
+	for (player = 0; player < NUM_PLAYERS; player++) {
+		if (remotePlayer[player] && remoteInputCount[player] < count)
+			count = remoteInputCount[player];
+	}
+	return count;
+}
+
+bool
+Rollback_init(const RollbackTransport *transport, const bool *remote) {
+	size_t i;
+
+	memset(rollbackFrames, 0, sizeof rollbackFrames);
+	for (i = 0; i < ROLLBACK_RING; i++) {
+		rollbackFrames[i].frameNr = NO_FRAME;
+		rollbackFrames[i].snapshot = CreateBattleSnapshot();
+		if (rollbackFrames[i].snapshot == NULL) {
+			log_add(log_Error, "NETPLAY: Could not allocate the battle "
+					"snapshots; playing in lockstep.");
+			Rollback_uninit();
+			return false;
+		}
+	}
+
+	for (i = 0; i < NUM_PLAYERS; i++) {
+		remotePlayer[i] = remote[i];
+		remoteInputCount[i] = 0;
+		lastRemoteInput[i] = (BATTLE_INPUT_STATE) 0;
+	}
+	localInputCount = 0;
+	nextChecksumFrame = 0;
+	nextInputFrame = 0;
+	memset(&rollbackStats, 0, sizeof rollbackStats);
+
+	rollbackTransport = transport;
+	rollbackActive = true;
+	return true;
+}
+
+void
+Rollback_uninit(void) {
+	size_t i;
+
+	if (rollbackActive) {
+		log_add(log_Info, "NETPLAY: Rollback: %lu frames, %lu of which "
+				"on predicted input; %lu rollbacks (deepest %lu frames), "
+				"%lu frames replayed, %lu rewinds, %lu stalls.",
+				(unsigned long) rollbackStats.frames,
+				(unsigned long) rollbackStats.predicted,
+				(unsigned long) rollbackStats.rollbacks,
+				(unsigned long) rollbackStats.maxDepth,
+				(unsigned long) rollbackStats.replayed,
+				(unsigned long) rollbackStats.rewinds,
+				(unsigned long) rollbackStats.stalls);
+	}
+
+	for (i = 0; i < ROLLBACK_RING; i++) {
+		DestroyBattleSnapshot(rollbackFrames[i].snapshot);
+		rollbackFrames[i].snapshot = NULL;
+		rollbackFrames[i].frameNr = NO_FRAME;
+	}
+	rollbackTransport = NULL;
+	rollbackActive = false;
+}
+
+bool
+Rollback_active(void) {
+	return rollbackActive;
+}
+
+// Returns true if the local input for the current frame is still to be
+// given, through Rollback_setInput().
+bool
+Rollback_startLocalInput(void) {
+	RollbackFrame *frame;
+	size_t player;
+
+	if (battleFrameCount < localInputCount)
+		return false;
+
+	assert(battleFrameCount == localInputCount);
+	frame = getFrame(battleFrameCount);
+	for (player = 0; player < NUM_PLAYERS; player++) {
+		if (!remotePlayer[player])
+			frame->input[player] = (BATTLE_INPUT_STATE) 0;
+	}
+	return true;
+}
+
+void
+Rollback_setInput(size_t player, BATTLE_INPUT_STATE input) {
+	if (remotePlayer[player]) {
+		rollbackTransport->sendInput(player, input);
+		return;
+	}
+	getFrame(battleFrameCount)->input[player] = input;
+}
+
+// Returns the input to play the frame with; the prediction if the input
+// is not there yet.
+static BATTLE_INPUT_STATE
+frameInput(BattleFrameCounter frameNr, size_t player) {
+	RollbackFrame *frame = getFrame(frameNr);
+
+	if (remotePlayer[player] && remoteInputCount[player] <= frameNr)
+		frame->input[player] = lastRemoteInput[player];
+	return frame->input[player];
+}
+
+BATTLE_INPUT_STATE
+Rollback_getInput(size_t player) {
+	return frameInput(battleFrameCount, player);
+}
+
+// Take in the remote input that has arrived, up to that for the current
+// frame. Returns the first frame that was played with a different
+// prediction, or NO_FRAME.
+static BattleFrameCounter
+receiveInput(void) {
+	BattleFrameCounter mispredicted = NO_FRAME;
+	size_t player;
+
+	for (player = 0; player < NUM_PLAYERS; player++) {
+		if (!remotePlayer[player])
+			continue;
+
+		while (remoteInputCount[player] <= battleFrameCount) {
+			BattleFrameCounter frameNr = remoteInputCount[player];
+			RollbackFrame *frame = getFrame(frameNr);
+			BATTLE_INPUT_STATE input;
+
+			if (!rollbackTransport->pollInput(player, &input))
+				break;
+
+			if (frameNr < battleFrameCount && frame->input[player] != input
+					&& frameNr < mispredicted)
+				mispredicted = frameNr;
+
+			frame->input[player] = input;
+			lastRemoteInput[player] = input;
+			remoteInputCount[player]++;
+		}
+	}
+
+	return mispredicted;
+}
+
+static void
+recordChecksum(BattleFrameCounter frameNr) {
+#ifdef NETPLAY_CHECKSUM
+	if (frameNr % NETPLAY_CHECKSUM_INTERVAL == 0)
+		getFrame(frameNr)->checksum = getStateChecksum();
+#else
+	(void) frameNr;
+#endif
+}
+
+static bool
+saveFrame(BattleFrameCounter frameNr) {
+	RollbackFrame *frame = getFrame(frameNr);
+
+	if (!SaveBattleSnapshot(frame->snapshot)) {
+		log_add(log_Warning, "NETPLAY: Could not save the state of "
+				"frame %u; playing it in lockstep.", (unsigned int) frameNr);
+		frame->frameNr = NO_FRAME;
+		return false;
+	}
+	frame->frameNr = frameNr;
+	return true;
+}
+
+static void
+playFrame(BattleFrameCounter frameNr) {
+	BATTLE_INPUT_STATE input[NUM_PLAYERS];
+	size_t player;
+
+	for (player = 0; player < NUM_PLAYERS; player++)
+		input[player] = frameInput(frameNr, player);
+	ApplyBattleInputs(input);
+}
+
+// Take the battle back to the start of frame 'from', and play the frames
+// from there up to the current one again.
+// If one of these frames turns out not to be reversible, the current
+// frame becomes that frame; it will be played in lockstep, and shown.
+// This is also done if the input for the frame is final, as a ship may
+// die or be replaced in it.
+static void
+replayFrames(BattleFrameCounter from) {
+	BattleFrameCounter end = battleFrameCount;
+	BattleFrameCounter frameNr;
+
+	assert(getFrame(from)->frameNr == from);
+	RestoreBattleSnapshot(getFrame(from)->snapshot);
+
+	rollbackStats.rollbacks++;
+	if (end - from > rollbackStats.maxDepth)
+		rollbackStats.maxDepth = end - from;
+
+	for (frameNr = from; frameNr < end; frameNr++) {
+		battleFrameCount = frameNr;
+		if (frameNr != from) {
+			recordChecksum(frameNr);
+			if (!BattleFrameReversible())
+				break;
+			if (frameNr >= getInputCount() && !saveFrame(frameNr))
+				break;
+		}
+		playFrame(frameNr);
+		SimulateQueue();
+		rollbackStats.replayed++;
+	}
+
+	battleFrameCount = frameNr;
+	if (frameNr != end) {
+		rollbackStats.rewinds++;
+#ifdef NETPLAY_DEBUG
+		log_add(log_Debug, "NETPLAY: Rollback: went back from frame %u "
+				"to frame %u.", (unsigned int) end, (unsigned int) frameNr);
+#endif
+	}
+}
+
+// Report the checksums and the input of the frames that have become
+// final.
+static void
+reportFinalFrames(void) {
+	BattleFrameCounter inputCount = getInputCount();
+	BattleFrameCounter finalFrame = Rollback_getFinalFrame();
+
+#ifdef NETPLAY_CHECKSUM
+	while (nextChecksumFrame <= finalFrame) {
+		if (nextChecksumFrame % NETPLAY_CHECKSUM_INTERVAL == 0)
+			rollbackTransport->stateChecksum(nextChecksumFrame,
+					getFrame(nextChecksumFrame)->checksum);
+		nextChecksumFrame++;
+	}
+#else
+	(void) finalFrame;
+#endif
+
+	if (rollbackTransport->frameInput == NULL)
+		return;
+	while (nextInputFrame < inputCount) {
+		rollbackTransport->frameInput(nextInputFrame,
+				getFrame(nextInputFrame)->input);
+		nextInputFrame++;
+	}
+}
+
+// Called at the start of each frame, after the local input for it has
+// been given. Takes in the remote input, goes back and plays the
+// mispredicted frames again if needed, and waits for remote input if
+// the current frame cannot be played on a prediction.
+// Afterwards, Rollback_getInput() gives the input to play the frame
+// with. battleFrameCount may have gone back.
+// Returns false if the battle is to be aborted.
+bool
+Rollback_beginFrame(void) {
+	if (battleFrameCount == localInputCount)
+		localInputCount++;
+
+	for (;;) {
+		BattleFrameCounter mispredicted;
+		BattleFrameCounter inputCount;
+
+		mispredicted = receiveInput();
+		if (mispredicted != NO_FRAME)
+			replayFrames(mispredicted);
+
+		inputCount = getInputCount();
+		if (inputCount > battleFrameCount)
+			break;  // The input for this frame is final.
+
+		if (battleFrameCount - inputCount < ROLLBACK_MAX_FRAMES &&
+				BattleFrameReversible() && saveFrame(battleFrameCount)) {
+			rollbackStats.predicted++;
+			break;
+		}
+
+		rollbackStats.stalls++;
+		if (!rollbackTransport->waitInput())
+			return false;
+	}
+
+	recordChecksum(battleFrameCount);
+	reportFinalFrames();
+	rollbackStats.frames++;
+	return true;
+}
+
+// Returns the number of the last frame whose state at the start is final;
+// that is, of which every frame before it was played with final input.
+// In lockstep, this is the current frame.
+BattleFrameCounter
+Rollback_getFinalFrame(void) {
+	BattleFrameCounter inputCount;
+
+	if (!rollbackActive)
+		return battleFrameCount;
+
+	inputCount = getInputCount();
+
+	return inputCount < battleFrameCount ? inputCount : battleFrameCount;
+}
+
+#endif  /* NETPLAY */
+
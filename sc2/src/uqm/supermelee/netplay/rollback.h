@@ -0,0 +1,100 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#if !defined(UQM_SUPERMELEE_NETPLAY_ROLLBACK_H_) && defined(NETPLAY)
+#define UQM_SUPERMELEE_NETPLAY_ROLLBACK_H_
+
+#include "types.h"
+#include "checksum.h"
+		// for Checksum
+#include "../../battle.h"
+		// for BattleFrameCounter
+#include "../../controls.h"
+		// for BATTLE_INPUT_STATE
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Rollback mode for network battles.
+//
+// In the normal (lockstep) mode, a frame is not played until the input
+// of every player for that frame has arrived. The input delay hides the
+// latency of the connection, at the cost of making the controls
+// sluggish.
+// In rollback mode the input of the remote players is predicted instead
+// (they are expected to keep on doing what they did last), and the
+// frame is played right away. The state of the battle is saved at the
+// start of each frame that is played on a prediction. When the real
+// input turns out to be different, the battle is taken back to the
+// first frame that was mispredicted, and the frames from there are
+// played again with the right input, without drawing them.
+//
+// The input delay still applies to the local input, and the wire
+// protocol is unchanged; the input of each player is numbered
+// implicitly by the order in which it arrives.
+//
+// Frames in which a ship may die or be replaced, or the battle may end,
+// involve the ship selection and the other side, and cannot be taken
+// back (see BattleFrameReversible()). Those frames, and those more
+// than ROLLBACK_MAX_FRAMES ahead of the remote input, are played in
+// lockstep.
+//
+// Checksums are only taken of the states that are final. They are
+// compared getChecksumDelay() frames later, which leaves room for the
+// sides to be that far apart.
+
+#define ROLLBACK_MAX_FRAMES 12
+		// Half a second at the normal battle frame rate.
+
+typedef struct {
+	bool (*pollInput)(size_t player, BATTLE_INPUT_STATE *input);
+			// Get the next input of a remote player; that is, its input
+			// for the frame after the one of its previous input.
+			// Returns false if it has not arrived yet.
+	bool (*waitInput)(void);
+			// Wait until more input may have arrived.
+			// Returns false if the battle is to be aborted.
+	void (*sendInput)(size_t player, BATTLE_INPUT_STATE input);
+			// Only used for a player that is controlled locally, but
+			// that the transport treats as remote: the transport will
+			// return this input through pollInput() at some later time.
+			// May be NULL if there are no such players.
+	void (*stateChecksum)(BattleFrameCounter frameNr, Checksum checksum);
+			// Called in order for every frame divisible by
+			// NETPLAY_CHECKSUM_INTERVAL, once its state is final.
+	void (*frameInput)(BattleFrameCounter frameNr,
+			const BATTLE_INPUT_STATE *input);
+			// Called in order for every frame, once the input of every
+			// player for it is final. May be NULL.
+} RollbackTransport;
+
+bool Rollback_init(const RollbackTransport *transport, const bool *remote);
+void Rollback_uninit(void);
+bool Rollback_active(void);
+
+bool Rollback_startLocalInput(void);
+void Rollback_setInput(size_t player, BATTLE_INPUT_STATE input);
+bool Rollback_beginFrame(void);
+BATTLE_INPUT_STATE Rollback_getInput(size_t player);
+
+BattleFrameCounter Rollback_getFinalFrame(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif  /* UQM_SUPERMELEE_NETPLAY_ROLLBACK_H_ */
@@ -29,6 +29,7 @@
 #include "../master.h"
 #include "../nameref.h"
 #include "melee.h"
+#include "meleesim.h"
 #ifdef NETPLAY
 #	include "netplay/netmelee.h"
 #	include "netplay/netmisc.h"
@@ -279,7 +280,7 @@ selectShipComputer (ComputerInputContext *context, GETMELEE_STATE *gms)
 {
 #define COMPUTER_SELECTION_DELAY (ONE_SECOND >> 1)
 	TimeCount now = GetTimeCounter ();
-	if (now < gms->player[context->playerNr].timeIn +
+	if (!meleeSimActive && now < gms->player[context->playerNr].timeIn +
 			COMPUTER_SELECTION_DELAY)
 		return TRUE;
 
@@ -331,7 +332,8 @@ DoGetMelee (GETMELEE_STATE *gms)
 			Flash_process (gms->player[playerI].flashContext);
 	}
 
-	SleepThread (ONE_SECOND / 120);
+	if (!meleeSimActive)
+		SleepThread (ONE_SECOND / 120);
 
 #ifdef NETPLAY
 	netInput ();
@@ -661,6 +663,9 @@ MeleeGameOver (void)
 	negotiateReadyConnections(true, NetState_inSetup);
 #endif
 
+	if (meleeSimActive)
+		return;
+
 	TimeOut = GetTimeCounter () + (ONE_SECOND * 4);
 
 	PressState = PulsedInputState.menu[KEY_MENU_SELECT] ||
@@ -871,9 +876,12 @@ GetInitialMeleeStarShips (HSTARSHIP *result)
 	}
 
 	// Fade in
-	SleepThreadUntil (FadeScreen (FadeAllToColor, ONE_SECOND / 2)
-			+ ONE_SECOND / 60);
-	FlushColorXForms ();
+	if (!meleeSimActive)
+	{
+		SleepThreadUntil (FadeScreen (FadeAllToColor, ONE_SECOND / 2)
+				+ ONE_SECOND / 60);
+		FlushColorXForms ();
+	}
 
 	playerMask = 0;
 	for (playerI = 0; playerI < NUM_PLAYERS; playerI++)
@@ -27,6 +27,7 @@
 #include "status.h"
 #include "battle.h"
 #include "init.h"
+#include "supermelee/meleesim.h"
 #include "supermelee/pickmele.h"
 #ifdef NETPLAY
 #	include "supermelee/netplay/netmelee.h"
@@ -77,6 +78,11 @@ OpponentAlive (STARSHIP *TestStarShipPtr)
 static void
 PlayDitty (STARSHIP *ship)
 {
+	if (meleeSimActive)
+		return;
+			// Nobody is listening, and waiting for the ditty to end would
+			// tie the length of the battle to the wall clock.
+
 	PlayMusic (ship->RaceDescPtr->ship_data.victory_ditty, FALSE, 3);
 	dittyIsPlaying = TRUE;
 }
@@ -36,6 +36,7 @@
 #include "setup.h"
 #include "state.h"
 #include "libs/mathlib.h"
+#include "libs/proflib.h"
 #include "lua/luadebug.h"
 
 #include <stdio.h>
@@ -138,6 +139,9 @@ debugKeyPressed (void)
 			// This will cause tallyResourcesToFile to be called from the
 			// Starcon2Main loop. Calling it from here would give threading
 			// problems.
+	prof_dump ();
+			// Writes what the profiler has recorded, when run with
+			// --profile.
 
 	// Interactive:
 //	uio_debugInteractive(stdin, stdout, stderr);
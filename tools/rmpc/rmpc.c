@@ -0,0 +1,513 @@
+/*
+ *  Compile resource indices (.rmp files) into the binary form (.rmc files)
+ *  that the game loads in their place.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <getopt.h>
+
+#include "../shared/util.h"
+
+// These must match sc2/src/libs/resource/cindex.h, which describes the
+// format.
+#define CINDEX_MAGIC 0x434d5255
+#define CINDEX_VERSION 1
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t sourceSize;
+	uint32_t sourceHash;
+	uint32_t numEntries;
+	uint32_t numBuckets;
+	uint32_t stringsSize;
+	uint32_t reserved;
+} CIndexHeader;
+
+typedef struct {
+	uint32_t key;
+	uint32_t value;
+	uint32_t path;
+} CIndexEntry;
+
+static uint32_t
+cindex_hash(const char *data, size_t len, uint32_t seed) {
+	uint32_t hash = 0x811c9dc5 ^ (seed * 0x9e3779b9);
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (uint8_t) data[i];
+		hash *= 0x01000193;
+	}
+
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+typedef struct {
+	const char *key;
+	const char *value;
+	size_t line;
+			// Later lines override earlier ones with the same key.
+	uint32_t bucket;
+	uint32_t slot;
+} Property;
+
+typedef struct {
+	Property *props;
+	size_t numProps;
+	size_t maxProps;
+} PropertyList;
+
+static void usage(FILE *out);
+static char *readFile(const char *fileName, size_t *size);
+static void parseProperties(const char *fileName, char *data,
+		PropertyList *list);
+static void removeDuplicates(const char *fileName, PropertyList *list);
+static uint32_t *makePerfectHash(const char *fileName, PropertyList *list,
+		uint32_t *numBuckets);
+static void compile(const char *inName, const char *outName);
+
+int
+main(int argc, char *argv[]) {
+	const char *outName = NULL;
+	int i;
+
+	for (;;) {
+		int ch = getopt(argc, argv, "ho:");
+		if (ch == -1)
+			break;
+		switch (ch) {
+			case 'o':
+				outName = optarg;
+				break;
+			case 'h':
+				usage(stdout);
+				return EXIT_SUCCESS;
+			default:
+				usage(stderr);
+				return EXIT_FAILURE;
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc == 0 || (outName != NULL && argc != 1)) {
+		usage(stderr);
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < argc; i++) {
+		size_t len = strlen(argv[i]);
+		char *name;
+
+		if (outName != NULL) {
+			compile(argv[i], outName);
+			continue;
+		}
+
+		if (len < 4 || strcasecmp(argv[i] + len - 4, ".rmp") != 0)
+			fatal(false, "'%s' does not end in '.rmp'; use -o.\n", argv[i]);
+		name = malloc(len + 1);
+		if (name == NULL)
+			fatal(false, "Out of memory.\n");
+		memcpy(name, argv[i], len + 1);
+		name[len - 1] = (name[len - 1] == 'P') ? 'C' : 'c';
+		compile(argv[i], name);
+		free(name);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+static void
+usage(FILE *out) {
+	fprintf(out, "Usage: rmpc [-o output] index.rmp...\n"
+			"\tCompiles each 'name.rmp' into 'name.rmc', next to it.\n"
+			"\t-o  the file to write, for a single index\n"
+			"The game only uses a compiled index while the text index is "
+			"the same as\nthe one it was compiled from, so run this again "
+			"after editing one.\n");
+}
+
+static char *
+readFile(const char *fileName, size_t *size) {
+	FILE *in;
+	long len;
+	char *data;
+
+	in = fopen(fileName, "rb");
+	if (in == NULL)
+		fatal(true, "Could not open '%s'.\n", fileName);
+	if (fseek(in, 0, SEEK_END) == -1 || (len = ftell(in)) == -1 ||
+			fseek(in, 0, SEEK_SET) == -1)
+		fatal(true, "Could not determine the size of '%s'.\n", fileName);
+
+	data = malloc((size_t) len + 1);
+	if (data == NULL)
+		fatal(false, "Out of memory.\n");
+	if (fread(data, 1, (size_t) len, in) != (size_t) len)
+		fatal(true, "Could not read '%s'.\n", fileName);
+	fclose(in);
+
+	data[len] = '\0';
+	*size = (size_t) len;
+	return data;
+}
+
+static void
+addProperty(PropertyList *list, const char *key, const char *value,
+		size_t line) {
+	if (list->numProps == list->maxProps) {
+		list->maxProps = list->maxProps ? list->maxProps * 2 : 256;
+		list->props = realloc(list->props,
+				list->maxProps * sizeof *list->props);
+		if (list->props == NULL)
+			fatal(false, "Out of memory.\n");
+	}
+	list->props[list->numProps].key = key;
+	list->props[list->numProps].value = value;
+	list->props[list->numProps].line = line;
+	list->numProps++;
+}
+
+// The same rules as PropFile_from_string() in
+// sc2/src/libs/resource/propfile.c, which reads the text indices.
+static void
+parseProperties(const char *fileName, char *d, PropertyList *list) {
+	size_t len = strlen(d);
+	size_t i = 0;
+	size_t line = 1;
+
+	while (i < len) {
+		size_t keyStart, keyEnd, valueStart, valueEnd;
+
+		while (i < len && isspace((unsigned char) d[i])) {
+			if (d[i] == '\n')
+				line++;
+			i++;
+		}
+		if (i >= len)
+			break;
+		if (d[i] == '#') {
+			while (i < len && d[i] != '\n')
+				i++;
+			continue;
+		}
+		keyStart = i;
+		while (i < len && d[i] != '=' && d[i] != '\n' && d[i] != '#')
+			i++;
+		if (i >= len) {
+			fprintf(stderr, "%s:%lu: Warning: Bare keyword at EOF.\n",
+					fileName, (unsigned long) line);
+			break;
+		}
+		if (d[i] != '=') {
+			fprintf(stderr, "%s:%lu: Warning: Key without value.\n",
+					fileName, (unsigned long) line);
+			while (i < len && d[i] != '\n')
+				i++;
+			continue;
+		}
+		keyEnd = i;
+		while (keyEnd > keyStart && isspace((unsigned char) d[keyEnd - 1]))
+			keyEnd--;
+
+		i++;
+		while (i < len && d[i] != '#' && d[i] != '\n' &&
+				isspace((unsigned char) d[i]))
+			i++;
+		valueStart = i;
+		while (i < len && d[i] != '#' && d[i] != '\n')
+			i++;
+		valueEnd = i;
+		while (valueEnd > valueStart &&
+				isspace((unsigned char) d[valueEnd - 1]))
+			valueEnd--;
+		// Past the end of the line, before it may be overwritten.
+		while (i < len && d[i] != '\n')
+			i++;
+		i++;
+
+		d[keyEnd] = '\0';
+		d[valueEnd] = '\0';
+		addProperty(list, d + keyStart, d + valueStart, line);
+		line++;
+	}
+}
+
+static int
+compareProperties(const void *a, const void *b) {
+	const Property *propA = a;
+	const Property *propB = b;
+	int cmp = strcmp(propA->key, propB->key);
+
+	if (cmp != 0)
+		return cmp;
+	return (propA->line > propB->line) - (propA->line < propB->line);
+}
+
+static void
+removeDuplicates(const char *fileName, PropertyList *list) {
+	size_t i, j;
+
+	qsort(list->props, list->numProps, sizeof *list->props,
+			compareProperties);
+	j = 0;
+	for (i = 0; i < list->numProps; i++) {
+		if (i + 1 < list->numProps &&
+				strcmp(list->props[i].key, list->props[i + 1].key) == 0) {
+			fprintf(stderr, "%s:%lu: Warning: '%s' is overridden on line "
+					"%lu.\n", fileName, (unsigned long) list->props[i].line,
+					list->props[i].key,
+					(unsigned long) list->props[i + 1].line);
+			continue;
+		}
+		list->props[j++] = list->props[i];
+	}
+	list->numProps = j;
+}
+
+// Hash and displace: the keys are divided over buckets, and for every
+// bucket, the biggest first, a seed is searched for that sends all its
+// keys to entries that are still free.
+static uint32_t *
+makePerfectHash(const char *fileName, PropertyList *list,
+		uint32_t *numBuckets) {
+	uint32_t n = (uint32_t) list->numProps;
+	uint32_t buckets = (n + 1) / 2;
+	uint32_t *seeds;
+	uint32_t *bucketSize;
+	uint32_t *order;
+	uint32_t *bucketStart;
+	Property **members;
+	char *taken;
+	uint32_t i, b;
+
+	*numBuckets = buckets;
+	if (n == 0)
+		return NULL;
+
+	seeds = calloc(buckets, sizeof *seeds);
+	bucketSize = calloc(buckets, sizeof *bucketSize);
+	bucketStart = calloc(buckets + 1, sizeof *bucketStart);
+	order = malloc(buckets * sizeof *order);
+	members = malloc(n * sizeof *members);
+	taken = calloc(n, 1);
+	if (seeds == NULL || bucketSize == NULL || bucketStart == NULL ||
+			order == NULL || members == NULL || taken == NULL)
+		fatal(false, "Out of memory.\n");
+
+	for (i = 0; i < n; i++) {
+		Property *prop = &list->props[i];
+		prop->bucket = cindex_hash(prop->key, strlen(prop->key), 0) %
+				buckets;
+		bucketSize[prop->bucket]++;
+	}
+	for (b = 0; b < buckets; b++)
+		bucketStart[b + 1] = bucketStart[b] + bucketSize[b];
+	memset(bucketSize, 0, buckets * sizeof *bucketSize);
+	for (i = 0; i < n; i++) {
+		Property *prop = &list->props[i];
+		members[bucketStart[prop->bucket] + bucketSize[prop->bucket]++] =
+				prop;
+	}
+
+	// Biggest buckets first, by counting.
+	{
+		uint32_t maxSize = 0;
+		uint32_t size;
+		uint32_t numOrdered = 0;
+
+		for (b = 0; b < buckets; b++) {
+			if (bucketSize[b] > maxSize)
+				maxSize = bucketSize[b];
+		}
+		for (size = maxSize; size > 0; size--) {
+			for (b = 0; b < buckets; b++) {
+				if (bucketSize[b] == size)
+					order[numOrdered++] = b;
+			}
+		}
+		for (b = 0; b < buckets; b++) {
+			if (bucketSize[b] == 0)
+				order[numOrdered++] = b;
+		}
+	}
+
+	for (i = 0; i < buckets; i++) {
+		uint32_t seed;
+		uint32_t start, size;
+		uint32_t j, k;
+
+		b = order[i];
+		start = bucketStart[b];
+		size = bucketSize[b];
+		if (size == 0)
+			break;
+
+		for (seed = 1; ; seed++) {
+			if (seed == 0)
+				fatal(false, "%s: Could not find a perfect hash.\n",
+						fileName);
+			for (j = 0; j < size; j++) {
+				Property *prop = members[start + j];
+				prop->slot = cindex_hash(prop->key, strlen(prop->key),
+						seed) % n;
+				if (taken[prop->slot])
+					break;
+				for (k = 0; k < j; k++) {
+					if (members[start + k]->slot == prop->slot)
+						break;
+				}
+				if (k < j)
+					break;
+			}
+			if (j == size)
+				break;
+		}
+
+		seeds[b] = seed;
+		for (j = 0; j < size; j++)
+			taken[members[start + j]->slot] = 1;
+	}
+
+	free(taken);
+	free(members);
+	free(order);
+	free(bucketStart);
+	free(bucketSize);
+	return seeds;
+}
+
+static void
+compile(const char *inName, const char *outName) {
+	char *source;
+	char *data;
+	size_t sourceSize;
+	PropertyList list = { NULL, 0, 0 };
+	uint32_t *seeds;
+	CIndexHeader header;
+	CIndexEntry *entries;
+	char *strings;
+	size_t stringsSize;
+	size_t i;
+	FILE *out;
+
+	source = readFile(inName, &sourceSize);
+	if (sourceSize > UINT32_MAX)
+		fatal(false, "'%s' is too big.\n", inName);
+	data = malloc(sourceSize + 1);
+	if (data == NULL)
+		fatal(false, "Out of memory.\n");
+	memcpy(data, source, sourceSize + 1);
+
+	parseProperties(inName, data, &list);
+	removeDuplicates(inName, &list);
+	seeds = makePerfectHash(inName, &list, &header.numBuckets);
+
+	entries = calloc(list.numProps + 1, sizeof *entries);
+	stringsSize = 1;
+	for (i = 0; i < list.numProps; i++) {
+		stringsSize += strlen(list.props[i].key) + 1 +
+				strlen(list.props[i].value) + 1;
+	}
+	if (stringsSize > UINT32_MAX)
+		fatal(false, "'%s' is too big.\n", inName);
+	strings = malloc(stringsSize);
+	if (entries == NULL || strings == NULL)
+		fatal(false, "Out of memory.\n");
+
+	// Offset 0 is an empty string, so that there is always one.
+	stringsSize = 0;
+	strings[stringsSize++] = '\0';
+	for (i = 0; i < list.numProps; i++) {
+		const Property *prop = &list.props[i];
+		CIndexEntry *entry = &entries[prop->slot];
+		const char *colon = strchr(prop->value, ':');
+		size_t len;
+
+		if (colon == NULL) {
+			fprintf(stderr, "%s:%lu: Warning: '%s' has no type.\n", inName,
+					(unsigned long) prop->line, prop->key);
+		}
+
+		len = strlen(prop->key) + 1;
+		entry->key = (uint32_t) stringsSize;
+		memcpy(strings + stringsSize, prop->key, len);
+		stringsSize += len;
+
+		len = strlen(prop->value) + 1;
+		entry->value = (uint32_t) stringsSize;
+		entry->path = colon ? (uint32_t) (colon + 1 - prop->value) : 0;
+		memcpy(strings + stringsSize, prop->value, len);
+		stringsSize += len;
+	}
+
+	// Check that every key is found where the game will look for it.
+	for (i = 0; i < list.numProps; i++) {
+		const char *key = list.props[i].key;
+		uint32_t bucket = cindex_hash(key, strlen(key), 0) %
+				header.numBuckets;
+		uint32_t slot = cindex_hash(key, strlen(key), seeds[bucket]) %
+				(uint32_t) list.numProps;
+		if (strcmp(strings + entries[slot].key, key) != 0)
+			fatal(false, "%s: Internal error: the hash is not perfect.\n",
+					inName);
+	}
+
+	header.magic = CINDEX_MAGIC;
+	header.version = CINDEX_VERSION;
+	header.sourceSize = (uint32_t) sourceSize;
+	header.sourceHash = cindex_hash(source, sourceSize, 0);
+	header.numEntries = (uint32_t) list.numProps;
+	header.stringsSize = (uint32_t) stringsSize;
+	header.reserved = 0;
+
+	out = fopen(outName, "wb");
+	if (out == NULL)
+		fatal(true, "Could not open '%s' for writing.\n", outName);
+	if (fwrite(&header, sizeof header, 1, out) != 1 ||
+			(header.numBuckets > 0 && fwrite(seeds, sizeof *seeds,
+			header.numBuckets, out) != header.numBuckets) ||
+			(header.numEntries > 0 && fwrite(entries, sizeof *entries,
+			header.numEntries, out) != header.numEntries) ||
+			fwrite(strings, 1, stringsSize, out) != stringsSize ||
+			fclose(out) != 0) {
+		remove(outName);
+		fatal(true, "Could not write '%s'.\n", outName);
+	}
+
+	printf("%s: %lu resources in %lu buckets.\n", outName,
+			(unsigned long) header.numEntries,
+			(unsigned long) header.numBuckets);
+
+	free(strings);
+	free(entries);
+	free(seeds);
+	free(list.props);
+	free(data);
+	free(source);
+}